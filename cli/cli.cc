@@ -4,6 +4,8 @@
 #include <readline/readline.h>
 #include <readline/history.h>
 #include <fstream>
+#include <thread>
+#include <future>
 
 // Command parsing delimiters
 // TODO: update delimiters later
@@ -11,6 +13,9 @@
 
 // CVS file read delimiters
 #define CVS_DELIMITERS ","
+// bytes handed to the parser threads at a time by a parallel load
+#define CVS_CHUNK_SIZE (16 * 1024 * 1024)
+#define CVS_DEFAULT_THREADS 4
 #define CLI_TABLES "cli_tables"
 #define CLI_COLUMNS "cli_columns"
 #define CLI_INDEXES "cli_indexes"
@@ -138,7 +143,7 @@ RC CLI::process(const string input) {
         }
 
             ////////////////////////////////////////////
-            // load <tableName> <fileName>
+            // load <tableName> <fileName> [parallel [<numThreads>]]
             // drop index <indexName>
             // drop attribute <attributeName> from <tableName>
             ////////////////////////////////////////////
@@ -162,6 +167,13 @@ RC CLI::process(const string input) {
                 code = error("I expect <tableName>");
         }
 
+            ////////////////////////////////////////////
+            // analyze <tableName>
+            ////////////////////////////////////////////
+        else if (expect(tokenizer, "analyze")) {
+            code = analyze();
+        }
+
             ///////////////////////////////////////////////////////////////
             // insert into <tableName> tuple(attr1=val1, attr2=value2, ...)
             ///////////////////////////////////////////////////////////////
@@ -191,7 +203,16 @@ RC CLI::process(const string input) {
             ////////////////////////////////////////////
         else if (expect(tokenizer, "SELECT")) {
             Iterator *it = NULL;
-            code = run(query(it));
+            it = query(it);
+            code = it == NULL ? error("the query cannot be run") : run(it);
+            cout << endl;
+        }
+
+            ////////////////////////////////////////////
+            // EXPLAIN [ ANALYZE ] SELECT...
+            ////////////////////////////////////////////
+        else if (expect(tokenizer, "EXPLAIN")) {
+            code = explain();
             cout << endl;
         }
 
@@ -237,6 +258,22 @@ Iterator *CLI::query(Iterator *previous, int code) {
                 it = gracehashjoin(previous);
                 break;
 
+            case SORT:
+                it = sort(previous);
+                break;
+
+            case SM_JOIN:
+                it = sortmergejoin(previous);
+                break;
+
+            case PH_JOIN:
+                it = parallelhashjoin(previous);
+                break;
+
+            case FROM:
+                it = optimizedQuery();
+                break;
+
             case IDX_SCAN:
                 it = createBaseScanner("IDXSCAN");
                 break;
@@ -297,33 +334,48 @@ Iterator *CLI::aggregate(Iterator *input) {
 
     token = next();
 
-    // check GROUPBY
-    bool groupby = false;
-    Attribute gAttr;
+    // check GROUPBY, its attributes run till PAGES or GET
+    vector<Attribute> groupAttrs;
     if (string(token) == "GROUPBY") {
-        groupby = true;
-        if (createAttribute(input, gAttr) != 0)
-            error("CLI: " + __LINE__);
+        vector<Attribute> attrs;
+        input->getAttributes(attrs);
+        token = next();
+        while (token != NULL && string(token) != "GET" && string(token) != "PAGES") {
+            Attribute gAttr;
+            if (getAttribute(fullyQualify(string(token), getTableName(input)), attrs, gAttr) != 0)
+                error("CLI: " + __LINE__);
+            groupAttrs.push_back(gAttr);
+            token = next();
+        }
+    }
 
+    // with a number of pages the groups spill to disk, before GET as a nested AGG ends with its aggregates
+    unsigned numPages = 0;
+    if (token != NULL && string(token) == "PAGES") {
+        token = next(); // get the number of pages
+        numPages = (unsigned) atoi(string(token).c_str());
         token = next(); // eat GET
     }
 
-    string operation = string(next());
-
-    AggregateOp op;
-    if (createAggregateOp(operation, op) != 0)
-        error("CLI: " + __LINE__);
-    Attribute aggAttr;
-    if (createAttribute(input, aggAttr) != 0)
-        error("CLI: " + __LINE__);
-
-    Aggregate *agg;
-    if (groupby) {
-        agg = new Aggregate(input, aggAttr, gAttr, op);
-    } else {
-        agg = new Aggregate(input, aggAttr, op);
+    // one aggregate, or several between [ and ]
+    vector<AggregateFunction> functions;
+    token = next();
+    bool list = string(token) == "[";
+    if (list)
+        token = next();
+    while (token != NULL && string(token) != "]") {
+        AggregateFunction function;
+        if (createAggregateOp(string(token), function.op) != 0)
+            error("CLI: " + __LINE__);
+        if (createAttribute(input, function.aggAttr) != 0)
+            error("CLI: " + __LINE__);
+        functions.push_back(function);
+        if (!list)
+            break;
+        token = next();
     }
-    return agg;
+
+    return new Aggregate(input, groupAttrs, functions, numPages);
 }
 
 // Create BNLJoin
@@ -383,8 +435,8 @@ Iterator *CLI::gracehashjoin(Iterator *input) {
     if (createCondition(getTableName(input), cond, true, rightTableName) != 0)
         error(__LINE__);
 
-    token = next(); // eat PARTITIONS
-    token = next(); // get partitions number
+    token = next(); // eat PAGES, older scripts say PARTITIONS
+    token = next(); // get the number of pages
 
     // Create Join
     GHJoin *join = new GHJoin(input, right, cond, (unsigned) atoi(string(token).c_str()));
@@ -392,6 +444,116 @@ Iterator *CLI::gracehashjoin(Iterator *input) {
     return join;
 }
 
+// Create PHJoin
+Iterator *CLI::parallelhashjoin(Iterator *input) {
+    char *token = next();
+    int code = -2;
+    if (isIterator(string(token), code)) {
+        input = query(input, code);
+    }
+
+    if (input == NULL) {
+        input = createBaseScanner(string(token));
+    }
+
+    // get right table
+    token = next();
+    string rightTableName = string(token);
+    TableScan *right = new TableScan(rm, rightTableName);
+
+    token = next(); // eat WHERE
+
+    // parse the join condition
+    Condition cond;
+    if (createCondition(getTableName(input), cond, true, rightTableName) != 0)
+        error(__LINE__);
+
+    token = next(); // eat THREADS
+    token = next(); // get the number of threads
+
+    // Create Join
+    PHJoin *join = new PHJoin(input, right, cond, (unsigned) atoi(string(token).c_str()));
+
+    return join;
+}
+
+// Create SMJoin
+Iterator *CLI::sortmergejoin(Iterator *input) {
+    char *token = next();
+    int code = -2;
+    if (isIterator(string(token), code)) {
+        input = query(input, code);
+    }
+
+    if (input == NULL) {
+        input = createBaseScanner(string(token));
+    }
+
+    // get right table
+    token = next();
+    string rightTableName = string(token);
+    TableScan *right = new TableScan(rm, rightTableName);
+
+    token = next(); // eat WHERE
+
+    // parse the join condition
+    Condition cond;
+    if (createCondition(getTableName(input), cond, true, rightTableName) != 0)
+        error(__LINE__);
+
+    token = next(); // eat PAGES
+    token = next(); // get the number of pages
+
+    // an index scan on the join attribute is already sorted
+    auto *is = dynamic_cast<IndexScan *>(input);
+    bool leftSorted = is != NULL && fullyQualify(is->attrName, is->tableName) == cond.lhsAttr;
+
+    // Create Join
+    SMJoin *join = new SMJoin(input, right, cond, (unsigned) atoi(string(token).c_str()), leftSorted);
+
+    return join;
+}
+
+// Create Sort
+Iterator *CLI::sort(Iterator *input) {
+    char *token = next();
+    int code = -2;
+    if (isIterator(string(token), code)) {
+        input = query(input, code);
+    }
+
+    if (input == NULL) {
+        input = createBaseScanner(string(token));
+    }
+
+    token = next(); // eat BY
+    token = next(); // eat [
+
+    // parse the sort keys, DESC turns the last one around
+    string tableName = getTableName(input);
+    vector<SortKey> keys;
+    while (true) {
+        token = next();
+        if (string(token) == "]")
+            break;
+        if (string(token) == "DESC" && !keys.empty()) {
+            keys.back().ascending = false;
+            continue;
+        }
+        if (string(token) == "ASC" && !keys.empty())
+            continue;
+        keys.push_back({fullyQualify(string(token), tableName), true});
+    }
+
+    token = next(); // eat PAGES
+    token = next(); // get the number of pages
+
+    // Create Sort
+    Sort *sort = new Sort(input, keys, (unsigned) atoi(string(token).c_str()));
+
+    return sort;
+}
+
 // Create Filter
 Iterator *CLI::filter(Iterator *input) {
     char *token = next();
@@ -411,6 +573,13 @@ Iterator *CLI::filter(Iterator *input) {
     if (createCondition(getTableName(input), cond) != 0)
         error(__LINE__);
 
+    // right on a table, the condition goes into the scan and rejects records on the page
+    TableScan *scan = dynamic_cast<TableScan *>(input);
+    if (scan != NULL) {
+        scan->pushPredicate(Filter::getConditionPredicate(cond));
+        return scan;
+    }
+
     // Create Filter
     Filter *filter = new Filter(input, cond);
 
@@ -453,10 +622,86 @@ Iterator *CLI::projection(Iterator *input) {
         addTableNameToAttrs(tableName, attrNames);
     }
 
+    // right on a table, the scan only decodes the projected attributes
+    TableScan *scan = dynamic_cast<TableScan *>(input);
+    if (scan != NULL && scan->pushProjection(attrNames) == 0)
+        return scan;
+
     Project *project = new Project(input, attrNames);
     return project;
 }
 
+// Create the plan of the optimizer, it reads the rest of the query
+Iterator *CLI::optimizedQuery() {
+    Query q;
+    char *token = next();
+    while (token != NULL && string(token) != "WHERE" && string(token) != "PAGES" && string(token) != "GET") {
+        q.tableNames.push_back(string(token));
+        token = next();
+    }
+
+    // conditions combined with AND, the right side is an attribute if one of the tables has it
+    while (token != NULL && (string(token) == "WHERE" || string(token) == "AND")) {
+        Condition cond;
+        Attribute attr;
+        token = next();
+        if (token == NULL || getQueryAttribute(q.tableNames, string(token), attr) != 0) {
+            error("attribute cannot be found");
+            return NULL;
+        }
+        cond.lhsAttr = attr.name;
+        token = next();
+        if (token == NULL || createCompOp(string(token), cond.op) != 0) {
+            error("I expect <op>");
+            return NULL;
+        }
+        token = next();
+        if (token == NULL) {
+            error("I expect <attr> or <value>");
+            return NULL;
+        }
+        Attribute rhsAttr;
+        cond.bRhsIsAttr = getQueryAttribute(q.tableNames, string(token), rhsAttr) == 0;
+        if (cond.bRhsIsAttr)
+            cond.rhsAttr = rhsAttr.name;
+        else if (createValue(string(token), attr.type, cond.rhsValue) != 0)
+            return NULL;
+        q.conditions.push_back(cond);
+        token = next();
+    }
+
+    unsigned numPages = QE_OPTIMIZER_PAGES;
+    if (token != NULL && string(token) == "PAGES") {
+        token = next(); // get the number of pages
+        numPages = (unsigned) atoi(string(token).c_str());
+        token = next();
+    }
+
+    // GET [ <attrs> ], all attributes without it
+    if (token != NULL && string(token) == "GET") {
+        token = next(); // eat [
+        token = next();
+        while (token != NULL && string(token) != "]") {
+            Attribute attr;
+            if (string(token) != "*") {
+                if (getQueryAttribute(q.tableNames, string(token), attr) != 0) {
+                    error("attribute cannot be found");
+                    return NULL;
+                }
+                q.attrNames.push_back(attr.name);
+            }
+            token = next();
+        }
+    }
+
+    Optimizer optimizer(rm, numPages);
+    if (optimizer.optimize(q, plan) != 0) {
+        error("the tables cannot be joined by the conditions");
+        return NULL;
+    }
+    return plan.getRoot();
+}
+
 Iterator *CLI::createBaseScanner(const string token) {
     // if token is "IDXSCAN" (index scanner), create index scanner
     if (token.compare("IDXSCAN") == 0) {
@@ -513,12 +758,20 @@ bool CLI::isIterator(const string token, int &code) {
         code = INL_JOIN;
     else if (expect(token, "GHJOIN"))
         code = GH_JOIN;
+    else if (expect(token, "SMJOIN"))
+        code = SM_JOIN;
+    else if (expect(token, "PHJOIN"))
+        code = PH_JOIN;
+    else if (expect(token, "SORT"))
+        code = SORT;
     else if (expect(token, "AGG"))
         code = AGG;
     else if (expect(token, "IDXSCAN"))
         code = IDX_SCAN;
     else if (expect(token, "TBLSCAN"))
         code = TBL_SCAN;
+    else if (expect(token, "FROM"))
+        code = FROM;
     else
         return false;
 
@@ -526,7 +779,7 @@ bool CLI::isIterator(const string token, int &code) {
 }
 
 RC CLI::run(Iterator *it) {
-    void *data = malloc(PAGE_SIZE);
+    TupleBatch batch;
     vector<Attribute> attrs;
     vector<string> outputBuffer;
     it->getAttributes(attrs);
@@ -534,9 +787,11 @@ RC CLI::run(Iterator *it) {
     for (uint i = 0; i < attrs.size(); i++)
         outputBuffer.push_back(attrs.at(i).name);
 
-    while (it->getNextTuple(data) != QE_EOF) {
-        if (updateOutputBuffer(outputBuffer, data, attrs) != 0)
-            return error(__LINE__);
+    while (it->getNextBatch(batch) != QE_EOF) {
+        for (uint i = 0; i < batch.size(); i++) {
+            if (updateOutputBuffer(outputBuffer, batch.getTuple(i), attrs) != 0)
+                return error(__LINE__);
+        }
     }
 
     if (printOutputBuffer(outputBuffer, attrs.size()) != 0)
@@ -569,22 +824,9 @@ RC CLI::createCondition(const string tableName, Condition &condition, const bool
 
     // get operation
     token = next();
-    if (string(token) == "=")
-        condition.op = EQ_OP;
-    else if (string(token) == "<")
-        condition.op = LT_OP;
-    else if (string(token) == ">")
-        condition.op = GT_OP;
-    else if (string(token) == "<=")
-        condition.op = LE_OP;
-    else if (string(token) == ">=")
-        condition.op = GE_OP;
-    else if (string(token) == "!=")
-        condition.op = NE_OP;
-    else if (string(token) == "NOOP") {
-        condition.op = NO_OP;
+    createCompOp(string(token), condition.op);
+    if (condition.op == NO_OP)
         return 0;
-    }
 
     if (join) {
         condition.bRhsIsAttr = true;
@@ -600,35 +842,75 @@ RC CLI::createCondition(const string tableName, Condition &condition, const bool
     if (this->getAttribute(tableName, attribute, attr) != 0)
         return error(__LINE__);
 
-    Value value;
-    value.type = attr.type;
-    value.data = malloc(PAGE_SIZE);
     token = next();
-    attribute = string(token);
+    return createValue(string(token), attr.type, condition.rhsValue);
+}
+
+RC CLI::createCompOp(const string token, CompOp &op) {
+    if (token == "=")
+        op = EQ_OP;
+    else if (token == "<")
+        op = LT_OP;
+    else if (token == ">")
+        op = GT_OP;
+    else if (token == "<=")
+        op = LE_OP;
+    else if (token == ">=")
+        op = GE_OP;
+    else if (token == "!=")
+        op = NE_OP;
+    else if (token == "NOOP")
+        op = NO_OP;
+    else
+        return -1;
+    return 0;
+}
+
+RC CLI::createValue(const string token, const AttrType type, Value &value) {
+    value.type = type;
+    value.data = malloc(PAGE_SIZE);
 
     int num;
     float floatNum;
-    switch (attr.type) {
+    switch (type) {
         case TypeVarChar:
-            num = attribute.size();
+            num = token.size();
             memcpy((char *) value.data, &num, sizeof(int));
-            memcpy((char *) value.data + sizeof(int), attribute.c_str(), num);
+            memcpy((char *) value.data + sizeof(int), token.c_str(), num);
             break;
         case TypeInt:
-            num = atoi(string(token).c_str());
+            num = atoi(token.c_str());
             memcpy((char *) value.data, &num, sizeof(int));
             break;
         case TypeReal:
-            floatNum = atof(string(token).c_str());
+            floatNum = atof(token.c_str());
             memcpy((char *) value.data, &floatNum, sizeof(float));
             break;
         default:
             return error("cli: " + __LINE__);
     }
-    condition.rhsValue = value;
     return 0;
 }
 
+// the attribute named table.attr, or attr if only one of the tables has it. -1 without a message otherwise
+RC CLI::getQueryAttribute(const vector<string> &tableNames, const string name, Attribute &attr) {
+    bool qualified = name.find('.') != string::npos;
+    unsigned found = 0;
+    for (auto const &tableName : tableNames) {
+        vector<Attribute> attrs;
+        rm.getAttributes(tableName, attrs);
+        for (auto const &it : attrs) {
+            string attrName = tableName + "." + it.name;
+            if (qualified ? attrName == name : it.name == name) {
+                attr = it;
+                attr.name = attrName;
+                found++;
+            }
+        }
+    }
+    return found == 1 ? 0 : -1;
+}
+
 RC CLI::createAttribute(Iterator *input, Attribute &attr) {
     string tableName = getTableName(input);
     string attribute = string(next());
@@ -961,7 +1243,7 @@ RC CLI::addAttribute() {
         return -1;
 
     int biggestPosition = 0, position = 0;
-    while (rmsi.getNextTuple(rid, data_returned) != RM_EOF) {
+    while (rmsi.getNextTuple(rid, data_returned) == 0) {
         // adding +1 because of nulls-indicator
         memcpy(&position, (char *) data_returned + 1, sizeof(int));
         if (biggestPosition < (int) position)
@@ -1014,7 +1296,7 @@ RC CLI::dropTable() {
         return -1;
 
     // delete tableName from CLI_TABLES
-    while (rmsi.getNextTuple(rid, data_returned) != RM_EOF) {
+    while (rmsi.getNextTuple(rid, data_returned) == 0) {
         if (rm.deleteTuple(CLI_TABLES, rid) != 0)
             return -1;
     }
@@ -1162,6 +1444,17 @@ RC CLI::load() {
     Attribute attr;
     vector<Attribute> attributes;
     this->getAttributesFromCatalog(tableName, attributes);
+
+    commandTokenizer = next();
+    if (commandTokenizer != NULL) {
+        if (!expect(commandTokenizer, "parallel"))
+            return error("I expect <parallel>");
+        commandTokenizer = next();
+        int numThreads = commandTokenizer == NULL ? CVS_DEFAULT_THREADS : atoi(commandTokenizer);
+        if (numThreads <= 0)
+            return error("<numThreads> should be bigger than 0");
+        return parallelLoad(tableName, DATABASE_FOLDER"../data/" + fileName, attributes, numThreads);
+    }
     uint offset = 0, index = 0, keyIndex = 0;
     uint length;
     void *buffer = malloc(PAGE_SIZE);
@@ -1184,7 +1477,6 @@ RC CLI::load() {
     if (!ifs.is_open())
         return error("could not open file: " + file_url);
 
-    // Assume that we don't have any NULL values when loading data.
     // Null-indicators
     int nullAttributesIndicatorActualSize = getActualByteForNullsIndicator(attributes.size());
     unsigned char *nullsIndicator = (unsigned char *) malloc(nullAttributesIndicatorActualSize);
@@ -1264,6 +1556,133 @@ RC CLI::load() {
     return 0;
 }
 
+/*
+ * Parallel load:
+ *  1. the file is read CVS_CHUNK_SIZE bytes at a time, cut at the last line break
+ *  2. every chunk is split at line breaks into numThreads pieces, each converted into tuples by its own thread
+ *  3. while the next chunk is parsed, the tuples of the current one go through rm.insertTuples in file order
+ *  4. indexes of the table are dropped before the load and rebuilt bottom-up afterwards
+ */
+RC CLI::parallelLoad(const string &tableName, const string &fileUrl, const vector<Attribute> &attributes,
+                     unsigned numThreads) {
+    ifstream ifs;
+    ifs.open(fileUrl, ifstream::in | ifstream::binary);
+    if (!ifs.is_open())
+        return error("could not open file: " + fileUrl);
+
+    vector<Attribute> attrs;
+    if (rm.getAttributes(tableName, attrs) != 0)
+        return error("table does not exist: " + tableName);
+    vector<string> indexedAttributes;
+    for (auto i : rm.indexMap[tableName])
+        indexedAttributes.push_back(attrs[i].name);
+    for (auto &attrName : indexedAttributes)
+        rm.destroyIndex(tableName, attrName);
+
+    string rest;
+    auto readChunk = [&ifs, &rest](string &chunk) {
+        chunk.swap(rest);
+        rest.clear();
+        size_t start = chunk.size();
+        chunk.resize(start + CVS_CHUNK_SIZE);
+        ifs.read(&chunk[start], CVS_CHUNK_SIZE);
+        chunk.resize(start + ifs.gcount());
+        // keep the unfinished last line for the next chunk
+        size_t end = chunk.rfind('\n');
+        if (ifs.good() && end != string::npos) {
+            rest = chunk.substr(end + 1);
+            chunk.resize(end + 1);
+        }
+        return !chunk.empty();
+    };
+    auto parseChunk = [&attributes, numThreads](string chunk) {
+        vector<vector<char>> tuples(numThreads);
+        vector<vector<size_t>> offsets(numThreads);
+        vector<thread> threads;
+        size_t begin = 0;
+        for (unsigned i = 0; i < numThreads && begin < chunk.size(); i++) {
+            size_t end = i == numThreads - 1 ? chunk.size() : chunk.find('\n', chunk.size() / numThreads * (i + 1));
+            end = end == string::npos ? chunk.size() : max(end + 1, begin);
+            threads.emplace_back(parseCSVLines, chunk.data() + begin, chunk.data() + end, cref(attributes),
+                                 ref(tuples[i]), ref(offsets[i]));
+            begin = end;
+        }
+        for (auto &t : threads)
+            t.join();
+        return make_pair(move(tuples), move(offsets));
+    };
+
+    RC rc = 0;
+    string chunk;
+    bool hasChunk = readChunk(chunk);
+    auto parsed = async(launch::async, parseChunk, move(chunk));
+    while (hasChunk) {
+        auto batches = parsed.get();
+        hasChunk = readChunk(chunk);
+        if (hasChunk)
+            parsed = async(launch::async, parseChunk, move(chunk));
+
+        // the only writer, one batch per parser thread keeps the file order
+        for (unsigned i = 0; i < numThreads && rc == 0; i++) {
+            vector<const void *> data;
+            for (size_t offset : batches.second[i])
+                data.push_back(batches.first[i].data() + offset);
+            vector<RID> rids;
+            if (!data.empty() && rm.insertTuples(tableName, data, rids) != 0)
+                rc = error("error while inserting tuple");
+        }
+        if (rc != 0) {
+            if (hasChunk)
+                parsed.wait();
+            break;
+        }
+    }
+    ifs.close();
+
+    for (auto &attrName : indexedAttributes) {
+        if (rm.createIndex(tableName, attrName) != 0)
+            rc = error("cannot rebuild index on column(" + attrName + ")");
+    }
+    return rc;
+}
+
+// convert the lines in [begin, end) into tuples, same rules as the serial load
+void CLI::parseCSVLines(const char *begin, const char *end, const vector<Attribute> &attributes,
+                        vector<char> &tuples, vector<size_t> &offsets) {
+    int nullAttributesIndicatorActualSize = getActualByteForNullsIndicator(attributes.size());
+    string line;
+    while (begin < end) {
+        const char *lineEnd = find(begin, end, '\n');
+        line.assign(begin, lineEnd);
+        begin = lineEnd == end ? end : lineEnd + 1;
+        if (line.empty())
+            continue;
+
+        size_t offset = tuples.size();
+        offsets.push_back(offset);
+        tuples.resize(offset + nullAttributesIndicatorActualSize, 0);
+
+        uint index = 0;
+        char *savePtr;
+        char *tokenizer = strtok_r(&line[0], CVS_DELIMITERS, &savePtr);
+        while (tokenizer != NULL && index < attributes.size()) {
+            const Attribute &attr = attributes.at(index++);
+            if (attr.type == TypeVarChar) {
+                uint length = strlen(tokenizer);
+                tuples.insert(tuples.end(), (char *) &length, (char *) &length + sizeof(int));
+                tuples.insert(tuples.end(), tokenizer, tokenizer + length);
+            } else if (attr.type == TypeInt) {
+                int num = atoi(tokenizer);
+                tuples.insert(tuples.end(), (char *) &num, (char *) &num + sizeof(num));
+            } else if (attr.type == TypeReal) {
+                float num = atof(tokenizer);
+                tuples.insert(tuples.end(), (char *) &num, (char *) &num + sizeof(num));
+            }
+            tokenizer = strtok_r(NULL, CVS_DELIMITERS, &savePtr);
+        }
+    }
+}
+
 RC CLI::insertTuple() {
     char *token = next();
     if (!expect(token, "into"))
@@ -1433,6 +1852,43 @@ RC CLI::printIndex() {
 }
 
 // print every tuples in given tableName
+RC CLI::analyze() {
+    char *token = next();
+    if (token == NULL)
+        return error("I expect <tableName>");
+    if (rm.analyze(string(token)) != 0)
+        return error("cannot analyze " + string(token));
+    return 0;
+}
+
+// print the operator tree of a query, ANALYZE runs it and adds what every operator did
+RC CLI::explain() {
+    char *token = next();
+    bool analyze = token != NULL && expect(token, "ANALYZE");
+    if (analyze)
+        token = next();
+    if (token == NULL || !expect(token, "SELECT"))
+        return error("I expect SELECT");
+
+    Iterator::profileNewIterators = analyze;
+    Iterator *it = query(NULL);
+    Iterator::profileNewIterators = false;
+    if (it == NULL)
+        return error("the query cannot be run");
+
+    if (analyze) {
+        TupleBatch batch;
+        while (it->getNextBatch(batch) != QE_EOF) {
+        }
+    }
+    // a FROM query has the estimates of the optimizer too
+    if (it == plan.getRoot())
+        plan.print(cout, analyze);
+    else
+        it->explain(cout, analyze);
+    return 0;
+}
+
 RC CLI::printTable(const string tableName) {
     vector<Attribute> attributes;
     RC rc = this->getAttributesFromCatalog(tableName, attributes);
@@ -1501,6 +1957,14 @@ RC CLI::help(const string input) {
     } else if (input.compare("load") == 0) {
         cout << "\tload <tableName> \"fileName\"";
         cout << ": loads given filName to given table" << endl;
+        cout << "\tload <tableName> \"fileName\" parallel [<numThreads>]";
+        cout << ": same, parsed by numThreads threads and inserted in batches, indexes are rebuilt at the end" << endl;
+    } else if (input.compare("analyze") == 0) {
+        cout << "\tanalyze <tableName>: collects the statistics of tableName for the optimizer" << endl;
+    } else if (input.compare("explain") == 0) {
+        cout << "\tEXPLAIN SELECT <query>: prints the operators of the query, inputs indented under them" << endl;
+        cout << "\tEXPLAIN ANALYZE SELECT <query>: runs the query and prints the calls, rows, time and page I/O";
+        cout << " of every operator, inputs included" << endl;
     } else if (input.compare("help") == 0) {
         cout << "\thelp <commandName>: print help for given command" << endl;
         cout << "\thelp: show help for all commands" << endl;
@@ -1515,15 +1979,23 @@ RC CLI::help(const string input) {
         cout << "\t\t\tFILTER <query> WHERE <attr> <op> <value>" << endl;
         cout << "\t\t\tBNLJOIN <query>, <query> WHERE <attr> <op> <attr> PAGES(<numPages>)" << endl;
         cout << "\t\t\tINLJOIN <query>, <query> WHERE <attr> <op> <attr>" << endl;
-        cout << "\t\t\tGHJOIN <query>, <query> WHERE <attr> <op> <attr> PARTITIONS(<numPartitions>)" << endl;
-        cout << "\t\t\tAGG <query> [ GROUPBY(<attr>) ] GET <agg-op>(<attr>)" << endl;
+        cout << "\t\t\tGHJOIN <query>, <query> WHERE <attr> <op> <attr> PAGES(<numPages>)" << endl;
+        cout << "\t\t\tSMJOIN <query>, <query> WHERE <attr> <op> <attr> PAGES(<numPages>)" << endl;
+        cout << "\t\t\tPHJOIN <query>, <query> WHERE <attr> = <attr> THREADS(<numThreads>)" << endl;
+        cout << "\t\t\tAGG <query> [ GROUPBY(<attrs>) ] [ PAGES(<numPages>) ] GET <aggs>" << endl;
+        cout << "\t\t\tSORT <query> BY \"[\" <keys> \"]\" PAGES(<numPages>)" << endl;
         cout << "\t\t\tIDXSCAN <query> <attr> <op> <value>" << endl;
         cout << "\t\t\tTBLSCAN <query>" << endl;
         cout << "\t\t\t<tableName>" << endl;
+        cout << "\t\t\tFROM <tables> [ WHERE <cond> { AND <cond> } ] [ PAGES(<numPages>) ] [ GET \"[\" <attrs> \"]\" ]";
+        cout << ": planned by the optimizer, not nested" << endl;
+        cout << "\t\t<cond> = <attr> <op> <attr> | <attr> <op> <value>" << endl;
 
+        cout << "\t\t<aggs> = <agg-op>(<attr>) | \"[\" <agg-op>(<attr>) { \",\" <agg-op>(<attr>) } \"]\"" << endl;
         cout << "\t\t<agg-op> = MIN | MAX | SUM | AVG | COUNT" << endl;
         cout << "\t\t<op> = < | > | = | != | >= | <= | NOOP" << endl;
         cout << "\t\t<attrs> = <attr> { \",\" <attr> }" << endl;
+        cout << "\t\t<keys> = <attr> [ ASC | DESC ] { \",\" <attr> [ ASC | DESC ] }" << endl;
         cout << "\t\t<numPages> = is a number bigger than 0" << endl;
         cout << "\t\t<numPartitions> = is a number bigger than 0" << endl;
         cout << endl;
@@ -1533,6 +2005,8 @@ RC CLI::help(const string input) {
         help("print");
         help("insert");
         help("load");
+        help("analyze");
+        help("explain");
         help("help");
         help("query");
         help("quit");
@@ -1748,7 +2222,7 @@ bool CLI::checkAttribute(const string tableName, const string columnName, RID &r
         return -1;
 
     // check if tableName is what we want
-    while (rmsi.getNextTuple(rid, data_returned) != RM_EOF) {
+    while (rmsi.getNextTuple(rid, data_returned) == 0) {
         int length = 0, offset = 0;
 
         // adding +1 because of nulls-indicator
@@ -1782,7 +2256,6 @@ RC CLI::updateOutputBuffer(vector<string> &buffer, void *data, vector<Attribute>
     char *str;
     string record = "";
 
-    // Assume that we don't have any NULL values when loading data.
     // Null-indicators
     int nullAttributesIndicatorActualSize = getActualByteForNullsIndicator(attrs.size());
 
@@ -1790,6 +2263,11 @@ RC CLI::updateOutputBuffer(vector<string> &buffer, void *data, vector<Attribute>
     offset += nullAttributesIndicatorActualSize;
 
     for (std::vector<Attribute>::iterator it = attrs.begin(); it != attrs.end(); ++it) {
+        // an aggregate over no values or a group of NULLs
+        if (RecordBasedFileManager::getNullIndicator(data, it - attrs.begin())) {
+            buffer.push_back("NULL");
+            continue;
+        }
         switch (it->type) {
             case TypeInt:
                 number = 0;
@@ -22,7 +22,7 @@
 #include "../qe/qe.h"
 
 typedef enum {
-    FILTER = 0, PROJECT, BNL_JOIN, INL_JOIN, GH_JOIN, AGG, IDX_SCAN, TBL_SCAN
+    FILTER = 0, PROJECT, BNL_JOIN, INL_JOIN, GH_JOIN, AGG, IDX_SCAN, TBL_SCAN, SORT, SM_JOIN, PH_JOIN, FROM
 } QUERY_OP;
 
 // Return code
@@ -70,12 +70,22 @@ private:
 
     RC load();
 
+    RC parallelLoad(const std::string &tableName, const std::string &fileUrl,
+                    const std::vector<Attribute> &attributes, unsigned numThreads);
+
+    static void parseCSVLines(const char *begin, const char *end, const std::vector<Attribute> &attributes,
+                              std::vector<char> &tuples, std::vector<size_t> &offsets);
+
     RC printTable(const std::string tableName);
 
     RC printAttributes();
 
     RC printIndex();
 
+    RC analyze();
+
+    RC explain();
+
     RC help(const std::string input);
 
     RC history();
@@ -98,8 +108,17 @@ private:
 
     Iterator *gracehashjoin(Iterator *input);
 
+    Iterator *sortmergejoin(Iterator *input);
+
+    Iterator *parallelhashjoin(Iterator *input);
+
     Iterator *aggregate(Iterator *input);
 
+    Iterator *sort(Iterator *input);
+
+    // tables, conditions and attributes only, the optimizer plans the rest
+    Iterator *optimizedQuery();
+
     // run the query
     RC run(Iterator *);
 
@@ -112,6 +131,12 @@ private:
 
     RC createAggregateOp(const std::string operation, AggregateOp &op);
 
+    RC createCompOp(const std::string token, CompOp &op);
+
+    RC createValue(const std::string token, const AttrType type, Value &value);
+
+    RC getQueryAttribute(const std::vector<std::string> &tableNames, const std::string name, Attribute &attr);
+
     void addTableNameToAttrs(const std::string tableName, std::vector<std::string> &attrs);
 
     bool isIterator(const std::string token, int &code);
@@ -158,6 +183,8 @@ private:
     RC getAttribute(const std::string name, const std::vector<Attribute> pool, Attribute &attr);
 
     RelationManager &rm = RelationManager::instance();
+    // plan of the last optimized query
+    QueryPlan plan;
     static CLI *_cli;
 };
 
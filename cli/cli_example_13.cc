@@ -0,0 +1,52 @@
+#include "cli.h"
+
+#define SUCCESS 0
+#define MODE 0  // 0 = TEST MODE
+// 1 = INTERACTIVE MODE
+// 3 = TEST + INTERACTIVE MODE
+
+CLI *cli;
+
+void exec(const std::string &command, bool equal = true) {
+    std::cout << ">>> " << command << std::endl;
+
+    if (equal)
+        assert (cli->process(command) == SUCCESS);
+    else
+        assert (cli->process(command) != SUCCESS);
+}
+
+// parallel load, with an index rebuilt afterwards
+void Test13() {
+    std::cout << "*********** CLI Test13 begins ******************" << std::endl;
+
+    std::string command;
+
+    exec("create table tbl_employee EmpName = varchar(30), Age = int, Height = real, Salary = int");
+
+    exec("load tbl_employee employee_50 parallel 3");
+    exec("create index Age on tbl_employee");
+    exec("load tbl_employee employee_5 parallel");
+
+    exec("print tbl_employee");
+    exec("SELECT FILTER tbl_employee WHERE Age > 60");
+
+    exec("load tbl_employee employee_5 serial", false);
+    exec("load tbl_employee employee_5 parallel 0", false);
+
+    exec(("drop table tbl_employee"));
+}
+
+int main() {
+
+    cli = CLI::Instance();
+
+    if (MODE == 0 || MODE == 3) {
+        Test13(); // parallel load
+    }
+    if (MODE == 1 || MODE == 3) {
+        cli->start();
+    }
+
+    return 0;
+}
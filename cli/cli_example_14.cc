@@ -0,0 +1,58 @@
+#include "cli.h"
+
+#define SUCCESS 0
+#define MODE 0  // 0 = TEST MODE
+// 1 = INTERACTIVE MODE
+// 3 = TEST + INTERACTIVE MODE
+
+CLI *cli;
+
+void exec(const std::string &command, bool equal = true) {
+    std::cout << ">>> " << command << std::endl;
+
+    if (equal)
+        assert (cli->process(command) == SUCCESS);
+    else
+        assert (cli->process(command) != SUCCESS);
+}
+
+// Sort
+void Test14() {
+    std::cout << "*********** CLI Test14 begins ******************" << std::endl;
+
+    std::string command;
+
+    exec("create table tbl_employee EmpName = varchar(30), Age = int, Height = real, Salary = int");
+
+    exec("create table ages Age = int, Explanation = varchar(50)");
+
+    exec("load tbl_employee employee_50");
+
+    exec("load ages ages_90");
+
+    exec("SELECT SORT tbl_employee BY [ Age ] PAGES(3)");
+
+    exec("SELECT SORT tbl_employee BY [ Age DESC, EmpName ] PAGES(10)");
+
+    exec("SELECT PROJECT (SORT (FILTER tbl_employee WHERE Age > 50) BY [ Salary DESC ] PAGES(3)) GET [ EmpName, Salary ]");
+
+    exec("SELECT SORT (BNLJOIN tbl_employee, ages WHERE Age = Age PAGES(10)) BY [ tbl_employee.Height ] PAGES(5)");
+
+    exec(("drop table tbl_employee"));
+
+    exec(("drop table ages"));
+}
+
+int main() {
+
+    cli = CLI::Instance();
+
+    if (MODE == 0 || MODE == 3) {
+        Test14(); // Sort
+    }
+    if (MODE == 1 || MODE == 3) {
+        cli->start();
+    }
+
+    return 0;
+}
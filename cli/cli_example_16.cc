@@ -0,0 +1,54 @@
+#include "cli.h"
+
+#define SUCCESS 0
+#define MODE 0  // 0 = TEST MODE
+// 1 = INTERACTIVE MODE
+// 3 = TEST + INTERACTIVE MODE
+
+CLI *cli;
+
+void exec(const std::string &command, bool equal = true) {
+    std::cout << ">>> " << command << std::endl;
+
+    if (equal)
+        assert (cli->process(command) == SUCCESS);
+    else
+        assert (cli->process(command) != SUCCESS);
+}
+
+// Parallel hash join
+void Test16() {
+    std::cout << "*********** CLI Test16 begins ******************" << std::endl;
+
+    std::string command;
+
+    exec("create table tbl_employee EmpName = varchar(30), Age = int, Height = real, Salary = int");
+
+    exec("create table ages Age = int, Explanation = varchar(50)");
+
+    exec("load tbl_employee employee_50");
+
+    exec("load ages ages_90");
+
+    exec("SELECT PHJOIN tbl_employee, ages WHERE Age = Age THREADS(4)");
+
+    exec("SELECT PROJECT (PHJOIN (FILTER tbl_employee WHERE Age > 60), ages WHERE Age = Age THREADS(2)) GET [ EmpName, ages.Explanation ]");
+
+    exec(("drop table tbl_employee"));
+
+    exec(("drop table ages"));
+}
+
+int main() {
+
+    cli = CLI::Instance();
+
+    if (MODE == 0 || MODE == 3) {
+        Test16(); // Parallel hash join
+    }
+    if (MODE == 1 || MODE == 3) {
+        cli->start();
+    }
+
+    return 0;
+}
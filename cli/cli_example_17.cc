@@ -0,0 +1,62 @@
+#include "cli.h"
+
+#define SUCCESS 0
+#define MODE 0  // 0 = TEST MODE
+// 1 = INTERACTIVE MODE
+// 3 = TEST + INTERACTIVE MODE
+
+CLI *cli;
+
+void exec(const std::string &command, bool equal = true) {
+    std::cout << ">>> " << command << std::endl;
+
+    if (equal)
+        assert (cli->process(command) == SUCCESS);
+    else
+        assert (cli->process(command) != SUCCESS);
+}
+
+// Hash aggregation with several aggregates and group attributes
+void Test17() {
+    std::cout << "*********** CLI Test17 begins ******************" << std::endl;
+
+    std::string command;
+
+    exec("create table tbl_employee EmpName = varchar(30), Age = int, Height = real, Salary = int");
+
+    exec("create table ages Age = int, Explanation = varchar(50)");
+
+    exec("load tbl_employee employee_50");
+
+    exec("load ages ages_90");
+
+    exec("SELECT AGG tbl_employee GROUPBY(Age) GET [ COUNT(EmpName), MIN(Salary), MAX(Salary), AVG(Height) ]");
+
+    exec("SELECT AGG tbl_employee GROUPBY(Age, Salary) GET [ COUNT(Height), SUM(Height) ]");
+
+    exec("SELECT AGG (FILTER tbl_employee WHERE Age > 200) GET [ COUNT(Age), MAX(Salary) ]");
+
+    exec("SELECT AGG ages GROUPBY(Explanation) GET AVG(Age)");
+
+    exec("SELECT AGG ages GROUPBY(Age) PAGES(3) GET [ COUNT(Explanation), MAX(Age) ]");
+
+    exec("SELECT AGG (FILTER tbl_employee WHERE Age > 40) GROUPBY(Salary) PAGES(2) GET AVG(Age)");
+
+    exec(("drop table tbl_employee"));
+
+    exec(("drop table ages"));
+}
+
+int main() {
+
+    cli = CLI::Instance();
+
+    if (MODE == 0 || MODE == 3) {
+        Test17(); // Hash aggregation with several aggregates and group attributes
+    }
+    if (MODE == 1 || MODE == 3) {
+        cli->start();
+    }
+
+    return 0;
+}
@@ -0,0 +1,66 @@
+#include "cli.h"
+
+#define SUCCESS 0
+#define MODE 0  // 0 = TEST MODE
+// 1 = INTERACTIVE MODE
+// 3 = TEST + INTERACTIVE MODE
+
+CLI *cli;
+
+void exec(const std::string &command, bool equal = true) {
+    std::cout << ">>> " << command << std::endl;
+
+    if (equal)
+        assert (cli->process(command) == SUCCESS);
+    else
+        assert (cli->process(command) != SUCCESS);
+}
+
+// Queries planned by the optimizer over analyzed tables
+void Test18() {
+    std::cout << "*********** CLI Test18 begins ******************" << std::endl;
+
+    std::string command;
+
+    exec("create table tbl_employee EmpName = varchar(30), Age = int, Height = real, Salary = int");
+
+    exec("create table ages Age = int, Explanation = varchar(50)");
+
+    exec("load tbl_employee employee_50");
+
+    exec("load ages ages_90");
+
+    exec("create index Age on ages");
+
+    exec("analyze tbl_employee");
+
+    exec("analyze ages");
+
+    exec("SELECT FROM ages WHERE Age = 30");
+
+    exec("SELECT FROM tbl_employee WHERE Age > 40 AND Salary < 200000 GET [ EmpName, Age ]");
+
+    exec("SELECT FROM tbl_employee, ages WHERE tbl_employee.Age = ages.Age GET [ EmpName, Explanation ]");
+
+    exec("SELECT FROM ages, tbl_employee WHERE ages.Age = tbl_employee.Age AND Height > 6.0 PAGES(3) GET [ * ]");
+
+    exec("SELECT FROM tbl_employee, ages", false);
+
+    exec(("drop table tbl_employee"));
+
+    exec(("drop table ages"));
+}
+
+int main() {
+
+    cli = CLI::Instance();
+
+    if (MODE == 0 || MODE == 3) {
+        Test18(); // Queries planned by the optimizer over analyzed tables
+    }
+    if (MODE == 1 || MODE == 3) {
+        cli->start();
+    }
+
+    return 0;
+}
@@ -0,0 +1,66 @@
+#include "cli.h"
+
+#define SUCCESS 0
+#define MODE 0  // 0 = TEST MODE
+// 1 = INTERACTIVE MODE
+// 3 = TEST + INTERACTIVE MODE
+
+CLI *cli;
+
+void exec(const std::string &command, bool equal = true) {
+    std::cout << ">>> " << command << std::endl;
+
+    if (equal)
+        assert (cli->process(command) == SUCCESS);
+    else
+        assert (cli->process(command) != SUCCESS);
+}
+
+// The operators of queries, and what they did
+void Test19() {
+    std::cout << "*********** CLI Test19 begins ******************" << std::endl;
+
+    std::string command;
+
+    exec("create table tbl_employee EmpName = varchar(30), Age = int, Height = real, Salary = int");
+
+    exec("create table ages Age = int, Explanation = varchar(50)");
+
+    exec("load tbl_employee employee_50");
+
+    exec("load ages ages_90");
+
+    exec("create index Age on ages");
+
+    exec("analyze tbl_employee");
+
+    exec("analyze ages");
+
+    exec("EXPLAIN SELECT PROJECT (FILTER tbl_employee WHERE Age > 40) GET [ EmpName, Age ]");
+
+    exec("EXPLAIN ANALYZE SELECT GHJOIN tbl_employee, ages WHERE Age = Age PAGES(10)");
+
+    exec("EXPLAIN ANALYZE SELECT AGG (SORT tbl_employee BY [ Age DESC ] PAGES(3)) GROUPBY(Age) GET MAX(Salary)");
+
+    exec("EXPLAIN ANALYZE SELECT FROM tbl_employee, ages WHERE tbl_employee.Age = ages.Age AND Height > 6.0");
+
+    exec("EXPLAIN ANALYZE ages", false);
+
+    exec(("drop table tbl_employee"));
+
+    exec(("drop table ages"));
+}
+
+int main() {
+
+    cli = CLI::Instance();
+
+    if (MODE == 0 || MODE == 3) {
+        Test19(); // The operators of queries, and what they did
+    }
+    if (MODE == 1 || MODE == 3) {
+        cli->start();
+    }
+
+    return 0;
+}
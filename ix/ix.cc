@@ -1,6 +1,7 @@
 #include <stack>
 #include "ix.h"
 #include <math.h>
+#include <algorithm>
 #include <iostream>
 
 IndexManager &IndexManager::instance() {
@@ -41,8 +42,8 @@ RC IndexManager::destroyFile(const std::string &fileName) {
     return PagedFileManager::instance().destroyFile(fileName);
 }
 
-RC IndexManager::openFile(const std::string &fileName, IXFileHandle &ixFileHandle) {
-    RC rc = PagedFileManager::instance().openFile(fileName, ixFileHandle.fileHandle);
+RC IndexManager::openFile(const std::string &fileName, IXFileHandle &ixFileHandle, bool mapped) {
+    RC rc = PagedFileManager::instance().openFile(fileName, ixFileHandle.fileHandle, mapped);
     if (rc == -1)
         return -1;
     ixFileHandle._readRootPageNum();
@@ -50,11 +51,13 @@ RC IndexManager::openFile(const std::string &fileName, IXFileHandle &ixFileHandl
 }
 
 RC IndexManager::closeFile(IXFileHandle &ixFileHandle) {
-    if (ixFileHandle.fileHandle.fs.is_open()) {
-        ixFileHandle._writeRootPageNum();
-    } else {
+    if (!ixFileHandle.fileHandle.fs.is_open()) {
         return -1;
     }
+    // nothing is written through a mapped index
+    if (!ixFileHandle.fileHandle.isMapped()) {
+        ixFileHandle._writeRootPageNum();
+    }
     return PagedFileManager::instance().closeFile(ixFileHandle.fileHandle);
 }
 
@@ -471,6 +474,145 @@ RC IndexManager::deleteEntry(IXFileHandle &ixFileHandle, const Attribute &attrib
     return -1;
 }
 
+/*
+ * Bulk load, bottom-up:
+ *
+ * 1. the loader hands back every entry in key order (external sort)
+ * 2. leaves are filled up to the fill factor, page 1 is the first leaf, the others are appended behind it
+ *    a run of the same key is kept in one leaf as long as the page is not physically full
+ * 3. every upper level is built from the first key of each page of the level below,
+ *    its first slot is the MIN node pointing to the leftmost child, same as a page made by a split
+ * 4. stop when a level fits into one page, that page is the root
+ */
+RC IndexManager::bulkLoad(IXFileHandle &ixFileHandle, IX_BulkLoader &loader) {
+    if (!isEmpty(ixFileHandle) || loader.sortEntries() == -1)
+        return -1;
+
+    AttrType type = loader.attribute.type;
+    float fillFactor = loader.fillFactor > 1 || loader.fillFactor <= 0 ? 1 : loader.fillFactor;
+    auto capacity = (unsigned short) (fillFactor * IX_INIT_FREE_SPACE);
+
+    void *pageData = malloc(PAGE_SIZE);
+    void *nodeData = malloc(PAGE_SIZE);
+    void *key = malloc(PAGE_SIZE);
+    RID rid;
+
+    // children of the level being built and the first key under each of them
+    std::vector<unsigned> pages;
+    std::vector<std::string> keys;
+
+    // leaves but the first are appended IO_QUEUE_DEPTH at a time
+    std::vector<char> leaves;
+
+    unsigned pageNum;
+    unsigned short offset = 0, length;
+    initNewPage(ixFileHandle, pageData, pageNum, true, type);
+    pageNum = 1;
+    pages.push_back(pageNum);
+    keys.emplace_back();
+
+    // a failed write stops the load, the index is not usable then
+    RC rc = 0;
+    while (rc == 0 && loader.getNextEntry(nodeData, length) != IX_EOF) {
+        unsigned short totalSlot = getTotalSlot(pageData);
+        unsigned short used = IX_INIT_FREE_SPACE - getFreeSpace(pageData);
+        if (totalSlot > 0 && used + length + SLOT_SIZE > capacity) {
+            unsigned short lastOffset, lastLength;
+            getSlotOffsetAndLength(pageData, totalSlot - 1, lastOffset, lastLength);
+            bool isSameKey = lastLength == length &&
+                             memcmp((char *) pageData + lastOffset + NODE_INDICATOR_SIZE,
+                                    (char *) nodeData + NODE_INDICATOR_SIZE,
+                                    length - NODE_INDICATOR_SIZE - IX_RID_SIZE) == 0;
+            if (!isSameKey || used + length + SLOT_SIZE > IX_INIT_FREE_SPACE) {
+                // leaves are written back to back, the next one is the next page
+                setNextPageNum(pageData, pageNum + 1);
+                if (pageNum == 1) {
+                    rc = ixFileHandle.writePage(pageNum, pageData);
+                } else {
+                    leaves.insert(leaves.end(), (char *) pageData, (char *) pageData + PAGE_SIZE);
+                    if (leaves.size() == IO_QUEUE_DEPTH * PAGE_SIZE) {
+                        rc = ixFileHandle.appendPages(IO_QUEUE_DEPTH, leaves.data());
+                        leaves.clear();
+                    }
+                }
+                initNewPage(ixFileHandle, pageData, pageNum, true, type);
+                pageNum += leaves.size() / PAGE_SIZE;
+                offset = 0;
+                totalSlot = 0;
+            }
+        }
+        addNode(pageData, nodeData, totalSlot, offset, length);
+        offset += length;
+        if (totalSlot == 0 && pageNum != pages.back()) {
+            leafNodeToKey(pageData, 0, key, rid, type);
+            unsigned keyLength = length - NODE_INDICATOR_SIZE - IX_RID_SIZE;
+            keyLength += type == TypeVarChar ? UNSIGNED_SIZE : 0;
+            pages.push_back(pageNum);
+            keys.emplace_back((char *) key, keyLength);
+        }
+    }
+    if (rc == 0 && pageNum == 1) {
+        rc = ixFileHandle.writePage(pageNum, pageData);
+    } else if (rc == 0) {
+        leaves.insert(leaves.end(), (char *) pageData, (char *) pageData + PAGE_SIZE);
+        rc = ixFileHandle.appendPages(leaves.size() / PAGE_SIZE, leaves.data());
+    }
+
+    // upper levels, every page holds at least two children so each level shrinks
+    while (rc == 0 && pages.size() > 1) {
+        std::vector<unsigned> upperPages;
+        std::vector<std::string> upperKeys;
+        for (unsigned i = 0; rc == 0 && i < pages.size(); i++) {
+            unsigned short totalSlot = i == 0 ? 0 : getTotalSlot(pageData);
+            if (i > 0) {
+                keyToNoneLeafNode(keys[i].data(), pages[i], nodeData, length, type);
+                unsigned short used = IX_INIT_FREE_SPACE - getFreeSpace(pageData);
+                if (totalSlot > 1 && used + length + SLOT_SIZE > capacity) {
+                    rc = ixFileHandle.appendPage(pageData);
+                    totalSlot = 0;
+                }
+            }
+            if (totalSlot == 0) {
+                // the child becomes the MIN node of a new page
+                initNewPage(ixFileHandle, pageData, pageNum, false, type);
+                unsigned short minOffset, minLength;
+                getSlotOffsetAndLength(pageData, 0, minOffset, minLength);
+                memcpy((char *) pageData + minOffset + minLength - UNSIGNED_SIZE, &pages[i], UNSIGNED_SIZE);
+                offset = minLength;
+                upperPages.push_back(pageNum);
+                upperKeys.push_back(keys[i]);
+                continue;
+            }
+            addNode(pageData, nodeData, totalSlot, offset, length);
+            offset += length;
+        }
+        if (rc == 0) {
+            rc = ixFileHandle.appendPage(pageData);
+        }
+        pages.swap(upperPages);
+        keys.swap(upperKeys);
+    }
+    if (rc == 0) {
+        ixFileHandle.rootPageNum = pages[0];
+    }
+
+    free(key);
+    free(nodeData);
+    free(pageData);
+    return rc;
+}
+
+bool IndexManager::isEmpty(IXFileHandle &ixFileHandle) {
+    if (!ixFileHandle.isOpen() || ixFileHandle.rootPageNum != 1 || ixFileHandle.getNumberOfPages() != 2)
+        return false;
+    void *rootPage;
+    if (ixFileHandle.pinPage(1, rootPage) == -1)
+        return false;
+    bool isEmpty = isLeafLayer(rootPage) && getTotalSlot(rootPage) == 0;
+    ixFileHandle.unpinPage(1, false);
+    return isEmpty;
+}
+
 RC IndexManager::scan(IXFileHandle &ixFileHandle, const Attribute &attribute, const void *lowKey, const void *highKey,
                       bool lowKeyInclusive, bool highKeyInclusive, IX_ScanIterator &ix_ScanIterator, void *pageData,
                       unsigned pageNum) {
@@ -498,20 +640,29 @@ RC IndexManager::scan(IXFileHandle &ixFileHandle, const Attribute &attribute, co
     ix_ScanIterator.attribute = attribute;
     ix_ScanIterator.ixFileHandle = &ixFileHandle;
     ix_ScanIterator.slotNum = 0;
+    ix_ScanIterator.isPageMapped = false;
 
     if (pageData == nullptr) {
         std::stack<void *> parents;
         std::stack<unsigned> parentsPageNum;
         searchLeafNodePage(ixFileHandle, ix_ScanIterator.lowKey, attribute.type, parents, parentsPageNum, false, true);
-        ix_ScanIterator.pageData = malloc(PAGE_SIZE);
-        memcpy(ix_ScanIterator.pageData, parents.top(), PAGE_SIZE);
         ix_ScanIterator.pageNum = parentsPageNum.top();
+        // the leaves of a mapped index are read in place, mostly in page order after a bulk load
+        if (ixFileHandle.fileHandle.isMapped() &&
+            ixFileHandle.pinPage(ix_ScanIterator.pageNum, ix_ScanIterator.pageData) == 0) {
+            ix_ScanIterator.isPageMapped = true;
+            ixFileHandle.fileHandle.adviseSequential(true);
+        } else {
+            ix_ScanIterator.pageData = malloc(PAGE_SIZE);
+            memcpy(ix_ScanIterator.pageData, parents.top(), PAGE_SIZE);
+        }
         free(parents.top());
     } else {
         ix_ScanIterator.pageData = malloc(PAGE_SIZE);
         memcpy(ix_ScanIterator.pageData, pageData, PAGE_SIZE);
         ix_ScanIterator.pageNum = pageNum;
     }
+    ix_ScanIterator.readaheadNextLeaf();
 
     if (lowKeyInclusive) {
         ix_ScanIterator.slotNum = searchNode(ix_ScanIterator.pageData, ix_ScanIterator.lowKey, attribute.type, LE_OP,
@@ -708,45 +859,43 @@ IndexManager::searchLeafNodePage(IXFileHandle &ixFileHandle, const void *key, At
                                  std::stack<unsigned int> &parentsPageNum, bool rememberParents,
                                  bool checkDelete) {
     unsigned curPageNum = ixFileHandle.rootPageNum;
-    void *pageData = malloc(PAGE_SIZE);
-    // slot nodeData
-    void *nodeData = malloc(PAGE_SIZE);
-    RC rc = ixFileHandle.readPage(curPageNum, pageData);
+    // interior pages are only looked at, so walk them on pinned frames
+    void *pageData;
+    RC rc = ixFileHandle.pinPage(curPageNum, pageData);
     if (rc == -1)
         throw std::logic_error("wrong rc");
 
-    unsigned short totalSlot;
     while (!isLeafLayer(pageData)) {
-        totalSlot = getTotalSlot(pageData);
-        for (unsigned short i = totalSlot - 1; i >= 0; i--) {
-            unsigned short offset, length;
-            getNodeDataAndOffsetAndLength(pageData, nodeData, i, offset, length);
-            // if key > slotData, we found next child, otherwise if current slot is last slot, must in there
-            if (i == 0 || compareMemoryBlock(key, nodeData, length, type, false) >= 0) {
-                unsigned nextPageNum = getNextPageFromNotLeafNode(nodeData, length);
-
-                void *parentPage = malloc(PAGE_SIZE);
-                memcpy(parentPage, pageData, PAGE_SIZE);
-                if (rememberParents) {
-                    parents.push(parentPage);
-                    parentsPageNum.push(curPageNum);
-                } else {
-                    free(parentPage);
-                }
+        // the child is under the last slot <= key, the first slot holds the minimum value
+        unsigned short slotNum = binarySearchNode(pageData, key, type, false, true);
+        slotNum = slotNum == 0 ? 0 : slotNum - 1;
 
-                ixFileHandle.readPage(nextPageNum, pageData);
-                curPageNum = nextPageNum;
-                break;
-            }
+        unsigned short offset, length;
+        getSlotOffsetAndLength(pageData, slotNum, offset, length);
+        unsigned nextPageNum = getNextPageFromNotLeafNode((char *) pageData + offset, length);
+
+        if (rememberParents) {
+            void *parentPage = malloc(PAGE_SIZE);
+            memcpy(parentPage, pageData, PAGE_SIZE);
+            parents.push(parentPage);
+            parentsPageNum.push(curPageNum);
         }
+
+        ixFileHandle.unpinPage(curPageNum, false);
+        ixFileHandle.pinPage(nextPageNum, pageData);
+        curPageNum = nextPageNum;
     }
 
+    // callers modify and free the leaf, hand them a private copy
+    void *leafPage = malloc(PAGE_SIZE);
+    memcpy(leafPage, pageData, PAGE_SIZE);
+    ixFileHandle.unpinPage(curPageNum, false);
+    pageData = leafPage;
+
     parents.push(pageData);
     parentsPageNum.push(curPageNum);
 
-    unsigned short slotNum = searchNode(pageData, key, type, EQ_OP, true, checkDelete);
-    free(nodeData);
-    return slotNum;
+    return searchNode(pageData, key, type, EQ_OP, true, checkDelete);
 }
 
 void
@@ -910,18 +1059,20 @@ int IndexManager::compareMemoryBlock(const void *key, void *slotData, unsigned s
     } else {
         unsigned keyLength;
         memcpy(&keyLength, key, UNSIGNED_SIZE);
-        std::string keyString((char *) key + UNSIGNED_SIZE, keyLength);
-        std::string blockString((char *) slotData + NODE_INDICATOR_SIZE,
-                                slotLength - NODE_INDICATOR_SIZE - (isLeaf ? IX_RID_SIZE : UNSIGNED_SIZE));
-        if (keyString == MAX_STRING)
+        const char *keyString = (char *) key + UNSIGNED_SIZE;
+        const char *blockString = (char *) slotData + NODE_INDICATOR_SIZE;
+        unsigned blockLength = slotLength - NODE_INDICATOR_SIZE - (isLeaf ? IX_RID_SIZE : UNSIGNED_SIZE);
+        if (isStringEqual(keyString, keyLength, MAX_STRING))
             return 1;
-        if (keyString == MIN_STRING)
+        if (isStringEqual(keyString, keyLength, MIN_STRING))
             return -1;
-        if (blockString == MAX_STRING)
+        if (isStringEqual(blockString, blockLength, MAX_STRING))
             return -1;
-        if (blockString == MIN_STRING)
+        if (isStringEqual(blockString, blockLength, MIN_STRING))
             return 1;
-        int res = keyString.compare(blockString);
+        int res = memcmp(keyString, blockString, std::min(keyLength, blockLength));
+        if (res == 0)
+            res = keyLength > blockLength ? 1 : (keyLength < blockLength ? -1 : 0);
         if (res > 0)
             return 1;
         else if (res < 0)
@@ -931,6 +1082,10 @@ int IndexManager::compareMemoryBlock(const void *key, void *slotData, unsigned s
     }
 }
 
+bool IndexManager::isStringEqual(const char *data, unsigned length, const char *literal) {
+    return length == strlen(literal) && memcmp(data, literal, length) == 0;
+}
+
 // IF node is not leaf node = <INDICATOR, KEY, PAGE_NUM> <1, key_size, 4> (bytes)
 unsigned int IndexManager::getNextPageFromNotLeafNode(void *data, unsigned nodeLength) {
     unsigned nextPage;
@@ -974,61 +1129,60 @@ IndexManager::searchNode(void *data, const void *key, AttrType type, CompOp comp
     unsigned short totalSlot = getTotalSlot(data);
     if (totalSlot == 0)
         return NOT_VALID_UNSIGNED_SHORT_SIGNAL;
-    void *nodeData = malloc(PAGE_SIZE);
-    for (unsigned short i = 0; i < totalSlot; i++) {
-        unsigned short offset, length;
-        getNodeDataAndOffsetAndLength(data, nodeData, i, offset, length);
-        // if already deleted
-        if (isLeaf && checkDelete && !checkNodeValid(nodeData))
-            continue;
-
-        int compareRes = compareMemoryBlock(key, nodeData, length, type, isLeaf);
-
-        switch (compOp) {
-            case EQ_OP:
-                if (compareRes == 0) {
-                    free(nodeData);
-                    return i;
-                }
-                break;
-            case GT_OP:
-                if (compareRes > 0) {
-                    free(nodeData);
-                    return i;
-                }
-                break;
-            case GE_OP:
-                if (compareRes >= 0) {
-                    free(nodeData);
-                    return i;
-                }
-                break;
-            case LT_OP:
-                if (compareRes < 0) {
-                    free(nodeData);
-                    return i;
-                }
-                break;
-            case LE_OP:
-                if (compareRes <= 0) {
-                    free(nodeData);
-                    return i;
-                }
-                break;
-            case NE_OP:
-                break;
-            case NO_OP:
-                break;
-        }
-    }
 
-    free(nodeData);
+    // slots are sorted, so "key > slot" / "key >= slot" hold for a prefix of the slots,
+    // "key < slot" / "key <= slot" for a suffix and "key == slot" for a run in between
+    unsigned short slotNum;
+    switch (compOp) {
+        case GT_OP:
+        case GE_OP:
+            // first live slot, if the prefix reaches that far
+            for (slotNum = 0; slotNum < totalSlot; slotNum++) {
+                if (!(isLeaf && checkDelete && !checkNodeNumValid(data, slotNum)))
+                    break;
+            }
+            if (slotNum < totalSlot) {
+                int compareRes = compareSlot(data, slotNum, key, type, isLeaf);
+                if (compareRes > 0 || (compOp == GE_OP && compareRes == 0))
+                    return slotNum;
+            }
+            return NOT_VALID_UNSIGNED_SHORT_SIGNAL;
+        case LT_OP:
+        case LE_OP:
+        case EQ_OP:
+            slotNum = binarySearchNode(data, key, type, isLeaf, compOp == LT_OP);
+            // lazily deleted entries stay in place, step over them
+            while (slotNum < totalSlot && isLeaf && checkDelete && !checkNodeNumValid(data, slotNum))
+                slotNum++;
+            if (slotNum == totalSlot)
+                return NOT_VALID_UNSIGNED_SHORT_SIGNAL;
+            if (compOp == EQ_OP && compareSlot(data, slotNum, key, type, isLeaf) != 0)
+                return NOT_VALID_UNSIGNED_SHORT_SIGNAL;
+            return slotNum;
+        default:
+            throw std::logic_error("CompOp is not valid!");
+    }
+}
 
-    if (compOp == EQ_OP || compOp == GT_OP || compOp == GE_OP || compOp == LT_OP || compOp == LE_OP) {
-        return NOT_VALID_UNSIGNED_SHORT_SIGNAL;
-    } else {
-        throw std::logic_error("CompOp is not valid!");
+unsigned short
+IndexManager::binarySearchNode(void *data, const void *key, AttrType type, bool isLeaf, bool strict) {
+    unsigned short low = 0, high = getTotalSlot(data);
+    while (low < high) {
+        unsigned short mid = low + (high - low) / 2;
+        int compareRes = compareSlot(data, mid, key, type, isLeaf);
+        // strict: first slot > key, otherwise first slot >= key
+        if (compareRes > 0 || (strict && compareRes == 0))
+            low = mid + 1;
+        else
+            high = mid;
     }
+    return low;
+}
+
+int IndexManager::compareSlot(void *data, unsigned short slotNum, const void *key, AttrType type, bool isLeaf) {
+    unsigned short offset, length;
+    getSlotOffsetAndLength(data, slotNum, offset, length);
+    return compareMemoryBlock(key, (char *) data + offset, length, type, isLeaf);
 }
 
 /*
@@ -1122,13 +1276,8 @@ bool IndexManager::checkNodeNumValid(void *data, unsigned short slotNum) {
     unsigned short offset, length;
     getSlotOffsetAndLength(data, slotNum, offset, length);
 
-    void *nodeData = malloc(PAGE_SIZE);
-    getNodeData(data, nodeData, offset, length);
-
     unsigned char indicator;
-    memcpy(&indicator, nodeData, NODE_INDICATOR_SIZE);
-
-    free(nodeData);
+    memcpy(&indicator, (char *) data + offset, NODE_INDICATOR_SIZE);
     return indicator != DELETE_FLAG;
 }
 
@@ -1215,6 +1364,7 @@ void IndexManager::generateFakeKey(void *fakeKey, const void *key, AttrType type
 
 IX_ScanIterator::IX_ScanIterator() {
     im = &IndexManager::instance();
+    isPageMapped = false;
 }
 
 IX_ScanIterator::~IX_ScanIterator() {
@@ -1270,10 +1420,18 @@ RC IX_ScanIterator::getNextEntry(RID &rid, void *key, bool checkDeleted, unsigne
             if (nextPage == NOT_VALID_UNSIGNED_SIGNAL) {
                 return IX_EOF;
             }
+            if (isPageMapped) {
+                ixFileHandle->unpinPage(pageNum, false);
+                if (ixFileHandle->pinPage(nextPage, pageData) != 0) {
+                    return IX_EOF;
+                }
+            } else {
+                ixFileHandle->readPage(nextPage, pageData);
+            }
             pageNum = nextPage;
-            ixFileHandle->readPage(nextPage, pageData);
             slotNum = 0;
             totalSLot = im->getTotalSlot(pageData);
+            readaheadNextLeaf();
         }
     }
 
@@ -1283,13 +1441,258 @@ RC IX_ScanIterator::getNextEntry(RID &rid, void *key, bool checkDeleted, unsigne
     return 0;
 }
 
+void IX_ScanIterator::readaheadNextLeaf() {
+    // the sibling is read while the entries of this leaf are returned
+    unsigned nextPage = im->getNextPageNum(pageData);
+    if (nextPage != NOT_VALID_UNSIGNED_SIGNAL) {
+        ixFileHandle->readahead(nextPage, 1);
+    }
+}
+
 RC IX_ScanIterator::close() {
-    free(pageData);
+    if (isPageMapped) {
+        ixFileHandle->unpinPage(pageNum, false);
+    } else {
+        free(pageData);
+    }
     free(lowKey);
     free(highKey);
     return 0;
 }
 
+IX_BulkLoader::IX_BulkLoader(const Attribute &attribute, float fillFactor, unsigned bufferPages) {
+    this->attribute = attribute;
+    this->fillFactor = fillFactor;
+    bufferSize = (bufferPages == 0 ? 1 : bufferPages) * PAGE_SIZE;
+    isSorted = false;
+    nextSlot = 0;
+}
+
+IX_BulkLoader::~IX_BulkLoader() {
+    closeRuns();
+}
+
+RC IX_BulkLoader::addEntry(const void *key, const RID &rid) {
+    if (isSorted)
+        return -1;
+    char nodeData[PAGE_SIZE];
+    unsigned short length;
+    IndexManager::keyToLeafNode(key, rid, nodeData, length, attribute.type);
+    entrySlots.emplace_back(entries.size(), length);
+    entries.insert(entries.end(), nodeData, nodeData + length);
+    if (entries.size() >= bufferSize)
+        return spillRun();
+    return 0;
+}
+
+RC IX_BulkLoader::sortEntries() {
+    if (isSorted)
+        return -1;
+    isSorted = true;
+    sortBuffer();
+    if (runFileNames.empty())
+        return 0;
+
+    // what is left in memory becomes the last run, then merge all of them
+    if (!entrySlots.empty() && spillRun() == -1)
+        return -1;
+    for (unsigned run = 0; run < runFileNames.size(); run++) {
+        auto *fileHandle = new FileHandle();
+        runHandles.push_back(fileHandle);
+        runPages.push_back((char *) malloc(PAGE_SIZE));
+        runPageNums.push_back(0);
+        runOffsets.push_back(0);
+        if (PagedFileManager::instance().openFile(runFileNames[run], *fileHandle) == -1)
+            return -1;
+        fileHandle->readPage(0, runPages[run]);
+        if (readRunEntry(run))
+            heap.push_back(run);
+    }
+    auto greater = [this](unsigned run1, unsigned run2) { return compareRun(run1, run2) > 0; };
+    std::make_heap(heap.begin(), heap.end(), greater);
+    return 0;
+}
+
+RC IX_BulkLoader::getNextEntry(void *nodeData, unsigned short &length) {
+    if (!isSorted)
+        return -1;
+    if (runHandles.empty()) {
+        if (nextSlot == entrySlots.size())
+            return IX_EOF;
+        length = entrySlots[nextSlot].second;
+        memcpy(nodeData, entries.data() + entrySlots[nextSlot].first, length);
+        nextSlot++;
+        return 0;
+    }
+
+    if (heap.empty())
+        return IX_EOF;
+    auto greater = [this](unsigned run1, unsigned run2) { return compareRun(run1, run2) > 0; };
+    std::pop_heap(heap.begin(), heap.end(), greater);
+    unsigned run = heap.back();
+    memcpy(&length, runPages[run] + runOffsets[run], UNSIGNED_SHORT_SIZE);
+    memcpy(nodeData, runPages[run] + runOffsets[run] + UNSIGNED_SHORT_SIZE, length);
+    runOffsets[run] += UNSIGNED_SHORT_SIZE + length;
+    if (readRunEntry(run))
+        std::push_heap(heap.begin(), heap.end(), greater);
+    else
+        heap.pop_back();
+    return 0;
+}
+
+RC IX_BulkLoader::getNextKey(void *key, RID &rid) {
+    char nodeData[PAGE_SIZE];
+    unsigned short length;
+    RC rc = getNextEntry(nodeData, length);
+    if (rc != 0)
+        return rc;
+
+    unsigned keyLength = length - NODE_INDICATOR_SIZE - IX_RID_SIZE;
+    unsigned pos = 0;
+    if (attribute.type == TypeVarChar) {
+        memcpy(key, &keyLength, UNSIGNED_SIZE);
+        pos += UNSIGNED_SIZE;
+    }
+    memcpy((char *) key + pos, nodeData + NODE_INDICATOR_SIZE, keyLength);
+    memcpy(&rid.pageNum, nodeData + NODE_INDICATOR_SIZE + keyLength, UNSIGNED_SIZE);
+    memcpy(&rid.slotNum, nodeData + NODE_INDICATOR_SIZE + keyLength + UNSIGNED_SIZE, UNSIGNED_SHORT_SIZE);
+    return 0;
+}
+
+unsigned IX_BulkLoader::getNumberOfRuns() {
+    return runFileNames.size();
+}
+
+int IX_BulkLoader::compareEntry(const char *node1, unsigned short length1, const char *node2, unsigned short length2,
+                                AttrType type) {
+    int res;
+    if (type == TypeInt) {
+        int key1, key2;
+        memcpy(&key1, node1 + NODE_INDICATOR_SIZE, UNSIGNED_SIZE);
+        memcpy(&key2, node2 + NODE_INDICATOR_SIZE, UNSIGNED_SIZE);
+        res = key1 < key2 ? -1 : (key1 > key2 ? 1 : 0);
+    } else if (type == TypeReal) {
+        float key1, key2;
+        memcpy(&key1, node1 + NODE_INDICATOR_SIZE, UNSIGNED_SIZE);
+        memcpy(&key2, node2 + NODE_INDICATOR_SIZE, UNSIGNED_SIZE);
+        res = key1 < key2 ? -1 : (key1 > key2 ? 1 : 0);
+    } else {
+        unsigned keyLength1 = length1 - NODE_INDICATOR_SIZE - IX_RID_SIZE;
+        unsigned keyLength2 = length2 - NODE_INDICATOR_SIZE - IX_RID_SIZE;
+        res = memcmp(node1 + NODE_INDICATOR_SIZE, node2 + NODE_INDICATOR_SIZE, std::min(keyLength1, keyLength2));
+        if (res == 0)
+            res = keyLength1 < keyLength2 ? -1 : (keyLength1 > keyLength2 ? 1 : 0);
+    }
+    if (res != 0)
+        return res < 0 ? -1 : 1;
+
+    // same key, keep the entries in RID order
+    RID rid1, rid2;
+    memcpy(&rid1.pageNum, node1 + length1 - IX_RID_SIZE, UNSIGNED_SIZE);
+    memcpy(&rid1.slotNum, node1 + length1 - UNSIGNED_SHORT_SIZE, UNSIGNED_SHORT_SIZE);
+    memcpy(&rid2.pageNum, node2 + length2 - IX_RID_SIZE, UNSIGNED_SIZE);
+    memcpy(&rid2.slotNum, node2 + length2 - UNSIGNED_SHORT_SIZE, UNSIGNED_SHORT_SIZE);
+    if (rid1.pageNum != rid2.pageNum)
+        return rid1.pageNum < rid2.pageNum ? -1 : 1;
+    if (rid1.slotNum != rid2.slotNum)
+        return rid1.slotNum < rid2.slotNum ? -1 : 1;
+    return 0;
+}
+
+void IX_BulkLoader::sortBuffer() {
+    const char *data = entries.data();
+    AttrType type = attribute.type;
+    std::sort(entrySlots.begin(), entrySlots.end(),
+              [data, type](const std::pair<unsigned, unsigned short> &slot1,
+                           const std::pair<unsigned, unsigned short> &slot2) {
+                  return compareEntry(data + slot1.first, slot1.second, data + slot2.first, slot2.second, type) < 0;
+              });
+}
+
+/*
+ * Run file page = [LENGTH, NODE, LENGTH, NODE, ..., 0]
+ * an entry never crosses a page, a zero length ends the page
+ */
+RC IX_BulkLoader::spillRun() {
+    sortBuffer();
+
+    std::string fileName;
+    if (PagedFileManager::instance().createTempFile(IX_RUN_PREFIX, fileName) == -1)
+        return -1;
+    runFileNames.push_back(fileName);
+
+    FileHandle fileHandle;
+    if (PagedFileManager::instance().openFile(fileName, fileHandle) == -1)
+        return -1;
+    // the run is built in memory and written IO_QUEUE_DEPTH pages at a time
+    std::vector<char> pages(PAGE_SIZE, 0);
+    unsigned short offset = 0;
+    RC rc = 0;
+    for (auto &slot : entrySlots) {
+        unsigned short length = slot.second;
+        if (offset + UNSIGNED_SHORT_SIZE * 2 + length > PAGE_SIZE) {
+            if (pages.size() == IO_QUEUE_DEPTH * PAGE_SIZE) {
+                rc = fileHandle.appendPages(IO_QUEUE_DEPTH, pages.data());
+                if (rc == -1)
+                    break;
+                pages.clear();
+            }
+            pages.resize(pages.size() + PAGE_SIZE, 0);
+            offset = 0;
+        }
+        char *pageData = pages.data() + pages.size() - PAGE_SIZE;
+        memcpy(pageData + offset, &length, UNSIGNED_SHORT_SIZE);
+        memcpy(pageData + offset + UNSIGNED_SHORT_SIZE, entries.data() + slot.first, length);
+        offset += UNSIGNED_SHORT_SIZE + length;
+    }
+    if (rc == 0 && offset > 0)
+        rc = fileHandle.appendPages(pages.size() / PAGE_SIZE, pages.data());
+    if (PagedFileManager::instance().closeFile(fileHandle) == -1)
+        rc = -1;
+
+    entries.clear();
+    entrySlots.clear();
+    return rc;
+}
+
+// move the run to its next entry, false once the run is used up
+bool IX_BulkLoader::readRunEntry(unsigned run) {
+    unsigned short length = 0;
+    if (runOffsets[run] + UNSIGNED_SHORT_SIZE <= PAGE_SIZE)
+        memcpy(&length, runPages[run] + runOffsets[run], UNSIGNED_SHORT_SIZE);
+    if (length != 0)
+        return true;
+    if (runPageNums[run] + 1 >= runHandles[run]->getNumberOfPages())
+        return false;
+    runPageNums[run]++;
+    runOffsets[run] = 0;
+    runHandles[run]->readPage(runPageNums[run], runPages[run]);
+    return true;
+}
+
+int IX_BulkLoader::compareRun(unsigned run1, unsigned run2) {
+    unsigned short length1, length2;
+    const char *node1 = runPages[run1] + runOffsets[run1];
+    const char *node2 = runPages[run2] + runOffsets[run2];
+    memcpy(&length1, node1, UNSIGNED_SHORT_SIZE);
+    memcpy(&length2, node2, UNSIGNED_SHORT_SIZE);
+    return compareEntry(node1 + UNSIGNED_SHORT_SIZE, length1, node2 + UNSIGNED_SHORT_SIZE, length2, attribute.type);
+}
+
+void IX_BulkLoader::closeRuns() {
+    for (unsigned run = 0; run < runHandles.size(); run++) {
+        PagedFileManager::instance().closeFile(*runHandles[run]);
+        delete runHandles[run];
+        free(runPages[run]);
+    }
+    for (auto &fileName : runFileNames)
+        PagedFileManager::instance().destroyFile(fileName);
+    runHandles.clear();
+    runPages.clear();
+    runFileNames.clear();
+    heap.clear();
+}
+
 IXFileHandle::IXFileHandle() {
     ixReadPageCounter = 0;
     ixWritePageCounter = 0;
@@ -1323,11 +1726,28 @@ RC IXFileHandle::appendPage(const void *data) {
     return fileHandle.appendPage(data);
 }
 
+RC IXFileHandle::appendPages(unsigned count, const void *data) {
+    return fileHandle.appendPages(count, data);
+}
+
+RC IXFileHandle::pinPage(PageNum pageNum, void *&data) {
+    return fileHandle.pinPage(pageNum, data);
+}
+
+RC IXFileHandle::unpinPage(PageNum pageNum, bool isDirty) {
+    return fileHandle.unpinPage(pageNum, isDirty);
+}
+
+RC IXFileHandle::readahead(PageNum pageNum, unsigned count) {
+    return fileHandle.readahead(pageNum, count);
+}
+
 void IXFileHandle::_readRootPageNum() {
-    void* data = malloc(PAGE_SIZE);
-    readPage(0, data);
+    void* data;
+    if (pinPage(0, data) == -1)
+        return;
     memcpy(&rootPageNum, data, UNSIGNED_SIZE);
-    free(data);
+    unpinPage(0, false);
 }
 
 void IXFileHandle::_writeRootPageNum() {
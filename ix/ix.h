@@ -28,11 +28,16 @@
 #define MAX_STRING "HIGH_STRING"
 #define NOT_VALID_UNSIGNED_SHORT_SIGNAL 65534
 #define NOT_VALID_UNSIGNED_SIGNAL 987654321
+#define IX_DEFAULT_FILL_FACTOR 0.9
+#define IX_BULK_LOAD_PAGES 256
+#define IX_RUN_PREFIX "ix_bulk_run_"
 
 class IX_ScanIterator;
 
 class IXFileHandle;
 
+class IX_BulkLoader;
+
 class IndexManager {
 
 public:
@@ -45,7 +50,8 @@ public:
     RC destroyFile(const std::string &fileName);
 
     // Open an index and return an ixFileHandle.
-     RC openFile(const std::string &fileName, IXFileHandle &ixFileHandle);
+    // Open an index read only through a mapping of the file if mapped, scans then walk the leaves in place.
+     RC openFile(const std::string &fileName, IXFileHandle &ixFileHandle, bool mapped = false);
 
     // Close an ixFileHandle for an index.
      RC closeFile(IXFileHandle &ixFileHandle);
@@ -56,6 +62,13 @@ public:
     // Delete an entry from the given index that is indicated by the given ixFileHandle.
     RC deleteEntry(IXFileHandle &ixFileHandle, const Attribute &attribute, const void *key, const RID &rid);
 
+    // Build an empty index bottom-up from the entries collected by the loader.
+    // Leaves are packed up to the loader's fill factor and chained left to right.
+    RC bulkLoad(IXFileHandle &ixFileHandle, IX_BulkLoader &loader);
+
+    // true if no entry was ever inserted, the root is still the leaf made by createFile
+    static bool isEmpty(IXFileHandle &ixFileHandle);
+
     // Initialize and IX_ScanIterator to support a range search
     static RC scan(IXFileHandle &ixFileHandle, const Attribute &attribute, const void *lowKey, const void *highKey,
                    bool lowKeyInclusive, bool highKeyInclusive, IX_ScanIterator &ix_ScanIterator, void *pageData,
@@ -107,6 +120,8 @@ public:
     // return 1 if key > block, -1 key < block, 0 key == block
     static int compareMemoryBlock(const void *key, void *slotData, unsigned short slotLength, AttrType type, bool isLeaf);
 
+    static bool isStringEqual(const char *data, unsigned length, const char *literal);
+
     static unsigned int getNextPageFromNotLeafNode(void *data, unsigned nodeLength);
 
     static void rightShiftSlot(void *data, unsigned short startSlot, unsigned short shiftLength);
@@ -114,6 +129,12 @@ public:
     static unsigned short
     searchNode(void *data, const void *key, AttrType type, CompOp compOp, bool isLeaf, bool checkDelete);
 
+    // binary search over the sorted slots: first slot > key if strict, else first slot >= key
+    static unsigned short binarySearchNode(void *data, const void *key, AttrType type, bool isLeaf, bool strict);
+
+    // compareMemoryBlock against a slot, in place
+    static int compareSlot(void *data, unsigned short slotNum, const void *key, AttrType type, bool isLeaf);
+
     static void keyToLeafNode(const void *key, const RID &rid, void *data, unsigned short &length, AttrType type);
 
     static void keyToNoneLeafNode(const void *key, unsigned pageNum, void *data, unsigned short &length, AttrType type);
@@ -172,6 +193,8 @@ public:
     unsigned short slotNum;
     unsigned pageNum;
     void* pageData;
+    // pageData points into the mapped index file, it is not a copy
+    bool isPageMapped;
 
     // Constructor
     IX_ScanIterator();
@@ -187,6 +210,60 @@ public:
 
     RC getNextEntry(RID &rid, void *key, bool checkDeleted, unsigned short &returnSlotNum, unsigned &returnPageNum,
                     void *returnNodeData);
+
+    // Start reading the right sibling of the current leaf
+    void readaheadNextLeaf();
+};
+
+// IX_BulkLoader collects (key, RID) entries and hands them back in key order.
+// Once the buffer is full it is sorted and spilled to a run file, the runs are merged at the end.
+class IX_BulkLoader {
+public:
+    Attribute attribute;
+    float fillFactor;
+
+    IX_BulkLoader(const Attribute &attribute, float fillFactor = IX_DEFAULT_FILL_FACTOR,
+                  unsigned bufferPages = IX_BULK_LOAD_PAGES);
+
+    ~IX_BulkLoader();
+
+    // "key" follows the same format as in IndexManager::insertEntry()
+    RC addEntry(const void *key, const RID &rid);
+
+    // sort what is buffered and start merging the runs, no entry can be added afterwards
+    RC sortEntries();
+
+    // next entry in key order as a leaf node, IX_EOF at the end
+    RC getNextEntry(void *nodeData, unsigned short &length);
+
+    // same, as a key in the format of IndexManager::insertEntry() and its RID
+    RC getNextKey(void *key, RID &rid);
+
+    unsigned getNumberOfRuns();
+
+    // order of two leaf nodes by key, then by RID
+    static int compareEntry(const char *node1, unsigned short length1, const char *node2, unsigned short length2,
+                            AttrType type);
+
+private:
+    unsigned bufferSize;
+    bool isSorted;
+    std::vector<char> entries;
+    std::vector<std::pair<unsigned, unsigned short>> entrySlots;
+    unsigned nextSlot;
+
+    std::vector<std::string> runFileNames;
+    std::vector<FileHandle *> runHandles;
+    std::vector<char *> runPages;
+    std::vector<unsigned> runPageNums;
+    std::vector<unsigned short> runOffsets;
+    std::vector<unsigned> heap;
+
+    void sortBuffer();
+    RC spillRun();
+    bool readRunEntry(unsigned run);
+    int compareRun(unsigned run1, unsigned run2);
+    void closeRuns();
 };
 
 class IXFileHandle {
@@ -215,6 +292,10 @@ public:
     RC readPage(PageNum pageNum, void *data);                           // Get a specific page
     RC writePage(PageNum pageNum, const void *data);                    // Write a specific page
     RC appendPage(const void *data);                                    // Append a specific page
+    RC appendPages(unsigned count, const void *data);                   // Append pages back to back in data
+    RC pinPage(PageNum pageNum, void *&data);                           // Pin a page in the buffer pool
+    RC unpinPage(PageNum pageNum, bool isDirty);                        // Unpin a page, isDirty if the frame was modified
+    RC readahead(PageNum pageNum, unsigned count);                      // Start reading pages, without waiting
 
     bool isOpen();
 
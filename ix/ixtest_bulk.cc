@@ -0,0 +1,149 @@
+#include <algorithm>
+
+#include "ix.h"
+#include "ix_test_util.h"
+
+int testCase_Bulk(const std::string &indexFileName, const Attribute &attribute) {
+    // Functions tested
+    // 1. Create Index File
+    // 2. Open Index File
+    // 3. Bulk load through an external sort with more than one run **
+    // 4. Scan entries, every key in order
+    // 5. Insert entry / Delete entry after the bulk load
+    // 6. Bulk load into a non-empty index -- should fail **
+    // 7. Close Index File
+    // 8. Destroy Index File
+    // NOTE: "**" signifies the new functions being tested in this test case.
+    std::cout << std::endl << "***** In IX Test Case Bulk *****" << std::endl;
+
+    RID rid;
+    IXFileHandle ixFileHandle;
+    IX_ScanIterator ix_ScanIterator;
+    unsigned numOfTuples = 40000;
+    unsigned numOfMoreTuples = 300;
+    int key;
+
+    // create index file
+    RC rc = indexManager.createFile(indexFileName);
+    assert(rc == success && "indexManager::createFile() should not fail.");
+
+    // open index file
+    rc = indexManager.openFile(indexFileName, ixFileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+
+    // every key twice, in random order, with a buffer of only four pages
+    std::vector<unsigned> order;
+    for (unsigned i = 0; i < numOfTuples; i++) {
+        order.push_back(i);
+    }
+    std::random_shuffle(order.begin(), order.end());
+
+    IX_BulkLoader loader(attribute, 0.7, 4);
+    for (unsigned i : order) {
+        key = (int) (i / 2);
+        rid.pageNum = i + 1;
+        rid.slotNum = i % 1000 + 1;
+        rc = loader.addEntry(&key, rid);
+        assert(rc == success && "IX_BulkLoader::addEntry() should not fail.");
+    }
+    assert(loader.getNumberOfRuns() > 1 && "The loader should spill sorted runs.");
+
+    rc = indexManager.bulkLoad(ixFileHandle, loader);
+    assert(rc == success && "indexManager::bulkLoad() should not fail.");
+    assert(ixFileHandle.rootPageNum != 1 && "The root should be an interior page.");
+
+    // insert more entries behind the loaded ones and delete some of the loaded ones
+    for (unsigned i = 0; i < numOfMoreTuples; i++) {
+        key = (int) (numOfTuples / 2 + i);
+        rid.pageNum = numOfTuples + i + 1;
+        rid.slotNum = 1;
+        rc = indexManager.insertEntry(ixFileHandle, attribute, &key, rid);
+        assert(rc == success && "indexManager::insertEntry() should not fail.");
+    }
+    for (unsigned i = 0; i < numOfMoreTuples; i++) {
+        key = (int) (i / 2);
+        rid.pageNum = i + 1;
+        rid.slotNum = i % 1000 + 1;
+        rc = indexManager.deleteEntry(ixFileHandle, attribute, &key, rid);
+        assert(rc == success && "indexManager::deleteEntry() should not fail.");
+    }
+
+    IX_BulkLoader otherLoader(attribute);
+    rc = otherLoader.addEntry(&key, rid);
+    assert(rc == success && "IX_BulkLoader::addEntry() should not fail.");
+    rc = indexManager.bulkLoad(ixFileHandle, otherLoader);
+    assert(rc != success && "indexManager::bulkLoad() on a non-empty index should fail.");
+
+    rc = indexManager.closeFile(ixFileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+
+    // scan everything after reopening
+    rc = indexManager.openFile(indexFileName, ixFileHandle);
+    assert(rc == success && "indexManager::openFile() should not fail.");
+    rc = indexManager.scan(ixFileHandle, attribute, NULL, NULL, true, true, ix_ScanIterator);
+    assert(rc == success && "indexManager::scan() should not fail.");
+
+    unsigned count = 0;
+    int lastKey = -1;
+    bool failed = false;
+    while (ix_ScanIterator.getNextEntry(rid, &key) == success) {
+        count++;
+        if (key < lastKey || (key < (int) (numOfTuples / 2) && rid.pageNum != (unsigned) key * 2 + 1 &&
+                              rid.pageNum != (unsigned) key * 2 + 2)) {
+            failed = true;
+        }
+        lastKey = key;
+    }
+    rc = ix_ScanIterator.close();
+    assert(rc == success && "IX_ScanIterator::close() should not fail.");
+
+    // a range in the middle, both ends inclusive
+    int lowKey = 5000;
+    int highKey = 5999;
+    unsigned rangeCount = 0;
+    rc = indexManager.scan(ixFileHandle, attribute, &lowKey, &highKey, true, true, ix_ScanIterator);
+    assert(rc == success && "indexManager::scan() should not fail.");
+    while (ix_ScanIterator.getNextEntry(rid, &key) == success) {
+        rangeCount++;
+        if (key < lowKey || key > highKey) {
+            failed = true;
+        }
+    }
+    rc = ix_ScanIterator.close();
+    assert(rc == success && "IX_ScanIterator::close() should not fail.");
+
+    rc = indexManager.closeFile(ixFileHandle);
+    assert(rc == success && "indexManager::closeFile() should not fail.");
+
+    if (failed || count != numOfTuples || rangeCount != 2000) {
+        std::cout << "Wrong entries output... " << count << " " << rangeCount << " The test failed" << std::endl;
+        indexManager.destroyFile(indexFileName);
+        return fail;
+    }
+
+    // Destroy Index
+    rc = indexManager.destroyFile(indexFileName);
+    assert(rc == success && "indexManager::destroyFile() should not fail.");
+
+    return success;
+}
+
+int main() {
+
+    const std::string indexFileName = "age_idx";
+    Attribute attrAge;
+    attrAge.length = 4;
+    attrAge.name = "age";
+    attrAge.type = TypeInt;
+
+    indexManager.destroyFile("age_idx");
+
+    if (testCase_Bulk(indexFileName, attrAge) == success) {
+        std::cout << "***** IX Test Case Bulk finished. The result will be examined. *****" << std::endl;
+        return success;
+    } else {
+        std::cout << "***** [FAIL] IX Test Case Bulk failed. *****" << std::endl;
+        return fail;
+    }
+
+}
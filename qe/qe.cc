@@ -1,53 +1,330 @@
 
+#include <cmath>
 #include <sstream>
+#include <algorithm>
+#include <limits>
 #include "qe.h"
 
+static const char *getCompOpString(CompOp op);
 
-Filter::Filter(Iterator *input, Condition &condition) {
-    this->targetAttrName = condition.lhsAttr;
-    input->getAttributes(this->relAttrs);
-    this->input = input;
-    op = condition.op;
-    rhsValue = condition.rhsValue;
-    targetAttrIndex = RecordBasedFileManager::getAttrIndex(relAttrs, targetAttrName);
+static std::string getConditionString(const Condition &condition);
+
+static std::string getPredicateString(const Predicate &predicate);
+
+TupleBatch::TupleBatch(unsigned bufferPages) {
+    capacity = bufferPages * PAGE_SIZE;
+    data = (char *) malloc(capacity);
+    used = 0;
+}
+
+TupleBatch::~TupleBatch() {
+    free(data);
+}
+
+void TupleBatch::clear() {
+    used = 0;
+    offsets.clear();
+}
+
+unsigned TupleBatch::getTupleLength(unsigned i) const {
+    unsigned end = i + 1 < offsets.size() ? offsets[i + 1] : used;
+    return end - offsets[i];
+}
+
+bool TupleBatch::isFull(unsigned maxTuples, unsigned maxLength) const {
+    return offsets.size() >= maxTuples || capacity - used < maxLength;
+}
+
+void TupleBatch::reserve(unsigned length) {
+    if (capacity < length && used == 0) {
+        capacity = (length + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+        data = (char *) realloc(data, capacity);
+    }
+}
+
+void TupleBatch::append(unsigned length) {
+    offsets.push_back(used);
+    used += length;
+}
+
+void TupleBatch::appendTuple(const void *tuple, unsigned length) {
+    memcpy(data + used, tuple, length);
+    append(length);
+}
+
+BatchReader::BatchReader(Iterator *input) : input(input) {
+    cursor = 0;
+    eof = false;
+}
+
+RC BatchReader::getNextTuple(void *&tuple, unsigned &length) {
+    if (cursor == batch.size()) {
+        cursor = 0;
+        // do not pull an input again once it is drained
+        if (eof || input->getNextBatch(batch) == QE_EOF) {
+            batch.clear();
+            eof = true;
+            return QE_EOF;
+        }
+    }
+    tuple = batch.getTuple(cursor);
+    length = batch.getTupleLength(cursor);
+    cursor++;
+    return 0;
+}
 
-    currentTuple = malloc(PAGE_SIZE);
+void BatchReader::reset() {
+    batch.clear();
+    cursor = 0;
+    eof = false;
+}
+
+RC Iterator::getNextBatch(TupleBatch &batch, unsigned maxTuples) {
+    std::vector<Attribute> attrs;
+    getAttributes(attrs);
+    unsigned maxLength = getMaxTupleLength(attrs);
 
-    for (const Attribute& attr : relAttrs) {
-        if (attr.name == targetAttrName) {
-            this->targetAttribute = attr;
+    batch.clear();
+    batch.reserve(maxLength);
+    while (!batch.isFull(maxTuples, maxLength)) {
+        void *data = batch.getFreeSpace();
+        if (getNextTuple(data) != 0) {
             break;
         }
+        batch.append(getTupleLength(attrs, data));
     }
+    return batch.empty() ? QE_EOF : 0;
 }
 
-RC Filter::getNextTuple(void *data) {
-    while (rc != QE_EOF) {
-        rc = input->getNextTuple(currentTuple);
-        // break when satisfied tuple
-        if (rc == QE_EOF || isTupleSatisfied()) {
+bool Iterator::profileNewIterators = false;
+
+void Iterator::setProfiling(bool profiling) {
+    this->profiling = profiling;
+    statistics = IteratorStatistics();
+    for (auto const & it : inputs) {
+        it->setProfiling(profiling);
+    }
+}
+
+void Iterator::explain(std::ostream &out, bool analyze, unsigned depth) const {
+    out << std::string(depth * 2, ' ') << getDescription();
+    if (analyze) {
+        out << " (" << getStatisticsString(statistics) << ")";
+    }
+    out << std::endl;
+    for (auto const & it : inputs) {
+        it->explain(out, analyze, depth + 1);
+    }
+}
+
+std::string Iterator::getStatisticsString(const IteratorStatistics &statistics) {
+    std::stringstream ss;
+    ss.setf(std::ios::fixed);
+    ss.precision(3);
+    ss << "calls=" << statistics.calls << " rows=" << statistics.rows << " time=" << statistics.wallTime * 1000
+       << "ms cpu=" << statistics.cpuTime * 1000 << "ms reads=" << statistics.pageReads << " writes="
+       << statistics.pageWrites;
+    return ss.str();
+}
+
+IteratorProfile::IteratorProfile(Iterator *iterator, bool isCall) {
+    this->iterator = iterator->profiling ? iterator : nullptr;
+    if (this->iterator == nullptr) {
+        return;
+    }
+    if (isCall) {
+        iterator->statistics.calls++;
+    }
+    wallStart = std::chrono::steady_clock::now();
+    cpuStart = std::clock();
+    readStart = FileHandle::totalReadPageCounter.load(std::memory_order_relaxed);
+    writeStart = FileHandle::totalWritePageCounter.load(std::memory_order_relaxed);
+}
+
+IteratorProfile::~IteratorProfile() {
+    if (iterator == nullptr) {
+        return;
+    }
+    IteratorStatistics &statistics = iterator->statistics;
+    statistics.wallTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    statistics.cpuTime += (double) (std::clock() - cpuStart) / CLOCKS_PER_SEC;
+    statistics.pageReads += FileHandle::totalReadPageCounter.load(std::memory_order_relaxed) - readStart;
+    statistics.pageWrites += FileHandle::totalWritePageCounter.load(std::memory_order_relaxed) - writeStart;
+}
+
+TableScan::TableScan(RelationManager &rm, const std::string &tableName, const Predicate &predicate,
+                     const std::vector<std::string> &attrNames, const char *alias) : TableScan(rm, tableName, alias) {
+    pushPredicate(predicate);
+    if (!attrNames.empty() && pushProjection(attrNames) == -1) {
+        throw std::logic_error("TableScan: unknown attribute in the projection");
+    }
+}
+
+void TableScan::pushPredicate(const Predicate &predicate) {
+    Predicate pushed = getRelationPredicate(predicate);
+    if (this->predicate.type == PRED_AND) {
+        this->predicate.children.push_back(pushed);
+    } else {
+        this->predicate = Predicate::conjunction({this->predicate, pushed});
+    }
+    setIterator();
+}
+
+RC TableScan::pushProjection(const std::vector<std::string> &attrNames) {
+    std::vector<Attribute> projectedAttrs;
+    std::vector<std::string> projectedNames;
+    for (auto const & it : attrNames) {
+        std::string attrName = getRelationAttrName(it);
+        int index = RecordBasedFileManager::getAttrIndex(attrs, attrName);
+        if (index == -1) {
+            return -1;
+        }
+        projectedAttrs.push_back(attrs[index]);
+        projectedNames.push_back(attrName);
+    }
+    attrs = projectedAttrs;
+    this->attrNames = projectedNames;
+    projected = true;
+    setIterator();
+    return 0;
+}
+
+std::string TableScan::getRelationAttrName(const std::string &attrName) const {
+    std::string prefix = tableName + ".";
+    if (attrName.compare(0, prefix.size(), prefix) == 0) {
+        return attrName.substr(prefix.size());
+    }
+    return attrName;
+}
+
+Predicate TableScan::getRelationPredicate(const Predicate &predicate) const {
+    Predicate result = predicate;
+    result.lhsAttr = getRelationAttrName(predicate.lhsAttr);
+    result.rhsAttr = getRelationAttrName(predicate.rhsAttr);
+    for (auto & child : result.children) {
+        child = getRelationPredicate(child);
+    }
+    return result;
+}
+
+RC TableScan::getNextBatch(TupleBatch &batch, unsigned maxTuples) {
+    IteratorProfile profile(this);
+    batch.clear();
+    while (!batch.isFull(maxTuples)) {
+        void *data = batch.getFreeSpace();
+        if (iter->getNextTuple(rid, data) != 0) {
             break;
         }
+        batch.append(getTupleLength(attrs, data));
     }
+    return profile.count(batch.empty() ? QE_EOF : 0, batch.size());
+}
 
-    if (rc == QE_EOF) {
-        return QE_EOF;
+std::string TableScan::getDescription() const {
+    std::string description = "TableScan " + relationName + (tableName != relationName ? " AS " + tableName : "");
+    std::string where = getPredicateString(predicate);
+    if (!where.empty()) {
+        description += " WHERE " + where;
     }
+    if (projected) {
+        for (unsigned i = 0; i < attrNames.size(); i++) {
+            description += (i == 0 ? " GET [ " : ", ") + attrNames[i];
+        }
+        description += " ]";
+    }
+    return description;
+}
 
-    memcpy(data, currentTuple, Iterator::getTupleLength(relAttrs, currentTuple));
+RC IndexScan::getNextBatch(TupleBatch &batch, unsigned maxTuples) {
+    IteratorProfile profile(this);
+    batch.clear();
+    while (!batch.isFull(maxTuples)) {
+        void *data = batch.getFreeSpace();
+        if (getNextRID(rid) != 0 || rm.readTuple(tableName, rid, data) != 0) {
+            break;
+        }
+        batch.append(getTupleLength(attrs, data));
+    }
+    return profile.count(batch.empty() ? QE_EOF : 0, batch.size());
+}
 
+RC IndexScan::getNextRID(RID &nextRID) {
+    if (pendingPosition == pendingRids.size()) {
+        pendingRids.clear();
+        pendingPosition = 0;
+        RID entry;
+        while (pendingRids.size() < IO_QUEUE_DEPTH && iter->getNextEntry(entry, key) == 0) {
+            pendingRids.push_back(entry);
+        }
+        if (pendingRids.empty()) {
+            return QE_EOF;
+        }
+        // the tuples sit on pages in no particular order, read them all at once instead of one per tuple
+        rm.prefetchTuples(tableName, pendingRids);
+    }
+    nextRID = pendingRids[pendingPosition++];
     return 0;
 }
 
-bool Filter::isTupleSatisfied() {
-    // get data from tuple
-    void* data = malloc(PAGE_SIZE);
-    RecordBasedFileManager::readAttributeFromRawData(currentTuple, data, relAttrs, "", targetAttrIndex);
+std::string IndexScan::getDescription() const {
+    return "IndexScan " + tableName + " ON " + attrName;
+}
 
-    bool res = RecordBasedFileManager::compareValue(rhsValue.data, data, op, targetAttribute.type);
 
-    free(data);
-    return res;
+Filter::Filter(Iterator *input, Condition &condition) : Filter(input, getConditionPredicate(condition)) {
+}
+
+Filter::Filter(Iterator *input, const Predicate &predicate) : reader(input) {
+    input->getAttributes(this->relAttrs);
+    this->input = input;
+    inputs = {input};
+    this->predicate = predicate;
+    // an unknown attribute lets no tuple through
+    evaluator.bind(predicate, relAttrs);
+}
+
+Predicate Filter::getConditionPredicate(const Condition &condition) {
+    if (condition.bRhsIsAttr) {
+        return Predicate::compare(condition.lhsAttr, condition.op, condition.rhsAttr);
+    }
+    return Predicate::compare(condition.lhsAttr, condition.op, condition.rhsValue.type, condition.rhsValue.data);
+}
+
+RC Filter::getNextTuple(void *data) {
+    IteratorProfile profile(this);
+    void *tuple;
+    unsigned length;
+    while (reader.getNextTuple(tuple, length) != QE_EOF) {
+        if (isTupleSatisfied(tuple)) {
+            memcpy(data, tuple, length);
+            return profile.count(0);
+        }
+    }
+    return QE_EOF;
+}
+
+RC Filter::getNextBatch(TupleBatch &batch, unsigned maxTuples) {
+    IteratorProfile profile(this);
+    void *tuple;
+    unsigned length;
+    // the input may be a join, its tuples longer than a page
+    unsigned maxLength = getMaxTupleLength(relAttrs);
+    batch.clear();
+    batch.reserve(maxLength);
+    while (!batch.isFull(maxTuples, maxLength) && reader.getNextTuple(tuple, length) != QE_EOF) {
+        if (isTupleSatisfied(tuple)) {
+            batch.appendTuple(tuple, length);
+        }
+    }
+    return profile.count(batch.empty() ? QE_EOF : 0, batch.size());
+}
+
+std::string Filter::getDescription() const {
+    return "Filter " + getPredicateString(predicate);
+}
+
+bool Filter::isTupleSatisfied(const void *tuple) {
+    return evaluator.evaluateData(tuple);
 }
 
 void Filter::getAttributes(std::vector<Attribute> &attrs) const {
@@ -57,17 +334,16 @@ void Filter::getAttributes(std::vector<Attribute> &attrs) const {
 }
 
 Filter::~Filter() {
-    free(currentTuple);
 }
 
 
-Project::Project(Iterator *input, const std::vector<std::string> &attrNames) {
+Project::Project(Iterator *input, const std::vector<std::string> &attrNames) : reader(input) {
     input->getAttributes(this->relAttrs);
-    currentTuple = malloc(PAGE_SIZE);
 
     this->targetAttributesNames.insert(targetAttributesNames.begin(), attrNames.begin(), attrNames.end());
 
     this->input = input;
+    inputs = {input};
     for (int i = 0; i < relAttrs.size(); i++) {
         // PositionToAttrMap[i] = relAttrs[i];
         attrNameToAttrMap[relAttrs[i].name] = relAttrs[i];
@@ -84,16 +360,39 @@ Project::Project(Iterator *input, const std::vector<std::string> &attrNames) {
     }
 }
 
-Project::~Project() {
-    free(currentTuple);
-}
-
 RC Project::getNextTuple(void *data) {
-    int rc = input->getNextTuple(currentTuple);
-    if (rc == QE_EOF) {
+    IteratorProfile profile(this);
+    void *tuple;
+    unsigned length;
+    if (reader.getNextTuple(tuple, length) == QE_EOF) {
         return QE_EOF;
     }
+    projectTuple(tuple, data);
+    return profile.count(0);
+}
+
+RC Project::getNextBatch(TupleBatch &batch, unsigned maxTuples) {
+    IteratorProfile profile(this);
+    void *tuple;
+    unsigned length;
+    unsigned maxLength = getMaxTupleLength(targetAttributes);
+    batch.clear();
+    batch.reserve(maxLength);
+    while (!batch.isFull(maxTuples, maxLength) && reader.getNextTuple(tuple, length) != QE_EOF) {
+        batch.append(projectTuple(tuple, batch.getFreeSpace()));
+    }
+    return profile.count(batch.empty() ? QE_EOF : 0, batch.size());
+}
+
+std::string Project::getDescription() const {
+    std::string description = "Project";
+    for (unsigned i = 0; i < targetAttributesNames.size(); i++) {
+        description += (i == 0 ? " " : ", ") + targetAttributesNames[i];
+    }
+    return description;
+}
 
+unsigned Project::projectTuple(const void *currentTuple, void *data) {
     unsigned short size = relAttrs.size();
     unsigned short pos = 0;
 
@@ -146,7 +445,7 @@ RC Project::getNextTuple(void *data) {
     memcpy(data, nullIndicator, nullIndicatorSize);
     delete [] attrsExist;
     delete [] nullIndicator;
-    return 0;
+    return dataPos;
 }
 
 void Project::getAttributes(std::vector<Attribute> &attrs) const {
@@ -163,6 +462,14 @@ unsigned Iterator::getAttributesEstLength(std::vector<Attribute> const &attrs) {
     return length;
 }
 
+unsigned Iterator::getMaxTupleLength(std::vector<Attribute> const &attrs) {
+    unsigned length = (attrs.size() + 7) / 8;
+    for (auto const & it : attrs) {
+        length += it.type == TypeVarChar ? UNSIGNED_SIZE + it.length : UNSIGNED_SIZE;
+    }
+    return length;
+}
+
 unsigned Iterator::getTupleLength(std::vector<Attribute> const &attrs, void *data) {
     unsigned short length = 0;
     int *attrsExist = new int[attrs.size()];
@@ -183,7 +490,7 @@ unsigned Iterator::getTupleLength(std::vector<Attribute> const &attrs, void *dat
     return length;
 }
 
-void Iterator::concatenateTuple(void *data, void *left, void *right, std::vector<Attribute> const &leftAttrs,
+unsigned Iterator::concatenateTuple(void *data, void *left, void *right, std::vector<Attribute> const &leftAttrs,
                                 std::vector<Attribute> const &rightAttrs) {
     int lSize = leftAttrs.size();
     int rSize = rightAttrs.size();
@@ -209,50 +516,160 @@ void Iterator::concatenateTuple(void *data, void *left, void *right, std::vector
     pos += leftLength;
     unsigned rightLength = getTupleLength(rightAttrs, right) - rightNullIndicatorSize;
     memcpy((char *) data + pos, (char *) right + rightNullIndicatorSize, rightLength);
+    return pos + rightLength;
+}
+
+TupleHashTable::TupleHashTable(const std::vector<Attribute> &attrs, int keyIndex) : attrs(attrs), keyIndex(keyIndex) {
+    // an unknown attribute (-1) leaves the table empty, its input has no tuples either
+    if (keyIndex >= 0 && keyIndex < (int) attrs.size()) {
+        keyType = attrs[keyIndex].type;
+    }
+}
+
+unsigned TupleHashTable::insert(const void *tuple, unsigned length) {
+    const char *key = Iterator::getAttributePointer(tuple, attrs, keyIndex);
+    return addEntry(tuple, length, key, Iterator::hashAttribute(key, keyType));
 }
 
-void Iterator::addTupleToHashMap(void *data, void *key, AttrType attrType,
-                                 std::unordered_map<int, std::vector<void *>> &intMap,
-                                 std::unordered_map<std::string, std::vector<void *>> &stringMap) {
-    if (attrType != TypeVarChar) {
-        int intKey;
-        memcpy(&intKey, key, INT_SIZE);
-        if (intMap.find(intKey) == intMap.end()) {
-            std::vector<void *> vector;
-            intMap[intKey] = vector;
+unsigned TupleHashTable::findOrInsert(const void *tuple, unsigned length, bool &inserted) {
+    const char *key = Iterator::getAttributePointer(tuple, attrs, keyIndex);
+    uint32_t hash = Iterator::hashAttribute(key, keyType);
+    if (!slots.empty()) {
+        unsigned head = slots[findSlot(key, hash)].head;
+        if (head != QE_HASH_END) {
+            inserted = false;
+            return head;
         }
-        intMap[intKey].push_back(data);
+    }
+    inserted = true;
+    return addEntry(tuple, length, key, hash);
+}
+
+unsigned TupleHashTable::find(const char *key) const {
+    if (slots.empty()) {
+        return QE_HASH_END;
+    }
+    return slots[findSlot(key, Iterator::hashAttribute(key, keyType))].head;
+}
+
+size_t TupleHashTable::getMemoryUsage() const {
+    return arena.size() + entries.size() * sizeof(Entry) + slots.size() * sizeof(Slot);
+}
+
+void TupleHashTable::clear() {
+    std::vector<char>().swap(arena);
+    std::vector<Entry>().swap(entries);
+    std::vector<Slot>().swap(slots);
+    usedSlots = 0;
+}
+
+const char *TupleHashTable::getKey(unsigned entry) const {
+    if (entries[entry].keyOffset == QE_HASH_END) {
+        return nullptr;
+    }
+    return arena.data() + entries[entry].offset + entries[entry].keyOffset;
+}
+
+unsigned TupleHashTable::findSlot(const char *key, uint32_t hash) const {
+    // the stored hash rules out most other keys before their values are compared
+    auto mask = (unsigned) slots.size() - 1;
+    unsigned slot = hash & mask;
+    while (slots[slot].head != QE_HASH_END &&
+           (slots[slot].hash != hash || Iterator::compareAttribute(getKey(slots[slot].head), key, keyType) != 0)) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+unsigned TupleHashTable::addEntry(const void *tuple, unsigned length, const char *key, uint32_t hash) {
+    // keep at least half of the slots free, the probe sequences stay short
+    if ((usedSlots + 1) * 2 > slots.size()) {
+        grow();
+    }
+    Slot &slot = slots[findSlot(key, hash)];
+
+    Entry entry;
+    entry.offset = arena.size();
+    entry.keyOffset = key == nullptr ? QE_HASH_END : (unsigned) (key - (const char *) tuple);
+    entry.next = QE_HASH_END;
+    arena.insert(arena.end(), (const char *) tuple, (const char *) tuple + length);
+    auto index = (unsigned) entries.size();
+    entries.push_back(entry);
+
+    if (slot.head == QE_HASH_END) {
+        slot.hash = hash;
+        slot.head = index;
+        usedSlots++;
     } else {
-        unsigned stringLength;
-        memcpy(&stringLength, key, UNSIGNED_SIZE);
-        std::string stringKey((char *) key + UNSIGNED_SIZE, stringLength);
-        if (stringMap.find(stringKey) == stringMap.end()) {
-            std::vector<void *> vector;
-            stringMap[stringKey] = vector;
+        entries[slot.tail].next = index;
+    }
+    slot.tail = index;
+    return index;
+}
+
+void TupleHashTable::grow() {
+    std::vector<Slot> oldSlots(std::max<size_t>(16, slots.size() * 2), Slot{0, QE_HASH_END, QE_HASH_END});
+    oldSlots.swap(slots);
+    auto mask = (unsigned) slots.size() - 1;
+    for (auto const & it : oldSlots) {
+        if (it.head == QE_HASH_END) {
+            continue;
+        }
+        unsigned slot = it.hash & mask;
+        while (slots[slot].head != QE_HASH_END) {
+            slot = (slot + 1) & mask;
         }
-        stringMap[stringKey].push_back(data);
+        slots[slot] = it;
+    }
+}
+
+RC SpillFile::create(const std::string &prefix, const std::vector<Attribute> &attrs) {
+    this->attrs = attrs;
+    pending.reserve(PAGE_SIZE);
+    RecordBasedFileManager &rbfm = RecordBasedFileManager::instance();
+    if (rbfm.createTempFile(prefix, fileName) == -1 || rbfm.openFile(fileName, fileHandle) == -1) {
+        return -1;
+    }
+    return 0;
+}
+
+RC SpillFile::append(const void *tuple, unsigned length) {
+    if (pending.size() + length > PAGE_SIZE && flush() == -1) {
+        return -1;
+    }
+    pendingOffsets.push_back(pending.size());
+    pending.insert(pending.end(), (const char *) tuple, (const char *) tuple + length);
+    tupleCount++;
+    return 0;
+}
+
+RC SpillFile::flush() {
+    std::vector<const void *> tuples;
+    for (auto const & it : pendingOffsets) {
+        tuples.push_back(pending.data() + it);
     }
+    std::vector<RID> rids;
+    RC rc = RecordBasedFileManager::instance().insertRecords(fileHandle, attrs, tuples, rids);
+    pending.clear();
+    pendingOffsets.clear();
+    return rc;
 }
 
 /*
- * 1. read tuple from leftIt, till the memory limit
- *      - hash the tuple by key : data
- *
- *      - getNextTuple, calculate length and get key from the tuple
- *      - insert key into hashMap
- *
+ * 1. read tuples from leftIt into a hash table on the key, till the memory limit
  *
  * 2. start table scan rightIt, scan all the tuple
- *      - if there is data in hash map, connect them
+ *      - every tuple of the table with the same key joins it
  *
- *  use leftRC(lrc) & right RC(rrc) to indicate whether the join is over
+ * 3. clear the table and restart rightIt for the next block, till leftIt is over
  *
+ * NULL keys never join
  * */
-BNLJoin::BNLJoin(Iterator *leftIn, TableScan *rightIn, const Condition &condition, const unsigned numPages) {
+BNLJoin::BNLJoin(Iterator *leftIn, TableScan *rightIn, const Condition &condition, const unsigned numPages)
+        : leftReader(leftIn), rightReader(rightIn) {
     rbfm = &RecordBasedFileManager::instance();
 
     memoryLimit = (numPages - 2) * PAGE_SIZE;
-    currentMemory = 0;
 
     lrc = 0;
     rrc = 0;
@@ -263,6 +680,7 @@ BNLJoin::BNLJoin(Iterator *leftIn, TableScan *rightIn, const Condition &conditio
     this->condition = condition;
     this->leftIt = leftIn;
     this->rightIt = rightIn;
+    inputs = {leftIn, rightIn};
 
     leftIn->getAttributes(leftAttrs);
     rightIn->getAttributes(rightAttrs);
@@ -271,94 +689,79 @@ BNLJoin::BNLJoin(Iterator *leftIn, TableScan *rightIn, const Condition &conditio
     leftAttrsIndex = RecordBasedFileManager::getAttrIndex(leftAttrs, condition.lhsAttr);
     rightAttrsIndex = RecordBasedFileManager::getAttrIndex(rightAttrs, condition.rhsAttr);
 
-    tuple1 = malloc(PAGE_SIZE);
-
-
+    table = TupleHashTable(leftAttrs, leftAttrsIndex);
+    matchEntry = QE_HASH_END;
+    // points into the batch of rightReader
+    tuple1 = nullptr;
 }
 
 BNLJoin::~BNLJoin() {
     clean();
-    free(tuple1);
 }
 
-
 RC BNLJoin::getNextTuple(void *data) {
-    void* key = malloc(PAGE_SIZE);
-    // outBuffer is empty, need to get something in it.
-    // when lrc == rrc == QE_EOF, we end
-    bool foundRight = false;
-    while (!foundRight && outBuffer.empty() && (lrc != QE_EOF || rrc != QE_EOF)) {
-        // if current memory is 0, need to start scan to fill input buffer
-        if (currentMemory == 0) {
-            while (currentMemory + leftAttrsEstLength <= memoryLimit) {
-                void *tuple = malloc(PAGE_SIZE);
-                lrc = leftIt->getNextTuple(tuple);
-                if (lrc == QE_EOF) {
-                    free(tuple);
-                    break;
-                }
-                // calculate Length & get key from tuple
-                unsigned short tupleLength;
-                getLengthAndDataFromTuple(tuple, leftAttrs, "", leftAttrsIndex, tupleLength, key);
-                currentMemory += tupleLength;
+    IteratorProfile profile(this);
+    unsigned length;
+    return profile.count(getNextJoinedTuple(data, length));
+}
 
-                // add key to hashMap
-                addTupleToHashMap(tuple, key, leftAttr.type, intMap, stringMap);
-            }
+RC BNLJoin::getNextBatch(TupleBatch &batch, unsigned maxTuples) {
+    IteratorProfile profile(this);
+    unsigned length;
+    // a joined tuple can be longer than a page
+    unsigned maxLength = getMaxTupleLength(leftAttrs) + getMaxTupleLength(rightAttrs);
+    batch.clear();
+    batch.reserve(maxLength);
+    while (!batch.isFull(maxTuples, maxLength) && getNextJoinedTuple(batch.getFreeSpace(), length) != QE_EOF) {
+        batch.append(length);
+    }
+    return profile.count(batch.empty() ? QE_EOF : 0, batch.size());
+}
+
+std::string BNLJoin::getDescription() const {
+    return "BNLJoin " + getConditionString(condition);
+}
+
+RC BNLJoin::getNextJoinedTuple(void *data, unsigned &length) {
+    while (true) {
+        if (matchEntry != QE_HASH_END) {
+            length = concatenateTuple(data, (void *) table.getTuple(matchEntry), tuple1, leftAttrs, rightAttrs);
+            matchEntry = table.next(matchEntry);
+            return 0;
         }
 
-        // search in tableScan
-        while (!foundRight) {
-            rrc = rightIt->getNextTuple(tuple1);
-            if (rrc == QE_EOF) {
-                break;
-            }
-            unsigned short tupleLength;
-            getLengthAndDataFromTuple(tuple1, rightAttrs, "", rightAttrsIndex, tupleLength, key);
-            if (leftAttr.type != TypeVarChar) {
-                int intKey;
-                memcpy(&intKey, key, INT_SIZE);
-                if (intMap.find(intKey) != intMap.end()) {
-                    for (auto const & it : intMap[intKey]) {
-                        outBuffer.push(it);
-                    }
-                    intMap.erase(intKey);
-                    foundRight = true;
-                }
-            } else {
-                unsigned stringLength;
-                memcpy(&stringLength, key, UNSIGNED_SIZE);
-                std::string stringKey ((char *) key + UNSIGNED_SIZE, stringLength);
-                if (stringMap.find(stringKey) != stringMap.end()) {
-                    for (auto const & it : stringMap[stringKey]) {
-                        outBuffer.push(it);
-                    }
-                    stringMap.erase(stringKey);
-                    foundRight = true;
+        // table is empty, fill it with the next block; one tuple at least, even if it is larger than the limit
+        if (table.size() == 0) {
+            while (lrc != QE_EOF && (table.size() == 0 || table.getMemoryUsage() + leftAttrsEstLength <= memoryLimit)) {
+                void *leftTuple;
+                unsigned tupleLength;
+                lrc = leftReader.getNextTuple(leftTuple, tupleLength);
+                if (lrc != QE_EOF && getAttributePointer(leftTuple, leftAttrs, leftAttrsIndex) != nullptr) {
+                    table.insert(leftTuple, tupleLength);
                 }
             }
+            if (table.size() == 0) {
+                return QE_EOF;
+            }
         }
 
-        // if right search is end, clear all hashMap & release memory
-        if (rrc == QE_EOF && lrc != QE_EOF) {
-            currentMemory = 0;
-            //restart iteration
-            rightIt->setIterator();
-            rrc = 0;
+        // search in tableScan
+        unsigned tupleLength;
+        rrc = rightReader.getNextTuple(tuple1, tupleLength);
+        if (rrc == QE_EOF) {
+            // the block is done, release it & restart the scan for the next one
             clean();
+            if (lrc != QE_EOF) {
+                rightIt->setIterator();
+                rightReader.reset();
+                rrc = 0;
+            }
+            continue;
+        }
+        const char *key = getAttributePointer(tuple1, rightAttrs, rightAttrsIndex);
+        if (key != nullptr) {
+            matchEntry = table.find(key);
         }
-    }
-
-    free(key);
-    // get record from out buffer
-    if (outBuffer.empty()) {
-        return QE_EOF;
-    } else {
-        void* tuple = outBuffer.top();
-        outBuffer.pop();
-        concatenateTuple(data, tuple, tuple1, leftAttrs, rightAttrs);
-        free(tuple);
-        return 0;
     }
 }
 
@@ -373,18 +776,8 @@ void BNLJoin::getAttributes(std::vector<Attribute> &attrs) const {
 }
 
 void BNLJoin::clean() {
-    for (auto & it : intMap) {
-        for (auto & it1 : it.second) {
-            free(it1);
-        }
-    }
-    intMap.clear();
-    for (auto & it : stringMap) {
-        for (auto & it1 : it.second) {
-            free(it1);
-        }
-    }
-    stringMap.clear();
+    table.clear();
+    matchEntry = QE_HASH_END;
 }
 
 void Iterator::getLengthAndDataFromTuple(void *tuple, std::vector<Attribute> const &attrs, const std::string &attrName,
@@ -420,11 +813,12 @@ void Iterator::getLengthAndDataFromTuple(void *tuple, std::vector<Attribute> con
     delete[](attrsExist);
 }
 
-INLJoin::INLJoin(Iterator *leftIn, IndexScan *rightIn, const Condition &condition) {
+INLJoin::INLJoin(Iterator *leftIn, IndexScan *rightIn, const Condition &condition) : leftReader(leftIn) {
     rbfm = &RecordBasedFileManager::instance();
 
     leftIt = leftIn;
     rightIt = rightIn;
+    inputs = {leftIn, rightIn};
     this->condition = condition;
 
     leftIn->getAttributes(leftAttrs);
@@ -436,18 +830,48 @@ INLJoin::INLJoin(Iterator *leftIn, IndexScan *rightIn, const Condition &conditio
     leftAttrIndex = RecordBasedFileManager::getAttrIndex(leftAttrs, condition.lhsAttr);
     rightAttrIndex = RecordBasedFileManager::getAttrIndex(rightAttrs, condition.rhsAttr);
 
-    tuple = malloc(PAGE_SIZE);
+    // points into the batch of leftReader
+    tuple = nullptr;
+    tuple1 = malloc(PAGE_SIZE);
+    key = malloc(PAGE_SIZE);
+}
+
+INLJoin::~INLJoin() {
+    free(tuple1);
+    free(key);
 }
 
 RC INLJoin::getNextTuple(void *data) {
-    void* key = malloc(PAGE_SIZE);
-    void* tuple1 = malloc(PAGE_SIZE);
+    IteratorProfile profile(this);
+    unsigned length;
+    return profile.count(getNextJoinedTuple(data, length));
+}
+
+RC INLJoin::getNextBatch(TupleBatch &batch, unsigned maxTuples) {
+    IteratorProfile profile(this);
+    unsigned length;
+    // a joined tuple can be longer than a page
+    unsigned maxLength = getMaxTupleLength(leftAttrs) + getMaxTupleLength(rightAttrs);
+    batch.clear();
+    batch.reserve(maxLength);
+    while (!batch.isFull(maxTuples, maxLength) && getNextJoinedTuple(batch.getFreeSpace(), length) != QE_EOF) {
+        batch.append(length);
+    }
+    return profile.count(batch.empty() ? QE_EOF : 0, batch.size());
+}
+
+std::string INLJoin::getDescription() const {
+    return "INLJoin " + getConditionString(condition);
+}
+
+RC INLJoin::getNextJoinedTuple(void *data, unsigned &length) {
     while (lrc != QE_EOF || rrc != QE_EOF) {
         // if rightIt is over, leftIt get next, restart rightIt scan
         if (rrc == QE_EOF) {
             // leftIt get Next
             unsigned short _;
-            lrc = leftIt->getNextTuple(tuple);
+            unsigned leftLength;
+            lrc = leftReader.getNextTuple(tuple, leftLength);
             if (lrc == QE_EOF) {
                 break;
             }
@@ -461,16 +885,13 @@ RC INLJoin::getNextTuple(void *data) {
         rrc = rightIt->getNextTuple(tuple1);
         // get the tuple, concatenate them
         if (rrc != QE_EOF) {
-            concatenateTuple(data, tuple, tuple1, leftAttrs, rightAttrs);
+            length = concatenateTuple(data, tuple, tuple1, leftAttrs, rightAttrs);
             // found, just break!
             break;
         }
     }
 
-    free(key);
-    free(tuple1);
     if (lrc == QE_EOF && rrc == QE_EOF) {
-        free(tuple);
         return QE_EOF;
     }
     return 0;
@@ -487,25 +908,32 @@ void INLJoin::getAttributes(std::vector<Attribute> &attrs) const {
 }
 
 /*
- * 1. do the partition, write into file, using rbfm
- * 2. using rbfm scan to read file, load all left tuple, then the right
- * 3. output
+ * hybrid hash join
+ * 1. partition R by the hash of the key, every partition starts as a hash table in memory.
+ *    once R outgrows the memory the last resident partition moves to its file, partition 0 goes last
+ * 2. read S once, tuples of resident partitions are joined right away, the others go to the files of S
+ * 3. join the spilled partitions one at a time, R loaded into memory, S scanned from its file
+ *      - R is loaded numPages - 1 pages at a time, one page is left to the scan of S.
+ *        a partition of R larger than that is joined block by block, S is scanned again for every block
  *
  * */
-GHJoin::GHJoin(Iterator *leftIn, Iterator *rightIn, const Condition &condition, const unsigned numPartitions) {
+GHJoin::GHJoin(Iterator *leftIn, Iterator *rightIn, const Condition &condition, const unsigned numPages)
+        : rightReader(rightIn) {
+    // the left input is consumed here, the time and I/O count without a call
+    IteratorProfile profile(this, false);
     rbfm = &RecordBasedFileManager::instance();
 
+    if (!condition.bRhsIsAttr) {
+        throw std::logic_error("check right hand Attr");
+    }
+    if (numPages < 2) {
+        throw std::logic_error("hash join needs at least 2 pages");
+    }
+
+    inputs = {leftIn, rightIn};
     leftIn->getAttributes(leftAttrs);
     rightIn->getAttributes(rightAttrs);
 
-    this->numPartitions = (int) numPartitions;
-
-    std::string leftAttrName = condition.lhsAttr;
-    std::string rightAttrName = condition.rhsAttr;
-
-    leftAttrIndex = RecordBasedFileManager::getAttrIndex(leftAttrs, condition.lhsAttr);
-    rightAttrIndex = RecordBasedFileManager::getAttrIndex(rightAttrs, condition.rhsAttr);
-
     for (auto const & it : leftAttrs) {
         leftAttrNames.push_back(it.name);
     }
@@ -514,120 +942,145 @@ GHJoin::GHJoin(Iterator *leftIn, Iterator *rightIn, const Condition &condition,
         rightAttrNames.push_back(it.name);
     }
 
-    leftAttr = leftAttrs[leftAttrIndex];
-    rightAttr = rightAttrs[rightAttrIndex];
-
-    attrType = leftAttr.type;
-
-    nextpart = 0;
-    lrc = 0;
-    rrc = RBFM_EOF;
+    leftAttrIndex = RecordBasedFileManager::getAttrIndex(leftAttrs, condition.lhsAttr);
+    rightAttrIndex = RecordBasedFileManager::getAttrIndex(rightAttrs, condition.rhsAttr);
+    attrType = leftAttrs[leftAttrIndex].type;
+
+    // every spilled partition keeps a page of pending tuples
+    numPartitions = std::max(2u, (numPages + 1) / 2);
+    memoryLimit = numPages * PAGE_SIZE;
+    memoryUsed = 0;
+    spillCount = 0;
+    resident.assign(numPartitions, true);
+    tables.assign(numPartitions, TupleHashTable(leftAttrs, leftAttrIndex));
+    leftFiles.assign(numPartitions, nullptr);
+    rightFiles.assign(numPartitions, nullptr);
+
+    probingInput = true;
+    nextPartition = 0;
+    currentPartition = 0;
+    scanningPartition = false;
+    partitionTuple = malloc(PAGE_SIZE);
+    leftTuple = malloc(PAGE_SIZE);
+    leftTupleHeld = false;
+    blockCount = 0;
+
+    probeTuple = nullptr;
+    matchEntry = QE_HASH_END;
+
+    if (partitionLeft(leftIn) == -1) {
+        destroyFiles();
+        throw std::logic_error("cannot write the hash join partitions");
+    }
+}
 
-    tuple1 = malloc(PAGE_SIZE);
+GHJoin::~GHJoin() {
+    destroyFiles();
+    free(partitionTuple);
+    free(leftTuple);
+}
 
-    /*
-     * start partition in the following code
-     * */
-    // create file
-    for (int i = 0; i < numPartitions; i++) {
-        leftPartitionNames.push_back(getFileName(i, true, leftAttrName));
-        rbfm->createFile(leftPartitionNames[i]);
+RC GHJoin::getNextTuple(void *data) {
+    IteratorProfile profile(this);
+    unsigned length;
+    return profile.count(getNextJoinedTuple(data, length));
+}
 
-        rightPartitionNames.push_back(getFileName(i, false, rightAttrName));
-        rbfm->createFile(rightPartitionNames[i]);
+RC GHJoin::getNextBatch(TupleBatch &batch, unsigned maxTuples) {
+    IteratorProfile profile(this);
+    unsigned length;
+    // a joined tuple can be longer than a page
+    unsigned maxLength = getMaxTupleLength(leftAttrs) + getMaxTupleLength(rightAttrs);
+    batch.clear();
+    batch.reserve(maxLength);
+    while (!batch.isFull(maxTuples, maxLength) && getNextJoinedTuple(batch.getFreeSpace(), length) != QE_EOF) {
+        batch.append(length);
     }
-
-    // partition
-    scanThenAddToPartitionFile(leftIn, leftPartitionNames, leftAttrs, leftAttrIndex);
-    scanThenAddToPartitionFile(rightIn, rightPartitionNames, rightAttrs, rightAttrIndex);
+    return profile.count(batch.empty() ? QE_EOF : 0, batch.size());
 }
 
-GHJoin::~GHJoin() {
-    free(tuple1);
-    clean();
+std::string GHJoin::getDescription() const {
+    return "GHJoin " + leftAttrs[leftAttrIndex].name + " = " + rightAttrs[rightAttrIndex].name;
 }
 
-RC GHJoin::getNextTuple(void *data) {
-    void *key = malloc(PAGE_SIZE);
-    RID rid;
-    bool foundRight = false;
-    while (!foundRight && outBuffer.empty() && (nextpart != numPartitions || rrc != RBFM_EOF)) {
-        // right end, scan left next & right next
-        if (rrc == RBFM_EOF) {
-            clean();
-            RBFM_ScanIterator rbfmsi;
-            FileHandle fileHandle;
-            rbfm->openFile(getFileName(nextpart, true, leftAttr.name), fileHandle);
-            rbfm->scan(fileHandle, leftAttrs, "", NO_OP, nullptr, leftAttrNames, rbfmsi);
-            void *tuple = malloc(PAGE_SIZE);
-            while (rbfmsi.getNextRecord(rid, tuple) != RBFM_EOF) {
-                RecordBasedFileManager::readAttributeFromRawData(tuple, key, leftAttrs, "", leftAttrIndex);
-                addTupleToHashMap(tuple, key, attrType, intMap, stringMap);
-                tuple = malloc(PAGE_SIZE);
-            }
-            free(tuple);
-            rbfmsi.close();
-
-            // restart scan right
-            rbfm->openFile(getFileName(nextpart, false, rightAttr.name), rightFileHandle);
-            rbfm->scan(rightFileHandle, rightAttrs, "", NO_OP, nullptr, rightAttrNames, rightRBFMSI);
-            rrc = 0;
-
-            nextpart += 1;
-        }
-
-        // search in right part
-        while (!foundRight) {
-            RID rid1;
-            rrc = rightRBFMSI.getNextRecord(rid1, tuple1);
-            if  (rrc == RBFM_EOF) {
-                rightRBFMSI.close();
-                break;
-            }
+RC GHJoin::getNextJoinedTuple(void *data, unsigned &length) {
+    while (true) {
+        if (matchEntry != QE_HASH_END) {
+            const char *tuple = tables[currentPartition].getTuple(matchEntry);
+            matchEntry = tables[currentPartition].next(matchEntry);
+            length = concatenateTuple(data, (void *) tuple, (void *) probeTuple, leftAttrs, rightAttrs);
+            return 0;
+        }
 
-            RecordBasedFileManager::readAttributeFromRawData(tuple1, key, rightAttrs, "", rightAttrIndex);
-            if (attrType != TypeVarChar) {
-                int intKey;
-                memcpy(&intKey, key, INT_SIZE);
-                if (intMap.find(intKey) != intMap.end()) {
-                    for (auto const & it : intMap[intKey]) {
-                        outBuffer.push(it);
-                    }
-                    intMap.erase(intKey);
-                    foundRight = true;
+        if (probingInput) {
+            void *tuple;
+            unsigned tupleLength;
+            if (rightReader.getNextTuple(tuple, tupleLength) == QE_EOF) {
+                probingInput = false;
+                if (closeFiles(rightFiles) == -1) {
+                    destroyFiles();
+                    return QE_EOF;
                 }
-            } else {
-                unsigned stringLength;
-                memcpy(&stringLength, key, UNSIGNED_SIZE);
-                std::string stringKey ((char *) key + UNSIGNED_SIZE, stringLength);
-                if (stringMap.find(stringKey) != stringMap.end()) {
-                    for (auto const & it : stringMap[stringKey]) {
-                        outBuffer.push(it);
-                    }
-                    stringMap.erase(stringKey);
-                    foundRight = true;
+                // resident partitions are done, make room for the spilled ones
+                for (auto & table : tables) {
+                    table.clear();
                 }
+                memoryUsed = 0;
+                continue;
+            }
+
+            const char *key = getAttributePointer(tuple, rightAttrs, rightAttrIndex);
+            if (key == nullptr) {
+                continue;
             }
+            unsigned partition = getPartition(key);
+            if (resident[partition]) {
+                currentPartition = partition;
+                probeTuple = tuple;
+                matchEntry = tables[partition].find(key);
+            } else if (leftFiles[partition] != nullptr &&
+                       addToFile(rightFiles[partition], rightAttrs, tuple, tupleLength) == -1) {
+                destroyFiles();
+                return QE_EOF;
+            }
+            continue;
         }
-    }
 
-    free(key);
-    if (outBuffer.empty()) {
-        clean();
-        for (const auto & it : leftPartitionNames) {
-            rbfm->destroyFile(it);
+        if (scanningPartition) {
+            RID rid;
+            RC rc = partitionIterator.getNextRecord(rid, partitionTuple);
+            if (rc == 0) {
+                probeTuple = partitionTuple;
+                matchEntry = tables[currentPartition].find(getAttributePointer(partitionTuple, rightAttrs,
+                                                                               rightAttrIndex));
+                continue;
+            }
+            if (rc == RBFM_ERROR) {
+                destroyFiles();
+                return QE_EOF;
+            }
+            // closing the iterator also closes the file
+            partitionIterator.close();
+            scanningPartition = false;
+            tables[currentPartition].clear();
+            if (leftTupleHeld) {
+                if (loadBlock() == -1) {
+                    destroyFiles();
+                    return QE_EOF;
+                }
+                continue;
+            }
         }
 
-        for (const auto & it : rightPartitionNames) {
-            rbfm->destroyFile(it);
+        // the next spilled partition with tuples on both sides
+        while (nextPartition < numPartitions &&
+               (leftFiles[nextPartition] == nullptr || rightFiles[nextPartition] == nullptr)) {
+            nextPartition++;
+        }
+        if (nextPartition == numPartitions || loadPartition(nextPartition++) == -1) {
+            destroyFiles();
+            return QE_EOF;
         }
-        return QE_EOF;
-    } else {
-        void* tuple = outBuffer.top();
-        outBuffer.pop();
-        concatenateTuple(data, tuple, tuple1, leftAttrs, rightAttrs);
-        free(tuple);
-        return 0;
     }
 }
 
@@ -641,292 +1094,2355 @@ void GHJoin::getAttributes(std::vector<Attribute> &attrs) const {
     }
 }
 
-std::string GHJoin::getFileName(int i, bool isLeft, std::string &attrName) {
-    std::ostringstream stringStream;
-    if (isLeft) {
-        stringStream << "left_join";
-    } else {
-        stringStream << "right_join";
+unsigned GHJoin::getPartition(const char *key) const {
+    // the high bits pick the partition and the low ones are left to the table
+    return (unsigned) (((uint64_t) hashAttribute(key, attrType) * numPartitions) >> 32);
+}
+
+RC GHJoin::addToFile(PartitionFile *&file, const std::vector<Attribute> &attrs, const void *tuple,
+                     unsigned length) {
+    if (file == nullptr) {
+        file = new PartitionFile();
+        if (file->create(QE_GHJOIN_PARTITION_PREFIX, attrs) == -1) {
+            return -1;
+        }
     }
-    stringStream << i << "_" << attrName << ".pat";
-    return stringStream.str();
+    return file->append(tuple, length);
 }
 
-void GHJoin::scanThenAddToPartitionFile(Iterator *iter, const std::vector<std::string> &partitionFileNames,
-                                        const std::vector<Attribute> &attributes, int attrIndex) {
+RC GHJoin::closeFiles(std::vector<PartitionFile *> &files) {
+    std::vector<FileHandle *> fileHandles;
+    for (auto & file : files) {
+        if (file == nullptr) {
+            continue;
+        }
+        if (file->hasPending() && file->flush() == -1) {
+            return -1;
+        }
+        fileHandles.push_back(&file->fileHandle);
+    }
+    if (BufferManager::instance().flushFiles(fileHandles) == -1) {
+        return -1;
+    }
+    for (FileHandle *fileHandle : fileHandles) {
+        if (rbfm->closeFile(*fileHandle) == -1) {
+            return -1;
+        }
+    }
+    return 0;
+}
 
-    void *tuple = malloc(PAGE_SIZE);
+void GHJoin::destroyFiles() {
+    // the scans point into the files
+    partitionIterator.close();
+    leftIterator.close();
+    scanningPartition = false;
+    leftTupleHeld = false;
+    for (auto *files : {&leftFiles, &rightFiles}) {
+        for (auto & file : *files) {
+            if (file != nullptr) {
+                rbfm->closeFile(file->fileHandle);
+                rbfm->destroyFile(file->fileName);
+                delete file;
+                file = nullptr;
+            }
+        }
+    }
+}
 
-    std::hash<std::string> str_hash;
+RC GHJoin::partitionLeft(Iterator *leftIn) {
+    BatchReader reader(leftIn);
+    void *tuple;
+    unsigned length;
+    while (reader.getNextTuple(tuple, length) != QE_EOF) {
+        // NULL never joins
+        const char *key = getAttributePointer(tuple, leftAttrs, leftAttrIndex);
+        if (key == nullptr) {
+            continue;
+        }
 
-    RID rid;
-    void *data = malloc(PAGE_SIZE);
-    while (iter->getNextTuple(tuple) != RM_EOF) {
-        RecordBasedFileManager::readAttributeFromRawData(tuple, data, attributes, "", attrIndex);
-        int remainder;
-        if (attrType != TypeVarChar) {
-            int dataInt;
-            memcpy(&dataInt, tuple, UNSIGNED_SIZE);
-            if (dataInt < 0) {
-                dataInt += 1;
-                dataInt *= -1;
-            }
-            remainder = dataInt % numPartitions;
-        } else {
-            unsigned length;
-            memcpy(&length, data, UNSIGNED_SIZE);
-            std::string string ((char *) data + UNSIGNED_SIZE, length);
-            int hashcode = str_hash(string);
-            if (hashcode < 0) {
-                hashcode += 1;
-                hashcode *= -1;
+        unsigned partition = getPartition(key);
+        if (!resident[partition]) {
+            if (addToFile(leftFiles[partition], leftAttrs, tuple, length) == -1) {
+                return -1;
             }
-            remainder = hashcode % numPartitions;
+            continue;
+        }
+        TupleHashTable &table = tables[partition];
+        memoryUsed -= table.getMemoryUsage();
+        table.insert(tuple, length);
+        memoryUsed += table.getMemoryUsage();
+        if (memoryUsed + spillCount * PAGE_SIZE > memoryLimit && spillPartitions() == -1) {
+            return -1;
         }
-        FileHandle fileHandle;
-        rbfm->openFile(partitionFileNames[remainder], fileHandle);
-        rbfm->insertRecord(fileHandle, attributes, tuple, rid);
-        rbfm->closeFile(fileHandle);
     }
 
-    free(tuple);
-    free(data);
+    return closeFiles(leftFiles);
 }
 
-void GHJoin::clean() {
-    for (auto & it : intMap) {
-        for (auto & it1 : it.second) {
-            free(it1);
+RC GHJoin::spillPartitions() {
+    for (unsigned partition = numPartitions; partition-- > 0 && memoryUsed + spillCount * PAGE_SIZE > memoryLimit;) {
+        // an empty partition frees nothing, its file would only cost a page
+        TupleHashTable &table = tables[partition];
+        if (!resident[partition] || table.size() == 0) {
+            continue;
         }
+        resident[partition] = false;
+        spillCount++;
+
+        // the tuples go in the order they came
+        for (unsigned entry = 0; entry < table.size(); entry++) {
+            auto *tuple = (void *) table.getTuple(entry);
+            if (addToFile(leftFiles[partition], leftAttrs, tuple, getTupleLength(leftAttrs, tuple)) == -1) {
+                return -1;
+            }
+        }
+        memoryUsed -= table.getMemoryUsage();
+        table.clear();
+    }
+    return 0;
+}
+
+RC GHJoin::loadPartition(unsigned partition) {
+    PartitionFile *file = leftFiles[partition];
+    if (rbfm->openFile(file->fileName, file->fileHandle) == -1) {
+        return -1;
+    }
+    rbfm->scan(file->fileHandle, leftAttrs, "", NO_OP, nullptr, leftAttrNames, leftIterator);
+    leftTupleHeld = false;
+    currentPartition = partition;
+    return loadBlock();
+}
+
+RC GHJoin::loadBlock() {
+    TupleHashTable &table = tables[currentPartition];
+    table.clear();
+    if (leftTupleHeld) {
+        table.insert(leftTuple, getTupleLength(leftAttrs, leftTuple));
+        leftTupleHeld = false;
     }
-    intMap.clear();
-    for (auto & it : stringMap) {
-        for (auto & it1 : it.second) {
-            free(it1);
+    RID rid;
+    RC rc;
+    while ((rc = leftIterator.getNextRecord(rid, leftTuple)) == 0) {
+        unsigned length = getTupleLength(leftAttrs, leftTuple);
+        // a block has one tuple at least
+        if (table.size() > 0 && table.getMemoryUsage() + length > memoryLimit - PAGE_SIZE) {
+            leftTupleHeld = true;
+            break;
         }
+        table.insert(leftTuple, length);
+    }
+    if (rc == RBFM_ERROR) {
+        return -1;
     }
-    stringMap.clear();
+    if (!leftTupleHeld) {
+        // closing the iterator also closes the file
+        leftIterator.close();
+    }
+    blockCount++;
+
+    PartitionFile *file = rightFiles[currentPartition];
+    if (rbfm->openFile(file->fileName, file->fileHandle) == -1) {
+        return -1;
+    }
+    rbfm->scan(file->fileHandle, rightAttrs, "", NO_OP, nullptr, rightAttrNames, partitionIterator);
+    scanningPartition = true;
+    return 0;
+}
+
+/*
+ * hash aggregation
+ * 1. on the first call read the whole input, the group key of every tuple is looked up in a hash table.
+ *    a new key gets an entry and one accumulator per aggregate
+ *      - the key packs the group attributes into a tuple of their own, compared byte by byte
+ *      - counts and INT sums are int64, REAL sums, min and max are double, NULL values are left out
+ *      - once the groups outgrow the memory, they are written to partition files by the hash of the key
+ *        as partial aggregates (key & accumulators) and the table starts over
+ * 2. output the groups in memory in the order they first came, AVG is divided only now
+ * 3. after a spill, every group ended up in a partition: merge the partitions one at a time.
+ *    a partition that does not fit either is spilled again, split by the next bits of its hash
+ *
+ * without group attributes there is exactly one group, even for an empty input
+ * */
+Aggregate::Aggregate(Iterator *input, const Attribute &aggAttr, AggregateOp op)
+        : Aggregate(input, std::vector<Attribute>(), {AggregateFunction{aggAttr, op}}, 0) {
+}
+
+//group by
+Aggregate::Aggregate(Iterator *input, const Attribute &aggAttr, const Attribute &groupAttr, AggregateOp op)
+        : Aggregate(input, std::vector<Attribute>{groupAttr}, {AggregateFunction{aggAttr, op}}, 0) {
 }
 
-Aggregate::Aggregate(Iterator *input, const Attribute &aggAttr, AggregateOp op) {
-    this->aggAttr =aggAttr;
-    this->op = op;
+Aggregate::Aggregate(Iterator *input, const std::vector<Attribute> &groupAttrs,
+                     const std::vector<AggregateFunction> &functions, const unsigned numPages) {
+    rbfm = &RecordBasedFileManager::instance();
+
     this->input = input;
-    this->maxValue = MIN_FLOAT;
-    this->minValue = MAX_FLOAT;
-    this->totalCount = 0;
-    this->groupAttr = aggAttr;
+    inputs = {input};
+    this->groupAttrs = groupAttrs;
+    this->functions = functions;
 
     input->getAttributes(attributes);
-    aggrIndex = RecordBasedFileManager::getAttrIndex(attributes, aggAttr.name);
+    for (auto & it : this->groupAttrs) {
+        int index = RecordBasedFileManager::getAttrIndex(attributes, it.name);
+        if (index != -1) {
+            it = attributes[index];
+        }
+        groupIndexes.push_back(index);
+        outputAttrs.push_back(it);
+    }
+
+    for (auto & it : this->functions) {
+        int index = RecordBasedFileManager::getAttrIndex(attributes, it.aggAttr.name);
+        if (index != -1) {
+            it.aggAttr = attributes[index];
+        }
+        if (it.op != COUNT && it.aggAttr.type == TypeVarChar) {
+            throw std::logic_error("cannot aggregate a VarChar attribute");
+        }
+        aggrIndexes.push_back(index);
+
+        std::string operatorString;
+        switch (it.op) {
+            case MIN:
+                operatorString = "MIN";
+                break;
+            case MAX:
+                operatorString = "MAX";
+                break;
+            case COUNT:
+                operatorString = "COUNT";
+                break;
+            case SUM:
+                operatorString = "SUM";
+                break;
+            case AVG:
+                operatorString = "AVG";
+                break;
+        }
+        Attribute attr = it.aggAttr;
+        attr.name = operatorString + "(" + it.aggAttr.name + ")";
+        attr.type = TypeReal;
+        attr.length = sizeof(float);
+        outputAttrs.push_back(attr);
+    }
+
+    Attribute keyAttr;
+    keyAttr.name = "group";
+    keyAttr.type = TypeVarChar;
+    keyAttr.length = PAGE_SIZE;
+    groupTable = TupleHashTable(std::vector<Attribute>{keyAttr}, 0);
+
+    aggregated = false;
+    outputIndex = 0;
+
+    Attribute stateAttr;
+    stateAttr.name = "state";
+    stateAttr.type = TypeVarChar;
+    stateAttr.length = PAGE_SIZE;
+    spillAttrs = {keyAttr, stateAttr};
+    spillAttrNames = {keyAttr.name, stateAttr.name};
+
+    // every partition of a pass keeps a page of pending records, the groups get the rest
+    numPartitions = std::max(2u, numPages / 2);
+    memoryLimit = numPages == 0 ? 0 : std::max(1u, numPages - std::min(numPages, numPartitions)) * PAGE_SIZE;
+    spillCount = 0;
+    levelCount = 0;
+}
+
+Aggregate::~Aggregate() {
+    destroyFiles();
 }
 
 RC Aggregate::getNextTuple(void *data) {
+    IteratorProfile profile(this);
+    unsigned length;
+    return profile.count(getNextGroup(data, length));
+}
+
+RC Aggregate::getNextBatch(TupleBatch &batch, unsigned maxTuples) {
+    IteratorProfile profile(this);
+    unsigned length;
+    batch.clear();
+    while (!batch.isFull(maxTuples) && getNextGroup(batch.getFreeSpace(), length) != QE_EOF) {
+        batch.append(length);
+    }
+    return profile.count(batch.empty() ? QE_EOF : 0, batch.size());
+}
+
+std::string Aggregate::getDescription() const {
+    std::string description = "Aggregate";
+    for (unsigned i = groupAttrs.size(); i < outputAttrs.size(); i++) {
+        description += (i == groupAttrs.size() ? " " : ", ") + outputAttrs[i].name;
+    }
+    for (unsigned i = 0; i < groupAttrs.size(); i++) {
+        description += (i == 0 ? " GROUP BY " : ", ") + groupAttrs[i].name;
+    }
+    return description;
+}
+
+RC Aggregate::getNextGroup(void *data, unsigned &length) {
+    RC rc = 0;
+    if (!aggregated) {
+        rc = aggregateInput();
+    }
+    while (rc == 0 && outputIndex == groupTable.size()) {
+        if (pendingFiles.empty()) {
+            return QE_EOF;
+        }
+        rc = mergePartition();
+    }
+    if (rc == -1) {
+        destroyFiles();
+        groupTable.clear();
+        accumulators.clear();
+        outputIndex = 0;
+        return QE_EOF;
+    }
 
-    if (groupAttr.name != aggAttr.name) {
-        return getNextTupleGroupBy(data);
+    // the key is a VarChar holding the null indicator & values of the group attributes
+    const char *keyTuple = groupTable.getTuple(outputIndex);
+    unsigned keyLength;
+    memcpy(&keyLength, keyTuple + NULL_INDICATOR_UNIT_SIZE, UNSIGNED_SIZE);
+    const char *groupTuple = keyTuple + NULL_INDICATOR_UNIT_SIZE + UNSIGNED_SIZE;
+    unsigned groupNullIndicatorSize = (groupAttrs.size() + 7) / 8;
+
+    unsigned nullIndicatorSize = (outputAttrs.size() + 7) / 8;
+    memset(data, 0, nullIndicatorSize);
+    for (unsigned i = 0; i < groupAttrs.size(); i++) {
+        RecordBasedFileManager::setNullIndicator(data, i,
+                                                 RecordBasedFileManager::getNullIndicator((void *) groupTuple, i));
+    }
+    unsigned pos = nullIndicatorSize;
+    memcpy((char *) data + pos, groupTuple + groupNullIndicatorSize, keyLength - groupNullIndicatorSize);
+    pos += keyLength - groupNullIndicatorSize;
+
+    const Accumulator *accumulator = &accumulators[outputIndex * functions.size()];
+    for (unsigned i = 0; i < functions.size(); i++) {
+        const Accumulator &it = accumulator[i];
+        if (functions[i].op != COUNT && it.count == 0) {
+            RecordBasedFileManager::setNullIndicator(data, groupAttrs.size() + i, 1);
+            continue;
+        }
+        double sum = functions[i].aggAttr.type == TypeInt ? (double) it.intSum : it.realSum;
+        float value = 0;
+        switch (functions[i].op) {
+            case MIN:
+                value = (float) it.min;
+                break;
+            case MAX:
+                value = (float) it.max;
+                break;
+            case COUNT:
+                value = (float) it.count;
+                break;
+            case SUM:
+                value = (float) sum;
+                break;
+            case AVG:
+                value = (float) (sum / it.count);
+                break;
+        }
+        memcpy((char *) data + pos, &value, sizeof(float));
+        pos += sizeof(float);
     }
 
-    void *currentTuple = malloc(PAGE_SIZE);
-    void* attrData = malloc(PAGE_SIZE);
+    outputIndex += 1;
+    length = pos;
+    return 0;
+}
 
-    while (input->getNextTuple(currentTuple) != QE_EOF) {
-        RecordBasedFileManager::readAttributeFromRawData(currentTuple, attrData, attributes, "", aggrIndex);
+unsigned Aggregate::makeGroupKey(const void *tuple, char *keyTuple) const {
+    char *groupTuple = keyTuple + NULL_INDICATOR_UNIT_SIZE + UNSIGNED_SIZE;
+    unsigned groupNullIndicatorSize = (groupAttrs.size() + 7) / 8;
+    keyTuple[0] = 0x00;
+    memset(groupTuple, 0, groupNullIndicatorSize);
+
+    unsigned pos = groupNullIndicatorSize;
+    for (unsigned i = 0; i < groupAttrs.size(); i++) {
+        const char *value = getAttributePointer(tuple, attributes, groupIndexes[i]);
+        if (value == nullptr) {
+            RecordBasedFileManager::setNullIndicator(groupTuple, i, 1);
+            continue;
+        }
+        unsigned length = UNSIGNED_SIZE;
+        if (groupAttrs[i].type == TypeVarChar) {
+            unsigned stringLength;
+            memcpy(&stringLength, value, UNSIGNED_SIZE);
+            length += stringLength;
+        }
+        memcpy(groupTuple + pos, value, length);
+        if (groupAttrs[i].type == TypeReal) {
+            // -0.0 belongs to the group of 0.0, the bytes have to match
+            float real;
+            memcpy(&real, value, sizeof(float));
+            if (real == 0) {
+                real = 0;
+                memcpy(groupTuple + pos, &real, sizeof(float));
+            }
+        }
+        pos += length;
+    }
+    memcpy(keyTuple + NULL_INDICATOR_UNIT_SIZE, &pos, UNSIGNED_SIZE);
+    return NULL_INDICATOR_UNIT_SIZE + UNSIGNED_SIZE + pos;
+}
 
-        float dataValue = 0;
-        int intValue;
+void Aggregate::accumulate(const void *tuple, Accumulator *accumulator) const {
+    for (unsigned i = 0; i < functions.size(); i++) {
+        const char *value = getAttributePointer(tuple, attributes, aggrIndexes[i]);
+        if (value == nullptr) {
+            continue;
+        }
+        Accumulator &it = accumulator[i];
+        it.count++;
+        if (functions[i].op == COUNT) {
+            continue;
+        }
 
-        if (aggAttr.type == TypeInt) {
-            memcpy(&intValue, attrData, UNSIGNED_SIZE);
-            dataValue += (float) intValue;
+        double real;
+        if (functions[i].aggAttr.type == TypeInt) {
+            int intValue;
+            memcpy(&intValue, value, INT_SIZE);
+            it.intSum += intValue;
+            real = intValue;
         } else {
-            memcpy(&dataValue, attrData, UNSIGNED_SIZE);
+            float floatValue;
+            memcpy(&floatValue, value, sizeof(float));
+            it.realSum += floatValue;
+            real = floatValue;
         }
+        it.min = std::min(it.min, real);
+        it.max = std::max(it.max, real);
+    }
+}
+
+void Aggregate::mergeAccumulators(Accumulator *accumulator, const char *state) const {
+    for (unsigned i = 0; i < functions.size(); i++) {
+        Accumulator partial;
+        memcpy(&partial, state + i * sizeof(Accumulator), sizeof(Accumulator));
+        Accumulator &it = accumulator[i];
+        it.count += partial.count;
+        it.intSum += partial.intSum;
+        it.realSum += partial.realSum;
+        it.min = std::min(it.min, partial.min);
+        it.max = std::max(it.max, partial.max);
+    }
+}
 
-        totalCount++;
-        minValue = dataValue < minValue ? dataValue : minValue;
-        maxValue = dataValue > maxValue ? dataValue : maxValue;
-        valueSum += dataValue;
-        valueAvg = valueSum / totalCount;
+unsigned Aggregate::addGroup(const char *keyTuple, unsigned keyLength, bool &inserted) {
+    unsigned group = groupTable.findOrInsert(keyTuple, keyLength, inserted);
+    if (inserted) {
+        Accumulator empty;
+        empty.count = 0;
+        empty.intSum = 0;
+        empty.realSum = 0;
+        empty.min = std::numeric_limits<double>::infinity();
+        empty.max = -std::numeric_limits<double>::infinity();
+        accumulators.insert(accumulators.end(), functions.size(), empty);
     }
+    return group;
+}
 
-    free(currentTuple);
-    free(attrData);
+bool Aggregate::isOverBudget() const {
+    return memoryLimit != 0 && groupTable.getMemoryUsage() + accumulators.size() * sizeof(Accumulator) > memoryLimit;
+}
 
-    int pos = 0;
-    unsigned char nullIndicator = 0x00;
-    memcpy((char *) data + pos, &nullIndicator, NULL_INDICATOR_UNIT_SIZE);
-    pos += NULL_INDICATOR_UNIT_SIZE;
+RC Aggregate::aggregateInput() {
+    aggregated = true;
 
-    switch (op) {
-        case MAX:
-            memcpy((char *) data + pos, &maxValue, UNSIGNED_SIZE);
-            break;
-        case MIN:
-            memcpy((char *) data + pos, &minValue, UNSIGNED_SIZE);
-            break;
-        case COUNT:
-            memcpy((char *) data + pos, &totalCount, UNSIGNED_SIZE);
-            break;
-        case SUM:
-            memcpy((char *) data + pos, &valueSum, UNSIGNED_SIZE);
-            break;
-        case AVG:
-            memcpy((char *) data + pos, &valueAvg, UNSIGNED_SIZE);
-            break;
+    std::vector<char> keyTuple(NULL_INDICATOR_UNIT_SIZE + UNSIGNED_SIZE + PAGE_SIZE);
+    bool inserted;
+    if (groupAttrs.empty()) {
+        addGroup(keyTuple.data(), makeGroupKey(nullptr, keyTuple.data()), inserted);
     }
 
-    if (!endFlag) {
-        endFlag = true;
-        return 0;
-    } else {
-        return QE_EOF;
+    std::vector<PartitionFile *> files;
+    BatchReader reader(input);
+    void *tuple;
+    unsigned length;
+    RC rc = 0;
+    while (rc == 0 && reader.getNextTuple(tuple, length) != QE_EOF) {
+        unsigned keyLength = makeGroupKey(tuple, keyTuple.data());
+        unsigned group = addGroup(keyTuple.data(), keyLength, inserted);
+        accumulate(tuple, &accumulators[group * functions.size()]);
+        if (inserted && isOverBudget()) {
+            rc = spillGroups(files, 0);
+        }
     }
 
+    // after a spill the groups still in memory belong to their partitions too
+    if (rc == 0 && !files.empty()) {
+        rc = spillGroups(files, 0);
+    }
+    if (finishFiles(files) == -1) {
+        rc = -1;
+    }
+    return rc;
 }
 
-//group by
-Aggregate::Aggregate(Iterator *input, const Attribute &aggAttr, const Attribute &groupAttr, AggregateOp op) {
-    this->groupAttr = groupAttr;
-    this->aggAttr =aggAttr;
-    this->op = op;
-    this->input = input;
-    this->maxValue = MIN_FLOAT;
-    this->minValue = MAX_FLOAT;
-    this->totalCount = 0;
+unsigned Aggregate::getPartition(const char *keyTuple, unsigned level) const {
+    uint32_t hash = hashAttribute(keyTuple + NULL_INDICATOR_UNIT_SIZE, TypeVarChar);
+    // every level mixes the hash once more, so a partition splits on other bits than the one it came from
+    for (unsigned i = 0; i < level; i++) {
+        hash += 0x9e3779b9u;
+        hash ^= hash >> 16u;
+        hash *= 0x85ebca6bu;
+        hash ^= hash >> 13u;
+        hash *= 0xc2b2ae35u;
+        hash ^= hash >> 16u;
+    }
+    return (unsigned) (((uint64_t) hash * numPartitions) >> 32);
+}
 
-    input->getAttributes(attributes);
-    aggrIndex = RecordBasedFileManager::getAttrIndex(attributes, aggAttr.name);
-    groupIndex = RecordBasedFileManager::getAttrIndex(attributes, groupAttr.name);
+RC Aggregate::addToFile(PartitionFile *&file, unsigned level, const void *record, unsigned length) {
+    if (file == nullptr) {
+        file = new PartitionFile();
+        file->level = level;
+        if (file->create(QE_AGGREGATE_PARTITION_PREFIX, spillAttrs) == -1) {
+            return -1;
+        }
+    }
+    return file->append(record, length);
+}
+
+RC Aggregate::spillGroups(std::vector<PartitionFile *> &files, unsigned level) {
+    files.resize(numPartitions, nullptr);
+    unsigned stateLength = functions.size() * sizeof(Accumulator);
+    std::vector<char> record;
+    for (unsigned entry = 0; entry < groupTable.size(); entry++) {
+        const char *keyTuple = groupTable.getTuple(entry);
+        unsigned keyLength;
+        memcpy(&keyLength, keyTuple + NULL_INDICATOR_UNIT_SIZE, UNSIGNED_SIZE);
+        keyLength += NULL_INDICATOR_UNIT_SIZE + UNSIGNED_SIZE;
+
+        // the key tuple has a NULL indicator of one byte, so does the record
+        record.assign(keyTuple, keyTuple + keyLength);
+        record.insert(record.end(), (const char *) &stateLength, (const char *) &stateLength + UNSIGNED_SIZE);
+        const char *state = (const char *) &accumulators[entry * functions.size()];
+        record.insert(record.end(), state, state + stateLength);
+        if (addToFile(files[getPartition(keyTuple, level)], level, record.data(), record.size()) == -1) {
+            return -1;
+        }
+    }
+    groupTable.clear();
+    accumulators.clear();
+    spillCount++;
+    levelCount = std::max(levelCount, level + 1);
+    return 0;
+}
+
+RC Aggregate::finishFiles(std::vector<PartitionFile *> &files) {
+    RC rc = 0;
+    for (auto & file : files) {
+        if (file == nullptr) {
+            continue;
+        }
+        if (file->hasPending() && file->flush() == -1) {
+            rc = -1;
+        }
+        rbfm->closeFile(file->fileHandle);
+        pendingFiles.push_back(file);
+    }
+    files.clear();
+    return rc;
+}
 
-    void *currentTuple = malloc(PAGE_SIZE);
+RC Aggregate::mergePartition() {
+    PartitionFile *file = pendingFiles.back();
+    pendingFiles.pop_back();
+    groupTable.clear();
+    accumulators.clear();
+    outputIndex = 0;
+
+    RC rc = rbfm->openFile(file->fileName, file->fileHandle);
+    if (rc == 0) {
+        RBFM_ScanIterator iterator;
+        rbfm->scan(file->fileHandle, spillAttrs, "", NO_OP, nullptr, spillAttrNames, iterator);
+        bool deeper = file->level + 1 < QE_AGGREGATE_MAX_LEVELS;
+        std::vector<PartitionFile *> files;
+        std::vector<char> record(PAGE_SIZE);
+        RID rid;
+        RC scanRC = 0;
+        while (rc == 0 && (scanRC = iterator.getNextRecord(rid, record.data())) == 0) {
+            unsigned keyLength;
+            memcpy(&keyLength, record.data() + NULL_INDICATOR_UNIT_SIZE, UNSIGNED_SIZE);
+            keyLength += NULL_INDICATOR_UNIT_SIZE + UNSIGNED_SIZE;
+
+            bool inserted;
+            unsigned group = addGroup(record.data(), keyLength, inserted);
+            mergeAccumulators(&accumulators[group * functions.size()], record.data() + keyLength + UNSIGNED_SIZE);
+            if (inserted && deeper && isOverBudget()) {
+                rc = spillGroups(files, file->level + 1);
+            }
+        }
+        // closing the iterator also closes the file
+        iterator.close();
+        if (scanRC == RBFM_ERROR) {
+            rc = -1;
+        }
 
-    while (input->getNextTuple(currentTuple) != QE_EOF) {
-        void *key = malloc(PAGE_SIZE);
-        void *attrData = malloc(PAGE_SIZE);
+        if (rc == 0 && !files.empty()) {
+            rc = spillGroups(files, file->level + 1);
+        }
+        if (finishFiles(files) == -1) {
+            rc = -1;
+        }
+    }
+    rbfm->destroyFile(file->fileName);
+    delete file;
+    return rc;
+}
 
-        RecordBasedFileManager::readAttributeFromRawData(currentTuple, key, attributes, "", groupIndex);
-        RecordBasedFileManager::readAttributeFromRawData(currentTuple, attrData, attributes, "", aggrIndex);
+void Aggregate::destroyFiles() {
+    for (auto & file : pendingFiles) {
+        rbfm->destroyFile(file->fileName);
+        delete file;
+    }
+    pendingFiles.clear();
+}
 
-        std::string keyString;
+unsigned Aggregate::getOutputLength(const void *data) const {
+    return getTupleLength(outputAttrs, (void *) data);
+}
 
-        if (groupAttr.type == TypeInt) {
-            int keyInt;
-            memcpy(&keyInt, key, UNSIGNED_SIZE);
-            keyString = std::to_string(keyInt);
-        } else if (groupAttr.type == TypeReal) {
-            float keyFloat;
-            memcpy(&keyFloat, key, UNSIGNED_SIZE);
-            keyString = std::to_string(keyFloat);
-        } else {
+void Aggregate::getAttributes(std::vector<Attribute> &attrs) const {
+    for (auto const & it : outputAttrs) {
+        attrs.push_back(it);
+    }
+}
+
+const char *Iterator::getAttributePointer(const void *tuple, std::vector<Attribute> const &attrs, int index) {
+    auto *nullIndicator = (const unsigned char *) tuple;
+    const char *pos = (const char *) tuple + (attrs.size() + 7) / 8;
+    for (int i = 0; i <= index; i++) {
+        if (nullIndicator[i / 8] & (0x80u >> (unsigned) (i % 8))) {
+            if (i == index) {
+                return nullptr;
+            }
+            continue;
+        }
+        if (i == index) {
+            break;
+        }
+        if (attrs[i].type == TypeVarChar) {
             unsigned length;
-            memcpy(&length, key, UNSIGNED_SIZE);
-            keyString.assign((char *) key + UNSIGNED_SIZE, length);
+            memcpy(&length, pos, UNSIGNED_SIZE);
+            pos += length;
         }
+        pos += UNSIGNED_SIZE;
+    }
+    return pos;
+}
 
-        float dataValue = 0;
-        int intValue;
+int Iterator::compareAttribute(const char *value1, const char *value2, AttrType type) {
+    if (value1 == nullptr || value2 == nullptr) {
+        return (value1 != nullptr) - (value2 != nullptr);
+    }
+    if (type == TypeInt) {
+        int int1, int2;
+        memcpy(&int1, value1, INT_SIZE);
+        memcpy(&int2, value2, INT_SIZE);
+        return (int1 > int2) - (int1 < int2);
+    } else if (type == TypeReal) {
+        float float1, float2;
+        memcpy(&float1, value1, UNSIGNED_SIZE);
+        memcpy(&float2, value2, UNSIGNED_SIZE);
+        return (float1 > float2) - (float1 < float2);
+    }
+    unsigned length1, length2;
+    memcpy(&length1, value1, UNSIGNED_SIZE);
+    memcpy(&length2, value2, UNSIGNED_SIZE);
+    int res = memcmp(value1 + UNSIGNED_SIZE, value2 + UNSIGNED_SIZE, std::min(length1, length2));
+    if (res != 0) {
+        return res;
+    }
+    return (length1 > length2) - (length1 < length2);
+}
 
-        if (aggAttr.type == TypeInt) {
-            memcpy(&intValue, attrData, UNSIGNED_SIZE);
-            dataValue += (float) intValue;
-        } else {
-            memcpy(&dataValue, attrData, UNSIGNED_SIZE);
+uint32_t Iterator::hashAttribute(const char *value, AttrType type) {
+    if (value == nullptr) {
+        return 0;
+    }
+    uint32_t hash;
+    if (type == TypeVarChar) {
+        // FNV-1a
+        unsigned length;
+        memcpy(&length, value, UNSIGNED_SIZE);
+        hash = 2166136261u;
+        for (unsigned i = 0; i < length; i++) {
+            hash ^= (unsigned char) value[UNSIGNED_SIZE + i];
+            hash *= 16777619u;
+        }
+    } else if (type == TypeReal) {
+        // 0.0 and -0.0 are equal, so they need the same bits
+        float real;
+        memcpy(&real, value, sizeof(float));
+        if (real == 0) {
+            real = 0;
         }
+        memcpy(&hash, &real, sizeof(float));
+    } else {
+        memcpy(&hash, value, sizeof(uint32_t));
+    }
+    // murmur3 finalizer, partitions take the high bits and hash tables the low ones
+    hash ^= hash >> 16u;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13u;
+    hash *= 0xc2b2ae35u;
+    hash ^= hash >> 16u;
+    return hash;
+}
 
-        free(key);
-        free(attrData);
+/*
+ * 1. read the input into memory, sort it and spill a run whenever the pages are full
+ *      - the input fits into memory: no run at all, output straight from the buffer
+ * 2. merge numPages - 1 runs at a time into a new run, till one pass is left
+ * 3. the last pass is merged through a loser tree while the tuples are pulled
+ *
+ * runs are RBFM files, records are appended in order and read back with a scan
+ * */
+Sort::Sort(Iterator *input, const std::vector<SortKey> &keys, const unsigned numPages) {
+    // the runs are built here, the time and I/O count without a call
+    IteratorProfile profile(this, false);
+    rbfm = &RecordBasedFileManager::instance();
 
-        totalCountMap[keyString] += 1;
+    if (numPages < 3) {
+        throw std::logic_error("sort needs at least 3 pages");
+    }
+    this->numPages = numPages;
+    memoryLimit = numPages * PAGE_SIZE;
+    runCount = 0;
+    cursor = 0;
+    readFailed = false;
+    inputs = {input};
+
+    input->getAttributes(attrs);
+    for (auto const & it : attrs) {
+        attrNames.push_back(it.name);
+    }
+    for (auto const & it : keys) {
+        int index = RecordBasedFileManager::getAttrIndex(attrs, it.attrName);
+        if (index == -1) {
+            throw std::logic_error("check sort key " + it.attrName);
+        }
+        keyIndexes.push_back(index);
+        keyAscending.push_back(it.ascending);
+    }
 
-        if (minMap.count(keyString) == 0) {
-            minMap[keyString] = dataValue;
-        } else {
-            minMap[keyString] = std::min(minMap[keyString], dataValue);
+    BatchReader reader(input);
+    void *tuple;
+    unsigned length;
+    buffer.reserve(memoryLimit);
+    while (reader.getNextTuple(tuple, length) != QE_EOF) {
+        if (buffer.size() + length > memoryLimit && spillBuffer() == -1) {
+            abandonRuns();
         }
+        offsets.push_back(buffer.size());
+        buffer.insert(buffer.end(), (char *) tuple, (char *) tuple + length);
+    }
 
-        if (maxMap.count(keyString) == 0) {
-            maxMap[keyString] = dataValue;
-        } else {
-            maxMap[keyString] = std::max(maxMap[keyString], dataValue);
+    if (runFileNames.empty()) {
+        sortBuffer();
+        return;
+    }
+    if (!offsets.empty() && spillBuffer() == -1) {
+        abandonRuns();
+    }
+    std::vector<char>().swap(buffer);
+
+    unsigned fanIn = numPages - 1;
+    unsigned first = 0;
+    while (runFileNames.size() - first > fanIn) {
+        if (mergeRuns(first, first + fanIn) == -1) {
+            abandonRuns();
         }
+        first += fanIn;
+    }
+    if (openRuns(first, runFileNames.size()) == -1) {
+        abandonRuns();
+    }
+}
+
+void Sort::abandonRuns() {
+    closeRuns();
+    // the runs merged already are gone, destroying them again does nothing
+    for (auto const & it : runFileNames) {
+        rbfm->destroyFile(it);
+    }
+    runFileNames.clear();
+    throw std::logic_error("cannot write the sort runs");
+}
+
+Sort::~Sort() {
+    closeRuns();
+}
 
-        sumMap[keyString] += dataValue;
-        avgMap[keyString] = sumMap[keyString] / totalCountMap[keyString];
+RC Sort::getNextTuple(void *data) {
+    IteratorProfile profile(this);
+    unsigned length;
+    return profile.count(getNextSortedTuple(data, length));
+}
+
+RC Sort::getNextBatch(TupleBatch &batch, unsigned maxTuples) {
+    IteratorProfile profile(this);
+    unsigned length;
+    batch.clear();
+    while (!batch.isFull(maxTuples) && getNextSortedTuple(batch.getFreeSpace(), length) != QE_EOF) {
+        batch.append(length);
+    }
+    return profile.count(batch.empty() ? QE_EOF : 0, batch.size());
+}
 
+std::string Sort::getDescription() const {
+    std::string description = "Sort";
+    for (unsigned i = 0; i < keyIndexes.size(); i++) {
+        description += (i == 0 ? " " : ", ") + attrNames[keyIndexes[i]] + (keyAscending[i] ? "" : " DESC");
     }
+    return description;
+}
 
-    for (const auto & it : totalCountMap) {
-        std::vector<float> vector {minMap[it.first], maxMap[it.first], it.second, sumMap[it.first], avgMap[it.first]};
-        aggregations.push_back(vector);
-        groups.push_back(it.first);
+void Sort::getAttributes(std::vector<Attribute> &attrs) const {
+    for (auto const & it : this->attrs) {
+        attrs.push_back(it);
     }
+}
 
-    free(currentTuple);
+int Sort::compareTuple(const void *tuple1, const void *tuple2) const {
+    for (unsigned i = 0; i < keyIndexes.size(); i++) {
+        int index = keyIndexes[i];
+        int res = compareAttribute(getAttributePointer(tuple1, attrs, index),
+                                   getAttributePointer(tuple2, attrs, index), attrs[index].type);
+        if (res != 0) {
+            return keyAscending[i] ? res : -res;
+        }
+    }
+    return 0;
 }
 
-RC Aggregate::getNextTupleGroupBy(void *data) {
-    if (outputIndex == groups.size())
-        return QE_EOF;
+void Sort::sortBuffer() {
+    std::stable_sort(offsets.begin(), offsets.end(), [this](unsigned offset1, unsigned offset2) {
+        return compareTuple(buffer.data() + offset1, buffer.data() + offset2) < 0;
+    });
+}
 
-    int pos = 0;
+RC Sort::createRunFile(std::string &fileName) {
+    if (rbfm->createTempFile(QE_SORT_RUN_PREFIX, fileName) == -1) {
+        return -1;
+    }
+    runFileNames.push_back(fileName);
+    return 0;
+}
 
-    unsigned char nullIndicator = 0x00;
-    memcpy((char *) data + pos, &nullIndicator, NULL_INDICATOR_UNIT_SIZE);
-    pos += NULL_INDICATOR_UNIT_SIZE;
+RC Sort::spillBuffer() {
+    sortBuffer();
 
-    // stringKey back to original
-    if (groupAttr.type == TypeInt) {
-        int intKey = std::stoi(groups[outputIndex]);
-        memcpy((char *) data + pos, &intKey, UNSIGNED_SIZE);
-        pos += UNSIGNED_SIZE;
-    } else if (groupAttr.type == TypeReal) {
-        float floatKey = std::stof(groups[outputIndex]);
-        memcpy((char *) data + pos, &floatKey, UNSIGNED_SIZE);
-        pos += UNSIGNED_SIZE;
-    } else {
-        unsigned length = groups[outputIndex].size();
-        memcpy((char *) data + pos, &length, UNSIGNED_SIZE);
-        pos += UNSIGNED_SIZE;
-        memcpy((char *) data + pos, groups[outputIndex].c_str(), length);
-        pos += (int) length;
+    std::string fileName;
+    FileHandle fileHandle;
+    if (createRunFile(fileName) == -1 || rbfm->openFile(fileName, fileHandle) == -1) {
+        return -1;
+    }
+
+    // records are appended in the given order
+    std::vector<const void *> tuples;
+    for (auto const & it : offsets) {
+        tuples.push_back(buffer.data() + it);
+    }
+    std::vector<RID> rids;
+    RC rc = rbfm->insertRecords(fileHandle, attrs, tuples, rids);
+    if (rbfm->closeFile(fileHandle) == -1) {
+        rc = -1;
     }
 
-    memcpy((char *) data + pos, &aggregations[outputIndex][op], UNSIGNED_SIZE);
+    buffer.clear();
+    offsets.clear();
+    runCount++;
+    return rc;
+}
 
-    outputIndex += 1;
+RC Sort::openRuns(unsigned first, unsigned last) {
+    for (unsigned i = first; i < last; i++) {
+        auto *run = new SortRun();
+        run->fileName = runFileNames[i];
+        run->tuple = malloc(PAGE_SIZE);
+        run->exhausted = false;
+        runs.push_back(run);
+        if (rbfm->openFile(run->fileName, run->fileHandle) == -1) {
+            return -1;
+        }
+        rbfm->scan(run->fileHandle, attrs, "", NO_OP, nullptr, attrNames, run->iterator);
+        if (readRun(runs.size() - 1) == -1) {
+            return -1;
+        }
+    }
+    buildTree();
     return 0;
 }
 
-void Aggregate::getAttributes(std::vector<Attribute> &attrs) const {
+void Sort::closeRuns() {
+    for (auto & run : runs) {
+        // closing the iterator also closes the file
+        run->iterator.close();
+        rbfm->destroyFile(run->fileName);
+        free(run->tuple);
+        delete run;
+    }
+    runs.clear();
+    tree.clear();
+}
 
-    std::string operatorString;
-    switch (op) {
-        case MIN:
-            operatorString = "MIN";
-            break;
-        case MAX:
-            operatorString = "MAX";
-            break;
-        case COUNT:
-            operatorString = "COUNT";
-            break;
-        case SUM:
-            operatorString = "SUM";
-            break;
-        case AVG:
-            operatorString = "AVG";
-            break;
+RC Sort::mergeRuns(unsigned first, unsigned last) {
+    if (openRuns(first, last) == -1) {
+        closeRuns();
+        return -1;
     }
 
-    Attribute tmpAttr = aggAttr;
-    std::string tmp = operatorString;
-    tmp += "(";
-    tmp += tmpAttr.name;
-    tmp += ")";
+    std::string fileName;
+    FileHandle fileHandle;
+    if (createRunFile(fileName) == -1 || rbfm->openFile(fileName, fileHandle) == -1) {
+        closeRuns();
+        return -1;
+    }
+
+    // collect a page worth of tuples, then append them in one go
+    std::vector<char> pending;
+    std::vector<const void *> tuples;
+    std::vector<unsigned> pendingOffsets;
+    std::vector<RID> rids;
+    void *tuple = malloc(PAGE_SIZE);
+    unsigned length;
+    RC rc = 0;
+    bool eof = false;
+    while (!eof && rc == 0) {
+        eof = getNextSortedTuple(tuple, length) == QE_EOF;
+        if (!pending.empty() && (eof || pending.size() + length > PAGE_SIZE)) {
+            tuples.clear();
+            for (auto const & it : pendingOffsets) {
+                tuples.push_back(pending.data() + it);
+            }
+            rc = rbfm->insertRecords(fileHandle, attrs, tuples, rids);
+            pending.clear();
+            pendingOffsets.clear();
+        }
+        if (!eof) {
+            pendingOffsets.push_back(pending.size());
+            pending.insert(pending.end(), (char *) tuple, (char *) tuple + length);
+        }
+    }
+    free(tuple);
+    if (rbfm->closeFile(fileHandle) == -1 || readFailed) {
+        rc = -1;
+    }
+    closeRuns();
+    return rc;
+}
 
-    tmpAttr.name = tmp;
-    attrs.push_back(tmpAttr);
+RC Sort::readRun(int run) {
+    RID rid;
+    RC rc = runs[run]->iterator.getNextRecord(rid, runs[run]->tuple);
+    if (rc == RBFM_EOF) {
+        runs[run]->exhausted = true;
+    } else if (rc != 0) {
+        readFailed = true;
+        return -1;
+    }
+    return 0;
+}
 
+bool Sort::isBefore(int run1, int run2) const {
+    if (runs[run1]->exhausted) {
+        return false;
+    }
+    if (runs[run2]->exhausted) {
+        return true;
+    }
+    // ties go to the earlier run, which keeps the sort stable
+    int res = compareTuple(runs[run1]->tuple, runs[run2]->tuple);
+    return res < 0 || (res == 0 && run1 < run2);
 }
 
+void Sort::adjustTree(int run) {
+    // leaves sit at k .. 2k - 1, every inner node keeps the loser of its match
+    int k = runs.size();
+    for (int t = (run + k) / 2; t > 0; t /= 2) {
+        // -1 only shows up while the tree is built and wins every match
+        if (tree[t] == -1 || (run != -1 && isBefore(tree[t], run))) {
+            std::swap(run, tree[t]);
+        }
+    }
+    tree[0] = run;
+}
+
+void Sort::buildTree() {
+    tree.assign(runs.size(), -1);
+    for (int i = (int) runs.size() - 1; i >= 0; i--) {
+        adjustTree(i);
+    }
+}
+
+RC Sort::getNextSortedTuple(void *data, unsigned &length) {
+    if (runs.empty()) {
+        if (cursor == offsets.size()) {
+            return QE_EOF;
+        }
+        void *tuple = buffer.data() + offsets[cursor++];
+        length = getTupleLength(attrs, tuple);
+        memcpy(data, tuple, length);
+        return 0;
+    }
+
+    int winner = tree[0];
+    if (readFailed || runs[winner]->exhausted) {
+        return QE_EOF;
+    }
+    length = getTupleLength(attrs, runs[winner]->tuple);
+    memcpy(data, runs[winner]->tuple, length);
+    // the tuples after a run that cannot be read would come out of order
+    if (readRun(winner) == -1) {
+        return QE_EOF;
+    }
+    adjustTree(winner);
+    return 0;
+}
+
+/*
+ * 1. sort both inputs ascending on the join key, unless they come sorted
+ * 2. the outer side drives, the inner tuples it joins with are buffered
+ *      - EQ: the buffer is the group of inner tuples with the outer key,
+ *        it is kept for the following outer tuples with the same key
+ *      - GT / GE: the buffer is the prefix of inner tuples below the outer key,
+ *        it only grows since the outer keys ascend
+ *      - LT / LE: same as GT / GE with S as the outer side
+ * 3. the buffer keeps what the sorts leave of numPages in memory, the rest goes to an RBFM temp file
+ *
+ * NULL keys never join
+ * */
+SMJoin::SMJoin(Iterator *leftIn, Iterator *rightIn, const Condition &condition, const unsigned numPages,
+               bool leftSorted, bool rightSorted) {
+    // the inputs are sorted here, the time and I/O count without a call
+    IteratorProfile profile(this, false);
+    rbfm = &RecordBasedFileManager::instance();
+
+    if (!condition.bRhsIsAttr) {
+        throw std::logic_error("check right hand Attr");
+    }
+    if (condition.op == NE_OP || condition.op == NO_OP) {
+        throw std::logic_error("sort-merge join needs EQ or a band condition");
+    }
+
+    leftIn->getAttributes(leftAttrs);
+    rightIn->getAttributes(rightAttrs);
+
+    // the sorts and the buffer share numPages, every sort keeps its 3 pages at least
+    unsigned sorts = (leftSorted ? 0 : 1) + (rightSorted ? 0 : 1);
+    unsigned sortPages = std::max(3u, numPages / (sorts + 1));
+    if (numPages < sorts * sortPages + 1) {
+        throw std::logic_error("sort-merge join needs at least " + std::to_string(sorts * 3 + 1) + " pages");
+    }
+    leftSort = leftSorted ? nullptr : new Sort(leftIn, {{condition.lhsAttr, true}}, sortPages);
+    rightSort = rightSorted ? nullptr : new Sort(rightIn, {{condition.rhsAttr, true}}, sortPages);
+    Iterator *left = leftSorted ? leftIn : leftSort;
+    Iterator *right = rightSorted ? rightIn : rightSort;
+    inputs = {left, right};
+
+    leftIsOuter = condition.op != LT_OP && condition.op != LE_OP;
+    if (leftIsOuter) {
+        op = condition.op;
+        outerAttrs = leftAttrs;
+        innerAttrs = rightAttrs;
+        outerIndex = RecordBasedFileManager::getAttrIndex(leftAttrs, condition.lhsAttr);
+        innerIndex = RecordBasedFileManager::getAttrIndex(rightAttrs, condition.rhsAttr);
+        outerReader = new BatchReader(left);
+        innerReader = new BatchReader(right);
+    } else {
+        // R < S is S > R
+        op = condition.op == LT_OP ? GT_OP : GE_OP;
+        outerAttrs = rightAttrs;
+        innerAttrs = leftAttrs;
+        outerIndex = RecordBasedFileManager::getAttrIndex(rightAttrs, condition.rhsAttr);
+        innerIndex = RecordBasedFileManager::getAttrIndex(leftAttrs, condition.lhsAttr);
+        outerReader = new BatchReader(right);
+        innerReader = new BatchReader(left);
+    }
+    keyType = outerAttrs[outerIndex].type;
+
+    memoryLimit = (numPages - sorts * sortPages) * PAGE_SIZE;
+    groupFile = nullptr;
+    spillCount = 0;
+    spillFailed = false;
+    outputting = false;
+    bufferPos = 0;
+    scanningGroup = false;
+
+    outerTuple = malloc(PAGE_SIZE);
+    groupTuple = malloc(PAGE_SIZE);
+    innerTuple = nullptr;
+    advanceInner();
+}
+
+SMJoin::~SMJoin() {
+    if (scanningGroup) {
+        groupIterator.close();
+    }
+    clearBuffer();
+    free(outerTuple);
+    free(groupTuple);
+    delete outerReader;
+    delete innerReader;
+    delete leftSort;
+    delete rightSort;
+}
+
+RC SMJoin::getNextTuple(void *data) {
+    IteratorProfile profile(this);
+    unsigned length;
+    return profile.count(getNextJoinedTuple(data, length));
+}
+
+RC SMJoin::getNextBatch(TupleBatch &batch, unsigned maxTuples) {
+    IteratorProfile profile(this);
+    unsigned length;
+    // a joined tuple can be longer than a page
+    unsigned maxLength = getMaxTupleLength(leftAttrs) + getMaxTupleLength(rightAttrs);
+    batch.clear();
+    batch.reserve(maxLength);
+    while (!batch.isFull(maxTuples, maxLength) && getNextJoinedTuple(batch.getFreeSpace(), length) != QE_EOF) {
+        batch.append(length);
+    }
+    return profile.count(batch.empty() ? QE_EOF : 0, batch.size());
+}
+
+std::string SMJoin::getDescription() const {
+    return "SMJoin " + outerAttrs[outerIndex].name + " " + getCompOpString(op) + " " + innerAttrs[innerIndex].name;
+}
+
+void SMJoin::getAttributes(std::vector<Attribute> &attrs) const {
+    for (auto const & it : leftAttrs) {
+        attrs.push_back(it);
+    }
+
+    for (auto const & it : rightAttrs) {
+        attrs.push_back(it);
+    }
+}
+
+void SMJoin::advanceInner() {
+    unsigned length;
+    do {
+        innerValid = innerReader->getNextTuple(innerTuple, length) != QE_EOF;
+    } while (innerValid && getAttributePointer(innerTuple, innerAttrs, innerIndex) == nullptr);
+}
+
+int SMJoin::compareKeys(const void *outer, const void *inner) const {
+    return compareAttribute(getAttributePointer(outer, outerAttrs, outerIndex),
+                            getAttributePointer(inner, innerAttrs, innerIndex), keyType);
+}
+
+RC SMJoin::appendToBuffer(const void *tuple, unsigned length) {
+    if (groupFile == nullptr && buffer.size() + length <= memoryLimit) {
+        offsets.push_back(buffer.size());
+        buffer.insert(buffer.end(), (const char *) tuple, (const char *) tuple + length);
+        return 0;
+    }
+
+    if (groupFile == nullptr) {
+        groupFile = new SpillFile();
+        if (groupFile->create(QE_SMJOIN_GROUP_PREFIX, innerAttrs) == -1) {
+            delete groupFile;
+            groupFile = nullptr;
+            return -1;
+        }
+        spillCount++;
+    }
+    // appended in order a page at a time, a scan reads them back the same way
+    return groupFile->append(tuple, length);
+}
+
+void SMJoin::clearBuffer() {
+    buffer.clear();
+    offsets.clear();
+    if (groupFile != nullptr) {
+        rbfm->closeFile(groupFile->fileHandle);
+        rbfm->destroyFile(groupFile->fileName);
+        delete groupFile;
+        groupFile = nullptr;
+    }
+}
+
+RC SMJoin::getNextJoinedTuple(void *data, unsigned &length) {
+    if (spillFailed) {
+        return QE_EOF;
+    }
+    while (true) {
+        // join the current outer tuple with the buffer, the memory part first
+        if (outputting) {
+            const void *inner = nullptr;
+            if (bufferPos < offsets.size()) {
+                inner = buffer.data() + offsets[bufferPos++];
+            } else if (scanningGroup) {
+                RID rid;
+                RC rc = groupIterator.getNextRecord(rid, groupTuple);
+                if (rc == 0) {
+                    inner = groupTuple;
+                } else {
+                    // closing the iterator also closes the file, it is open again for the next append or scan
+                    groupIterator.close();
+                    scanningGroup = false;
+                    if (rc == RBFM_ERROR || rbfm->openFile(groupFile->fileName, groupFile->fileHandle) == -1) {
+                        spillFailed = true;
+                        return QE_EOF;
+                    }
+                }
+            }
+
+            if (inner != nullptr) {
+                if (leftIsOuter) {
+                    length = concatenateTuple(data, outerTuple, (void *) inner, leftAttrs, rightAttrs);
+                } else {
+                    length = concatenateTuple(data, (void *) inner, outerTuple, leftAttrs, rightAttrs);
+                }
+                return 0;
+            }
+            outputting = false;
+        }
+
+        void *tuple;
+        unsigned tupleLength;
+        if (outerReader->getNextTuple(tuple, tupleLength) == QE_EOF) {
+            return QE_EOF;
+        }
+        if (getAttributePointer(tuple, outerAttrs, outerIndex) == nullptr) {
+            continue;
+        }
+        memcpy(outerTuple, tuple, tupleLength);
+
+        if (op == EQ_OP) {
+            // a new key, drop the group of the last one
+            if (!offsets.empty() && compareKeys(outerTuple, buffer.data() + offsets[0]) != 0) {
+                clearBuffer();
+            }
+            if (offsets.empty()) {
+                while (innerValid && compareKeys(outerTuple, innerTuple) > 0) {
+                    advanceInner();
+                }
+                while (innerValid && compareKeys(outerTuple, innerTuple) == 0) {
+                    if (appendToBuffer(innerTuple, getTupleLength(innerAttrs, innerTuple)) == -1) {
+                        spillFailed = true;
+                        return QE_EOF;
+                    }
+                    advanceInner();
+                }
+            }
+        } else {
+            int res;
+            while (innerValid && ((res = compareKeys(outerTuple, innerTuple)) > 0 || (res == 0 && op == GE_OP))) {
+                if (appendToBuffer(innerTuple, getTupleLength(innerAttrs, innerTuple)) == -1) {
+                    spillFailed = true;
+                    return QE_EOF;
+                }
+                advanceInner();
+            }
+        }
+
+        if (offsets.empty()) {
+            continue;
+        }
+        outputting = true;
+        bufferPos = 0;
+        if (groupFile != nullptr) {
+            std::vector<std::string> innerAttrNames;
+            for (auto const & it : innerAttrs) {
+                innerAttrNames.push_back(it.name);
+            }
+            if (groupFile->hasPending() && groupFile->flush() == -1) {
+                spillFailed = true;
+                return QE_EOF;
+            }
+            // the scan reads through the handle that wrote the file
+            rbfm->scan(groupFile->fileHandle, innerAttrs, "", NO_OP, nullptr, innerAttrNames, groupIterator);
+            scanningGroup = true;
+        }
+    }
+}
+
+/*
+ * parallel radix hash join
+ * 1. read both inputs into memory, NULL keys are dropped
+ * 2. partition both sides on the high bits of the key hash, the threads first count
+ *    their chunk into a histogram, then scatter it to the offsets the histograms give
+ * 3. a partition of R much larger than the average is split on the next bits, what is
+ *    still too large after that holds a few heavy keys, its table is built once and
+ *    the matching part of S is probed in slices
+ * 4. every task builds or shares the table of its partition and probes its part of S,
+ *    the workers take the tasks in order and the output is read in the same order.
+ *    a worker runs at most a few tasks per thread ahead of the output
+ *
+ * */
+PHJoin::PHJoin(Iterator *leftIn, Iterator *rightIn, const Condition &condition, const unsigned numThreads) {
+    // both inputs are consumed here, the time and I/O count without a call
+    IteratorProfile profile(this, false);
+    if (!condition.bRhsIsAttr) {
+        throw std::logic_error("check right hand Attr");
+    }
+    if (condition.op != EQ_OP) {
+        throw std::logic_error("parallel hash join needs an EQ condition");
+    }
+
+    inputs = {leftIn, rightIn};
+    leftIn->getAttributes(leftAttrs);
+    rightIn->getAttributes(rightAttrs);
+    leftAttrIndex = RecordBasedFileManager::getAttrIndex(leftAttrs, condition.lhsAttr);
+    rightAttrIndex = RecordBasedFileManager::getAttrIndex(rightAttrs, condition.rhsAttr);
+    attrType = leftAttrs[leftAttrIndex].type;
+    this->numThreads = std::max(1u, numThreads);
+
+    readInput(leftIn, leftAttrs, leftAttrIndex, leftTuples, leftEntries);
+    readInput(rightIn, rightAttrs, rightAttrIndex, rightTuples, rightEntries);
+
+    // a few partitions per thread, and few enough tuples in each to keep its table in cache
+    radixBits = 1;
+    while (radixBits < QE_PHJOIN_MAX_RADIX_BITS && ((1u << radixBits) < 4 * this->numThreads ||
+                                                    ((size_t) QE_PHJOIN_PARTITION_TUPLES << radixBits) <
+                                                    leftEntries.size())) {
+        radixBits++;
+    }
+    numPartitions = 1u << radixBits;
+    splitCount = 0;
+
+    std::vector<size_t> leftStarts, rightStarts;
+    partition(leftTuples, leftAttrs, leftAttrIndex, leftEntries, leftStarts);
+    partition(rightTuples, rightAttrs, rightAttrIndex, rightEntries, rightStarts);
+
+    size_t limit = std::max((size_t) QE_PHJOIN_PARTITION_TUPLES,
+                            leftEntries.size() / numPartitions * QE_PHJOIN_SKEW_FACTOR);
+    for (unsigned p = 0; p < numPartitions; p++) {
+        size_t leftBegin = leftStarts[p], leftEnd = leftStarts[p + 1];
+        size_t rightBegin = rightStarts[p], rightEnd = rightStarts[p + 1];
+        if (leftBegin == leftEnd || rightBegin == rightEnd) {
+            continue;
+        }
+        if (leftEnd - leftBegin <= limit) {
+            addTasks(leftBegin, leftEnd, rightBegin, rightEnd, false);
+            continue;
+        }
+
+        splitCount++;
+        std::vector<size_t> leftSplits, rightSplits;
+        splitRange(leftEntries, leftBegin, leftEnd, leftSplits);
+        splitRange(rightEntries, rightBegin, rightEnd, rightSplits);
+        for (unsigned s = 0; s + 1 < leftSplits.size(); s++) {
+            if (leftSplits[s] != leftSplits[s + 1] && rightSplits[s] != rightSplits[s + 1]) {
+                addTasks(leftSplits[s], leftSplits[s + 1], rightSplits[s], rightSplits[s + 1],
+                         leftSplits[s + 1] - leftSplits[s] > limit);
+            }
+        }
+    }
+
+    nextTask = 0;
+    stopping = false;
+    currentTask = 0;
+    matchPos = 0;
+    for (unsigned t = 0; t < this->numThreads; t++) {
+        workers.emplace_back(&PHJoin::runTasks, this);
+    }
+}
+
+PHJoin::~PHJoin() {
+    // running tasks finish, the rest are dropped
+    {
+        std::lock_guard<std::mutex> lock(taskMutex);
+        stopping = true;
+    }
+    taskWindow.notify_all();
+    for (auto & worker : workers) {
+        worker.join();
+    }
+    for (auto & task : tasks) {
+        delete task;
+    }
+    for (auto & table : tables) {
+        delete table;
+    }
+}
+
+RC PHJoin::getNextTuple(void *data) {
+    IteratorProfile profile(this);
+    unsigned length;
+    return profile.count(getNextJoinedTuple(data, length));
+}
+
+RC PHJoin::getNextBatch(TupleBatch &batch, unsigned maxTuples) {
+    IteratorProfile profile(this);
+    unsigned length;
+    // a joined tuple can be longer than a page
+    unsigned maxLength = getMaxTupleLength(leftAttrs) + getMaxTupleLength(rightAttrs);
+    batch.clear();
+    batch.reserve(maxLength);
+    while (!batch.isFull(maxTuples, maxLength) && getNextJoinedTuple(batch.getFreeSpace(), length) != QE_EOF) {
+        batch.append(length);
+    }
+    return profile.count(batch.empty() ? QE_EOF : 0, batch.size());
+}
+
+std::string PHJoin::getDescription() const {
+    return "PHJoin " + leftAttrs[leftAttrIndex].name + " = " + rightAttrs[rightAttrIndex].name + " THREADS(" +
+           std::to_string(numThreads) + ")";
+}
+
+void PHJoin::getAttributes(std::vector<Attribute> &attrs) const {
+    for (auto const & it : leftAttrs) {
+        attrs.push_back(it);
+    }
+
+    for (auto const & it : rightAttrs) {
+        attrs.push_back(it);
+    }
+}
+
+RC PHJoin::getNextJoinedTuple(void *data, unsigned &length) {
+    while (currentTask < tasks.size()) {
+        Task *task = tasks[currentTask];
+        if (matchPos == 0) {
+            task->ready.wait();
+        }
+        if (matchPos < task->matches.size()) {
+            auto const & match = task->matches[matchPos++];
+            length = concatenateTuple(data, leftTuples.data() + match.first, rightTuples.data() + match.second,
+                                      leftAttrs, rightAttrs);
+            return 0;
+        }
+        std::vector<std::pair<size_t, size_t>>().swap(task->matches);
+        {
+            std::lock_guard<std::mutex> lock(taskMutex);
+            currentTask++;
+        }
+        taskWindow.notify_all();
+        matchPos = 0;
+    }
+    return QE_EOF;
+}
+
+void PHJoin::readInput(Iterator *input, const std::vector<Attribute> &attrs, int attrIndex,
+                       std::vector<char> &tuples, std::vector<Entry> &entries) {
+    BatchReader reader(input);
+    void *tuple;
+    unsigned length;
+    while (reader.getNextTuple(tuple, length) != QE_EOF) {
+        // NULL never joins
+        if (getAttributePointer(tuple, attrs, attrIndex) == nullptr) {
+            continue;
+        }
+        entries.push_back({tuples.size(), 0});
+        tuples.insert(tuples.end(), (char *) tuple, (char *) tuple + length);
+    }
+}
+
+void PHJoin::runParallel(const std::function<void(unsigned)> &work) {
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < numThreads; t++) {
+        threads.emplace_back(work, t);
+    }
+    for (auto & thread : threads) {
+        thread.join();
+    }
+}
+
+void PHJoin::partition(const std::vector<char> &tuples, const std::vector<Attribute> &attrs, int attrIndex,
+                       std::vector<Entry> &entries, std::vector<size_t> &starts) {
+    size_t count = entries.size();
+    size_t chunk = (count + numThreads - 1) / numThreads;
+    unsigned shift = 32 - radixBits;
+    std::vector<std::vector<size_t>> histograms(numThreads, std::vector<size_t>(numPartitions, 0));
+    runParallel([&](unsigned t) {
+        size_t end = std::min(count, (t + 1) * chunk);
+        for (size_t i = std::min(count, t * chunk); i < end; i++) {
+            entries[i].hash = hashAttribute(getAttributePointer(tuples.data() + entries[i].offset, attrs, attrIndex),
+                                             attrType);
+            histograms[t][entries[i].hash >> shift]++;
+        }
+    });
+
+    // thread t writes its part of partition p right after the part of thread t - 1
+    starts.assign(numPartitions + 1, count);
+    size_t position = 0;
+    for (unsigned p = 0; p < numPartitions; p++) {
+        starts[p] = position;
+        for (unsigned t = 0; t < numThreads; t++) {
+            size_t size = histograms[t][p];
+            histograms[t][p] = position;
+            position += size;
+        }
+    }
+
+    std::vector<Entry> partitioned(count);
+    runParallel([&](unsigned t) {
+        size_t end = std::min(count, (t + 1) * chunk);
+        for (size_t i = std::min(count, t * chunk); i < end; i++) {
+            partitioned[histograms[t][entries[i].hash >> shift]++] = entries[i];
+        }
+    });
+    entries.swap(partitioned);
+}
+
+void PHJoin::splitRange(std::vector<Entry> &entries, size_t begin, size_t end, std::vector<size_t> &starts) {
+    unsigned shift = 32 - radixBits - QE_PHJOIN_SPLIT_BITS;
+    unsigned mask = (1u << QE_PHJOIN_SPLIT_BITS) - 1;
+    std::vector<size_t> positions(1u << QE_PHJOIN_SPLIT_BITS, 0);
+    for (size_t i = begin; i < end; i++) {
+        positions[(entries[i].hash >> shift) & mask]++;
+    }
+
+    starts.clear();
+    size_t position = begin;
+    for (auto & it : positions) {
+        starts.push_back(position);
+        size_t size = it;
+        it = position;
+        position += size;
+    }
+    starts.push_back(end);
+
+    std::vector<Entry> split(end - begin);
+    for (size_t i = begin; i < end; i++) {
+        split[positions[(entries[i].hash >> shift) & mask]++ - begin] = entries[i];
+    }
+    std::copy(split.begin(), split.end(), entries.begin() + begin);
+}
+
+void PHJoin::addTasks(size_t leftBegin, size_t leftEnd, size_t rightBegin, size_t rightEnd, bool skewed) {
+    auto *table = new Table();
+    table->begin = leftBegin;
+    table->end = leftEnd;
+    tables.push_back(table);
+
+    // a skewed table is shared, every thread probes a slice of S
+    size_t slices = skewed ? std::min((size_t) numThreads, rightEnd - rightBegin) : 1;
+    size_t slice = (rightEnd - rightBegin + slices - 1) / slices;
+    for (size_t begin = rightBegin; begin < rightEnd; begin += slice) {
+        auto *task = new Task();
+        task->table = table;
+        task->probeBegin = begin;
+        task->probeEnd = std::min(rightEnd, begin + slice);
+        task->ready = task->done.get_future();
+        tasks.push_back(task);
+    }
+}
+
+void PHJoin::buildTable(Table *table) {
+    size_t size = table->end - table->begin;
+    uint32_t buckets = 1;
+    while (buckets < 2 * size) {
+        buckets <<= 1u;
+    }
+    table->mask = buckets - 1;
+    table->heads.assign(buckets, -1);
+    table->next.resize(size);
+    for (size_t i = 0; i < size; i++) {
+        uint32_t bucket = leftEntries[table->begin + i].hash & table->mask;
+        table->next[i] = table->heads[bucket];
+        table->heads[bucket] = (int) i;
+    }
+}
+
+void PHJoin::runTask(Task *task) {
+    Table *table = task->table;
+    std::call_once(table->built, &PHJoin::buildTable, this, table);
+
+    for (size_t i = task->probeBegin; i < task->probeEnd; i++) {
+        const Entry &probe = rightEntries[i];
+        const char *rightKey = nullptr;
+        for (int j = table->heads[probe.hash & table->mask]; j != -1; j = table->next[j]) {
+            const Entry &build = leftEntries[table->begin + j];
+            if (build.hash != probe.hash) {
+                continue;
+            }
+            if (rightKey == nullptr) {
+                rightKey = getAttributePointer(rightTuples.data() + probe.offset, rightAttrs, rightAttrIndex);
+            }
+            const char *leftKey = getAttributePointer(leftTuples.data() + build.offset, leftAttrs, leftAttrIndex);
+            if (compareAttribute(leftKey, rightKey, attrType) == 0) {
+                task->matches.emplace_back(build.offset, probe.offset);
+            }
+        }
+    }
+}
+
+void PHJoin::runTasks() {
+    size_t window = (size_t) numThreads * QE_PHJOIN_TASKS_PER_THREAD;
+    while (true) {
+        size_t i;
+        {
+            std::unique_lock<std::mutex> lock(taskMutex);
+            taskWindow.wait(lock, [&] {
+                return stopping || nextTask >= tasks.size() || nextTask < currentTask + window;
+            });
+            if (stopping || nextTask >= tasks.size()) {
+                return;
+            }
+            i = nextTask++;
+        }
+        runTask(tasks[i]);
+        tasks[i]->done.set_value();
+    }
+}
+
+QueryPlan::~QueryPlan() {
+    clear();
+}
+
+unsigned QueryPlan::addNode(Iterator *iterator, const std::string &description, double rows, double cost,
+                            const std::vector<unsigned> &inputs) {
+    nodes.push_back({iterator, description, rows, cost, inputs});
+    return nodes.size() - 1;
+}
+
+void QueryPlan::clear() {
+    // an operator goes before its inputs
+    for (auto it = nodes.rbegin(); it != nodes.rend(); it++) {
+        delete it->iterator;
+    }
+    nodes.clear();
+}
+
+void QueryPlan::print(std::ostream &out, bool analyze) const {
+    if (!nodes.empty()) {
+        print(out, nodes.size() - 1, 0, analyze);
+    }
+}
+
+void QueryPlan::print(std::ostream &out, unsigned node, unsigned depth, bool analyze) const {
+    const Node &it = nodes[node];
+    out << std::string(depth * 2, ' ') << it.description << " (rows=" << (unsigned long long) std::ceil(it.rows)
+        << " cost=" << (unsigned long long) std::ceil(it.cost) << ")";
+    if (analyze && it.iterator->isProfiling()) {
+        out << " (actual " << Iterator::getStatisticsString(it.iterator->getStatistics()) << ")";
+    }
+    out << std::endl;
+    for (auto const & input : it.inputs) {
+        print(out, input, depth + 1, analyze);
+    }
+}
+
+static const char *getCompOpString(CompOp op) {
+    static const char *names[] = {"=", "<", "<=", ">", ">=", "!=", "NOOP"};
+    return names[op];
+}
+
+// a op b is b op' a
+static CompOp getMirroredCompOp(CompOp op) {
+    switch (op) {
+        case LT_OP:
+            return GT_OP;
+        case LE_OP:
+            return GE_OP;
+        case GT_OP:
+            return LT_OP;
+        case GE_OP:
+            return LE_OP;
+        default:
+            return op;
+    }
+}
+
+static std::string getConditionString(const Condition &condition) {
+    std::stringstream ss;
+    ss << condition.lhsAttr << " " << getCompOpString(condition.op);
+    if (condition.op == NO_OP) {
+        return ss.str();
+    }
+    ss << " ";
+    if (condition.bRhsIsAttr) {
+        ss << condition.rhsAttr;
+    } else if (condition.rhsValue.type == TypeInt) {
+        ss << *(int *) condition.rhsValue.data;
+    } else if (condition.rhsValue.type == TypeReal) {
+        ss << *(float *) condition.rhsValue.data;
+    } else {
+        unsigned length;
+        memcpy(&length, condition.rhsValue.data, UNSIGNED_SIZE);
+        ss << "'" << std::string((char *) condition.rhsValue.data + UNSIGNED_SIZE, length) << "'";
+    }
+    return ss.str();
+}
+
+// AND binds tighter than OR, an OR under an AND is parenthesized. an empty AND is empty
+static std::string getPredicateString(const Predicate &predicate) {
+    std::stringstream ss;
+    switch (predicate.type) {
+        case PRED_COMPARE:
+            ss << predicate.lhsAttr << " " << getCompOpString(predicate.op);
+            if (predicate.op == NO_OP) {
+                break;
+            }
+            ss << " ";
+            if (predicate.bRhsIsAttr) {
+                ss << predicate.rhsAttr;
+            } else if (predicate.rhsType == TypeInt) {
+                ss << *(int *) predicate.rhsValue.data();
+            } else if (predicate.rhsType == TypeReal) {
+                ss << *(float *) predicate.rhsValue.data();
+            } else {
+                ss << "'" << predicate.rhsValue.substr(UNSIGNED_SIZE) << "'";
+            }
+            break;
+        case PRED_AND:
+        case PRED_OR:
+            for (auto const & child : predicate.children) {
+                std::string text = getPredicateString(child);
+                if (text.empty()) {
+                    continue;
+                }
+                if (predicate.type == PRED_AND && child.type == PRED_OR) {
+                    text = "(" + text + ")";
+                }
+                ss << (ss.tellp() == 0 ? "" : predicate.type == PRED_AND ? " AND " : " OR ") << text;
+            }
+            break;
+        case PRED_NOT:
+            ss << "NOT (" << getPredicateString(predicate.children[0]) << ")";
+            break;
+    }
+    return ss.str();
+}
+
+Optimizer::Optimizer(RelationManager &rm, unsigned numPages) : rm(rm) {
+    this->numPages = numPages;
+}
+
+/*
+ * optimize
+ * 1. every table gets its rows, pages and tuple width from the statistics, its own conditions are pushed down
+ *    and it is read by a TableScan or, if cheaper, an IndexScan on one of these conditions
+ * 2. left deep join orders are built up over the subsets of the tables, each subset keeps its cheapest plan.
+ *    a table only joins tables it shares a condition with, every join takes its cheapest method
+ * 3. the joins share the memory, a join method whose minimum does not fit next to the minimums of the
+ *    joins before it is not considered, a query no plan fits is rejected.
+ *    the plan is built bottom up with the conditions left over in a Filter
+ *    right after the join that has both their tables, a Project puts the attributes in order
+ *
+ * costs are counted in page reads and writes
+ * */
+RC Optimizer::optimize(const Query &query, QueryPlan &plan) {
+    plan.clear();
+    if (prepare(query) == -1) {
+        return -1;
+    }
+
+    SubPlan best;
+    if (!searchPlan(best)) {
+        return -1;
+    }
+    grantMemory(best);
+    return buildPlan(best, plan);
+}
+
+int Optimizer::getTable(const std::string &attrName) const {
+    size_t pos = attrName.find('.');
+    if (pos == std::string::npos) {
+        return -1;
+    }
+    std::string tableName = attrName.substr(0, pos);
+    for (unsigned i = 0; i < tables.size(); i++) {
+        if (tables[i].tableName == tableName) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int Optimizer::getAttrIndex(unsigned table, const std::string &attrName) const {
+    return RecordBasedFileManager::getAttrIndex(tables[table].attrs, attrName.substr(attrName.find('.') + 1));
+}
+
+RC Optimizer::prepare(const Query &query) {
+    this->query = query;
+    tables.clear();
+    lhsTables.clear();
+    rhsTables.clear();
+    if (query.tableNames.empty() || query.tableNames.size() > sizeof(unsigned long long) * 8) {
+        return -1;
+    }
+
+    for (auto const & tableName : query.tableNames) {
+        TableInfo table;
+        table.tableName = tableName;
+        if (getTable(tableName + ".") != -1 || rm.getAttributes(tableName, table.attrs) == -1 ||
+            table.attrs.empty()) {
+            return -1;
+        }
+        table.analyzed = rm.getStatistics(tableName, table.statistics) == 0;
+        table.rows = table.analyzed ? table.statistics.rowCount : QE_OPTIMIZER_TABLE_ROWS;
+        table.width = table.analyzed && table.statistics.avgTupleLength != 0 ? table.statistics.avgTupleLength
+                                                                             : Iterator::getAttributesEstLength(
+                        table.attrs);
+        table.pages = table.analyzed ? table.statistics.pageCount : std::ceil(table.rows * table.width / PAGE_SIZE);
+        table.pages = std::max(1.0, table.pages);
+        tables.push_back(table);
+    }
+
+    for (unsigned i = 0; i < query.conditions.size(); i++) {
+        const Condition &condition = query.conditions[i];
+        int lhsTable = getTable(condition.lhsAttr);
+        int rhsTable = condition.bRhsIsAttr ? getTable(condition.rhsAttr) : -1;
+        if (lhsTable == -1 || getAttrIndex(lhsTable, condition.lhsAttr) == -1 ||
+            (condition.bRhsIsAttr && (rhsTable == -1 || getAttrIndex(rhsTable, condition.rhsAttr) == -1))) {
+            return -1;
+        }
+        lhsTables.push_back(lhsTable);
+        rhsTables.push_back(rhsTable);
+        if (rhsTable == -1 || rhsTable == lhsTable) {
+            tables[lhsTable].localConditions.push_back(i);
+        }
+    }
+
+    for (auto const & attrName : query.attrNames) {
+        int table = getTable(attrName);
+        if (table == -1 || getAttrIndex(table, attrName) == -1) {
+            return -1;
+        }
+    }
+
+    for (auto & table : tables) {
+        chooseAccess(table);
+    }
+    return 0;
+}
+
+/*
+ * selectivity
+ * - EQ_OP keeps 1 / distinct values, NE_OP the rest
+ * - a range keeps the buckets of the equi-depth histogram below or above the value,
+ *   inside its bucket the position of the value is interpolated
+ * - NULLs satisfy nothing
+ * without statistics EQ_OP keeps a tenth, NE_OP nine tenths, a range a third
+ * */
+double Optimizer::getSelectivity(const std::string &tableName, const Condition &condition) {
+    if (condition.op == NO_OP) {
+        return 1;
+    }
+    double equal = 0.1;
+    double range = 1.0 / 3;
+
+    std::vector<Attribute> attrs;
+    TableStatistics statistics;
+    rm.getAttributes(tableName, attrs);
+    int index = RecordBasedFileManager::getAttrIndex(attrs, condition.lhsAttr.substr(condition.lhsAttr.find('.') + 1));
+    if (condition.bRhsIsAttr || index == -1 || rm.getStatistics(tableName, statistics) == -1 ||
+        statistics.rowCount == 0 || (unsigned) index >= statistics.columns.size()) {
+        return condition.op == EQ_OP ? equal : condition.op == NE_OP ? 1 - equal : range;
+    }
+
+    const ColumnStatistics &column = statistics.columns[index];
+    double nonNull = (double) (statistics.rowCount - column.nullCount) / statistics.rowCount;
+    equal = 1.0 / std::max(1u, column.distinctCount);
+    if (condition.op == EQ_OP) {
+        return nonNull * equal;
+    }
+    if (condition.op == NE_OP) {
+        return nonNull * (1 - equal);
+    }
+
+    // fraction of the values below the value
+    AttrType type = attrs[index].type;
+    unsigned prefix = type == TypeVarChar ? UNSIGNED_SIZE : 0;
+    const char *value = (const char *) condition.rhsValue.data;
+    unsigned valueLength = UNSIGNED_SIZE;
+    if (type == TypeVarChar) {
+        memcpy(&valueLength, value, UNSIGNED_SIZE);
+    }
+    const std::vector<std::string> &bounds = column.bounds;
+    unsigned below = 0;
+    while (below < bounds.size() &&
+           RecordBasedFileManager::compareRawAttributes(bounds[below].data() + prefix, bounds[below].size() - prefix,
+                                                        value + prefix, valueLength, type) < 0) {
+        below++;
+    }
+    double fraction = 0.5;
+    if (below == bounds.size() && !bounds.empty()) {
+        fraction = 1;
+    } else if (below == 0 && !bounds.empty()) {
+        fraction = 0;
+    } else if (!bounds.empty()) {
+        // the value is in (bounds[below - 1], bounds[below]]
+        double position = 0.5;
+        if (type != TypeVarChar) {
+            double low, high, key;
+            if (type == TypeInt) {
+                low = *(int *) bounds[below - 1].data();
+                high = *(int *) bounds[below].data();
+                key = *(int *) value;
+            } else {
+                low = *(float *) bounds[below - 1].data();
+                high = *(float *) bounds[below].data();
+                key = *(float *) value;
+            }
+            position = high > low ? (key - low) / (high - low) : 0.5;
+        }
+        fraction = (below - 1 + position) / (bounds.size() - 1);
+    }
+
+    double selectivity;
+    switch (condition.op) {
+        case LT_OP:
+            selectivity = fraction;
+            break;
+        case LE_OP:
+            selectivity = fraction + equal;
+            break;
+        case GT_OP:
+            selectivity = 1 - fraction - equal;
+            break;
+        default:
+            selectivity = 1 - fraction;
+            break;
+    }
+    return nonNull * std::min(1.0, std::max(0.0, selectivity));
+}
+
+double Optimizer::getJoinSelectivity(const Condition &condition) {
+    int lhsTable = getTable(condition.lhsAttr);
+    int rhsTable = getTable(condition.rhsAttr);
+    double distinct = 1;
+    for (int table : {lhsTable, rhsTable}) {
+        const TableInfo &info = tables[table];
+        unsigned index = getAttrIndex(table, table == lhsTable ? condition.lhsAttr : condition.rhsAttr);
+        if (info.analyzed && index < info.statistics.columns.size()) {
+            distinct = std::max(distinct, (double) info.statistics.columns[index].distinctCount);
+        } else {
+            distinct = std::max(distinct, info.rows);
+        }
+    }
+    if (condition.op == EQ_OP) {
+        return 1 / distinct;
+    }
+    return condition.op == NE_OP ? 1 - 1 / distinct : 1.0 / 3;
+}
+
+// an unclustered index reads a page for every matching row
+void Optimizer::chooseAccess(TableInfo &table) {
+    table.selectivity = 1;
+    table.access = SCAN;
+    table.indexCondition = -1;
+    table.accessCost = table.pages;
+    for (auto const & i : table.localConditions) {
+        const Condition &condition = query.conditions[i];
+        if (condition.bRhsIsAttr) {
+            table.selectivity *= getJoinSelectivity(condition);
+            continue;
+        }
+        double selectivity = getSelectivity(table.tableName, condition);
+        table.selectivity *= selectivity;
+
+        std::string attrName = condition.lhsAttr.substr(condition.lhsAttr.find('.') + 1);
+        if (condition.op == NE_OP || condition.op == NO_OP ||
+            rm.tNANToIndexFile.count(RelationManager::getIndexNameHash(table.tableName, attrName)) == 0) {
+            continue;
+        }
+        double cost = QE_OPTIMIZER_INDEX_PROBE + table.rows * selectivity;
+        if (cost < table.accessCost) {
+            table.access = INDEX_SCAN;
+            table.indexCondition = i;
+            table.accessCost = cost;
+        }
+    }
+}
+
+Optimizer::SubPlan Optimizer::getTablePlan(unsigned table) const {
+    const TableInfo &info = tables[table];
+    SubPlan plan;
+    plan.tableSet = 1ull << table;
+    plan.rows = info.rows * info.selectivity;
+    plan.cost = info.accessCost;
+    plan.width = info.width;
+    plan.minPages = 0;
+    plan.steps.push_back({table, info.access, info.indexCondition, plan.rows, plan.cost, 0, 0});
+    return plan;
+}
+
+/*
+ * costs of a join, L the left input so far and T the table, in pages
+ * - BNLJoin reads T once for every block of L, EQ_OP only
+ * - INLJoin descends the index of T once for every tuple of L and reads its matches, EQ_OP only
+ * - GHJoin reads T, if L does not fit into memory both are written to partitions and read back, EQ_OP only
+ * - SMJoin reads T, every input larger than the memory is sorted in passes, EQ_OP or a band
+ * a method is only considered if its minimum fits into the available pages
+ * */
+Optimizer::SubPlan Optimizer::extendPlan(const SubPlan &plan, unsigned table, unsigned available) {
+    SubPlan result = plan;
+    result.cost = std::numeric_limits<double>::infinity();
+    const TableInfo &info = tables[table];
+
+    // an equi-join condition if there is one, a band otherwise
+    int joinCondition = -1;
+    double selectivity = 1;
+    for (unsigned i = 0; i < query.conditions.size(); i++) {
+        int lhsTable = lhsTables[i];
+        int rhsTable = rhsTables[i];
+        if (rhsTable == -1 || lhsTable == rhsTable) {
+            continue;
+        }
+        int other = lhsTable == (int) table ? rhsTable : rhsTable == (int) table ? lhsTable : -1;
+        if (other == -1 || (plan.tableSet & (1ull << other)) == 0) {
+            continue;
+        }
+        selectivity *= getJoinSelectivity(query.conditions[i]);
+        CompOp op = query.conditions[i].op;
+        if (op == NE_OP || op == NO_OP) {
+            continue;
+        }
+        if (joinCondition == -1 || (op == EQ_OP && query.conditions[joinCondition].op != EQ_OP)) {
+            joinCondition = i;
+        }
+    }
+    if (joinCondition == -1) {
+        return result;
+    }
+
+    Condition condition = getJoinCondition(joinCondition, plan.tableSet);
+    double leftPages = std::max(1.0, std::ceil(plan.rows * plan.width / PAGE_SIZE));
+    double rightRows = info.rows * info.selectivity;
+    double rightPages = std::max(1.0, std::ceil(rightRows * info.width / PAGE_SIZE));
+    double memory = numPages;
+
+    Step step = {table, SM_JOIN, joinCondition, 0, std::numeric_limits<double>::infinity(), 0, 0};
+    auto sortCost = [memory](double pages) {
+        if (pages <= memory) {
+            return 0.0;
+        }
+        double passes = std::max(1.0, std::ceil(std::log(pages / memory) / std::log(memory - 1)));
+        return 2 * pages * passes;
+    };
+    if (getMinPages(SM_JOIN) <= available) {
+        step.cost = info.accessCost + sortCost(leftPages) + sortCost(rightPages);
+        step.pages = std::max(leftPages, rightPages);
+    }
+
+    if (condition.op == EQ_OP) {
+        double cost = std::ceil(leftPages / (memory - 2)) * info.pages;
+        if (getMinPages(BNL_JOIN) <= available && cost < step.cost) {
+            step.method = BNL_JOIN;
+            step.cost = cost;
+            step.pages = leftPages + 2;
+        }
+
+        // on a tie hashing beats sorting
+        cost = info.accessCost + (leftPages > memory ? 2 * (leftPages + rightPages) : 0);
+        if (getMinPages(GH_JOIN) <= available && cost <= step.cost) {
+            step.method = GH_JOIN;
+            step.cost = cost;
+            step.pages = leftPages + 1;
+        }
+
+        std::string attrName = condition.rhsAttr.substr(condition.rhsAttr.find('.') + 1);
+        if (rm.tNANToIndexFile.count(RelationManager::getIndexNameHash(info.tableName, attrName)) != 0) {
+            int index = getAttrIndex(table, attrName);
+            double distinct = info.analyzed && info.statistics.columns[index].distinctCount != 0
+                              ? info.statistics.columns[index].distinctCount : info.rows;
+            cost = plan.rows * (QE_OPTIMIZER_INDEX_PROBE + info.rows / distinct);
+            if (cost < step.cost) {
+                step.method = INL_JOIN;
+                step.cost = cost;
+                step.pages = 0;
+            }
+        }
+    }
+
+    if (std::isinf(step.cost)) {
+        return result;
+    }
+    result.tableSet |= 1ull << table;
+    result.minPages += getMinPages(step.method);
+    result.rows = plan.rows * rightRows * selectivity;
+    result.cost = plan.cost + step.cost;
+    result.width = plan.width + info.width;
+    step.rows = result.rows;
+    step.cost = result.cost;
+    result.steps.push_back(step);
+    return result;
+}
+
+bool Optimizer::searchPlan(SubPlan &best) {
+    unsigned count = tables.size();
+    if (count <= QE_OPTIMIZER_DP_TABLES) {
+        // the cheapest plan of every subset of the tables, bigger subsets extend smaller ones.
+        // the plan that needs the fewest pages is kept as well, the cheapest may leave too few for the next joins
+        // the joins before keep their minimum, every extension gets the rest or, to stay lean, none of it
+        std::vector<SubPlan> plans(1u << count);
+        std::vector<SubPlan> leanPlans(1u << count);
+        for (unsigned set = 0; set < plans.size(); set++) {
+            plans[set].cost = std::numeric_limits<double>::infinity();
+            leanPlans[set].cost = std::numeric_limits<double>::infinity();
+        }
+        for (unsigned i = 0; i < count; i++) {
+            plans[1u << i] = getTablePlan(i);
+            leanPlans[1u << i] = plans[1u << i];
+        }
+        for (unsigned set = 1; set < plans.size(); set++) {
+            for (const SubPlan *base : {&plans[set], &leanPlans[set]}) {
+                if (std::isinf(base->cost)) {
+                    continue;
+                }
+                for (unsigned i = 0; i < count; i++) {
+                    if ((set & (1u << i)) != 0) {
+                        continue;
+                    }
+                    for (unsigned available : {numPages - base->minPages, 0u}) {
+                        SubPlan plan = extendPlan(*base, i, available);
+                        if (std::isinf(plan.cost)) {
+                            continue;
+                        }
+                        SubPlan &cheapest = plans[set | (1u << i)];
+                        SubPlan &lean = leanPlans[set | (1u << i)];
+                        if (plan.cost < cheapest.cost) {
+                            cheapest = plan;
+                        }
+                        if (std::isinf(lean.cost) || plan.minPages < lean.minPages ||
+                            (plan.minPages == lean.minPages && plan.cost < lean.cost)) {
+                            lean = plan;
+                        }
+                    }
+                }
+            }
+        }
+        best = plans.back();
+        return !std::isinf(best.cost);
+    }
+
+    // greedy, from the smallest table on the cheapest join next
+    unsigned first = 0;
+    for (unsigned i = 1; i < count; i++) {
+        if (tables[i].rows * tables[i].selectivity < tables[first].rows * tables[first].selectivity) {
+            first = i;
+        }
+    }
+    best = getTablePlan(first);
+    for (unsigned joined = 1; joined < count; joined++) {
+        SubPlan next;
+        next.cost = std::numeric_limits<double>::infinity();
+        for (unsigned i = 0; i < count; i++) {
+            if ((best.tableSet & (1ull << i)) != 0) {
+                continue;
+            }
+            SubPlan plan = extendPlan(best, i, numPages - best.minPages);
+            if (plan.cost < next.cost) {
+                next = plan;
+            }
+        }
+        if (std::isinf(next.cost)) {
+            return false;
+        }
+        best = next;
+    }
+    return true;
+}
+
+unsigned Optimizer::getMinPages(JoinMethod method) {
+    switch (method) {
+        case BNL_JOIN:
+        case GH_JOIN:
+            return QE_OPTIMIZER_MIN_PAGES;
+        case SM_JOIN:
+            // a sort-merge join sorts both inputs
+            return QE_SMJOIN_MIN_PAGES;
+        default:
+            return 0;
+    }
+}
+
+// every join gets its minimum first, then what it needs beyond it if the pages left allow, otherwise
+// a share of them in proportion to that
+void Optimizer::grantMemory(SubPlan &plan) {
+    double spare = numPages - plan.minPages;
+    double wanted = 0;
+    for (auto const & step : plan.steps) {
+        if (getMinPages(step.method) != 0) {
+            wanted += std::max(0.0, step.pages - getMinPages(step.method));
+        }
+    }
+    for (auto & step : plan.steps) {
+        unsigned minimum = getMinPages(step.method);
+        double extra = minimum == 0 ? 0 : std::max(0.0, step.pages - minimum);
+        double grant = wanted <= spare ? extra : std::floor(spare * extra / wanted);
+        step.numPages = minimum + (unsigned) grant;
+    }
+}
+
+Condition Optimizer::getJoinCondition(unsigned condition, unsigned long long leftSet) const {
+    Condition result = query.conditions[condition];
+    if ((leftSet & (1ull << lhsTables[condition])) == 0) {
+        std::swap(result.lhsAttr, result.rhsAttr);
+        result.op = getMirroredCompOp(result.op);
+    }
+    return result;
+}
+
+Predicate Optimizer::getLocalPredicate(unsigned table) const {
+    std::vector<Predicate> children;
+    for (auto const & i : tables[table].localConditions) {
+        children.push_back(Filter::getConditionPredicate(query.conditions[i]));
+    }
+    return children.empty() ? Predicate() : Predicate::conjunction(children);
+}
+
+// the output attributes and the attributes of the conditions, no attribute names means all of them
+std::vector<std::string> Optimizer::getNeededAttrs(unsigned table) const {
+    std::vector<std::string> attrNames;
+    if (query.attrNames.empty()) {
+        return attrNames;
+    }
+    std::vector<bool> needed(tables[table].attrs.size(), false);
+    for (auto const & attrName : query.attrNames) {
+        if (getTable(attrName) == (int) table) {
+            needed[getAttrIndex(table, attrName)] = true;
+        }
+    }
+    for (unsigned i = 0; i < query.conditions.size(); i++) {
+        if (lhsTables[i] == (int) table) {
+            needed[getAttrIndex(table, query.conditions[i].lhsAttr)] = true;
+        }
+        if (rhsTables[i] == (int) table) {
+            needed[getAttrIndex(table, query.conditions[i].rhsAttr)] = true;
+        }
+    }
+    for (unsigned i = 0; i < needed.size(); i++) {
+        if (needed[i]) {
+            attrNames.push_back(tables[table].tableName + "." + tables[table].attrs[i].name);
+        }
+    }
+    return attrNames;
+}
+
+unsigned Optimizer::buildAccess(const Step &step, QueryPlan &plan) {
+    const TableInfo &info = tables[step.table];
+    double rows = info.rows * info.selectivity;
+    Predicate predicate = getLocalPredicate(step.table);
+    if (info.access == SCAN) {
+        auto *scan = new TableScan(rm, info.tableName, predicate, getNeededAttrs(step.table));
+        std::string description = "TableScan " + info.tableName;
+        for (unsigned i = 0; i < info.localConditions.size(); i++) {
+            description += (i == 0 ? " WHERE " : " AND ") + getConditionString(query.conditions[info.localConditions[i]]);
+        }
+        return plan.addNode(scan, description, rows, info.accessCost);
+    }
+
+    const Condition &condition = query.conditions[info.indexCondition];
+    auto *scan = new IndexScan(rm, info.tableName, condition.lhsAttr.substr(condition.lhsAttr.find('.') + 1));
+    void *key = condition.rhsValue.data;
+    switch (condition.op) {
+        case EQ_OP:
+            scan->setIterator(key, key, true, true);
+            break;
+        case LT_OP:
+        case LE_OP:
+            scan->setIterator(NULL, key, true, condition.op == LE_OP);
+            break;
+        default:
+            scan->setIterator(key, NULL, condition.op == GE_OP, true);
+            break;
+    }
+    unsigned node = plan.addNode(scan, "IndexScan " + info.tableName + " ON " + getConditionString(condition),
+                                 info.rows * getSelectivity(info.tableName, condition), info.accessCost);
+    if (info.localConditions.size() == 1) {
+        return node;
+    }
+    std::string description = "Filter";
+    for (unsigned i = 0; i < info.localConditions.size(); i++) {
+        description += (i == 0 ? " " : " AND ") + getConditionString(query.conditions[info.localConditions[i]]);
+    }
+    return plan.addNode(new Filter(scan, predicate), description, rows, info.accessCost, {node});
+}
+
+RC Optimizer::buildPlan(const SubPlan &best, QueryPlan &plan) {
+    unsigned node = buildAccess(best.steps[0], plan);
+    unsigned long long leftSet = 1ull << best.steps[0].table;
+    for (unsigned s = 1; s < best.steps.size(); s++) {
+        const Step &step = best.steps[s];
+        const TableInfo &info = tables[step.table];
+        Iterator *left = plan.getRoot();
+        Condition condition = getJoinCondition(step.condition, leftSet);
+        std::string pages = " PAGES(" + std::to_string(step.numPages) + ")";
+
+        unsigned right;
+        switch (step.method) {
+            case BNL_JOIN: {
+                auto *scan = new TableScan(rm, info.tableName, getLocalPredicate(step.table),
+                                           getNeededAttrs(step.table));
+                right = plan.addNode(scan, "TableScan " + info.tableName, info.rows * info.selectivity, info.pages);
+                node = plan.addNode(new BNLJoin(left, scan, condition, step.numPages),
+                                    "BNLJoin " + getConditionString(condition) + pages, step.rows, step.cost,
+                                    {node, right});
+                break;
+            }
+            case INL_JOIN: {
+                // the index reads whole tuples, the conditions on the table follow the join
+                auto *scan = new IndexScan(rm, info.tableName,
+                                           condition.rhsAttr.substr(condition.rhsAttr.find('.') + 1));
+                right = plan.addNode(scan, "IndexScan " + info.tableName + " ON " +
+                                           condition.rhsAttr.substr(condition.rhsAttr.find('.') + 1),
+                                     info.rows, QE_OPTIMIZER_INDEX_PROBE);
+                node = plan.addNode(new INLJoin(left, scan, condition), "INLJoin " + getConditionString(condition),
+                                    step.rows, step.cost, {node, right});
+                if (!info.localConditions.empty()) {
+                    node = plan.addNode(new Filter(plan.getRoot(), getLocalPredicate(step.table)),
+                                        "Filter on " + info.tableName, step.rows, step.cost, {node});
+                }
+                break;
+            }
+            case GH_JOIN:
+                right = buildAccess(step, plan);
+                node = plan.addNode(new GHJoin(left, plan.getRoot(), condition, step.numPages),
+                                    "GHJoin " + getConditionString(condition) + pages, step.rows, step.cost,
+                                    {node, right});
+                break;
+            default:
+                right = buildAccess(step, plan);
+                node = plan.addNode(new SMJoin(left, plan.getRoot(), condition, step.numPages),
+                                    "SMJoin " + getConditionString(condition) + pages, step.rows, step.cost,
+                                    {node, right});
+                break;
+        }
+
+        // the other conditions between the table and the tables before it
+        std::vector<Predicate> children;
+        std::string description = "Filter";
+        for (unsigned i = 0; i < query.conditions.size(); i++) {
+            if ((int) i == step.condition || rhsTables[i] == -1 || lhsTables[i] == rhsTables[i]) {
+                continue;
+            }
+            int other = lhsTables[i] == (int) step.table ? rhsTables[i] : rhsTables[i] == (int) step.table
+                                                                           ? lhsTables[i] : -1;
+            if (other != -1 && (leftSet & (1ull << other)) != 0) {
+                children.push_back(Filter::getConditionPredicate(query.conditions[i]));
+                description += (children.size() == 1 ? " " : " AND ") + getConditionString(query.conditions[i]);
+            }
+        }
+        if (!children.empty()) {
+            node = plan.addNode(new Filter(plan.getRoot(), Predicate::conjunction(children)), description,
+                                step.rows, step.cost, {node});
+        }
+        leftSet |= 1ull << step.table;
+    }
+
+    // the attributes in the order of the query
+    std::vector<std::string> attrNames = query.attrNames;
+    if (attrNames.empty()) {
+        for (auto const & table : tables) {
+            for (auto const & attr : table.attrs) {
+                attrNames.push_back(table.tableName + "." + attr.name);
+            }
+        }
+    }
+    std::vector<Attribute> attrs;
+    plan.getRoot()->getAttributes(attrs);
+    bool ordered = attrs.size() == attrNames.size();
+    for (unsigned i = 0; ordered && i < attrs.size(); i++) {
+        ordered = attrs[i].name == attrNames[i];
+    }
+    if (!ordered) {
+        std::string description = "Project";
+        for (unsigned i = 0; i < attrNames.size(); i++) {
+            description += (i == 0 ? " " : ", ") + attrNames[i];
+        }
+        plan.addNode(new Project(plan.getRoot(), attrNames), description, best.rows, best.cost, {node});
+    }
+    return 0;
+}
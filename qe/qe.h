@@ -1,10 +1,45 @@
 #ifndef _qe_h_
 #define _qe_h_
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <ostream>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+
 #include "../rm/rm.h"
 
 #define QE_EOF (-1)  // end of the index scan
 
+#define QE_BATCH_SIZE 256           // default number of tuples per getNextBatch call
+#define QE_BATCH_BUFFER_PAGES 16    // size of a batch buffer in pages
+
+#define QE_HASH_END (~0u)  // end of a chain in a TupleHashTable, no such entry
+
+#define QE_SORT_RUN_PREFIX "sort_run_"  // temp files holding the sorted runs
+#define QE_SMJOIN_GROUP_PREFIX "smjoin_group_"  // temp files holding the overflow of a buffered group
+#define QE_SMJOIN_MIN_PAGES 7          // two sorts of 3 pages and a page of buffered tuples
+#define QE_GHJOIN_PARTITION_PREFIX "ghjoin_part_"  // temp files holding the spilled hash join partitions
+#define QE_AGGREGATE_PARTITION_PREFIX "aggregate_part_"  // temp files holding the spilled partial aggregates
+
+#define QE_AGGREGATE_MAX_LEVELS 32  // partitioning passes at most, a deeper partition stays in memory
+
+#define QE_PHJOIN_PARTITION_TUPLES 16384  // target number of R tuples in a radix partition
+#define QE_PHJOIN_MAX_RADIX_BITS 16       // radix bits of the first partitioning pass, at most
+#define QE_PHJOIN_SPLIT_BITS 4            // radix bits added when a skewed partition is split
+#define QE_PHJOIN_SKEW_FACTOR 4           // a partition this many times the average is skewed
+#define QE_PHJOIN_TASKS_PER_THREAD 4      // tasks a worker may run ahead of the one being read
+
+#define QE_OPTIMIZER_PAGES 64          // default memory budget of a plan in pages, shared by its joins
+#define QE_OPTIMIZER_MIN_PAGES 3       // a join or a sort gets at least this many pages
+#define QE_OPTIMIZER_TABLE_ROWS 1000   // rows assumed for a table that was never analyzed
+#define QE_OPTIMIZER_INDEX_PROBE 3     // page reads to descend an index
+#define QE_OPTIMIZER_DP_TABLES 10      // join orders are enumerated up to this many tables, greedy beyond
+
 typedef enum {
     MIN = 0, MAX, COUNT, SUM, AVG
 } AggregateOp;
@@ -19,6 +54,16 @@ struct Value {
     void *data;             // value
 };
 
+struct AggregateFunction {
+    Attribute aggAttr;          // attribute to aggregate, any type for COUNT, INT or REAL otherwise
+    AggregateOp op;             // aggregate operation
+};
+
+struct SortKey {
+    std::string attrName;       // attribute to sort on
+    bool ascending;             // TRUE for ascending order, NULLs come first
+};
+
 struct Condition {
     std::string lhsAttr;        // left-hand side attribute
     CompOp op;                  // comparison operator
@@ -27,29 +72,262 @@ struct Condition {
     Value rhsValue;             // right-hand side value if bRhsIsAttr = FALSE
 };
 
+// A row batch: tuples are packed back to back in one buffer, tuple i starts at offsets[i]
+class TupleBatch {
+public:
+    explicit TupleBatch(unsigned bufferPages = QE_BATCH_BUFFER_PAGES);
+
+    ~TupleBatch();
+
+    TupleBatch(const TupleBatch &) = delete;
+
+    TupleBatch &operator=(const TupleBatch &) = delete;
+
+    unsigned size() const { return offsets.size(); };
+
+    bool empty() const { return offsets.empty(); };
+
+    void clear();
+
+    void *getTuple(unsigned i) const { return data + offsets[i]; };
+
+    unsigned getTupleLength(unsigned i) const;
+
+    // true once maxTuples are in or a tuple of maxLength might not fit anymore
+    bool isFull(unsigned maxTuples, unsigned maxLength = PAGE_SIZE) const;
+
+    // grow an empty batch to hold a tuple of length at least
+    void reserve(unsigned length);
+
+    // write the next tuple here, then commit it with append
+    void *getFreeSpace() const { return data + used; };
+
+    void append(unsigned length);
+
+    void appendTuple(const void *tuple, unsigned length);
+
+private:
+    char *data;
+    unsigned capacity;
+    unsigned used;
+    std::vector<unsigned> offsets;
+};
+
+class Iterator;
+
+// What an iterator did while it was profiled, the work of its inputs included
+struct IteratorStatistics {
+    unsigned long long calls = 0;       // getNextTuple and getNextBatch calls
+    unsigned long long rows = 0;        // tuples returned
+    double wallTime = 0;                // seconds
+    double cpuTime = 0;                 // seconds of CPU of the process, worker threads included
+    unsigned long long pageReads = 0;   // FileHandle page reads
+    unsigned long long pageWrites = 0;  // FileHandle page writes and appends
+};
+
+// Pulls an input batch by batch and hands the tuples out one at a time.
+// The returned pointer stays valid until the next call.
+class BatchReader {
+public:
+    explicit BatchReader(Iterator *input);
+
+    RC getNextTuple(void *&tuple, unsigned &length);
+
+    // drop the buffered tuples, the input has been restarted
+    void reset();
+
+private:
+    Iterator *input;
+    TupleBatch batch;
+    unsigned cursor;
+    bool eof;
+};
+
 class Iterator {
     // All the relational operators and access methods are iterators.
 public:
+    // iterators created while this is set are profiled from the start, EXPLAIN ANALYZE sets it to build a query
+    static bool profileNewIterators;
+
+    Iterator() : profiling(profileNewIterators) {};
 
     virtual RC getNextTuple(void *data) = 0;
 
+    // Fill batch with up to maxTuples tuples, QE_EOF once nothing is left.
+    // The default adapter loops getNextTuple for operators without a native version.
+    virtual RC getNextBatch(TupleBatch &batch, unsigned maxTuples = QE_BATCH_SIZE);
+
     virtual void getAttributes(std::vector<Attribute> &attrs) const = 0;
 
     virtual ~Iterator() = default;
 
+    // the operator and its arguments, one line for EXPLAIN
+    virtual std::string getDescription() const { return "Iterator"; };
+
+    // the iterators feeding this one, left first
+    const std::vector<Iterator *> &getInputs() const { return inputs; };
+
+    // profile this iterator and its inputs from now on, their statistics start over
+    void setProfiling(bool profiling);
+
+    bool isProfiling() const { return profiling; };
+
+    const IteratorStatistics &getStatistics() const { return statistics; };
+
+    // the operator tree, an operator a line and its inputs indented under it, with the statistics if analyze.
+    // the time and I/O of an operator include those of its inputs
+    void explain(std::ostream &out, bool analyze, unsigned depth = 0) const;
+
+    static std::string getStatisticsString(const IteratorStatistics &statistics);
+
     static void getLengthAndDataFromTuple(void *tuple, std::vector<Attribute> const &attrs, const std::string &attrName, unsigned index, unsigned short &length, void *data);
 
     static unsigned getAttributesEstLength(std::vector<Attribute> const &attrs);
 
+    // longest tuple the attributes can make, every VarChar at its full length
+    static unsigned getMaxTupleLength(std::vector<Attribute> const &attrs);
+
     static unsigned getTupleLength(std::vector<Attribute> const &attrs, void *data);
 
-    static void concatenateTuple(void *data, void *left, void *right, std::vector<Attribute> const &leftAttrs,
+    static unsigned concatenateTuple(void *data, void *left, void *right, std::vector<Attribute> const &leftAttrs,
                                  std::vector<Attribute> const &rightAttrs);
 
-    static void addTupleToHashMap(void *data, void *key, AttrType attrType,
-                                  std::unordered_map<int, std::vector<void *>> &intMap,
-                                  std::unordered_map<std::string, std::vector<void *>> &stringMap);
+    // start of attribute index inside tuple, nullptr if it is NULL
+    static const char *getAttributePointer(const void *tuple, std::vector<Attribute> const &attrs, int index);
+
+    // order of two attribute values like memcmp, a NULL (nullptr) comes first
+    static int compareAttribute(const char *value1, const char *value2, AttrType type);
+
+    // hash of an attribute value, equal values hash alike (0.0 and -0.0 too), a NULL (nullptr) hashes to 0
+    static uint32_t hashAttribute(const char *value, AttrType type);
+
+protected:
+    std::vector<Iterator *> inputs;
+
+private:
+    friend class IteratorProfile;
+
+    bool profiling;
+    IteratorStatistics statistics;
+};
+
+// Measures one call of an iterator while it is profiled, the first statement of getNextTuple and getNextBatch.
+// A constructor doing the work of the first call measures it too, without counting a call.
+class IteratorProfile {
+public:
+    explicit IteratorProfile(Iterator *iterator, bool isCall = true);
+
+    ~IteratorProfile();
+
+    IteratorProfile(const IteratorProfile &) = delete;
+
+    IteratorProfile &operator=(const IteratorProfile &) = delete;
+
+    // counts the tuples of a call that returned them, returns rc
+    RC count(RC rc, unsigned rows = 1) {
+        if (iterator != nullptr && rc == 0) {
+            iterator->statistics.rows += rows;
+        }
+        return rc;
+    };
+
+private:
+    // nullptr while the iterator is not profiled
+    Iterator *iterator;
+    std::chrono::steady_clock::time_point wallStart;
+    std::clock_t cpuStart;
+    unsigned long long readStart;
+    unsigned long long writeStart;
+};
+
+// Tuples hashed on one of their attributes, shared by the hash joins and the group-by.
+// The tuples are copied back to back into one arena. Every distinct key has one slot,
+// found by linear probing, and the tuples with that key are chained in the order they came.
+// A NULL key is a key of its own, the joins leave those tuples out.
+class TupleHashTable {
+public:
+    TupleHashTable() = default;
+
+    TupleHashTable(const std::vector<Attribute> &attrs, int keyIndex);
+
+    // copy tuple into the table, returns its entry
+    unsigned insert(const void *tuple, unsigned length);
+
+    // the first entry with the key of tuple, tuple is inserted if there is none yet
+    unsigned findOrInsert(const void *tuple, unsigned length, bool &inserted);
+
+    // the first entry whose key equals key, QE_HASH_END if there is none
+    unsigned find(const char *key) const;
 
+    // the next entry with the same key, QE_HASH_END at the end of the chain
+    unsigned next(unsigned entry) const { return entries[entry].next; };
+
+    // entries are numbered in the order they were inserted
+    const char *getTuple(unsigned entry) const { return arena.data() + entries[entry].offset; };
+
+    unsigned size() const { return entries.size(); };
+
+    // bytes taken by the tuples, the entries and the slots
+    size_t getMemoryUsage() const;
+
+    // drop every tuple and give the memory back
+    void clear();
+
+private:
+    struct Slot {
+        uint32_t hash;
+        unsigned head;      // QE_HASH_END while the slot is free
+        unsigned tail;
+    };
+
+    struct Entry {
+        size_t offset;
+        unsigned keyOffset; // from the start of the tuple, QE_HASH_END for a NULL key
+        unsigned next;
+    };
+
+    std::vector<Attribute> attrs;
+    int keyIndex = 0;
+    AttrType keyType = TypeInt;
+
+    std::vector<char> arena;
+    std::vector<Entry> entries;
+    std::vector<Slot> slots;
+    unsigned usedSlots = 0;
+
+    const char *getKey(unsigned entry) const;
+    // the slot holding key, or the free slot where it belongs
+    unsigned findSlot(const char *key, uint32_t hash) const;
+    unsigned addEntry(const void *tuple, unsigned length, const char *key, uint32_t hash);
+    void grow();
+};
+
+// Tuples an operator moves to a temp file, shared by the hash join and the group-by.
+// They are buffered a page at a time and every full page goes out in one insertRecords.
+class SpillFile {
+public:
+    std::string fileName;
+    FileHandle fileHandle;
+
+    // create and open a temp file named after prefix, its tuples have the attributes attrs
+    RC create(const std::string &prefix, const std::vector<Attribute> &attrs);
+
+    // copy tuple into the page being filled, a full page is written out first
+    RC append(const void *tuple, unsigned length);
+
+    // write out the tuples still buffered
+    RC flush();
+
+    bool hasPending() const { return !pending.empty(); };
+
+    // tuples appended so far
+    unsigned getTupleCount() const { return tupleCount; };
+
+private:
+    std::vector<Attribute> attrs;
+    std::vector<char> pending;
+    std::vector<unsigned> pendingOffsets;
+    unsigned tupleCount = 0;
 };
 
 class TableScan : public Iterator {
@@ -62,9 +340,17 @@ public:
     std::vector<std::string> attrNames;
     RID rid{};
 
+    // table scanned, tableName may be an alias
+    std::string relationName;
+    // pushed into RBFM_ScanIterator, records that fail it never leave the page
+    Predicate predicate;
+    // attrNames came from pushProjection
+    bool projected = false;
+
     TableScan(RelationManager &rm, const std::string &tableName, const char *alias = NULL) : rm(rm) {
         //Set members
         this->tableName = tableName;
+        this->relationName = tableName;
 
         // Get Attributes from RM
         rm.getAttributes(tableName, attrs);
@@ -77,24 +363,38 @@ public:
 
         // Call RM scan to get an iterator
         iter = new RM_ScanIterator();
-        rm.scan(tableName, "", NO_OP, NULL, attrNames, *iter);
+        rm.scan(tableName, predicate, attrNames, *iter);
 
         // Set alias
         if (alias) this->tableName = alias;
     };
 
+    // Scan with the predicate and projection pushed down. Attribute names are plain or qualified as
+    // getAttributes returns them, no attribute names means all of them.
+    TableScan(RelationManager &rm, const std::string &tableName, const Predicate &predicate,
+              const std::vector<std::string> &attrNames, const char *alias = NULL);
+
     // Start a new iterator given the new compOp and value
     void setIterator() {
         iter->close();
         delete iter;
         iter = new RM_ScanIterator();
-        rm.scan(tableName, "", NO_OP, NULL, attrNames, *iter);
+        rm.scan(relationName, predicate, attrNames, *iter);
     };
 
+    // AND the predicate to the pushed one, restarts the scan
+    void pushPredicate(const Predicate &predicate);
+
+    // keep only these attributes, in this order. -1 if one is not returned by the scan. restarts the scan
+    RC pushProjection(const std::vector<std::string> &attrNames);
+
     RC getNextTuple(void *data) override {
-        return iter->getNextTuple(rid, data);
+        IteratorProfile profile(this);
+        return profile.count(iter->getNextTuple(rid, data));
     };
 
+    RC getNextBatch(TupleBatch &batch, unsigned maxTuples = QE_BATCH_SIZE) override;
+
     void getAttributes(std::vector<Attribute> &attributes) const override {
         attributes.clear();
         attributes = this->attrs;
@@ -108,9 +408,17 @@ public:
         }
     };
 
+    std::string getDescription() const override;
+
     ~TableScan() override {
         iter->close();
     };
+
+private:
+    // the attribute name as the table knows it
+    std::string getRelationAttrName(const std::string &attrName) const;
+
+    Predicate getRelationPredicate(const Predicate &predicate) const;
 };
 
 class IndexScan : public Iterator {
@@ -123,6 +431,9 @@ public:
     std::vector<Attribute> attrs;
     char key[PAGE_SIZE]{};
     RID rid{};
+    // entries read ahead of their tuples, the pages of the tuples are prefetched together
+    std::vector<RID> pendingRids;
+    unsigned pendingPosition = 0;
 
     IndexScan(RelationManager &rm, const std::string &tableName, const std::string &attrName, const char *alias = NULL)
             : rm(rm) {
@@ -148,16 +459,21 @@ public:
         delete iter;
         iter = new RM_IndexScanIterator();
         rm.indexScan(tableName, attrName, lowKey, highKey, lowKeyInclusive, highKeyInclusive, *iter);
+        pendingRids.clear();
+        pendingPosition = 0;
     };
 
     RC getNextTuple(void *data) override {
-        int rc = iter->getNextEntry(rid, key);
+        IteratorProfile profile(this);
+        int rc = getNextRID(rid);
         if (rc == 0) {
             rc = rm.readTuple(tableName.c_str(), rid, data);
         }
-        return rc;
+        return profile.count(rc);
     };
 
+    RC getNextBatch(TupleBatch &batch, unsigned maxTuples = QE_BATCH_SIZE) override;
+
     void getAttributes(std::vector<Attribute> &attributes) const override {
         attributes.clear();
         attributes = this->attrs;
@@ -171,6 +487,11 @@ public:
         }
     };
 
+    std::string getDescription() const override;
+
+    // next entry of the index, IO_QUEUE_DEPTH of them are read ahead at a time
+    RC getNextRID(RID &nextRID);
+
     ~IndexScan() override {
         iter->close();
     };
@@ -180,32 +501,34 @@ class Filter : public Iterator {
     // Filter operator
 public:
     std::vector<Attribute> relAttrs;
-    std::string targetAttrName;
-    Attribute targetAttribute;
-    int targetAttrIndex;
-    int rc = 0;
-
-    std::string lhsAttr;        // left-hand side attribute
-    CompOp op;                  // comparison operator
-    bool bRhsIsAttr;            // TRUE if right-hand side is an attribute and not a value; FALSE, otherwise.
-    std::string rhsAttr;        // right-hand side attribute if bRhsIsAttr = TRUE
-    Value rhsValue;             // right-hand side value if bRhsIsAttr = FALSE
-
-    void* currentTuple;
+    Predicate predicate;
+    PredicateEvaluator evaluator;
 
     Iterator *input;
+    BatchReader reader;
 
     Filter(Iterator *input,               // Iterator of input Rconst
             Condition &condition     // Selection condition
     );
-    bool isTupleSatisfied();
+
+    // several conditions combined with AND, OR and NOT, checked in one pass over the tuple
+    Filter(Iterator *input, const Predicate &predicate);
+
+    bool isTupleSatisfied(const void *tuple);
+
+    // the condition as a predicate over the attribute names of the input
+    static Predicate getConditionPredicate(const Condition &condition);
 
     ~Filter() override;
 
     RC getNextTuple(void *data) override;
 
+    RC getNextBatch(TupleBatch &batch, unsigned maxTuples = QE_BATCH_SIZE) override;
+
     // For attribute in std::vector<Attribute>, name it as rel.attr
     void getAttributes(std::vector<Attribute> &attrs) const override;
+
+    std::string getDescription() const override;
 };
 
 class Project : public Iterator {
@@ -218,24 +541,30 @@ public:
     std::vector<std::string> targetAttributesNames;
     std::vector<Attribute> targetAttributes;
 
-    void* currentTuple;
     Iterator *input;
+    BatchReader reader;
 
     Project(Iterator *input,                    // Iterator of input R
             const std::vector<std::string> &attrNames);   // std::vector containing attribute names
-    ~Project() override;
+    ~Project() override = default;
 
     RC getNextTuple(void *data) override;
 
+    RC getNextBatch(TupleBatch &batch, unsigned maxTuples = QE_BATCH_SIZE) override;
+
+    // writes the projection of tuple into data, returns its length
+    unsigned projectTuple(const void *tuple, void *data);
+
     // For attribute in std::vector<Attribute>, name it as rel.attr
     void getAttributes(std::vector<Attribute> &attrs) const override;
+
+    std::string getDescription() const override;
 };
 
 class BNLJoin : public Iterator {
     // Block nested-loop join operator
 public:
     unsigned memoryLimit;
-    unsigned currentMemory;
 
     int lrc;
     int rrc;
@@ -243,23 +572,23 @@ public:
     Condition condition;
     Iterator *leftIt;
     TableScan *rightIt;
-    AttrType type;
 
     std::vector<Attribute> leftAttrs;
     std::vector<Attribute> rightAttrs;
 
-    Attribute leftAttr;
-
     unsigned leftAttrsEstLength;
     int leftAttrsIndex;
     int rightAttrsIndex;
 
-    std::unordered_map<int, std::vector<void *>> intMap;
-    std::unordered_map<std::string, std::vector<void *>> stringMap;
-
-    std::stack<void *> outBuffer;
+    // the current block of R
+    TupleHashTable table;
+    // R tuples matching the current S tuple
+    unsigned matchEntry;
     void* tuple1;
 
+    BatchReader leftReader;
+    BatchReader rightReader;
+
     BNLJoin(Iterator *leftIn,            // Iterator of input R
             TableScan *rightIn,           // TableScan Iterator of input S
             const Condition &condition,   // Join condition
@@ -271,13 +600,19 @@ public:
 
     RC getNextTuple(void *data) override;
 
+    RC getNextBatch(TupleBatch &batch, unsigned maxTuples = QE_BATCH_SIZE) override;
+
     // For attribute in std::vector<Attribute>, name it as rel.attr
     void getAttributes(std::vector<Attribute> &attrs) const override;
 
+    std::string getDescription() const override;
+
     void clean();
 
 private:
     RecordBasedFileManager *rbfm;
+
+    RC getNextJoinedTuple(void *data, unsigned &length);
 };
 
 class INLJoin : public Iterator {
@@ -299,144 +634,635 @@ public:
     int rrc;
 
     void* tuple;
+    void* tuple1;
+    void* key;
+
+    BatchReader leftReader;
 
     INLJoin(Iterator *leftIn,           // Iterator of input R
             IndexScan *rightIn,          // IndexScan Iterator of input S
             const Condition &condition   // Join condition
     );
 
-    ~INLJoin() override = default;
+    ~INLJoin() override;
 
     RC getNextTuple(void *data) override;
 
+    RC getNextBatch(TupleBatch &batch, unsigned maxTuples = QE_BATCH_SIZE) override;
+
     // For attribute in std::vector<Attribute>, name it as rel.attr
     void getAttributes(std::vector<Attribute> &attrs) const override;
 
+    std::string getDescription() const override;
+
 private:
     RecordBasedFileManager *rbfm;
+
+    RC getNextJoinedTuple(void *data, unsigned &length);
 };
 
 // Optional for everyone. 10 extra-credit points
 class GHJoin : public Iterator {
-    // Grace hash join operator
+    // Hybrid hash join operator
+    // R never takes more than numPages pages of memory. A spilled partition of R larger than that, a skewed
+    // key for instance, is joined in blocks of numPages - 1 pages and its S file is read once per block.
 public:
+    GHJoin(Iterator *leftIn,               // Iterator of input R
+           Iterator *rightIn,               // Iterator of input S
+           const Condition &condition,      // Join condition (CompOp is always EQ)
+           const unsigned numPages          // # of pages of memory, decides the partitions and how many stay in memory
+    );
+
+    ~GHJoin() override;
 
-    int numPartitions;
-    std::vector<std::string> leftPartitionNames;
-    std::vector<std::string> rightPartitionNames;
+    RC getNextTuple(void *data) override;
 
+    RC getNextBatch(TupleBatch &batch, unsigned maxTuples = QE_BATCH_SIZE) override;
 
-    int lrc;
-    int rrc;
+    // For attribute in std::vector<Attribute>, name it as rel.attr
+    void getAttributes(std::vector<Attribute> &attrs) const override;
 
-    int leftAttrIndex;
-    int rightAttrIndex;
+    std::string getDescription() const override;
+
+    unsigned getNumberOfPartitions() const { return numPartitions; };
 
-    // index
-    int nextpart;
+    // number of partitions of R that did not fit into memory
+    unsigned getNumberOfSpills() const { return spillCount; };
 
-    std::unordered_map<int, std::vector<void *>> intMap;
-    std::unordered_map<std::string, std::vector<void *>> stringMap;
+    // blocks the spilled partitions of R were joined in, one per partition if each fit into memory
+    unsigned getNumberOfBlocks() const { return blockCount; };
 
-    std::stack<void *> outBuffer;
+private:
+    // spilled tuples of one partition
+    typedef SpillFile PartitionFile;
+
+    RecordBasedFileManager *rbfm;
 
     std::vector<Attribute> leftAttrs;
     std::vector<Attribute> rightAttrs;
-
     std::vector<std::string> leftAttrNames;
     std::vector<std::string> rightAttrNames;
+    int leftAttrIndex;
+    int rightAttrIndex;
+    AttrType attrType;
 
-    Attribute leftAttr;
-    Attribute rightAttr;
+    // partition 0 gets half of the memory when every other partition has spilled
+    unsigned numPartitions;
+    unsigned memoryLimit;
+    // what the tables of the resident partitions take, see TupleHashTable::getMemoryUsage
+    size_t memoryUsed;
+    unsigned spillCount;
+    std::vector<bool> resident;
+    // tuples of R in each partition, hashed by the join key
+    std::vector<TupleHashTable> tables;
+    std::vector<PartitionFile *> leftFiles;
+    std::vector<PartitionFile *> rightFiles;
+
+    // S is read once, tuples of resident partitions are joined right away
+    BatchReader rightReader;
+    bool probingInput;
+
+    // the spilled partition being joined
+    unsigned nextPartition;
+    unsigned currentPartition;
+    bool scanningPartition;
+    RBFM_ScanIterator partitionIterator;
+    void *partitionTuple;
+    // R of the spilled partition, read a block at a time
+    RBFM_ScanIterator leftIterator;
+    void *leftTuple;
+    // leftTuple did not fit into the last block, it starts the next one
+    bool leftTupleHeld;
+    unsigned blockCount;
+
+    // R tuples matching the current S tuple
+    const void *probeTuple;
+    unsigned matchEntry;
+
+    unsigned getPartition(const char *key) const;
+
+    RC addToFile(PartitionFile *&file, const std::vector<Attribute> &attrs, const void *tuple, unsigned length);
+    // flush and close every open partition file, their dirty pages are written together
+    RC closeFiles(std::vector<PartitionFile *> &files);
+    void destroyFiles();
+
+    RC partitionLeft(Iterator *leftIn);
+    // moves resident partitions to disk, the last ones first, until R fits into memory again
+    RC spillPartitions();
+    RC loadPartition(unsigned partition);
+    // the next block of R into memory, then a scan of the S partition from the start
+    RC loadBlock();
+
+    RC getNextJoinedTuple(void *data, unsigned &length);
+};
 
-    FileHandle rightFileHandle;
-    RBFM_ScanIterator rightRBFMSI;
-    void* tuple1;
+class Aggregate : public Iterator {
+    // Hash aggregation operator
+public:
+    // Mandatory
+    // Basic aggregation
+    Aggregate(Iterator *input,          // Iterator of input R
+              const Attribute &aggAttr,        // The attribute over which we are computing an aggregate
+              AggregateOp op            // Aggregate operation
+    );
 
-    AttrType attrType;
+    // Optional for everyone: 5 extra-credit points
+    // Group-based hash aggregation
+    Aggregate(Iterator *input,             // Iterator of input R
+              const Attribute &aggAttr,           // The attribute over which we are computing an aggregate
+              const Attribute &groupAttr,         // The attribute over which we are grouping the tuples
+              AggregateOp op              // Aggregate operation
+    );
 
-    GHJoin(Iterator *leftIn,               // Iterator of input R
-           Iterator *rightIn,               // Iterator of input S
-           const Condition &condition,      // Join condition (CompOp is always EQ)
-           const unsigned numPartitions     // # of partitions for each relation (decided by the optimizer)
+    // Several aggregates over groups of several attributes, in one pass over the input.
+    // Past numPages of groups the partial aggregates spill to partitions on disk
+    Aggregate(Iterator *input,                                    // Iterator of input R
+              const std::vector<Attribute> &groupAttrs,           // The attributes to group by, none for one group
+              const std::vector<AggregateFunction> &functions,    // The aggregates computed for every group
+              const unsigned numPages = 0                         // # of pages of memory, 0 for no bound
     );
 
-    ~GHJoin() override;
+    ~Aggregate() override;
 
     RC getNextTuple(void *data) override;
 
+    RC getNextBatch(TupleBatch &batch, unsigned maxTuples = QE_BATCH_SIZE) override;
+
+    // length of a tuple returned by getNextTuple
+    unsigned getOutputLength(const void *data) const;
+
+    // The group attributes come first, then one REAL attribute per aggregate,
+    // named as aggregateOp(aggAttr)
+    // E.g. Relation=rel, attribute=attr, aggregateOp=MAX
+    // output attrname = "MAX(rel.attr)"
+    // An aggregate over no values is NULL, COUNT is 0 then
+    void getAttributes(std::vector<Attribute> &attrs) const override;
+
+    std::string getDescription() const override;
+
+    // groups in memory, all of them unless the aggregation spilled
+    unsigned getNumberOfGroups() const { return groupTable.size(); };
+
+    // number of times the groups in memory were written to the partitions
+    unsigned getNumberOfSpills() const { return spillCount; };
+
+    // partitioning passes, 0 if everything fit into memory
+    unsigned getNumberOfLevels() const { return levelCount; };
+
+private:
+    // running state of one aggregate in one group, AVG is only divided on output
+    struct Accumulator {
+        int64_t count;
+        int64_t intSum;
+        double realSum;
+        double min;
+        double max;
+    };
+
+    // partial aggregates of one partition, spilled on a level of the partitioning
+    struct PartitionFile : SpillFile {
+        unsigned level;
+    };
+
+    RecordBasedFileManager *rbfm;
+
+    Iterator *input;
+    std::vector<Attribute> attributes;
+    std::vector<Attribute> groupAttrs;
+    std::vector<int> groupIndexes;
+    std::vector<AggregateFunction> functions;
+    std::vector<int> aggrIndexes;
+    std::vector<Attribute> outputAttrs;
+
+    // one entry per group, its only attribute is a VarChar holding the group key tuple
+    TupleHashTable groupTable;
+    // functions.size() accumulators for every group entry
+    std::vector<Accumulator> accumulators;
+    bool aggregated;
+    unsigned outputIndex;
+
+    // a spilled record is the group key followed by a VarChar of the accumulators
+    std::vector<Attribute> spillAttrs;
+    std::vector<std::string> spillAttrNames;
+    unsigned memoryLimit;
+    unsigned numPartitions;
+    unsigned spillCount;
+    unsigned levelCount;
+    // partitions left to merge, the last one first
+    std::vector<PartitionFile *> pendingFiles;
+
+    // writes the group key of tuple into keyTuple, returns its length
+    unsigned makeGroupKey(const void *tuple, char *keyTuple) const;
+    void accumulate(const void *tuple, Accumulator *accumulator) const;
+    void mergeAccumulators(Accumulator *accumulator, const char *state) const;
+    // the entry of the group, with new accumulators if it was not there yet
+    unsigned addGroup(const char *keyTuple, unsigned keyLength, bool &inserted);
+    bool isOverBudget() const;
+    RC aggregateInput();
+
+    unsigned getPartition(const char *keyTuple, unsigned level) const;
+    RC addToFile(PartitionFile *&file, unsigned level, const void *record, unsigned length);
+    // moves the groups in memory to files[the partition of their key on level]
+    RC spillGroups(std::vector<PartitionFile *> &files, unsigned level);
+    // closes the files of a finished pass, they wait in pendingFiles
+    RC finishFiles(std::vector<PartitionFile *> &files);
+    // merges the next pending partition into memory, spilling it one level deeper if it does not fit
+    RC mergePartition();
+    void destroyFiles();
+
+    RC getNextGroup(void *data, unsigned &length);
+};
+
+class Sort : public Iterator {
+    // External merge sort operator
+public:
+    Sort(Iterator *input,                     // Iterator of input R
+         const std::vector<SortKey> &keys,    // sort keys, most significant first
+         const unsigned numPages              // # of pages that can be loaded into memory,
+         //   run generation uses all of them, a merge reads numPages - 1 runs at once
+    );
+
+    ~Sort() override;
+
+    RC getNextTuple(void *data) override;
+
+    RC getNextBatch(TupleBatch &batch, unsigned maxTuples = QE_BATCH_SIZE) override;
+
     // For attribute in std::vector<Attribute>, name it as rel.attr
     void getAttributes(std::vector<Attribute> &attrs) const override;
 
-    static std::string getFileName(int i, bool isLeft, std::string &attrName);
+    std::string getDescription() const override;
 
-    void scanThenAddToPartitionFile(Iterator *iter, const std::vector<std::string> &partitionFileNames,
-                                    const std::vector<Attribute> &attributes, int attrIndex);
+    // order of two tuples by the sort keys, like memcmp
+    int compareTuple(const void *tuple1, const void *tuple2) const;
 
-    void clean();
+    // number of runs written to disk, 0 if the input fit into memory
+    unsigned getNumberOfRuns() const { return runCount; };
 
 private:
+    struct SortRun {
+        std::string fileName;
+        FileHandle fileHandle;
+        RBFM_ScanIterator iterator;
+        void *tuple;
+        bool exhausted;
+    };
+
     RecordBasedFileManager *rbfm;
+
+    std::vector<Attribute> attrs;
+    std::vector<std::string> attrNames;
+    std::vector<int> keyIndexes;
+    std::vector<bool> keyAscending;
+
+    unsigned numPages;
+    unsigned memoryLimit;
+    unsigned runCount;
+
+    // run generation, also the output when everything fits
+    std::vector<char> buffer;
+    std::vector<unsigned> offsets;
+    unsigned cursor;
+
+    // every run written so far, the last numPages - 1 of them form the final merge
+    std::vector<std::string> runFileNames;
+    std::vector<SortRun *> runs;
+    // loser tree over runs, tree[0] is the current winner
+    std::vector<int> tree;
+    // a run could not be read, the output stops there
+    bool readFailed;
+
+    void sortBuffer();
+    RC spillBuffer();
+    RC createRunFile(std::string &fileName);
+    // runFileNames[first, last) take part in a merge
+    RC openRuns(unsigned first, unsigned last);
+    void closeRuns();
+    RC mergeRuns(unsigned first, unsigned last);
+    // drop every run file, then throw
+    void abandonRuns();
+
+    RC readRun(int run);
+    bool isBefore(int run1, int run2) const;
+    void adjustTree(int run);
+    void buildTree();
+    RC getNextSortedTuple(void *data, unsigned &length);
 };
 
-class Aggregate : public Iterator {
-    // Aggregation operator
+class SMJoin : public Iterator {
+    // Sort-merge join operator
 public:
-    // Mandatory
-    // Basic aggregation
-    Aggregate(Iterator *input,          // Iterator of input R
-              const Attribute &aggAttr,        // The attribute over which we are computing an aggregate
-              AggregateOp op            // Aggregate operation
+    SMJoin(Iterator *leftIn,                  // Iterator of input R
+           Iterator *rightIn,                 // Iterator of input S
+           const Condition &condition,        // Join condition, EQ_OP or a band LT_OP / LE_OP / GT_OP / GE_OP
+           const unsigned numPages,           // # of pages shared by the sorts and the buffered tuples
+           bool leftSorted = false,           // TRUE if R already comes in ascending join key order
+           bool rightSorted = false           // TRUE if S already comes in ascending join key order
     );
 
-    Attribute aggAttr;
-    AggregateOp op;
-    Iterator *input;
+    ~SMJoin() override;
 
-    int aggrIndex;
-    int groupIndex;
-    std::vector<Attribute> attributes;
+    RC getNextTuple(void *data) override;
 
-    float minValue;
-    float maxValue;
-    float totalCount;
-    float valueSum;
-    float valueAvg;
+    RC getNextBatch(TupleBatch &batch, unsigned maxTuples = QE_BATCH_SIZE) override;
 
-    bool endFlag = false;
+    // For attribute in std::vector<Attribute>, name it as rel.attr
+    void getAttributes(std::vector<Attribute> &attrs) const override;
 
-    std::unordered_map<std::string, float> totalCountMap;
-    std::unordered_map<std::string, float> minMap;
-    std::unordered_map<std::string, float> maxMap;
-    std::unordered_map<std::string, float> sumMap;
-    std::unordered_map<std::string, float> avgMap;
+    std::string getDescription() const override;
 
-    int outputIndex = 0;
-    std::vector<std::string> groups;
-    std::vector<std::vector<float>> aggregations;
+    // Number of buffered groups that did not fit into memory
+    unsigned getNumberOfSpills() const { return spillCount; };
 
-    Attribute groupAttr;
+private:
+    RecordBasedFileManager *rbfm;
 
-    // Optional for everyone: 5 extra-credit points
-    // Group-based hash aggregation
-    Aggregate(Iterator *input,             // Iterator of input R
-              const Attribute &aggAttr,           // The attribute over which we are computing an aggregate
-              const Attribute &groupAttr,         // The attribute over which we are grouping the tuples
-              AggregateOp op              // Aggregate operation
+    std::vector<Attribute> leftAttrs;
+    std::vector<Attribute> rightAttrs;
+
+    // inputs sorted by the join, nullptr if they came sorted
+    Sort *leftSort;
+    Sort *rightSort;
+
+    // both sides ascend, the outer side drives and the inner one is buffered.
+    // R is outer unless the condition is LT_OP / LE_OP, then it is flipped to S GT_OP / GE_OP R
+    bool leftIsOuter;
+    CompOp op;
+    std::vector<Attribute> outerAttrs;
+    std::vector<Attribute> innerAttrs;
+    int outerIndex;
+    int innerIndex;
+    AttrType keyType;
+
+    BatchReader *outerReader;
+    BatchReader *innerReader;
+
+    void *outerTuple;
+    void *innerTuple;
+    bool innerValid;
+
+    // inner tuples matching the current outer tuple, the overflow goes to a temp file
+    unsigned memoryLimit;
+    std::vector<char> buffer;
+    std::vector<unsigned> offsets;
+    SpillFile *groupFile;               // nullptr while the buffer fits
+    unsigned spillCount;
+    // set once the overflow cannot be written or read back, the join ends there
+    bool spillFailed;
+
+    // position while the current outer tuple is joined with the buffer
+    bool outputting;
+    unsigned bufferPos;
+    RBFM_ScanIterator groupIterator;
+    bool scanningGroup;
+    void *groupTuple;
+
+    void advanceInner();
+    int compareKeys(const void *outer, const void *inner) const;
+    RC appendToBuffer(const void *tuple, unsigned length);
+    void clearBuffer();
+    RC getNextJoinedTuple(void *data, unsigned &length);
+};
+
+class PHJoin : public Iterator {
+    // Parallel radix hash join operator, both inputs are held in memory
+public:
+    PHJoin(Iterator *leftIn,                  // Iterator of input R, the build side
+           Iterator *rightIn,                 // Iterator of input S, the probe side
+           const Condition &condition,        // Join condition (CompOp is always EQ)
+           const unsigned numThreads          // # of worker threads
     );
 
-    ~Aggregate() = default;
+    ~PHJoin() override;
 
     RC getNextTuple(void *data) override;
 
-    RC getNextTupleGroupBy(void *data);
+    RC getNextBatch(TupleBatch &batch, unsigned maxTuples = QE_BATCH_SIZE) override;
 
-    // Please name the output attribute as aggregateOp(aggAttr)
-    // E.g. Relation=rel, attribute=attr, aggregateOp=MAX
-    // output attrname = "MAX(rel.attr)"
+    // For attribute in std::vector<Attribute>, name it as rel.attr
     void getAttributes(std::vector<Attribute> &attrs) const override;
+
+    std::string getDescription() const override;
+
+    unsigned getNumberOfPartitions() const { return numPartitions; };
+
+    // number of skewed partitions of R that were split further
+    unsigned getNumberOfSplits() const { return splitCount; };
+
+    unsigned getNumberOfTasks() const { return tasks.size(); };
+
+private:
+    // a tuple in the arena of its input and the hash of its key
+    struct Entry {
+        size_t offset;
+        uint32_t hash;
+    };
+
+    // chained hash table over leftEntries[begin, end), built by the first task that needs it
+    struct Table {
+        size_t begin;
+        size_t end;
+        std::once_flag built;
+        uint32_t mask;
+        std::vector<int> heads;
+        std::vector<int> next;
+    };
+
+    // probes rightEntries[probeBegin, probeEnd) against a table, the result is pairs of tuple offsets
+    struct Task {
+        Table *table;
+        size_t probeBegin;
+        size_t probeEnd;
+        std::vector<std::pair<size_t, size_t>> matches;
+        std::promise<void> done;
+        std::future<void> ready;
+    };
+
+    std::vector<Attribute> leftAttrs;
+    std::vector<Attribute> rightAttrs;
+    int leftAttrIndex;
+    int rightAttrIndex;
+    AttrType attrType;
+    unsigned numThreads;
+
+    std::vector<char> leftTuples;
+    std::vector<char> rightTuples;
+    std::vector<Entry> leftEntries;
+    std::vector<Entry> rightEntries;
+
+    unsigned radixBits;
+    unsigned numPartitions;
+    unsigned splitCount;
+    std::vector<Table *> tables;
+    std::vector<Task *> tasks;
+
+    // workers take the tasks in order, the output follows the same order. a worker waits
+    // while numThreads * QE_PHJOIN_TASKS_PER_THREAD tasks past currentTask are taken,
+    // so the matches that are not read yet stay bounded
+    std::vector<std::thread> workers;
+    std::mutex taskMutex;
+    std::condition_variable taskWindow;
+    size_t nextTask;
+    bool stopping;
+    size_t currentTask;
+    size_t matchPos;
+
+    void readInput(Iterator *input, const std::vector<Attribute> &attrs, int attrIndex, std::vector<char> &tuples,
+                   std::vector<Entry> &entries);
+    // runs work(0) to work(numThreads - 1) at the same time
+    void runParallel(const std::function<void(unsigned)> &work);
+    // hashes the keys and orders the entries by the first radixBits bits of the hash, partition p starts at starts[p]
+    void partition(const std::vector<char> &tuples, const std::vector<Attribute> &attrs, int attrIndex,
+                   std::vector<Entry> &entries, std::vector<size_t> &starts);
+    // orders entries[begin, end) by the next QE_PHJOIN_SPLIT_BITS bits of the hash
+    void splitRange(std::vector<Entry> &entries, size_t begin, size_t end, std::vector<size_t> &starts);
+    void addTasks(size_t leftBegin, size_t leftEnd, size_t rightBegin, size_t rightEnd, bool skewed);
+    void buildTable(Table *table);
+    void runTask(Task *task);
+    void runTasks();
+
+    RC getNextJoinedTuple(void *data, unsigned &length);
+};
+
+// A select-project-join query, the optimizer decides how it runs
+struct Query {
+    std::vector<std::string> tableNames;    // tables joined, each at most once
+    std::vector<Condition> conditions;      // combined with AND, attributes are qualified as table.attr
+    std::vector<std::string> attrNames;     // output attributes, qualified, no attribute names means all of them
 };
 
+// The iterators of a plan with the estimates they were picked by, a plan owns its iterators
+class QueryPlan {
+public:
+    QueryPlan() = default;
+
+    ~QueryPlan();
+
+    QueryPlan(const QueryPlan &) = delete;
+
+    QueryPlan &operator=(const QueryPlan &) = delete;
+
+    // nullptr while the plan is empty
+    Iterator *getRoot() const { return nodes.empty() ? nullptr : nodes.back().iterator; };
+
+    double getEstimatedRows() const { return nodes.empty() ? 0 : nodes.back().rows; };
+
+    // in page reads and writes
+    double getEstimatedCost() const { return nodes.empty() ? 0 : nodes.back().cost; };
+
+    // the operator tree, one operator a line, inputs indented under it. analyze adds the statistics of profiled operators
+    void print(std::ostream &out, bool analyze = false) const;
+
+    // takes over the iterator, returns its node. inputs are nodes added before, the last node is the root
+    unsigned addNode(Iterator *iterator, const std::string &description, double rows, double cost,
+                     const std::vector<unsigned> &inputs = {});
+
+    void clear();
+
+private:
+    struct Node {
+        Iterator *iterator;
+        std::string description;
+        double rows;
+        double cost;
+        std::vector<unsigned> inputs;
+    };
 
+    std::vector<Node> nodes;
+
+    void print(std::ostream &out, unsigned node, unsigned depth, bool analyze) const;
+};
+
+/*
+ * cost based optimizer over the statistics of RelationManager::analyze
+ * - every table is read by a TableScan with its conditions and attributes pushed down, or by an IndexScan
+ * - the join order is left deep, the cheapest order is searched over the subsets of the tables
+ * - every join picks BNLJoin, INLJoin, GHJoin or SMJoin by its cost
+ * - the joins share the memory budget in proportion to what they need
+ * */
+class Optimizer {
+public:
+    explicit Optimizer(RelationManager &rm, unsigned numPages = QE_OPTIMIZER_PAGES);
+
+    // -1 if a table or an attribute is unknown, or the tables are not all joined by a condition other than NE_OP
+    RC optimize(const Query &query, QueryPlan &plan);
+
+    // fraction of the rows of a table satisfying a condition between its attribute and a value
+    double getSelectivity(const std::string &tableName, const Condition &condition);
+
+private:
+    enum JoinMethod {
+        SCAN = 0, INDEX_SCAN, BNL_JOIN, INL_JOIN, GH_JOIN, SM_JOIN
+    };
+
+    struct TableInfo {
+        std::string tableName;
+        std::vector<Attribute> attrs;
+        TableStatistics statistics;
+        bool analyzed;
+        double rows;
+        double pages;
+        double width;
+        // conditions on this table only
+        std::vector<unsigned> localConditions;
+        double selectivity;
+        // the cheapest way to read it on its own
+        JoinMethod access;
+        int indexCondition;
+        double accessCost;
+    };
+
+    // how a table joins the tables before it
+    struct Step {
+        unsigned table;
+        JoinMethod method;
+        int condition;
+        double rows;
+        double cost;
+        double pages;
+        unsigned numPages;
+    };
+
+    struct SubPlan {
+        std::vector<Step> steps;
+        unsigned long long tableSet;
+        double rows;
+        double cost;
+        double width;
+        // pages its joins need at least, never more than numPages
+        unsigned minPages;
+    };
+
+    RelationManager &rm;
+    unsigned numPages;
+
+    Query query;
+    std::vector<TableInfo> tables;
+    // table of the lhs and the rhs attribute of every condition, -1 for a value
+    std::vector<int> lhsTables;
+    std::vector<int> rhsTables;
+
+    int getTable(const std::string &attrName) const;
+    // position of an attribute in its table, -1 if unknown
+    int getAttrIndex(unsigned table, const std::string &attrName) const;
+    RC prepare(const Query &query);
+    void chooseAccess(TableInfo &table);
+    double getJoinSelectivity(const Condition &condition);
+
+    SubPlan getTablePlan(unsigned table) const;
+    // joins the table to the plan, the cost is infinite if they cannot be joined
+    SubPlan extendPlan(const SubPlan &plan, unsigned table, unsigned available);
+    bool searchPlan(SubPlan &best);
+    // pages a step cannot run with less of, 0 if it needs no memory of its own
+    static unsigned getMinPages(JoinMethod method);
+    void grantMemory(SubPlan &plan);
+
+    // the condition as the join gets it, its lhs on the left input
+    Condition getJoinCondition(unsigned condition, unsigned long long leftSet) const;
+    Predicate getLocalPredicate(unsigned table) const;
+    std::vector<std::string> getNeededAttrs(unsigned table) const;
+    unsigned buildAccess(const Step &step, QueryPlan &plan);
+    RC buildPlan(const SubPlan &best, QueryPlan &plan);
+};
 
 #endif
@@ -9,6 +9,8 @@ const int fail = -1;
 #include <fstream>
 #include <iostream>
 
+#include <algorithm>
+#include <string>
 #include <vector>
 
 #include <cstdlib>
@@ -1105,6 +1107,104 @@ int createIndexforGroupB() {
     return rm.createIndex("group", "B");
 }
 
+// a table of the given columns, a VarChar holds up to 30 characters
+int createJoinTable(const std::string &tableName, const std::vector<std::string> &names,
+                    const std::vector<AttrType> &types) {
+    vector<Attribute> attrs;
+    for (unsigned i = 0; i < names.size(); i++) {
+        Attribute attr;
+        attr.name = names[i];
+        attr.type = types[i];
+        attr.length = types[i] == TypeVarChar ? 30 : 4;
+        attrs.push_back(attr);
+    }
+    return rm.createTable(tableName, attrs);
+}
+
+// insert (a, b, n) into a table of INT, INT and VarChar columns, b may be NULL
+int insertJoinTuple(const std::string &tableName, int a, int b, bool bIsNull, const std::string &n) {
+    char buf[PAGE_SIZE];
+    unsigned char nullsIndicator = bIsNull ? 0x40 : 0;
+    int offset = 0;
+    memcpy(buf + offset, &nullsIndicator, 1);
+    offset += 1;
+    memcpy(buf + offset, &a, sizeof(int));
+    offset += sizeof(int);
+    if (!bIsNull) {
+        memcpy(buf + offset, &b, sizeof(int));
+        offset += sizeof(int);
+    }
+    unsigned length = n.size();
+    memcpy(buf + offset, &length, sizeof(unsigned));
+    offset += sizeof(unsigned);
+    memcpy(buf + offset, n.c_str(), length);
+
+    RID rid;
+    return rm.insertTuple(tableName, buf, rid);
+}
+
+// every tuple of the table as it comes out of a TableScan
+void readTable(const std::string &tableName, std::vector<std::string> &tuples) {
+    TableScan ts(rm, tableName);
+    std::vector<Attribute> attrs;
+    ts.getAttributes(attrs);
+    void *data = malloc(PAGE_SIZE);
+    while (ts.getNextTuple(data) != QE_EOF) {
+        tuples.emplace_back((char *) data, Iterator::getTupleLength(attrs, data));
+    }
+    free(data);
+}
+
+// whether op holds for two values that compare as comparison
+bool satisfiesCompOp(int comparison, CompOp op) {
+    switch (op) {
+        case EQ_OP:
+            return comparison == 0;
+        case LT_OP:
+            return comparison < 0;
+        case LE_OP:
+            return comparison <= 0;
+        case GT_OP:
+            return comparison > 0;
+        case GE_OP:
+            return comparison >= 0;
+        case NE_OP:
+            return comparison != 0;
+        default:
+            return true;
+    }
+}
+
+// every joined tuple, sorted, by a nested loop over both tables. NULL keys never join
+void expectedJoin(const std::string &leftTable, const std::string &rightTable, int leftIndex, int rightIndex,
+                  CompOp op, std::vector<std::string> &result) {
+    std::vector<std::string> leftTuples, rightTuples;
+    readTable(leftTable, leftTuples);
+    readTable(rightTable, rightTuples);
+    std::vector<Attribute> leftAttrs, rightAttrs;
+    rm.getAttributes(leftTable, leftAttrs);
+    rm.getAttributes(rightTable, rightAttrs);
+
+    std::vector<const char *> rightKeys;
+    for (auto &right : rightTuples) {
+        rightKeys.push_back(Iterator::getAttributePointer(right.data(), rightAttrs, rightIndex));
+    }
+    char data[PAGE_SIZE];
+    for (auto &left : leftTuples) {
+        const char *leftKey = Iterator::getAttributePointer(left.data(), leftAttrs, leftIndex);
+        for (unsigned i = 0; i < rightTuples.size() && leftKey != nullptr; i++) {
+            if (rightKeys[i] == nullptr ||
+                !satisfiesCompOp(Iterator::compareAttribute(leftKey, rightKeys[i], leftAttrs[leftIndex].type), op)) {
+                continue;
+            }
+            unsigned length = Iterator::concatenateTuple(data, (void *) left.data(), (void *) rightTuples[i].data(),
+                                                         leftAttrs, rightAttrs);
+            result.emplace_back(data, length);
+        }
+    }
+    std::sort(result.begin(), result.end());
+}
+
 int deleteAndCreateCatalog() {
     // Try to delete the System Catalog.
     // If this is the first time, it will generate an error. It's OK and we will ignore that.
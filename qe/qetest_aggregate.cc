@@ -0,0 +1,287 @@
+#include <map>
+#include <unistd.h>
+#include "qe_test_util.h"
+
+// Number of tuples in the aggregation table
+const int aggTupleCount = 3000;
+// C starts above 2^24, a float cannot count up from there
+const int aggLargeValue = 16777217;
+
+int createAggregateTable() {
+    vector<Attribute> attrs;
+    Attribute attr;
+
+    attr.name = "A";
+    attr.type = TypeInt;
+    attr.length = 4;
+    attrs.push_back(attr);
+    attr.name = "B";
+    attr.type = TypeVarChar;
+    attr.length = 30;
+    attrs.push_back(attr);
+    attr.name = "C";
+    attr.type = TypeInt;
+    attr.length = 4;
+    attrs.push_back(attr);
+    attr.name = "D";
+    attr.type = TypeReal;
+    attr.length = 4;
+    attrs.push_back(attr);
+    return rm.createTable("aggtable", attrs);
+}
+
+int populateAggregateTable() {
+    RC rc = success;
+    RID rid;
+    void *buf = malloc(bufSize);
+
+    for (int i = 0; i < aggTupleCount && rc == success; i++) {
+        // a in [0, 6], b in 5 names, every 13th d and every 100th b is NULL
+        int a = i % 7;
+        std::string b = "group_" + std::to_string(i % 5);
+        int c = aggLargeValue + i;
+        float d = (float) i / 2;
+        unsigned char nullsIndicator = (i % 100 == 99 ? 0x40 : 0) | (i % 13 == 12 ? 0x10 : 0);
+
+        int offset = 0;
+        memcpy((char *) buf + offset, &nullsIndicator, 1);
+        offset += 1;
+        memcpy((char *) buf + offset, &a, sizeof(int));
+        offset += sizeof(int);
+        if (!(nullsIndicator & 0x40)) {
+            unsigned length = b.size();
+            memcpy((char *) buf + offset, &length, sizeof(unsigned));
+            offset += sizeof(unsigned);
+            memcpy((char *) buf + offset, b.c_str(), length);
+            offset += length;
+        }
+        memcpy((char *) buf + offset, &c, sizeof(int));
+        offset += sizeof(int);
+        if (!(nullsIndicator & 0x10)) {
+            memcpy((char *) buf + offset, &d, sizeof(float));
+        }
+        rc = rm.insertTuple("aggtable", buf, rid);
+    }
+    free(buf);
+    return rc;
+}
+
+// the aggregates of one group, computed exactly
+struct ExpectedGroup {
+    int countD = 0;
+    int64_t sumC = 0;
+    int countC = 0;
+    double sumD = 0;
+    double minD = 1e30;
+    double maxD = -1e30;
+};
+
+// group key as text, NULL b is written as "NULL"
+void expectedGroups(std::map<std::string, ExpectedGroup> &groups) {
+    TableScan ts(rm, "aggtable");
+    std::vector<Attribute> attrs;
+    ts.getAttributes(attrs);
+    void *data = malloc(PAGE_SIZE);
+    while (ts.getNextTuple(data) != QE_EOF) {
+        const char *a = Iterator::getAttributePointer(data, attrs, 0);
+        const char *b = Iterator::getAttributePointer(data, attrs, 1);
+        const char *c = Iterator::getAttributePointer(data, attrs, 2);
+        const char *d = Iterator::getAttributePointer(data, attrs, 3);
+        std::string key = std::to_string(*(int *) a) + "|" +
+                          (b == nullptr ? "NULL" : std::string(b + sizeof(unsigned), *(unsigned *) b));
+        ExpectedGroup &group = groups[key];
+        group.countC++;
+        group.sumC += *(int *) c;
+        if (d != nullptr) {
+            group.countD++;
+            group.sumD += *(float *) d;
+            group.minD = std::min(group.minD, (double) *(float *) d);
+            group.maxD = std::max(group.maxD, (double) *(float *) d);
+        }
+    }
+    free(data);
+}
+
+RC testCase_Aggregate() {
+    // Functions Tested
+    // 1. Aggregate grouped by an INT and a VarChar attribute, NULL is a group of its own
+    // 2. Several aggregates in one pass, NULL values left out, INT sums above 2^24 stay exact
+    // 3. Aggregate over an empty input, one group with COUNT 0 and NULL for the others
+    std::cerr << std::endl << "***** In QE Test Case Aggregate *****" << std::endl;
+    RC rc = success;
+
+    std::map<std::string, ExpectedGroup> expected;
+    expectedGroups(expected);
+
+    // 1. and 2.
+    auto *input = new TableScan(rm, "aggtable");
+    std::vector<Attribute> attrs;
+    input->getAttributes(attrs);
+    std::vector<Attribute> groupAttrs {attrs[0], attrs[1]};
+    std::vector<AggregateFunction> functions {{attrs[3], COUNT}, {attrs[2], SUM}, {attrs[2], AVG},
+                                              {attrs[3], MIN}, {attrs[3], MAX}, {attrs[3], SUM}};
+    auto *agg = new Aggregate(input, groupAttrs, functions);
+
+    std::vector<Attribute> outputAttrs;
+    agg->getAttributes(outputAttrs);
+    if (outputAttrs.size() != 8 || outputAttrs[1].name != "aggtable.B" || outputAttrs[4].name != "AVG(aggtable.C)" ||
+        outputAttrs[4].type != TypeReal) {
+        std::cerr << "***** The output attributes are wrong. *****" << std::endl;
+        rc = fail;
+    }
+
+    unsigned groups = 0;
+    TupleBatch batch;
+    while (agg->getNextBatch(batch) != QE_EOF) {
+        for (unsigned i = 0; i < batch.size(); i++, groups++) {
+            void *data = batch.getTuple(i);
+            const char *a = Iterator::getAttributePointer(data, outputAttrs, 0);
+            const char *b = Iterator::getAttributePointer(data, outputAttrs, 1);
+            std::string key = std::to_string(*(int *) a) + "|" +
+                              (b == nullptr ? "NULL" : std::string(b + sizeof(unsigned), *(unsigned *) b));
+            if (expected.count(key) == 0) {
+                std::cerr << "***** Unexpected group " << key << ". *****" << std::endl;
+                rc = fail;
+                continue;
+            }
+            ExpectedGroup &group = expected[key];
+            float values[6] = {(float) group.countD, (float) group.sumC, (float) ((double) group.sumC / group.countC),
+                               (float) group.minD, (float) group.maxD, (float) group.sumD};
+            for (int j = 0; j < 6; j++) {
+                const char *value = Iterator::getAttributePointer(data, outputAttrs, 2 + j);
+                if (value == nullptr || *(float *) value != values[j]) {
+                    std::cerr << "***** Group " << key << " has " << outputAttrs[2 + j].name << " "
+                              << (value == nullptr ? 0 : *(float *) value) << ", expected " << values[j] << ". *****"
+                              << std::endl;
+                    rc = fail;
+                }
+            }
+            if (batch.getTupleLength(i) != agg->getOutputLength(data)) {
+                rc = fail;
+            }
+        }
+    }
+    if (groups != expected.size() || agg->getNumberOfGroups() != expected.size()) {
+        std::cerr << "***** Aggregate returned " << groups << " groups, expected " << expected.size() << ". *****"
+                  << std::endl;
+        rc = fail;
+    }
+    delete agg;
+    delete input;
+
+    // 3. no a is above 100
+    input = new TableScan(rm, "aggtable");
+    int limit = 100;
+    Condition cond;
+    cond.lhsAttr = "aggtable.A";
+    cond.op = GT_OP;
+    cond.bRhsIsAttr = false;
+    cond.rhsValue.type = TypeInt;
+    cond.rhsValue.data = &limit;
+    auto *filter = new Filter(input, cond);
+    agg = new Aggregate(filter, std::vector<Attribute>(), {{attrs[2], COUNT}, {attrs[2], MIN}});
+    void *data = malloc(PAGE_SIZE);
+    if (agg->getNextTuple(data) != success || *(unsigned char *) data != 0x40 ||
+        *(float *) ((char *) data + 1) != 0 || agg->getNextTuple(data) != QE_EOF) {
+        std::cerr << "***** Aggregate over an empty input is wrong. *****" << std::endl;
+        rc = fail;
+    }
+    free(data);
+    delete agg;
+    delete filter;
+    delete input;
+    return rc;
+}
+
+// every group of the aggregate keyed by its first attribute
+void readGroups(Aggregate *agg, std::map<std::string, std::string> &groups) {
+    std::vector<Attribute> attrs;
+    agg->getAttributes(attrs);
+    void *data = malloc(PAGE_SIZE);
+    while (agg->getNextTuple(data) != QE_EOF) {
+        std::string key((char *) data + 1, sizeof(int));
+        groups[key] = std::string((char *) data, Iterator::getTupleLength(attrs, data));
+    }
+    free(data);
+}
+
+RC testCase_AggregateSpill() {
+    // Functions Tested
+    // 1. Aggregate with a page budget, the groups spill to partitions which spill again when merged
+    // 2. The result equals the one of the unbounded aggregate, no partition file is left behind
+    std::cerr << std::endl << "***** In QE Test Case Aggregate with spills *****" << std::endl;
+    RC rc = success;
+
+    std::vector<Attribute> attrs;
+    rm.getAttributes("aggtable", attrs);
+    for (auto &attr : attrs) {
+        attr.name = "aggtable." + attr.name;
+    }
+    // c is distinct, every tuple is a group
+    std::vector<Attribute> groupAttrs {attrs[2]};
+    std::vector<AggregateFunction> functions {{attrs[3], COUNT}, {attrs[3], SUM}, {attrs[0], MAX}};
+
+    std::map<std::string, std::string> expected, actual;
+    auto *input = new TableScan(rm, "aggtable");
+    auto *agg = new Aggregate(input, groupAttrs, functions);
+    readGroups(agg, expected);
+    if (agg->getNumberOfSpills() != 0) {
+        rc = fail;
+    }
+    delete agg;
+
+    // 1. and 2.
+    input->setIterator();
+    agg = new Aggregate(input, groupAttrs, functions, 4);
+    readGroups(agg, actual);
+    if (expected.size() != (unsigned) aggTupleCount || actual != expected || agg->getNumberOfSpills() == 0 ||
+        agg->getNumberOfLevels() < 2) {
+        std::cerr << "***** Aggregate with 4 pages returned " << actual.size() << " groups, expected "
+                  << expected.size() << ", " << agg->getNumberOfSpills() << " spills on "
+                  << agg->getNumberOfLevels() << " levels. *****" << std::endl;
+        rc = fail;
+    }
+    delete agg;
+
+    // stopping early removes the partitions too
+    input->setIterator();
+    agg = new Aggregate(input, groupAttrs, functions, 4);
+    void *data = malloc(PAGE_SIZE);
+    agg->getNextTuple(data);
+    free(data);
+    delete agg;
+    delete input;
+    for (unsigned i = 0; i < 1000 && rc == success; i++) {
+        if (access((QE_AGGREGATE_PARTITION_PREFIX + std::to_string(i)).c_str(), F_OK) == 0) {
+            std::cerr << "***** A partition file is left behind. *****" << std::endl;
+            rc = fail;
+        }
+    }
+    return rc;
+}
+
+int main() {
+    // Tables created: aggtable
+    // Indexes created: none
+
+    rm.deleteTable("aggtable");
+    if (createAggregateTable() != success || populateAggregateTable() != success) {
+        std::cerr << "***** Creating the aggregation table failed." << std::endl;
+        std::cerr << "***** [FAIL] QE Test Case Aggregate failed. *****" << std::endl;
+        return fail;
+    }
+
+    RC rc = testCase_Aggregate();
+    if (testCase_AggregateSpill() != success) {
+        rc = fail;
+    }
+    rm.deleteTable("aggtable");
+
+    if (rc != success) {
+        std::cerr << "***** [FAIL] QE Test Case Aggregate failed. *****" << std::endl;
+        return fail;
+    } else {
+        std::cerr << "***** QE Test Case Aggregate finished. The result will be examined. *****" << std::endl;
+        return success;
+    }
+}
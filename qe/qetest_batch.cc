@@ -0,0 +1,262 @@
+#include <algorithm>
+#include "qe_test_util.h"
+
+// Number of tuples in each of the batch tables
+const int batchTupleCount = 1000;
+
+// Iterator that only implements getNextTuple, goes through the default getNextBatch
+class LegacyIterator : public Iterator {
+public:
+    Iterator *input;
+
+    explicit LegacyIterator(Iterator *input) : input(input) {};
+
+    RC getNextTuple(void *data) override {
+        return input->getNextTuple(data);
+    };
+
+    void getAttributes(std::vector<Attribute> &attrs) const override {
+        input->getAttributes(attrs);
+    };
+};
+
+int createBatchTables() {
+    vector<Attribute> attrs;
+    Attribute attr;
+    attr.length = 4;
+
+    attr.name = "A";
+    attr.type = TypeInt;
+    attrs.push_back(attr);
+    attr.name = "B";
+    attr.type = TypeInt;
+    attrs.push_back(attr);
+    attr.name = "C";
+    attr.type = TypeReal;
+    attrs.push_back(attr);
+    RC rc = rm.createTable("batchleft", attrs);
+    if (rc != success) {
+        return rc;
+    }
+
+    attrs.clear();
+    attr.name = "B";
+    attr.type = TypeInt;
+    attrs.push_back(attr);
+    attr.name = "C";
+    attr.type = TypeReal;
+    attrs.push_back(attr);
+    attr.name = "D";
+    attr.type = TypeInt;
+    attrs.push_back(attr);
+    return rm.createTable("batchright", attrs);
+}
+
+int populateBatchTables() {
+    RC rc = success;
+    RID rid;
+    void *buf = malloc(bufSize);
+    unsigned char nullsIndicator = 0;
+
+    for (int i = 0; i < batchTupleCount && rc == success; i++) {
+        // b in [10, 509], every value twice
+        prepareLeftTuple(3, &nullsIndicator, i, i % 500 + 10, (float) i, buf);
+        rc = rm.insertTuple("batchleft", buf, rid);
+    }
+    for (int i = 0; i < batchTupleCount && rc == success; i++) {
+        // b in [200, 1199]
+        prepareRightTuple(3, &nullsIndicator, i + 200, (float) i, i, buf);
+        rc = rm.insertTuple("batchright", buf, rid);
+    }
+    free(buf);
+    if (rc != success) {
+        return rc;
+    }
+    return rm.createIndex("batchright", "B");
+}
+
+// plan 0: TableScan, 1: IndexScan, 2: Filter, 3: Project over Filter,
+// 4: BNLJoin, 5: INLJoin, 6: GHJoin, 7: Aggregate, 8: default adapter
+const int numPlans = 9;
+
+Iterator *buildPlan(int plan, std::vector<Iterator *> &owned, Condition &filterCond, Condition &joinCond) {
+    Iterator *it = nullptr;
+    auto *left = new TableScan(rm, "batchleft");
+    owned.push_back(left);
+    switch (plan) {
+        case 0:
+            return left;
+        case 1:
+            it = new IndexScan(rm, "batchright", "B");
+            break;
+        case 2:
+            it = new Filter(left, filterCond);
+            break;
+        case 3: {
+            auto *filter = new Filter(left, filterCond);
+            owned.push_back(filter);
+            it = new Project(filter, {"batchleft.C", "batchleft.A"});
+            break;
+        }
+        case 4: {
+            auto *right = new TableScan(rm, "batchright");
+            owned.push_back(right);
+            it = new BNLJoin(left, right, joinCond, 5);
+            break;
+        }
+        case 5: {
+            auto *right = new IndexScan(rm, "batchright", "B");
+            owned.push_back(right);
+            it = new INLJoin(left, right, joinCond);
+            break;
+        }
+        case 6: {
+            auto *right = new TableScan(rm, "batchright");
+            owned.push_back(right);
+            it = new GHJoin(left, right, joinCond, 4);
+            break;
+        }
+        case 7: {
+            Attribute aggAttr;
+            aggAttr.name = "batchleft.C";
+            aggAttr.type = TypeReal;
+            aggAttr.length = 4;
+            it = new Aggregate(left, aggAttr, MAX);
+            break;
+        }
+        default:
+            it = new LegacyIterator(left);
+            break;
+    }
+    owned.push_back(it);
+    return it;
+}
+
+void deletePlan(std::vector<Iterator *> &owned) {
+    // parents first, they may still reference their inputs
+    for (auto it = owned.rbegin(); it != owned.rend(); it++) {
+        delete *it;
+    }
+    owned.clear();
+}
+
+void collectTuples(Iterator *it, std::vector<std::string> &tuples) {
+    std::vector<Attribute> attrs;
+    it->getAttributes(attrs);
+    void *data = malloc(PAGE_SIZE);
+    while (it->getNextTuple(data) != QE_EOF) {
+        tuples.emplace_back((char *) data, Iterator::getTupleLength(attrs, data));
+    }
+    free(data);
+}
+
+void collectBatches(Iterator *it, unsigned maxTuples, std::vector<std::string> &tuples, bool &failed) {
+    TupleBatch batch;
+    while (it->getNextBatch(batch, maxTuples) != QE_EOF) {
+        if (batch.empty() || batch.size() > maxTuples) {
+            failed = true;
+        }
+        for (unsigned i = 0; i < batch.size(); i++) {
+            tuples.emplace_back((char *) batch.getTuple(i), batch.getTupleLength(i));
+        }
+    }
+}
+
+RC testCase_Batch() {
+    // Functions Tested
+    // getNextBatch of every operator returns the same tuples as getNextTuple,
+    // with small and default batch sizes
+    std::cerr << std::endl << "***** In QE Test Case Batch *****" << std::endl;
+    RC rc = success;
+
+    Condition filterCond;
+    filterCond.lhsAttr = "batchleft.B";
+    filterCond.op = LE_OP;
+    filterCond.bRhsIsAttr = false;
+    Value value{};
+    value.type = TypeInt;
+    value.data = malloc(bufSize);
+    *(int *) value.data = 300;
+    filterCond.rhsValue = value;
+
+    Condition joinCond;
+    joinCond.lhsAttr = "batchleft.B";
+    joinCond.op = EQ_OP;
+    joinCond.bRhsIsAttr = true;
+    joinCond.rhsAttr = "batchright.B";
+
+    // b <= 300 hits 291 of every 500 tuples, 310 b values are on both sides
+    size_t expectedCounts[numPlans] = {1000, 1000, 582, 582, 620, 620, 620, 1, 1000};
+
+    std::vector<Iterator *> owned;
+    for (int plan = 0; plan < numPlans && rc == success; plan++) {
+        std::vector<std::string> expected;
+        collectTuples(buildPlan(plan, owned, filterCond, joinCond), expected);
+        deletePlan(owned);
+        std::sort(expected.begin(), expected.end());
+
+        for (unsigned maxTuples : {7u, (unsigned) QE_BATCH_SIZE}) {
+            std::vector<std::string> actual;
+            bool failed = false;
+            collectBatches(buildPlan(plan, owned, filterCond, joinCond), maxTuples, actual, failed);
+            deletePlan(owned);
+            std::sort(actual.begin(), actual.end());
+
+            if (failed || expected.size() != expectedCounts[plan] || actual != expected) {
+                std::cerr << "***** Plan " << plan << " returned " << actual.size() << " tuples in batches of "
+                          << maxTuples << ", expected " << expected.size() << ". *****" << std::endl;
+                rc = fail;
+            }
+        }
+    }
+
+    // tuple and batch calls can be mixed on the same operator
+    if (rc == success) {
+        std::vector<std::string> actual;
+        bool failed = false;
+        Iterator *it = buildPlan(2, owned, filterCond, joinCond);
+        TupleBatch batch;
+        it->getNextBatch(batch, 5);
+        actual.resize(batch.size());
+        void *data = malloc(PAGE_SIZE);
+        for (int i = 0; i < 3 && it->getNextTuple(data) != QE_EOF; i++) {
+            actual.emplace_back("");
+        }
+        free(data);
+        collectBatches(it, QE_BATCH_SIZE, actual, failed);
+        deletePlan(owned);
+        if (failed || actual.size() != expectedCounts[2]) {
+            std::cerr << "***** Mixing getNextTuple and getNextBatch returned " << actual.size()
+                      << " tuples. *****" << std::endl;
+            rc = fail;
+        }
+    }
+
+    free(value.data);
+    return rc;
+}
+
+int main() {
+    // Tables created: batchleft, batchright
+    // Indexes created: batchright.B
+
+    rm.deleteTable("batchleft");
+    rm.deleteTable("batchright");
+    if (createBatchTables() != success || populateBatchTables() != success) {
+        std::cerr << "***** Creating the batch tables failed." << std::endl;
+        std::cerr << "***** [FAIL] QE Test Case Batch failed. *****" << std::endl;
+        return fail;
+    }
+
+    RC rc = testCase_Batch();
+    rm.deleteTable("batchleft");
+    rm.deleteTable("batchright");
+
+    if (rc != success) {
+        std::cerr << "***** [FAIL] QE Test Case Batch failed. *****" << std::endl;
+        return fail;
+    } else {
+        std::cerr << "***** QE Test Case Batch finished. The result will be examined. *****" << std::endl;
+        return success;
+    }
+}
@@ -0,0 +1,131 @@
+#include <sstream>
+#include "qe_test_util.h"
+
+RC testCase_Explain() {
+    // Functions Tested
+    // 1. Rows and calls of every operator of a profiled Project over Filter over GHJoin over two scans
+    // 2. Page reads are attributed to the scans, and an operator includes the reads of its inputs
+    // 3. The operator tree printed by explain, with and without the statistics, and what a scan had pushed into it
+    // 4. Iterators created while profiling is off count nothing until setProfiling
+    std::cerr << std::endl << "***** In QE Test Case Explain *****" << std::endl;
+    RC rc = success;
+
+    // left.B = right.B for a in [10, 99], then left.A < 50 keeps a in [10, 49]
+    Iterator::profileNewIterators = true;
+    auto *leftIn = new TableScan(rm, "left");
+    auto *rightIn = new TableScan(rm, "right");
+    Condition joinCondition;
+    joinCondition.lhsAttr = "left.B";
+    joinCondition.op = EQ_OP;
+    joinCondition.bRhsIsAttr = true;
+    joinCondition.rhsAttr = "right.B";
+    auto *join = new GHJoin(leftIn, rightIn, joinCondition, 10);
+    int value = 50;
+    auto *filter = new Filter(join, Predicate::compare("left.A", LT_OP, TypeInt, &value));
+    auto *project = new Project(filter, {"left.A", "right.D"});
+    Iterator::profileNewIterators = false;
+
+    // 1. a tuple at a time, the last call returns QE_EOF
+    char data[PAGE_SIZE];
+    unsigned count = 0;
+    while (project->getNextTuple(data) != QE_EOF) {
+        count++;
+    }
+    const IteratorStatistics &projectStatistics = project->getStatistics();
+    if (count != 40 || projectStatistics.rows != 40 || projectStatistics.calls != 41 ||
+        filter->getStatistics().rows != 40 || join->getStatistics().rows != 90 ||
+        leftIn->getStatistics().rows != 100 || rightIn->getStatistics().rows != 100) {
+        std::cerr << "***** Expected rows 40, 40, 90, 100, 100, got " << projectStatistics.rows << ", "
+                  << filter->getStatistics().rows << ", " << join->getStatistics().rows << ", "
+                  << leftIn->getStatistics().rows << ", " << rightIn->getStatistics().rows << ". *****" << std::endl;
+        rc = fail;
+    }
+
+    // 2.
+    if (leftIn->getStatistics().pageReads == 0 || rightIn->getStatistics().pageReads == 0 ||
+        join->getStatistics().pageReads < rightIn->getStatistics().pageReads ||
+        projectStatistics.wallTime < filter->getStatistics().wallTime) {
+        std::cerr << "***** The page reads and times are not attributed to the operators. *****" << std::endl;
+        rc = fail;
+    }
+
+    // 3.
+    std::stringstream plan;
+    project->explain(plan, false);
+    std::string expected = "Project left.A, right.D\n"
+                           "  Filter left.A < 50\n"
+                           "    GHJoin left.B = right.B\n"
+                           "      TableScan left\n"
+                           "      TableScan right\n";
+    if (plan.str() != expected) {
+        std::cerr << "***** Unexpected plan:" << std::endl << plan.str() << "*****" << std::endl;
+        rc = fail;
+    }
+    std::stringstream analyzed;
+    project->explain(analyzed, true);
+    if (analyzed.str().find("Project left.A, right.D (calls=41 rows=40 ") != 0 ||
+        analyzed.str().find("  Filter left.A < 50 (calls=") == std::string::npos) {
+        std::cerr << "***** Unexpected analyzed plan:" << std::endl << analyzed.str() << "*****" << std::endl;
+        rc = fail;
+    }
+    TableScan pushed(rm, "left", Predicate::compare("left.A", LT_OP, TypeInt, &value), {"B", "A"});
+    if (pushed.getDescription() != "TableScan left WHERE A < 50 GET [ B, A ]") {
+        std::cerr << "***** Unexpected description " << pushed.getDescription() << ". *****" << std::endl;
+        rc = fail;
+    }
+    delete project;
+    delete filter;
+    delete join;
+    delete leftIn;
+    delete rightIn;
+
+    // 4. in batches, the sort read its input before it was profiled
+    auto *scan = new TableScan(rm, "left");
+    auto *sort = new Sort(scan, {{"left.B", false}}, 3);
+    if (sort->isProfiling() || sort->getStatistics().wallTime != 0 || scan->getStatistics().rows != 0) {
+        std::cerr << "***** An iterator counted while it was not profiled. *****" << std::endl;
+        rc = fail;
+    }
+    sort->setProfiling(true);
+    TupleBatch batch;
+    count = 0;
+    while (sort->getNextBatch(batch) != QE_EOF) {
+        count += batch.size();
+    }
+    if (!scan->isProfiling() || scan->getStatistics().rows != 0 || count != 100 ||
+        sort->getStatistics().rows != 100 || sort->getStatistics().calls < 2 ||
+        sort->getDescription() != "Sort left.B DESC") {
+        std::cerr << "***** The sort returned " << sort->getStatistics().rows << " rows in "
+                  << sort->getStatistics().calls << " calls. *****" << std::endl;
+        rc = fail;
+    }
+    delete sort;
+    delete scan;
+    return rc;
+}
+
+int main() {
+    // Tables created: left, right
+    // Indexes created: none
+
+    rm.deleteTable("left");
+    rm.deleteTable("right");
+    if (createLeftTable() != success || populateLeftTable() != success ||
+        createRightTable() != success || populateRightTable() != success) {
+        std::cerr << "***** Creating the tables failed." << std::endl;
+        std::cerr << "***** [FAIL] QE Test Case Explain failed. *****" << std::endl;
+        return fail;
+    }
+
+    RC rc = testCase_Explain();
+    rm.deleteTable("left");
+    rm.deleteTable("right");
+
+    if (rc != success) {
+        std::cerr << "***** [FAIL] QE Test Case Explain failed. *****" << std::endl;
+        return fail;
+    } else {
+        std::cerr << "***** QE Test Case Explain finished. The result will be examined. *****" << std::endl;
+        return success;
+    }
+}
@@ -0,0 +1,124 @@
+#include <algorithm>
+#include "qe_test_util.h"
+
+// Number of tuples in each of the hash join tables
+const int hashTupleCount = 2000;
+
+int populateHashJoinTable(const std::string &tableName, int keyStep) {
+    RC rc = success;
+    for (int i = 0; i < hashTupleCount && rc == success; i++) {
+        // b in [0, 399] and n in 37 names, both repeat, every 40th b is NULL
+        rc = insertJoinTuple(tableName, i, (i * keyStep) % 400, i % 40 == 39,
+                             "name_" + std::to_string((i * keyStep) % 37));
+    }
+    return rc;
+}
+
+RC testCase_GHJoin() {
+    // Functions Tested
+    // 1. GHJoin with every partition in memory
+    // 2. GHJoin with spilled partitions, duplicate keys on both sides
+    //    the spilled partitions of R are larger than the memory, they are joined in blocks
+    // 3. GHJoin on a VarChar attribute, read in batches
+    std::cerr << std::endl << "***** In QE Test Case GHJoin *****" << std::endl;
+    RC rc = success;
+
+    Condition cond;
+    cond.lhsAttr = "hashleft.B";
+    cond.op = EQ_OP;
+    cond.bRhsIsAttr = true;
+    cond.rhsAttr = "hashright.B";
+
+    std::vector<std::string> expected;
+    expectedJoin("hashleft", "hashright", 1, 1, EQ_OP, expected);
+
+    // 1. and 2.
+    for (unsigned numPages : {100u, 3u}) {
+        auto *leftIn = new TableScan(rm, "hashleft");
+        auto *rightIn = new TableScan(rm, "hashright");
+        auto *join = new GHJoin(leftIn, rightIn, cond, numPages);
+        std::vector<Attribute> attrs;
+        join->getAttributes(attrs);
+        std::vector<std::string> actual;
+        void *data = malloc(PAGE_SIZE);
+        while (join->getNextTuple(data) != QE_EOF) {
+            actual.emplace_back((char *) data, Iterator::getTupleLength(attrs, data));
+        }
+        free(data);
+        std::sort(actual.begin(), actual.end());
+
+        bool spilled = join->getNumberOfSpills() > 0;
+        bool blocked = join->getNumberOfBlocks() > join->getNumberOfSpills();
+        if (expected.empty() || actual != expected || spilled != (numPages < 100) || blocked != spilled) {
+            std::cerr << "***** GHJoin with " << numPages << " pages returned " << actual.size()
+                      << " tuples, expected " << expected.size() << ", " << join->getNumberOfSpills() << " of "
+                      << join->getNumberOfPartitions() << " partitions spilled, joined in "
+                      << join->getNumberOfBlocks() << " blocks. *****" << std::endl;
+            rc = fail;
+        }
+        delete join;
+        delete leftIn;
+        delete rightIn;
+    }
+
+    // 3. n repeats every 37 tuples, a few pages each side
+    cond.lhsAttr = "hashleft.N";
+    cond.rhsAttr = "hashright.N";
+    expected.clear();
+    expectedJoin("hashleft", "hashright", 2, 2, EQ_OP, expected);
+    auto *leftIn = new TableScan(rm, "hashleft");
+    auto *rightIn = new TableScan(rm, "hashright");
+    auto *join = new GHJoin(leftIn, rightIn, cond, 4);
+    std::vector<std::string> actual;
+    TupleBatch batch;
+    while (join->getNextBatch(batch) != QE_EOF) {
+        for (unsigned i = 0; i < batch.size(); i++) {
+            actual.emplace_back((char *) batch.getTuple(i), batch.getTupleLength(i));
+        }
+    }
+    std::sort(actual.begin(), actual.end());
+    if (actual != expected || join->getNumberOfSpills() == 0) {
+        std::cerr << "***** GHJoin on VarChar returned " << actual.size() << " tuples, expected "
+                  << expected.size() << ". *****" << std::endl;
+        rc = fail;
+    }
+    delete join;
+    delete leftIn;
+    delete rightIn;
+
+    // every partition file is gone
+    FILE *file = fopen(QE_GHJOIN_PARTITION_PREFIX "0", "r");
+    if (file != nullptr) {
+        fclose(file);
+        std::cerr << "***** A partition file was left behind. *****" << std::endl;
+        rc = fail;
+    }
+    return rc;
+}
+
+int main() {
+    // Tables created: hashleft, hashright
+    // Indexes created: none
+
+    rm.deleteTable("hashleft");
+    rm.deleteTable("hashright");
+    if (createJoinTable("hashleft", {"A", "B", "N"}, {TypeInt, TypeInt, TypeVarChar}) != success ||
+        createJoinTable("hashright", {"D", "B", "N"}, {TypeInt, TypeInt, TypeVarChar}) != success ||
+        populateHashJoinTable("hashleft", 7) != success || populateHashJoinTable("hashright", 11) != success) {
+        std::cerr << "***** Creating the hash join tables failed." << std::endl;
+        std::cerr << "***** [FAIL] QE Test Case GHJoin failed. *****" << std::endl;
+        return fail;
+    }
+
+    RC rc = testCase_GHJoin();
+    rm.deleteTable("hashleft");
+    rm.deleteTable("hashright");
+
+    if (rc != success) {
+        std::cerr << "***** [FAIL] QE Test Case GHJoin failed. *****" << std::endl;
+        return fail;
+    } else {
+        std::cerr << "***** QE Test Case GHJoin finished. The result will be examined. *****" << std::endl;
+        return success;
+    }
+}
@@ -0,0 +1,224 @@
+#include <algorithm>
+#include <map>
+#include "qe_test_util.h"
+
+// Number of tuples in each of the hash table tables
+const int htTupleCount = 1500;
+
+int populateHashTableTable(const std::string &tableName, int keyStep, bool negativeZero) {
+    RC rc = success;
+    RID rid;
+    void *buf = malloc(bufSize);
+
+    for (int i = 0; i < htTupleCount && rc == success; i++) {
+        // c in 60 halves, every other 0 may be -0.0, n in 41 names, every 30th c and every 50th n is NULL
+        float c = (float) ((i * keyStep) % 60) / 2;
+        if (c == 0 && negativeZero && i % 2 == 1) {
+            c = -0.0f;
+        }
+        std::string n = "name_" + std::to_string((i * keyStep) % 41);
+        unsigned char nullsIndicator = (i % 30 == 29 ? 0x40 : 0) | (i % 50 == 49 ? 0x20 : 0);
+
+        int offset = 0;
+        memcpy((char *) buf + offset, &nullsIndicator, 1);
+        offset += 1;
+        memcpy((char *) buf + offset, &i, sizeof(int));
+        offset += sizeof(int);
+        if (!(nullsIndicator & 0x40)) {
+            memcpy((char *) buf + offset, &c, sizeof(float));
+            offset += sizeof(float);
+        }
+        if (!(nullsIndicator & 0x20)) {
+            unsigned length = n.size();
+            memcpy((char *) buf + offset, &length, sizeof(unsigned));
+            offset += sizeof(unsigned);
+            memcpy((char *) buf + offset, n.c_str(), length);
+        }
+        rc = rm.insertTuple(tableName, buf, rid);
+    }
+    free(buf);
+    return rc;
+}
+
+RC testCase_TupleHashTable() {
+    // Functions Tested
+    // 1. TupleHashTable on REAL keys, 0.0 and -0.0 are one key, a NULL key is a key of its own
+    // 2. TupleHashTable on VarChar keys, growing past many slots, chains in insertion order
+    std::cerr << std::endl << "***** In QE Test Case TupleHashTable *****" << std::endl;
+    RC rc = success;
+
+    std::vector<std::string> tuples;
+    readTable("htright", tuples);
+    std::vector<Attribute> attrs;
+    rm.getAttributes("htright", attrs);
+
+    // 1. and 2.
+    for (int attrIndex : {1, 2}) {
+        TupleHashTable table(attrs, attrIndex);
+        std::map<std::string, std::vector<unsigned>> expected;
+        for (unsigned i = 0; i < tuples.size(); i++) {
+            const char *key = Iterator::getAttributePointer(tuples[i].data(), attrs, attrIndex);
+            std::string keyString = "NULL";
+            if (key != nullptr && attrIndex == 1) {
+                keyString = std::to_string(*(float *) key + 0.0f);
+            } else if (key != nullptr) {
+                keyString = std::string(key + sizeof(unsigned), *(unsigned *) key);
+            }
+            expected[keyString].push_back(table.insert(tuples[i].data(), tuples[i].size()));
+        }
+
+        for (auto &it : expected) {
+            std::vector<unsigned> actual;
+            const char *key = Iterator::getAttributePointer(table.getTuple(it.second[0]), attrs, attrIndex);
+            for (unsigned entry = table.find(key); entry != QE_HASH_END; entry = table.next(entry)) {
+                actual.push_back(entry);
+            }
+            if (actual != it.second) {
+                std::cerr << "***** Key " << it.first << " has " << actual.size() << " tuples, expected "
+                          << it.second.size() << ". *****" << std::endl;
+                rc = fail;
+            }
+        }
+        if (table.size() != tuples.size() || memcmp(table.getTuple(7), tuples[7].data(), tuples[7].size()) != 0) {
+            std::cerr << "***** The table lost a tuple. *****" << std::endl;
+            rc = fail;
+        }
+
+        float missing = 1000;
+        char missingName[] = "\x04\0\0\0nope";
+        if (table.find(attrIndex == 1 ? (char *) &missing : missingName) != QE_HASH_END) {
+            std::cerr << "***** A missing key was found. *****" << std::endl;
+            rc = fail;
+        }
+        table.clear();
+        if (table.size() != 0 || table.find(missingName) != QE_HASH_END) {
+            std::cerr << "***** The table is not empty after clear. *****" << std::endl;
+            rc = fail;
+        }
+    }
+    return rc;
+}
+
+RC testCase_BNLJoinDuplicates() {
+    // Functions Tested
+    // 1. BNLJoin on a REAL attribute with duplicate keys on both sides, several blocks
+    // 2. BNLJoin on a VarChar attribute
+    std::cerr << std::endl << "***** In QE Test Case BNLJoin on the hash table *****" << std::endl;
+    RC rc = success;
+
+    Condition cond;
+    cond.op = EQ_OP;
+    cond.bRhsIsAttr = true;
+
+    for (int attrIndex : {1, 2}) {
+        std::string attrName = attrIndex == 1 ? "C" : "N";
+        cond.lhsAttr = "htleft." + attrName;
+        cond.rhsAttr = "htright." + attrName;
+        std::vector<std::string> expected, actual;
+        expectedJoin("htleft", "htright", attrIndex, attrIndex, EQ_OP, expected);
+
+        auto *leftIn = new TableScan(rm, "htleft");
+        auto *rightIn = new TableScan(rm, "htright");
+        auto *join = new BNLJoin(leftIn, rightIn, cond, 4);
+        TupleBatch batch;
+        while (join->getNextBatch(batch) != QE_EOF) {
+            for (unsigned i = 0; i < batch.size(); i++) {
+                actual.emplace_back((char *) batch.getTuple(i), batch.getTupleLength(i));
+            }
+        }
+        std::sort(actual.begin(), actual.end());
+        delete join;
+        delete leftIn;
+        delete rightIn;
+
+        if (expected.empty() || actual != expected) {
+            std::cerr << "***** BNLJoin on " << attrName << " returned " << actual.size() << " tuples, expected "
+                      << expected.size() << ". *****" << std::endl;
+            rc = fail;
+        }
+    }
+    return rc;
+}
+
+RC testCase_GroupByKeys() {
+    // Functions Tested
+    // 1. Aggregate grouped by a REAL attribute keeps the exact key, 0.0 and -0.0 are one group, NULL is a group
+    std::cerr << std::endl << "***** In QE Test Case Group-by on the hash table *****" << std::endl;
+    RC rc = success;
+
+    std::vector<std::string> tuples;
+    readTable("htright", tuples);
+    std::vector<Attribute> attrs;
+    rm.getAttributes("htright", attrs);
+    std::map<std::string, int> expected;
+    for (auto &tuple : tuples) {
+        const char *key = Iterator::getAttributePointer(tuple.data(), attrs, 1);
+        // -0.0 + 0.0 is 0.0
+        float c = key == nullptr ? 0 : *(float *) key + 0.0f;
+        expected[key == nullptr ? std::string() : std::string((char *) &c, sizeof(float))]++;
+    }
+
+    auto *input = new TableScan(rm, "htright");
+    Attribute aggAttr = attrs[0];
+    aggAttr.name = "htright.D";
+    Attribute groupAttr = attrs[1];
+    groupAttr.name = "htright.C";
+    auto *agg = new Aggregate(input, aggAttr, groupAttr, COUNT);
+    std::map<std::string, int> actual;
+    void *data = malloc(PAGE_SIZE);
+    while (agg->getNextTuple(data) == success) {
+        bool isNull = *(unsigned char *) data & 0x80u;
+        float c = isNull ? 0 : *(float *) ((char *) data + 1) + 0.0f;
+        std::string key = isNull ? std::string() : std::string((char *) &c, sizeof(float));
+        float count;
+        memcpy(&count, (char *) data + 1 + (isNull ? 0 : sizeof(float)), sizeof(float));
+        actual[key] += (int) count;
+        if (agg->getOutputLength(data) != 1 + sizeof(float) * (isNull ? 1 : 2)) {
+            rc = fail;
+        }
+    }
+    free(data);
+    delete agg;
+    delete input;
+
+    if (actual != expected) {
+        std::cerr << "***** Group-by on C returned " << actual.size() << " groups, expected " << expected.size()
+                  << ". *****" << std::endl;
+        rc = fail;
+    }
+    return rc;
+}
+
+int main() {
+    // Tables created: htleft, htright
+    // Indexes created: none
+
+    rm.deleteTable("htleft");
+    rm.deleteTable("htright");
+    if (createJoinTable("htleft", {"A", "C", "N"}, {TypeInt, TypeReal, TypeVarChar}) != success ||
+        createJoinTable("htright", {"D", "C", "N"}, {TypeInt, TypeReal, TypeVarChar}) != success ||
+        populateHashTableTable("htleft", 7, false) != success ||
+        populateHashTableTable("htright", 11, true) != success) {
+        std::cerr << "***** Creating the hash table tables failed." << std::endl;
+        std::cerr << "***** [FAIL] QE Test Case TupleHashTable failed. *****" << std::endl;
+        return fail;
+    }
+
+    RC rc = testCase_TupleHashTable();
+    if (testCase_BNLJoinDuplicates() != success) {
+        rc = fail;
+    }
+    if (testCase_GroupByKeys() != success) {
+        rc = fail;
+    }
+    rm.deleteTable("htleft");
+    rm.deleteTable("htright");
+
+    if (rc != success) {
+        std::cerr << "***** [FAIL] QE Test Case TupleHashTable failed. *****" << std::endl;
+        return fail;
+    } else {
+        std::cerr << "***** QE Test Case TupleHashTable finished. The result will be examined. *****" << std::endl;
+        return success;
+    }
+}
@@ -0,0 +1,319 @@
+#include <algorithm>
+#include <sstream>
+#include "qe_test_util.h"
+
+// Number of tuples in the optimizer tables
+const int optACount = 3000;
+const int optBCount = 2000;
+const int optCCount = 50;
+
+// optA(K, V, N): k in [0, 2999] with an index, v = k % 50, n in 20 names
+// optB(K, W): k = i * 7 % 3000 without repeats, w = i / 2
+// optC(V, X): v in [0, 49], x = v * 2
+int createOptimizerTables() {
+    vector<Attribute> attrs;
+    Attribute attr;
+    attr.length = 4;
+
+    attr.name = "K";
+    attr.type = TypeInt;
+    attrs.push_back(attr);
+    attr.name = "V";
+    attrs.push_back(attr);
+    attr.name = "N";
+    attr.type = TypeVarChar;
+    attr.length = 20;
+    attrs.push_back(attr);
+    if (rm.createTable("optA", attrs) != success || rm.createIndex("optA", "K") != success) {
+        return fail;
+    }
+
+    attrs.clear();
+    attr.length = 4;
+    attr.name = "K";
+    attr.type = TypeInt;
+    attrs.push_back(attr);
+    attr.name = "W";
+    attr.type = TypeReal;
+    attrs.push_back(attr);
+    if (rm.createTable("optB", attrs) != success) {
+        return fail;
+    }
+
+    attrs.clear();
+    attr.name = "V";
+    attr.type = TypeInt;
+    attrs.push_back(attr);
+    attr.name = "X";
+    attrs.push_back(attr);
+    return rm.createTable("optC", attrs);
+}
+
+std::string getOptimizerName(int k) {
+    return "name_" + std::to_string(k % 20);
+}
+
+int populateOptimizerTables() {
+    RC rc = success;
+    RID rid;
+    char buf[PAGE_SIZE];
+    buf[0] = 0;
+
+    for (int i = 0; i < optACount && rc == success; i++) {
+        int v = i % 50;
+        std::string n = getOptimizerName(i);
+        unsigned length = n.size();
+        memcpy(buf + 1, &i, sizeof(int));
+        memcpy(buf + 1 + sizeof(int), &v, sizeof(int));
+        memcpy(buf + 1 + 2 * sizeof(int), &length, sizeof(unsigned));
+        memcpy(buf + 1 + 2 * sizeof(int) + sizeof(unsigned), n.c_str(), length);
+        rc = rm.insertTuple("optA", buf, rid);
+    }
+    for (int i = 0; i < optBCount && rc == success; i++) {
+        int k = i * 7 % optACount;
+        float w = (float) i / 2;
+        memcpy(buf + 1, &k, sizeof(int));
+        memcpy(buf + 1 + sizeof(int), &w, sizeof(float));
+        rc = rm.insertTuple("optB", buf, rid);
+    }
+    for (int i = 0; i < optCCount && rc == success; i++) {
+        int x = i * 2;
+        memcpy(buf + 1, &i, sizeof(int));
+        memcpy(buf + 1 + sizeof(int), &x, sizeof(int));
+        rc = rm.insertTuple("optC", buf, rid);
+    }
+    return rc;
+}
+
+RC testCase_Analyze() {
+    // Functions Tested
+    // 1. RelationManager::analyze counts rows, NULLs and distinct values, the histogram bounds are ordered
+    // 2. The statistics are stored in the catalog and read back from it
+    // 3. Selectivities from the histogram and the distinct values
+    std::cerr << std::endl << "***** In QE Test Case Analyze *****" << std::endl;
+    RC rc = success;
+
+    TableStatistics statistics;
+    if (rm.getStatistics("optA", statistics) != fail) {
+        std::cerr << "***** optA has statistics before it was analyzed. *****" << std::endl;
+        rc = fail;
+    }
+    if (rm.analyze("optA") != success || rm.analyze("optB") != success || rm.analyze("optC") != success ||
+        rm.analyze("optA") != success || rm.getStatistics("optA", statistics) != success) {
+        std::cerr << "***** Analyzing the tables failed. *****" << std::endl;
+        return fail;
+    }
+
+    // 1. k is estimated from its hashes, v is counted exactly
+    std::vector<ColumnStatistics> &columns = statistics.columns;
+    if (statistics.rowCount != (unsigned) optACount || statistics.pageCount == 0 || columns.size() != 3 ||
+        columns[0].distinctCount < optACount * 8 / 10 || columns[0].distinctCount > optACount ||
+        columns[1].distinctCount != 50 || columns[2].distinctCount != 20 || columns[0].nullCount != 0) {
+        std::cerr << "***** The statistics of optA are off, " << statistics.rowCount << " rows, "
+                  << (columns.empty() ? 0 : columns[0].distinctCount) << " distinct k. *****" << std::endl;
+        rc = fail;
+    }
+    for (auto const & column : columns) {
+        if (column.bounds.size() != STATISTICS_BUCKETS + 1) {
+            rc = fail;
+        }
+    }
+    for (unsigned i = 1; rc == success && i < columns[0].bounds.size(); i++) {
+        if (*(int *) columns[0].bounds[i - 1].data() > *(int *) columns[0].bounds[i].data()) {
+            std::cerr << "***** The histogram of optA.K is not ordered. *****" << std::endl;
+            rc = fail;
+        }
+    }
+    if (rc == success && (*(int *) columns[0].bounds.front().data() != 0 ||
+                          *(int *) columns[0].bounds.back().data() != optACount - 1)) {
+        std::cerr << "***** The histogram of optA.K misses the smallest or the largest k. *****" << std::endl;
+        rc = fail;
+    }
+
+    // 2. a row for the table and one per attribute, every table analyzed once
+    RM_ScanIterator iterator;
+    rm.scan(STATISTICS_NAME, "", NO_OP, NULL, {"table-name"}, iterator);
+    RID rid;
+    char data[PAGE_SIZE];
+    unsigned count = 0;
+    while (iterator.getNextTuple(rid, data) != RM_EOF) {
+        count++;
+    }
+    iterator.close();
+    rm.statisticsMap.clear();
+    rm.initScanStatistics();
+    TableStatistics stored;
+    if (count != 4 + 3 + 3 || rm.getStatistics("optA", stored) != success || stored.rowCount != statistics.rowCount ||
+        stored.pageCount != statistics.pageCount || stored.columns.size() != 3 ||
+        stored.columns[0].distinctCount != columns[0].distinctCount ||
+        stored.columns[2].bounds != columns[2].bounds) {
+        std::cerr << "***** The catalog holds " << count << " statistics rows, expected 10. *****" << std::endl;
+        rc = fail;
+    }
+
+    // 3. a tenth of k is below 300, v = 3 is one of 50
+    Optimizer optimizer(rm);
+    int value = 300;
+    Condition condition{"optA.K", LT_OP, false, "", {TypeInt, &value}};
+    double below = optimizer.getSelectivity("optA", condition);
+    value = 3;
+    condition.lhsAttr = "optA.V";
+    condition.op = EQ_OP;
+    double equal = optimizer.getSelectivity("optA", condition);
+    if (below < 0.07 || below > 0.13 || equal < 0.019 || equal > 0.021) {
+        std::cerr << "***** Selectivities " << below << " and " << equal << ", expected 0.1 and 0.02. *****"
+                  << std::endl;
+        rc = fail;
+    }
+    return rc;
+}
+
+// the tuples of the plan, sorted, as strings
+std::vector<std::string> getPlanTuples(QueryPlan &plan) {
+    std::vector<std::string> tuples;
+    std::vector<Attribute> attrs;
+    plan.getRoot()->getAttributes(attrs);
+    char data[PAGE_SIZE];
+    while (plan.getRoot()->getNextTuple(data) != QE_EOF) {
+        // only the bits of the attributes are set, at most 8 of them
+        data[0] &= (char) (0xff << (8 - attrs.size()));
+        tuples.emplace_back(data, Iterator::getTupleLength(attrs, data));
+    }
+    std::sort(tuples.begin(), tuples.end());
+    return tuples;
+}
+
+RC testCase_AccessPath() {
+    // Functions Tested
+    // 1. A selective condition on an indexed attribute reads the index
+    // 2. A condition on an attribute without an index is pushed into the TableScan
+    std::cerr << std::endl << "***** In QE Test Case Access Path *****" << std::endl;
+    RC rc = success;
+
+    Optimizer optimizer(rm);
+    QueryPlan plan;
+    int k = 42;
+    Query query{{"optA"}, {{"optA.K", EQ_OP, false, "", {TypeInt, &k}}}, {"optA.N"}};
+    std::stringstream ss;
+    if (optimizer.optimize(query, plan) != success) {
+        return fail;
+    }
+    plan.print(ss);
+    std::vector<std::string> tuples = getPlanTuples(plan);
+    std::string name = getOptimizerName(k);
+    unsigned length = name.size();
+    std::string expected = std::string(1, '\0') + std::string((char *) &length, sizeof(unsigned)) + name;
+    if (ss.str().find("IndexScan optA") == std::string::npos || tuples.size() != 1 || tuples[0] != expected) {
+        std::cerr << "***** The plan of k = 42 returned " << tuples.size() << " tuples:" << std::endl << ss.str();
+        rc = fail;
+    }
+
+    int v = 3;
+    query.conditions = {{"optA.V", EQ_OP, false, "", {TypeInt, &v}}};
+    query.attrNames.clear();
+    ss.str("");
+    if (optimizer.optimize(query, plan) != success) {
+        return fail;
+    }
+    plan.print(ss);
+    tuples = getPlanTuples(plan);
+    if (ss.str().find("TableScan optA WHERE optA.V = 3") == std::string::npos ||
+        tuples.size() != (unsigned) optACount / 50) {
+        std::cerr << "***** The plan of v = 3 returned " << tuples.size() << " tuples:" << std::endl << ss.str();
+        rc = fail;
+    }
+    return rc;
+}
+
+RC testCase_JoinOrder() {
+    // Functions Tested
+    // 1. A three way join in any order of the tables returns the same tuples, with plenty and with little memory
+    // 2. Tables without a join condition are not planned
+    std::cerr << std::endl << "***** In QE Test Case Join Order *****" << std::endl;
+    RC rc = success;
+
+    // w, n, x of optB joined with optA on k and with optC on v, x < 40
+    std::vector<std::string> expected;
+    for (int i = 0; i < optBCount; i++) {
+        int k = i * 7 % optACount;
+        int x = k % 50 * 2;
+        if (x >= 40) {
+            continue;
+        }
+        float w = (float) i / 2;
+        std::string n = getOptimizerName(k);
+        unsigned length = n.size();
+        expected.push_back(std::string(1, '\0') + std::string((char *) &w, sizeof(float)) +
+                           std::string((char *) &length, sizeof(unsigned)) + n +
+                           std::string((char *) &x, sizeof(int)));
+    }
+    std::sort(expected.begin(), expected.end());
+
+    int x = 40;
+    std::vector<Condition> conditions = {{"optA.K", EQ_OP, true, "optB.K", {}},
+                                         {"optC.V", EQ_OP, true, "optA.V", {}},
+                                         {"optC.X", LT_OP, false, "", {TypeInt, &x}}};
+    std::vector<std::vector<std::string>> orders = {{"optA", "optB", "optC"}, {"optC", "optB", "optA"}};
+    for (auto const & tableNames : orders) {
+        for (unsigned numPages : {(unsigned) QE_OPTIMIZER_PAGES, 3u}) {
+            Optimizer optimizer(rm, numPages);
+            QueryPlan plan;
+            Query query{tableNames, conditions, {"optB.W", "optA.N", "optC.X"}};
+            if (optimizer.optimize(query, plan) != success) {
+                std::cerr << "***** The join was not planned. *****" << std::endl;
+                return fail;
+            }
+            std::vector<std::string> actual = getPlanTuples(plan);
+            if (actual != expected) {
+                std::stringstream ss;
+                plan.print(ss);
+                std::cerr << "***** The join returned " << actual.size() << " tuples, expected " << expected.size()
+                          << ":" << std::endl << ss.str();
+                rc = fail;
+            }
+        }
+    }
+
+    // 2. optC is not joined
+    Optimizer optimizer(rm);
+    QueryPlan plan;
+    Query query{{"optA", "optB", "optC"}, {conditions[0]}, {}};
+    if (optimizer.optimize(query, plan) != fail || plan.getRoot() != nullptr) {
+        std::cerr << "***** A query without a join condition for optC was planned. *****" << std::endl;
+        rc = fail;
+    }
+    return rc;
+}
+
+int main() {
+    // Tables created: optA, optB, optC, Statistics
+    // Indexes created: optA.K
+
+    rm.deleteTable("optA");
+    rm.deleteTable("optB");
+    rm.deleteTable("optC");
+    if (createOptimizerTables() != success || populateOptimizerTables() != success) {
+        std::cerr << "***** Creating the optimizer tables failed." << std::endl;
+        std::cerr << "***** [FAIL] QE Test Case Optimizer failed. *****" << std::endl;
+        return fail;
+    }
+
+    RC rc = testCase_Analyze();
+    if (testCase_AccessPath() != success) {
+        rc = fail;
+    }
+    if (testCase_JoinOrder() != success) {
+        rc = fail;
+    }
+    rm.deleteTable("optA");
+    rm.deleteTable("optB");
+    rm.deleteTable("optC");
+
+    if (rc != success) {
+        std::cerr << "***** [FAIL] QE Test Case Optimizer failed. *****" << std::endl;
+        return fail;
+    } else {
+        std::cerr << "***** QE Test Case Optimizer finished. The result will be examined. *****" << std::endl;
+        return success;
+    }
+}
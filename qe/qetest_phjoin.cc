@@ -0,0 +1,125 @@
+#include <algorithm>
+#include "qe_test_util.h"
+
+// Number of tuples in the parallel join tables, most of phleft shares one key
+const int phLeftTupleCount = 24000;
+const int phHeavyTupleCount = 18000;
+const int phRightTupleCount = 3000;
+
+int populatePHJoinTables() {
+    RC rc = success;
+    // b is 7 for the first tuples, in [0, 2999] for the others, every 100th b is NULL
+    for (int i = 0; i < phLeftTupleCount && rc == success; i++) {
+        int b = i < phHeavyTupleCount ? 7 : (i * 13) % 3000;
+        rc = insertJoinTuple("phleft", i, b, i % 100 == 99, "name_" + std::to_string(i % 500));
+    }
+    // b in [0, 999], every value three times
+    for (int i = 0; i < phRightTupleCount && rc == success; i++) {
+        rc = insertJoinTuple("phright", i, (i * 7) % 1000, false, "name_" + std::to_string((i * 7) % 500));
+    }
+    return rc;
+}
+
+RC testCase_PHJoin() {
+    // Functions Tested
+    // 1. PHJoin on one thread
+    // 2. PHJoin on eight threads, the partition of the heavy key is split and probed in slices
+    // 3. PHJoin on a VarChar attribute, read in batches
+    std::cerr << std::endl << "***** In QE Test Case PHJoin *****" << std::endl;
+    RC rc = success;
+
+    Condition cond;
+    cond.lhsAttr = "phleft.B";
+    cond.op = EQ_OP;
+    cond.bRhsIsAttr = true;
+    cond.rhsAttr = "phright.B";
+
+    std::vector<std::string> expected;
+    expectedJoin("phleft", "phright", 1, 1, EQ_OP, expected);
+
+    // 1. and 2.
+    for (unsigned numThreads : {1u, 8u}) {
+        auto *leftIn = new TableScan(rm, "phleft");
+        auto *rightIn = new TableScan(rm, "phright");
+        auto *join = new PHJoin(leftIn, rightIn, cond, numThreads);
+        std::vector<Attribute> attrs;
+        join->getAttributes(attrs);
+        std::vector<std::string> actual;
+        void *data = malloc(PAGE_SIZE);
+        while (join->getNextTuple(data) != QE_EOF) {
+            actual.emplace_back((char *) data, Iterator::getTupleLength(attrs, data));
+        }
+        free(data);
+        std::sort(actual.begin(), actual.end());
+
+        if (expected.empty() || actual != expected || (numThreads == 8 && join->getNumberOfSplits() == 0)) {
+            std::cerr << "***** PHJoin on " << numThreads << " threads returned " << actual.size()
+                      << " tuples, expected " << expected.size() << ", " << join->getNumberOfSplits()
+                      << " partitions split. *****" << std::endl;
+            rc = fail;
+        }
+        delete join;
+        delete leftIn;
+        delete rightIn;
+    }
+
+    // 3. n in 500 names on both sides
+    cond.lhsAttr = "phleft.N";
+    cond.rhsAttr = "phright.N";
+    expected.clear();
+    expectedJoin("phleft", "phright", 2, 2, EQ_OP, expected);
+    auto *leftIn = new TableScan(rm, "phleft");
+    auto *rightIn = new TableScan(rm, "phright");
+    auto *join = new PHJoin(leftIn, rightIn, cond, 4);
+    std::vector<std::string> actual;
+    TupleBatch batch;
+    while (join->getNextBatch(batch) != QE_EOF) {
+        for (unsigned i = 0; i < batch.size(); i++) {
+            actual.emplace_back((char *) batch.getTuple(i), batch.getTupleLength(i));
+        }
+    }
+    std::sort(actual.begin(), actual.end());
+    if (expected.empty() || actual != expected) {
+        std::cerr << "***** PHJoin on VarChar returned " << actual.size() << " tuples, expected "
+                  << expected.size() << ". *****" << std::endl;
+        rc = fail;
+    }
+    delete join;
+
+    // stopping early leaves no worker behind
+    leftIn->setIterator();
+    rightIn->setIterator();
+    join = new PHJoin(leftIn, rightIn, cond, 4);
+    join->getNextBatch(batch);
+    delete join;
+    delete leftIn;
+    delete rightIn;
+    return rc;
+}
+
+int main() {
+    // Tables created: phleft, phright
+    // Indexes created: none
+
+    rm.deleteTable("phleft");
+    rm.deleteTable("phright");
+    if (createJoinTable("phleft", {"A", "B", "N"}, {TypeInt, TypeInt, TypeVarChar}) != success ||
+        createJoinTable("phright", {"D", "B", "N"}, {TypeInt, TypeInt, TypeVarChar}) != success ||
+        populatePHJoinTables() != success) {
+        std::cerr << "***** Creating the parallel join tables failed." << std::endl;
+        std::cerr << "***** [FAIL] QE Test Case PHJoin failed. *****" << std::endl;
+        return fail;
+    }
+
+    RC rc = testCase_PHJoin();
+    rm.deleteTable("phleft");
+    rm.deleteTable("phright");
+
+    if (rc != success) {
+        std::cerr << "***** [FAIL] QE Test Case PHJoin failed. *****" << std::endl;
+        return fail;
+    } else {
+        std::cerr << "***** QE Test Case PHJoin finished. The result will be examined. *****" << std::endl;
+        return success;
+    }
+}
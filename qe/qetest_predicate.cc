@@ -0,0 +1,275 @@
+#include <algorithm>
+#include "qe_test_util.h"
+
+// Number of tuples in the predicate table
+const int predTupleCount = 2000;
+
+int createPredicateTable() {
+    vector<Attribute> attrs;
+    Attribute attr;
+
+    attr.name = "A";
+    attr.type = TypeInt;
+    attr.length = 4;
+    attrs.push_back(attr);
+    attr.name = "B";
+    attr.type = TypeReal;
+    attr.length = 4;
+    attrs.push_back(attr);
+    attr.name = "C";
+    attr.type = TypeVarChar;
+    attr.length = 30;
+    attrs.push_back(attr);
+    attr.name = "D";
+    attr.type = TypeInt;
+    attr.length = 4;
+    attrs.push_back(attr);
+    return rm.createTable("predtable", attrs);
+}
+
+// a in [0, 99], b in halves of [0, 49.5], c in 7 names, d in [0, 149]. every 11th b and every 17th c is NULL
+struct PredicateRow {
+    int a;
+    float b;
+    bool bIsNull;
+    std::string c;
+    bool cIsNull;
+    int d;
+};
+
+PredicateRow getPredicateRow(int i) {
+    PredicateRow row;
+    row.a = (i * 7) % 100;
+    row.b = (float) (i % 100) / 2;
+    row.bIsNull = i % 11 == 10;
+    row.c = "name_" + std::to_string(i % 7);
+    row.cIsNull = i % 17 == 16;
+    row.d = (i * 13) % 150;
+    return row;
+}
+
+int populatePredicateTable() {
+    RC rc = success;
+    RID rid;
+    char buf[PAGE_SIZE];
+
+    for (int i = 0; i < predTupleCount && rc == success; i++) {
+        PredicateRow row = getPredicateRow(i);
+        unsigned char nullsIndicator = (row.bIsNull ? 0x40 : 0) | (row.cIsNull ? 0x20 : 0);
+
+        int offset = 0;
+        memcpy(buf + offset, &nullsIndicator, 1);
+        offset += 1;
+        memcpy(buf + offset, &row.a, sizeof(int));
+        offset += sizeof(int);
+        if (!row.bIsNull) {
+            memcpy(buf + offset, &row.b, sizeof(float));
+            offset += sizeof(float);
+        }
+        if (!row.cIsNull) {
+            unsigned length = row.c.size();
+            memcpy(buf + offset, &length, sizeof(unsigned));
+            offset += sizeof(unsigned);
+            memcpy(buf + offset, row.c.c_str(), length);
+            offset += length;
+        }
+        memcpy(buf + offset, &row.d, sizeof(int));
+        rc = rm.insertTuple("predtable", buf, rid);
+    }
+    return rc;
+}
+
+// (a > 40 AND b <= 30) OR (NOT (c = 'name_3') AND a < d), NULL comparisons are unknown
+bool isExpected(const PredicateRow &row) {
+    bool first = row.a > 40 && !row.bIsNull && row.b <= 30;
+    bool second = !row.cIsNull && row.c != "name_3" && row.a < row.d;
+    return first || second;
+}
+
+Predicate getPredicate(const std::string &prefix) {
+    int a = 40;
+    float b = 30;
+    char c[] = "\x06\0\0\0name_3";
+    return Predicate::disjunction({
+        Predicate::conjunction({Predicate::compare(prefix + "A", GT_OP, TypeInt, &a),
+                                Predicate::compare(prefix + "B", LE_OP, TypeReal, &b)}),
+        Predicate::conjunction({Predicate::negation(Predicate::compare(prefix + "C", EQ_OP, TypeVarChar, c)),
+                                Predicate::compare(prefix + "A", LT_OP, prefix + "D")})});
+}
+
+RC testCase_Predicate() {
+    // Functions Tested
+    // 1. Filter with AND, OR, NOT and an attribute against an attribute, NULL comparisons are unknown
+    // 2. RelationManager::scan with the same predicate, projected
+    // 3. A predicate on an unknown attribute selects nothing
+    std::cerr << std::endl << "***** In QE Test Case Predicate *****" << std::endl;
+    RC rc = success;
+
+    // a tuple is known by a * 1000 + d, the scan does not keep the insertion order
+    std::vector<int> expected;
+    for (int i = 0; i < predTupleCount; i++) {
+        PredicateRow row = getPredicateRow(i);
+        if (isExpected(row)) {
+            expected.push_back(row.a * 1000 + row.d);
+        }
+    }
+    std::sort(expected.begin(), expected.end());
+
+    // 1. in batches
+    auto *input = new TableScan(rm, "predtable");
+    auto *filter = new Filter(input, getPredicate("predtable."));
+    std::vector<Attribute> attrs;
+    filter->getAttributes(attrs);
+    std::vector<int> actual;
+    TupleBatch batch;
+    while (filter->getNextBatch(batch) != QE_EOF) {
+        for (unsigned i = 0; i < batch.size(); i++) {
+            void *data = batch.getTuple(i);
+            actual.push_back(*(int *) Iterator::getAttributePointer(data, attrs, 0) * 1000 +
+                             *(int *) Iterator::getAttributePointer(data, attrs, 3));
+        }
+    }
+    std::sort(actual.begin(), actual.end());
+    if (expected.empty() || expected.size() == (unsigned) predTupleCount || actual != expected) {
+        std::cerr << "***** Filter returned " << actual.size() << " tuples, expected " << expected.size()
+                  << ". *****" << std::endl;
+        rc = fail;
+    }
+    delete filter;
+    delete input;
+
+    // 2. d and a, in this order
+    RM_ScanIterator iterator;
+    rm.scan("predtable", getPredicate(""), {"D", "A"}, iterator);
+    actual.clear();
+    RID rid;
+    char data[PAGE_SIZE];
+    while (iterator.getNextTuple(rid, data) != RM_EOF) {
+        int d, a;
+        memcpy(&d, data + 1, sizeof(int));
+        memcpy(&a, data + 1 + sizeof(int), sizeof(int));
+        actual.push_back(a * 1000 + d);
+    }
+    iterator.close();
+    std::sort(actual.begin(), actual.end());
+    if (actual != expected) {
+        std::cerr << "***** RelationManager::scan returned " << actual.size() << " tuples, expected "
+                  << expected.size() << ". *****" << std::endl;
+        rc = fail;
+    }
+
+    // 3.
+    int a = 0;
+    RM_ScanIterator unknownIterator;
+    rm.scan("predtable", Predicate::negation(Predicate::compare("E", EQ_OP, TypeInt, &a)), {"A"},
+            unknownIterator);
+    if (unknownIterator.getNextTuple(rid, data) != RM_EOF) {
+        std::cerr << "***** A predicate on an unknown attribute selected a tuple. *****" << std::endl;
+        rc = fail;
+    }
+    unknownIterator.close();
+    return rc;
+}
+
+RC testCase_Pushdown() {
+    // Functions Tested
+    // 1. TableScan with the predicate and the projection pushed down, against Filter and Project over a scan
+    // 2. Pushing into a running TableScan under an alias, the projection reverses the attributes
+    std::cerr << std::endl << "***** In QE Test Case Pushdown *****" << std::endl;
+    RC rc = success;
+
+    auto *input = new TableScan(rm, "predtable");
+    auto *filter = new Filter(input, getPredicate("predtable."));
+    auto *project = new Project(filter, {"predtable.D", "predtable.C", "predtable.A"});
+    std::vector<Attribute> expectedAttrs;
+    project->getAttributes(expectedAttrs);
+    std::vector<std::string> expected;
+    char data[PAGE_SIZE];
+    while (project->getNextTuple(data) != QE_EOF) {
+        expected.emplace_back(data, Iterator::getTupleLength(expectedAttrs, data));
+    }
+    std::sort(expected.begin(), expected.end());
+    delete project;
+    delete filter;
+    delete input;
+
+    // 1.
+    auto *scan = new TableScan(rm, "predtable", getPredicate("predtable."), {"D", "predtable.C", "A"});
+    std::vector<Attribute> attrs;
+    scan->getAttributes(attrs);
+    std::vector<std::string> actual;
+    TupleBatch batch;
+    while (scan->getNextBatch(batch) != QE_EOF) {
+        for (unsigned i = 0; i < batch.size(); i++) {
+            actual.emplace_back((char *) batch.getTuple(i), batch.getTupleLength(i));
+        }
+    }
+    std::sort(actual.begin(), actual.end());
+    if (attrs.size() != 3 || attrs[1].name != expectedAttrs[1].name || expected.empty() || actual != expected) {
+        std::cerr << "***** The pushed down scan returned " << actual.size() << " tuples, expected "
+                  << expected.size() << ". *****" << std::endl;
+        rc = fail;
+    }
+    delete scan;
+
+    // 2. a > 40 AND b <= 30, then d and a
+    int a = 40;
+    float b = 30;
+    scan = new TableScan(rm, "predtable", "pt");
+    scan->pushPredicate(Predicate::compare("pt.A", GT_OP, TypeInt, &a));
+    scan->pushPredicate(Predicate::compare("B", LE_OP, TypeReal, &b));
+    if (scan->pushProjection({"pt.D", "pt.A"}) != success || scan->pushProjection({"pt.E"}) != fail) {
+        rc = fail;
+    }
+    // a follows d
+    unsigned count = 0;
+    while (scan->getNextTuple(data) != QE_EOF) {
+        int scanA;
+        memcpy(&scanA, data + 1 + sizeof(int), sizeof(int));
+        count += scanA > 40 ? 1 : 0;
+    }
+    // the scan starts over with what was pushed
+    scan->setIterator();
+    unsigned again = 0;
+    while (scan->getNextTuple(data) != QE_EOF) {
+        again++;
+    }
+    unsigned expectedCount = 0;
+    for (int i = 0; i < predTupleCount; i++) {
+        PredicateRow row = getPredicateRow(i);
+        expectedCount += row.a > 40 && !row.bIsNull && row.b <= 30 ? 1 : 0;
+    }
+    if (expectedCount == 0 || count != expectedCount || again != expectedCount) {
+        std::cerr << "***** The aliased scan returned " << count << " tuples, expected " << expectedCount
+                  << ". *****" << std::endl;
+        rc = fail;
+    }
+    delete scan;
+    return rc;
+}
+
+int main() {
+    // Tables created: predtable
+    // Indexes created: none
+
+    rm.deleteTable("predtable");
+    if (createPredicateTable() != success || populatePredicateTable() != success) {
+        std::cerr << "***** Creating the predicate table failed." << std::endl;
+        std::cerr << "***** [FAIL] QE Test Case Predicate failed. *****" << std::endl;
+        return fail;
+    }
+
+    RC rc = testCase_Predicate();
+    if (testCase_Pushdown() != success) {
+        rc = fail;
+    }
+    rm.deleteTable("predtable");
+
+    if (rc != success) {
+        std::cerr << "***** [FAIL] QE Test Case Predicate failed. *****" << std::endl;
+        return fail;
+    } else {
+        std::cerr << "***** QE Test Case Predicate finished. The result will be examined. *****" << std::endl;
+        return success;
+    }
+}
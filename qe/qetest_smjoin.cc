@@ -0,0 +1,147 @@
+#include <algorithm>
+#include "qe_test_util.h"
+
+// Number of tuples in the sort-merge join tables
+const int smLeftTupleCount = 300;
+const int smRightTupleCount = 200;
+const int smSkewTupleCount = 2000;
+
+int populateSMJoinTable(const std::string &tableName, int count, int keyMod, int keyStep, bool withNulls) {
+    RC rc = success;
+    RID rid;
+    void *buf = malloc(bufSize);
+    unsigned char nullsIndicator;
+
+    for (int i = 0; i < count && rc == success; i++) {
+        // every 50th b is NULL, indexed tables have no NULL keys
+        nullsIndicator = withNulls && i % 50 == 49 ? 0x40 : 0;
+        prepareLeftTuple(3, &nullsIndicator, i, (i * keyStep) % keyMod, (float) i, buf);
+        rc = rm.insertTuple(tableName, buf, rid);
+    }
+    free(buf);
+    return rc;
+}
+
+void collectJoin(SMJoin *join, std::vector<std::string> &result) {
+    TupleBatch batch;
+    while (join->getNextBatch(batch) != QE_EOF) {
+        for (unsigned i = 0; i < batch.size(); i++) {
+            result.emplace_back((char *) batch.getTuple(i), batch.getTupleLength(i));
+        }
+    }
+    std::sort(result.begin(), result.end());
+}
+
+RC testCase_SMJoin() {
+    // Functions Tested
+    // 1. SMJoin on EQ and on every band condition, sorting both inputs
+    // 2. SMJoin on index scans that come sorted
+    // 3. A group of duplicates too large for the buffer
+    std::cerr << std::endl << "***** In QE Test Case SMJoin *****" << std::endl;
+    RC rc = success;
+
+    Condition cond;
+    cond.lhsAttr = "smleft.B";
+    cond.bRhsIsAttr = true;
+    cond.rhsAttr = "smright.B";
+
+    // 1. left b in [0, 99] three times, right b in [0, 99] twice, shuffled
+    for (CompOp op : {EQ_OP, LT_OP, LE_OP, GT_OP, GE_OP}) {
+        cond.op = op;
+        std::vector<std::string> expected, actual;
+        expectedJoin("smleft", "smright", 1, 1, op, expected);
+
+        auto *leftIn = new TableScan(rm, "smleft");
+        auto *rightIn = new TableScan(rm, "smright");
+        auto *join = new SMJoin(leftIn, rightIn, cond, QE_SMJOIN_MIN_PAGES);
+        collectJoin(join, actual);
+        delete join;
+        delete leftIn;
+        delete rightIn;
+
+        if (expected.empty() || actual != expected) {
+            std::cerr << "***** SMJoin with op " << op << " returned " << actual.size() << " tuples, expected "
+                      << expected.size() << ". *****" << std::endl;
+            rc = fail;
+        }
+    }
+
+    // 2. inputs sorted by their indexes
+    cond.op = EQ_OP;
+    std::vector<std::string> expected, actual;
+    expectedJoin("smleft", "smright", 1, 1, EQ_OP, expected);
+    auto *leftIndex = new IndexScan(rm, "smleft", "B");
+    auto *rightIndex = new IndexScan(rm, "smright", "B");
+    auto *join = new SMJoin(leftIndex, rightIndex, cond, 3, true, true);
+    collectJoin(join, actual);
+    delete join;
+    delete leftIndex;
+    delete rightIndex;
+    if (actual != expected) {
+        std::cerr << "***** SMJoin over index scans returned " << actual.size() << " tuples, expected "
+                  << expected.size() << ". *****" << std::endl;
+        rc = fail;
+    }
+
+    // 3. every right b is 0, the group does not fit into the page the sorts leave
+    cond.rhsAttr = "smskew.B";
+    expected.clear();
+    actual.clear();
+    expectedJoin("smleft", "smskew", 1, 1, EQ_OP, expected);
+    auto *leftIn = new TableScan(rm, "smleft");
+    auto *rightIn = new TableScan(rm, "smskew");
+    join = new SMJoin(leftIn, rightIn, cond, QE_SMJOIN_MIN_PAGES);
+    collectJoin(join, actual);
+    unsigned spills = join->getNumberOfSpills();
+    delete join;
+    delete leftIn;
+    delete rightIn;
+    if (spills != 1 || expected.empty() || actual != expected) {
+        std::cerr << "***** SMJoin with a large group returned " << actual.size() << " tuples, expected "
+                  << expected.size() << ". *****" << std::endl;
+        rc = fail;
+    }
+
+    FILE *file = fopen(QE_SMJOIN_GROUP_PREFIX "0", "r");
+    if (file != nullptr) {
+        fclose(file);
+        std::cerr << "***** A group file was left behind. *****" << std::endl;
+        rc = fail;
+    }
+    return rc;
+}
+
+void deleteSMJoinTables() {
+    rm.deleteTable("smleft");
+    rm.deleteTable("smright");
+    rm.deleteTable("smskew");
+}
+
+int main() {
+    // Tables created: smleft, smright, smskew
+    // Indexes created: smleft.B, smright.B
+
+    deleteSMJoinTables();
+    if (createJoinTable("smleft", {"A", "B", "C"}, {TypeInt, TypeInt, TypeReal}) != success ||
+        createJoinTable("smright", {"D", "B", "C"}, {TypeInt, TypeInt, TypeReal}) != success ||
+        createJoinTable("smskew", {"D", "B", "C"}, {TypeInt, TypeInt, TypeReal}) != success ||
+        populateSMJoinTable("smleft", smLeftTupleCount, 100, 37, false) != success ||
+        populateSMJoinTable("smright", smRightTupleCount, 100, 53, false) != success ||
+        populateSMJoinTable("smskew", smSkewTupleCount, 1, 1, true) != success ||
+        rm.createIndex("smleft", "B") != success || rm.createIndex("smright", "B") != success) {
+        std::cerr << "***** Creating the sort-merge join tables failed." << std::endl;
+        std::cerr << "***** [FAIL] QE Test Case SMJoin failed. *****" << std::endl;
+        return fail;
+    }
+
+    RC rc = testCase_SMJoin();
+    deleteSMJoinTables();
+
+    if (rc != success) {
+        std::cerr << "***** [FAIL] QE Test Case SMJoin failed. *****" << std::endl;
+        return fail;
+    } else {
+        std::cerr << "***** QE Test Case SMJoin finished. The result will be examined. *****" << std::endl;
+        return success;
+    }
+}
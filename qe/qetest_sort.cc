@@ -0,0 +1,200 @@
+#include "qe_test_util.h"
+
+// Number of tuples in the sort table, spread over about 60 pages
+const int sortTupleCount = 6000;
+
+int createSortTable() {
+    vector<Attribute> attrs;
+    Attribute attr;
+
+    attr.name = "A";
+    attr.type = TypeInt;
+    attr.length = 4;
+    attrs.push_back(attr);
+    attr.name = "B";
+    attr.type = TypeVarChar;
+    attr.length = 30;
+    attrs.push_back(attr);
+    attr.name = "C";
+    attr.type = TypeReal;
+    attr.length = 4;
+    attrs.push_back(attr);
+    return rm.createTable("sorttable", attrs);
+}
+
+int populateSortTable() {
+    RC rc = success;
+    RID rid;
+    void *buf = malloc(bufSize);
+
+    for (int i = 0; i < sortTupleCount && rc == success; i++) {
+        // a is a permutation of [0, 5999], b repeats every 26 tuples, every 10th c is NULL
+        int a = (i * 7919) % sortTupleCount;
+        std::string b = "name_" + std::string(1, (char) ('a' + i % 26));
+        auto c = (float) (i % 100);
+        unsigned char nullsIndicator = i % 10 == 0 ? 0x20 : 0;
+
+        int offset = 0;
+        memcpy((char *) buf + offset, &nullsIndicator, 1);
+        offset += 1;
+        memcpy((char *) buf + offset, &a, sizeof(int));
+        offset += sizeof(int);
+        unsigned length = b.size();
+        memcpy((char *) buf + offset, &length, sizeof(unsigned));
+        offset += sizeof(unsigned);
+        memcpy((char *) buf + offset, b.c_str(), length);
+        offset += length;
+        if (!nullsIndicator) {
+            memcpy((char *) buf + offset, &c, sizeof(float));
+        }
+        rc = rm.insertTuple("sorttable", buf, rid);
+    }
+    free(buf);
+    return rc;
+}
+
+// checks every tuple against the previous one, returns the number of tuples
+int checkOrder(Sort *sort, bool &failed) {
+    int count = 0;
+    void *previous = malloc(PAGE_SIZE);
+    void *data = malloc(PAGE_SIZE);
+    while (sort->getNextTuple(data) != QE_EOF) {
+        if (count > 0 && sort->compareTuple(previous, data) > 0) {
+            failed = true;
+        }
+        memcpy(previous, data, PAGE_SIZE);
+        count++;
+    }
+    free(previous);
+    free(data);
+    return count;
+}
+
+RC testCase_Sort() {
+    // Functions Tested
+    // 1. Sort with runs spilled to disk and more than one merge pass
+    // 2. Sort in memory on two keys, one of them descending
+    // 3. NULLs come first
+    // 4. Sort over a Filter, read in batches
+    std::cerr << std::endl << "***** In QE Test Case Sort *****" << std::endl;
+    RC rc = success;
+    bool failed = false;
+
+    // 1. A ascending with 3 pages, every run is merged twice
+    auto *ts = new TableScan(rm, "sorttable");
+    auto *sort = new Sort(ts, {{"sorttable.A", true}}, 3);
+    void *data = malloc(PAGE_SIZE);
+    int expected = 0;
+    while (sort->getNextTuple(data) != QE_EOF) {
+        int a = *(int *) ((char *) data + 1);
+        if (a != expected) {
+            failed = true;
+        }
+        expected++;
+    }
+    if (failed || expected != sortTupleCount || sort->getNumberOfRuns() <= 2 * (3 - 1)) {
+        std::cerr << "***** Sort on disk returned " << expected << " tuples in " << sort->getNumberOfRuns()
+                  << " runs. *****" << std::endl;
+        rc = fail;
+    }
+    delete sort;
+    delete ts;
+
+    // 2. B descending, then A ascending, all in memory
+    ts = new TableScan(rm, "sorttable");
+    sort = new Sort(ts, {{"sorttable.B", false}, {"sorttable.A", true}}, 100);
+    sort->getNextTuple(data);
+    std::string first((char *) data + 1 + sizeof(int) + sizeof(unsigned), 6);
+    int count = 1 + checkOrder(sort, failed);
+    if (failed || count != sortTupleCount || first != "name_z" || sort->getNumberOfRuns() != 0) {
+        std::cerr << "***** Sort in memory returned " << count << " tuples, first " << first << ". *****"
+                  << std::endl;
+        rc = fail;
+    }
+    delete sort;
+    delete ts;
+
+    // 3. C ascending on disk, the NULLs first
+    ts = new TableScan(rm, "sorttable");
+    sort = new Sort(ts, {{"sorttable.C", true}}, 4);
+    count = 0;
+    int nullCount = 0;
+    while (sort->getNextTuple(data) != QE_EOF) {
+        bool isNull = (*(unsigned char *) data & 0x20) != 0;
+        if (isNull && nullCount++ != count) {
+            failed = true;
+        }
+        count++;
+    }
+    if (failed || count != sortTupleCount || nullCount != sortTupleCount / 10) {
+        std::cerr << "***** Sort with NULLs returned " << count << " tuples, " << nullCount << " NULLs. *****"
+                  << std::endl;
+        rc = fail;
+    }
+    delete sort;
+    delete ts;
+
+    // 4. A descending over Filter A < 1000, in batches
+    ts = new TableScan(rm, "sorttable");
+    Condition cond;
+    cond.lhsAttr = "sorttable.A";
+    cond.op = LT_OP;
+    cond.bRhsIsAttr = false;
+    Value value{};
+    value.type = TypeInt;
+    value.data = malloc(bufSize);
+    *(int *) value.data = 1000;
+    cond.rhsValue = value;
+    auto *filter = new Filter(ts, cond);
+    sort = new Sort(filter, {{"sorttable.A", false}}, 3);
+    TupleBatch batch;
+    expected = 999;
+    while (sort->getNextBatch(batch, 100) != QE_EOF) {
+        for (unsigned i = 0; i < batch.size(); i++) {
+            if (*(int *) ((char *) batch.getTuple(i) + 1) != expected--) {
+                failed = true;
+            }
+        }
+    }
+    if (failed || expected != -1) {
+        std::cerr << "***** Sort over a filter stopped at " << expected << ". *****" << std::endl;
+        rc = fail;
+    }
+    delete sort;
+    delete filter;
+    delete ts;
+    free(value.data);
+    free(data);
+
+    // every run file is gone
+    FILE *file = fopen(QE_SORT_RUN_PREFIX "0", "r");
+    if (file != nullptr) {
+        fclose(file);
+        std::cerr << "***** A run file was left behind. *****" << std::endl;
+        rc = fail;
+    }
+    return rc;
+}
+
+int main() {
+    // Tables created: sorttable
+    // Indexes created: none
+
+    rm.deleteTable("sorttable");
+    if (createSortTable() != success || populateSortTable() != success) {
+        std::cerr << "***** Creating the sort table failed." << std::endl;
+        std::cerr << "***** [FAIL] QE Test Case Sort failed. *****" << std::endl;
+        return fail;
+    }
+
+    RC rc = testCase_Sort();
+    rm.deleteTable("sorttable");
+
+    if (rc != success) {
+        std::cerr << "***** [FAIL] QE Test Case Sort failed. *****" << std::endl;
+        return fail;
+    } else {
+        std::cerr << "***** QE Test Case Sort finished. The result will be examined. *****" << std::endl;
+        return success;
+    }
+}
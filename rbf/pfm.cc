@@ -1,15 +1,76 @@
 #include "pfm.h"
 #include <iostream>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
 #include <cstdio>
+#include <cstdlib>
+#include <algorithm>
 #include <unordered_map>
 
+// one preadv or pwritev per IOV_MAX pages, a short transfer goes on from where it stopped
+static RC transferPages(int fd, PageNum pageNum, std::vector<iovec> &iov, bool isWrite) {
+    off_t offset = ((off_t) pageNum + 1) * PAGE_SIZE;
+    size_t first = 0;
+    while (first < iov.size()) {
+        int count = (int) std::min(iov.size() - first, (size_t) IOV_MAX);
+        ssize_t n = isWrite ? pwritev(fd, &iov[first], count, offset) : preadv(fd, &iov[first], count, offset);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n == -1 || (n == 0 && isWrite)) {
+            return -1;
+        }
+        // past the end of the file, as in phyReadPage
+        if (n == 0) {
+            for (; first < iov.size(); first++) {
+                memset(iov[first].iov_base, 0, iov[first].iov_len);
+            }
+            return 0;
+        }
+        offset += n;
+        while (n > 0) {
+            size_t step = std::min((size_t) n, iov[first].iov_len);
+            iov[first].iov_base = (char *) iov[first].iov_base + step;
+            iov[first].iov_len -= step;
+            n -= step;
+            if (iov[first].iov_len == 0) {
+                first++;
+            }
+        }
+    }
+    return 0;
+}
+
+template<typename T>
+static std::vector<iovec> getPageVectors(const std::vector<T *> &pages) {
+    std::vector<iovec> iov(pages.size());
+    for (size_t i = 0; i < pages.size(); i++) {
+        iov[i].iov_base = const_cast<void *>(static_cast<const void *>(pages[i]));
+        iov[i].iov_len = PAGE_SIZE;
+    }
+    return iov;
+}
+
+// the pages of count pages back to back
+static std::vector<const void *> splitPages(const void *data, unsigned count) {
+    std::vector<const void *> pages(count);
+    for (unsigned i = 0; i < count; i++) {
+        pages[i] = static_cast<const char *>(data) + (size_t) i * PAGE_SIZE;
+    }
+    return pages;
+}
+
 PagedFileManager &PagedFileManager::instance() {
     static PagedFileManager _pf_manager = PagedFileManager();
     return _pf_manager;
 }
 
-PagedFileManager::PagedFileManager() = default;
+PagedFileManager::PagedFileManager() : extentPages(DEFAULT_EXTENT_PAGES) {
+}
 
 PagedFileManager::~PagedFileManager() = default;
 
@@ -22,27 +83,63 @@ bool PagedFileManager::exists_test (const std::string& name) {
     return (stat (name.c_str(), &buffer) == 0);
 }
 
+RC PagedFileManager::setExtentPages(unsigned extentPages) {
+    this->extentPages = extentPages;
+    return 0;
+}
+
+unsigned PagedFileManager::getExtentPages() {
+    return extentPages;
+}
+
 RC PagedFileManager::createFile(const std::string &fileName) {
 
     if (exists_test(fileName)) {
         return -1;
     } else {
+        BufferManager::instance().discardFile(fileName);
         std::fstream outfile(fileName, std::ios::out | std::ios::binary);
+        // the three counters and the format version
         unsigned x = 0;
-        for (int i = 0; i < 3; i++) {
+        for (int i = 0; i < 4; i++) {
             outfile.write(reinterpret_cast<const char *>(&x), sizeof(x));
         }
         outfile.close();
+        // an unwritable directory or a full disk
+        if (!outfile) {
+            remove(fileName.c_str());
+            return -1;
+        }
     }
     return 0;
 }
 
+RC PagedFileManager::createTempFile(const std::string &prefix, std::string &fileName) {
+    // pick a file name nobody else is using
+    static std::atomic<unsigned> tempFileCount(0);
+    for (unsigned attempt = 0; attempt < TEMP_FILE_ATTEMPTS; attempt++) {
+        fileName = prefix + std::to_string(tempFileCount++);
+        if (exists_test(fileName)) {
+            continue;
+        }
+        if (createFile(fileName) == 0) {
+            return 0;
+        }
+        // only a name taken in between is worth another try
+        if (!exists_test(fileName)) {
+            return -1;
+        }
+    }
+    return -1;
+}
+
 RC PagedFileManager::destroyFile(const std::string &fileName) {
+    BufferManager::instance().discardFile(fileName);
     const int result = remove(fileName.c_str());
     return result;
 }
 
-RC PagedFileManager::openFile(const std::string &fileName, FileHandle &fileHandle) {
+RC PagedFileManager::openFile(const std::string &fileName, FileHandle &fileHandle, bool mapped) {
     if (!exists_test(fileName) || fileHandle.fs.is_open()) {
         return -1;
     } else {
@@ -50,60 +147,266 @@ RC PagedFileManager::openFile(const std::string &fileName, FileHandle &fileHandl
         fileHandle.fs.open(fileName, std::ios::in | std::ios::out | std::ios::binary);
         if (fileHandle.fs.is_open()) {
             fileHandle.phyReadCounterValues();
+            // extents allocated before are found again by fallocate, which skips them
+            fileHandle.allocatedPageCounter = fileHandle.totalPageCounter;
+            // a handle opened again starts without a stream
+            fileHandle.sequentialPageNum = UINT_MAX;
+            fileHandle.candidatePageNum = UINT_MAX;
+            fileHandle.readaheadPageNum = 0;
+            fileHandle.readaheadWindow = READAHEAD_MIN_PAGES;
         } else {
             return -1;
         }
+        fileHandle.ioDescriptor = open(fileName.c_str(), O_RDWR);
+        if (fileHandle.ioDescriptor == -1 || (mapped && mapFile(fileHandle) != 0)) {
+            closeDescriptor(fileHandle);
+            fileHandle.fs.close();
+            return -1;
+        }
         return 0;
     }
 }
 
+RC PagedFileManager::mapFile(FileHandle &fileHandle) {
+    // the mapping reads the file on disk, the pool may hold newer pages
+    if (BufferManager::instance().flushFile(fileHandle) != 0) {
+        return -1;
+    }
+    int fd = open(fileHandle.fileName.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return -1;
+    }
+    struct stat buffer;
+    void *data = MAP_FAILED;
+    if (fstat(fd, &buffer) == 0 && buffer.st_size > 0) {
+        data = mmap(nullptr, buffer.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    // the mapping keeps the file, not the descriptor
+    close(fd);
+    if (data == MAP_FAILED) {
+        return -1;
+    }
+    fileHandle.mappedData = static_cast<const char *>(data);
+    fileHandle.mappedLength = buffer.st_size;
+    return 0;
+}
+
+void PagedFileManager::unmapFile(FileHandle &fileHandle) {
+    if (fileHandle.isMapped()) {
+        munmap(const_cast<char *>(fileHandle.mappedData), fileHandle.mappedLength);
+        fileHandle.mappedData = nullptr;
+        fileHandle.mappedLength = 0;
+    }
+}
+
+void PagedFileManager::closeDescriptor(FileHandle &fileHandle) {
+    if (fileHandle.ioDescriptor != -1) {
+        close(fileHandle.ioDescriptor);
+        fileHandle.ioDescriptor = -1;
+    }
+}
+
 RC PagedFileManager::closeFile(FileHandle &fileHandle) {
     if (fileHandle.fs.is_open()) {
+        unmapFile(fileHandle);
+        BufferManager::instance().flushFile(fileHandle);
         fileHandle.phyWriteCounterValues();
         fileHandle.fs << std::flush;
         fileHandle.fs.close();
+        closeDescriptor(fileHandle);
     } else {
         return -1;
     }
     return 0;
 }
 
-FileHandle::FileHandle() {
+std::atomic<unsigned long long> FileHandle::totalReadPageCounter(0);
+std::atomic<unsigned long long> FileHandle::totalWritePageCounter(0);
+
+FileHandle::FileHandle() : formatVersion(0), allocatedPageCounter(0), mappedData(nullptr), mappedLength(0), ioDescriptor(-1), sequentialPageNum(UINT_MAX),
+                           candidatePageNum(UINT_MAX), readaheadPageNum(0), readaheadWindow(READAHEAD_MIN_PAGES) {
 }
 
-FileHandle::~FileHandle() = default;
+FileHandle::~FileHandle() {
+    PagedFileManager::unmapFile(*this);
+    if (fs.is_open()) {
+        BufferManager::instance().flushFile(*this);
+    }
+    PagedFileManager::closeDescriptor(*this);
+}
 
 RC FileHandle::readPage(PageNum pageNum, void *data) {
-    if (fs.is_open() && (pageNum + 1 <=  totalPageCounter)) {
-        fs.seekg ((pageNum + 1) * PAGE_SIZE, std::ios::beg);
-        fs.read(static_cast<char *>(data), PAGE_SIZE);
-    } else {
+    if (!fs.is_open() || pageNum + 1 > totalPageCounter) {
         return -1;
     }
-    readPageCounter = readPageCounter + 1;
-    return 0;
+    void *frame;
+    if (pinPage(pageNum, frame) != 0) {
+        return -1;
+    }
+    memcpy(data, frame, PAGE_SIZE);
+    return unpinPage(pageNum, false);
 }
 
 RC FileHandle::writePage(PageNum pageNum, const void *data) {
-    if (fs.is_open() && (pageNum + 1 <=  totalPageCounter)) {
-        fs.seekp ((pageNum + 1) * PAGE_SIZE, std::ios::beg);
-        fs.write(reinterpret_cast<const char *>(data), PAGE_SIZE);
-    } else {
+    if (!fs.is_open() || isMapped() || pageNum + 1 > totalPageCounter) {
         return -1;
     }
-    writePageCounter = writePageCounter + 1;
-    return 0;
+    // the whole page is overwritten, so there is no need to fetch it from disk first
+    void *frame;
+    if (BufferManager::instance().pinPage(*this, pageNum, true, frame) != 0) {
+        return -1;
+    }
+    memcpy(frame, data, PAGE_SIZE);
+    return unpinPage(pageNum, true);
 }
 
 RC FileHandle::appendPage(const void *data) {
-    if (fs.is_open()) {
-        fs.seekp ((totalPageCounter + 1) * PAGE_SIZE);
-        fs.write(reinterpret_cast<const char *>(data), PAGE_SIZE);
-    } else {
+    if (!fs.is_open() || isMapped()) {
+        return -1;
+    }
+    void *frame;
+    if (allocatePages(1) != 0 || BufferManager::instance().pinPage(*this, totalPageCounter, true, frame) != 0) {
+        return -1;
+    }
+    memcpy(frame, data, PAGE_SIZE);
+    // appends are written through, so the file on disk always holds getNumberOfPages() pages
+    RC rc = phyWritePage(totalPageCounter, frame);
+    BufferManager::instance().unpinPage(*this, totalPageCounter, false);
+    if (rc != 0) {
         return -1;
     }
     appendPageCounter = appendPageCounter + 1;
     totalPageCounter = appendPageCounter;
+    totalWritePageCounter.fetch_add(1, std::memory_order_relaxed);
+    return 0;
+}
+
+RC FileHandle::readPages(PageNum pageNum, unsigned count, void *data) {
+    if (!fs.is_open() || pageNum + count > totalPageCounter) {
+        return -1;
+    }
+    char *buffer = static_cast<char *>(data);
+    if (isMapped()) {
+        size_t offset = ((size_t) pageNum + 1) * PAGE_SIZE;
+        if (offset + (size_t) count * PAGE_SIZE > mappedLength) {
+            return -1;
+        }
+        memcpy(buffer, mappedData + offset, (size_t) count * PAGE_SIZE);
+    } else {
+        // pages in the pool may be newer than the file, the runs of the others are read in one go
+        std::vector<void *> run;
+        for (unsigned i = 0; i < count; i++) {
+            const char *frame = BufferManager::instance().findPage(*this, pageNum + i);
+            if (frame == nullptr) {
+                run.push_back(buffer + (size_t) i * PAGE_SIZE);
+                continue;
+            }
+            memcpy(buffer + (size_t) i * PAGE_SIZE, frame, PAGE_SIZE);
+            if (!run.empty() && phyReadPages(pageNum + i - run.size(), run) != 0) {
+                return -1;
+            }
+            run.clear();
+        }
+        if (!run.empty() && phyReadPages(pageNum + count - run.size(), run) != 0) {
+            return -1;
+        }
+    }
+    readPageCounter = readPageCounter + count;
+    totalReadPageCounter.fetch_add(count, std::memory_order_relaxed);
+    return 0;
+}
+
+RC FileHandle::writePages(PageNum pageNum, unsigned count, const void *data) {
+    if (!fs.is_open() || isMapped() || pageNum + count > totalPageCounter) {
+        return -1;
+    }
+    if (phyWritePages(pageNum, splitPages(data, count)) != 0) {
+        return -1;
+    }
+    BufferManager::instance().updatePages(*this, pageNum, count, data);
+    writePageCounter = writePageCounter + count;
+    totalWritePageCounter.fetch_add(count, std::memory_order_relaxed);
+    return 0;
+}
+
+RC FileHandle::appendPages(unsigned count, const void *data) {
+    if (!fs.is_open() || isMapped()) {
+        return -1;
+    }
+    if (count == 0) {
+        return 0;
+    }
+    if (allocatePages(count) != 0) {
+        return -1;
+    }
+    // like appendPage the pages go to disk right away, so the file always holds getNumberOfPages() pages
+    if (phyWritePages(totalPageCounter, splitPages(data, count)) != 0) {
+        return -1;
+    }
+    BufferManager::instance().updatePages(*this, totalPageCounter, count, data);
+    appendPageCounter = appendPageCounter + count;
+    totalPageCounter = appendPageCounter;
+    totalWritePageCounter.fetch_add(count, std::memory_order_relaxed);
+    return 0;
+}
+
+RC FileHandle::allocatePages(unsigned count) {
+    if (!fs.is_open() || isMapped()) {
+        return -1;
+    }
+    unsigned extentPages = PagedFileManager::instance().getExtentPages();
+    if (extentPages == 0 || totalPageCounter + count <= allocatedPageCounter) {
+        return 0;
+    }
+    // up to the end of the extent holding the last page, extents start at multiples of extentPages
+    unsigned allocated = std::max(allocatedPageCounter, totalPageCounter);
+    unsigned end = (totalPageCounter + count + extentPages - 1) / extentPages * extentPages;
+#ifdef FALLOC_FL_KEEP_SIZE
+    // the size of the file is left alone, it grows with the pages written as before
+    off_t offset = ((off_t) allocated + 1) * PAGE_SIZE;
+    if (fallocate(ioDescriptor, FALLOC_FL_KEEP_SIZE, offset, (off_t) (end - allocated) * PAGE_SIZE) != 0 &&
+        errno != EOPNOTSUPP && errno != ENOSYS) {
+        return -1;
+    }
+#endif
+    allocatedPageCounter = end;
+    return 0;
+}
+
+RC FileHandle::pinPage(PageNum pageNum, void *&data) {
+    if (!fs.is_open() || pageNum + 1 > totalPageCounter) {
+        return -1;
+    }
+    if (isMapped()) {
+        // page 0 of the file is the header
+        size_t offset = ((size_t) pageNum + 1) * PAGE_SIZE;
+        if (offset + PAGE_SIZE > mappedLength) {
+            return -1;
+        }
+        data = const_cast<char *>(mappedData + offset);
+    } else {
+        trackSequential(pageNum);
+        if (BufferManager::instance().pinPage(*this, pageNum, false, data) != 0) {
+            return -1;
+        }
+    }
+    readPageCounter = readPageCounter + 1;
+    totalReadPageCounter.fetch_add(1, std::memory_order_relaxed);
+    return 0;
+}
+
+RC FileHandle::unpinPage(PageNum pageNum, bool isDirty) {
+    if (isMapped()) {
+        // nothing is pinned, and nothing may be written
+        return isDirty ? -1 : 0;
+    }
+    if (BufferManager::instance().unpinPage(*this, pageNum, isDirty) != 0) {
+        return -1;
+    }
+    if (isDirty) {
+        writePageCounter = writePageCounter + 1;
+        totalWritePageCounter.fetch_add(1, std::memory_order_relaxed);
+    }
     return 0;
 }
 
@@ -111,6 +414,87 @@ unsigned FileHandle::getNumberOfPages() {
     return totalPageCounter;
 }
 
+RC FileHandle::adviseSequential(bool sequential) {
+    if (!isMapped()) {
+        return -1;
+    }
+    return madvise(const_cast<char *>(mappedData), mappedLength, sequential ? MADV_SEQUENTIAL : MADV_NORMAL);
+}
+
+RC FileHandle::prefetchPages(PageNum pageNum, unsigned count) {
+    std::vector<PageNum> pageNums;
+    for (PageNum i = pageNum; i < pageNum + count && i < totalPageCounter; i++) {
+        pageNums.push_back(i);
+    }
+    return prefetchPages(pageNums);
+}
+
+RC FileHandle::prefetchPages(const std::vector<PageNum> &pageNums) {
+    if (!fs.is_open()) {
+        return -1;
+    }
+    // a mapped file is read in place
+    if (isMapped() || pageNums.empty()) {
+        return 0;
+    }
+    return BufferManager::instance().prefetchPages(*this, pageNums);
+}
+
+RC FileHandle::readahead(PageNum pageNum, unsigned count) {
+    if (!fs.is_open()) {
+        return -1;
+    }
+    if (isMapped()) {
+        // the kernel pages the range of the mapping in
+        size_t offset = ((size_t) pageNum + 1) * PAGE_SIZE;
+        if (count == 0 || offset >= mappedLength) {
+            return 0;
+        }
+        size_t length = std::min((size_t) count * PAGE_SIZE, mappedLength - offset);
+        return madvise(const_cast<char *>(mappedData + offset), length, MADV_WILLNEED);
+    }
+    std::vector<PageNum> pageNums;
+    for (PageNum i = pageNum; i < pageNum + count && i < totalPageCounter; i++) {
+        pageNums.push_back(i);
+    }
+    if (pageNums.empty()) {
+        return 0;
+    }
+    return BufferManager::instance().prefetchPages(*this, pageNums, false);
+}
+
+void FileHandle::trackSequential(PageNum pageNum) {
+    // pageNum + 1 does not wrap around below
+    if (pageNum >= totalPageCounter) {
+        return;
+    }
+    // the same page again, UINT_MAX is no stream at all
+    if (sequentialPageNum != UINT_MAX && pageNum + 1 == sequentialPageNum) {
+        return;
+    }
+    if (pageNum != sequentialPageNum) {
+        if (pageNum != candidatePageNum) {
+            candidatePageNum = pageNum + 1;
+            return;
+        }
+        readaheadPageNum = pageNum + 1;
+        readaheadWindow = READAHEAD_MIN_PAGES;
+    }
+    sequentialPageNum = pageNum + 1;
+
+    // the next window goes out once the consumer is halfway through the pages read ahead
+    if (readaheadPageNum > pageNum + 1 + readaheadWindow / 2) {
+        return;
+    }
+    PageNum first = std::max(pageNum + 1, readaheadPageNum);
+    PageNum last = std::min(pageNum + 1 + readaheadWindow, totalPageCounter);
+    if (first < last) {
+        readahead(first, last - first);
+    }
+    readaheadPageNum = std::max(readaheadPageNum, last);
+    readaheadWindow = std::min(readaheadWindow * 2, (unsigned) READAHEAD_MAX_PAGES);
+}
+
 RC FileHandle::collectCounterValues(unsigned &readPageCount, unsigned &writePageCount, unsigned &appendPageCount) {
     readPageCount = readPageCounter;
     writePageCount = writePageCounter;
@@ -125,6 +509,8 @@ RC FileHandle::phyWriteCounterValues() {
         fs.write(reinterpret_cast<const char *>(&readPageCounter), sizeof(readPageCounter));
         fs.write(reinterpret_cast<const char *>(&writePageCounter), sizeof(writePageCounter));
         fs.write(reinterpret_cast<const char *>(&appendPageCounter), sizeof(appendPageCounter));
+        fs.write(reinterpret_cast<const char *>(&formatVersion), sizeof(formatVersion));
+        fs.flush();
     } else {
         return -1;
     }
@@ -137,9 +523,537 @@ RC FileHandle::phyReadCounterValues() {
     fs.read(reinterpret_cast<char *>(&readPageCounter), sizeof(readPageCounter));
     fs.read(reinterpret_cast<char *>(&writePageCounter), sizeof(writePageCounter));
     fs.read(reinterpret_cast<char *>(&appendPageCounter), sizeof(appendPageCounter));
+    fs.read(reinterpret_cast<char *>(&formatVersion), sizeof(formatVersion));
+    // a header written before the format version ends after the counters
+    if (!fs) {
+        fs.clear();
+        formatVersion = 0;
+    }
     totalPageCounter = appendPageCounter;
     return 0;
 }
 
 
 
+
+RC FileHandle::phyReadPage(PageNum pageNum, void *data) {
+    if (!fs.is_open()) {
+        return -1;
+    }
+    fs.clear();
+    fs.seekg((pageNum + 1) * PAGE_SIZE, std::ios::beg);
+    fs.read(static_cast<char *>(data), PAGE_SIZE);
+    std::streamsize readSize = fs.gcount();
+    if (readSize < PAGE_SIZE) {
+        memset(static_cast<char *>(data) + readSize, 0, PAGE_SIZE - readSize);
+        fs.clear();
+    }
+    return 0;
+}
+
+RC FileHandle::phyWritePage(PageNum pageNum, const void *data) {
+    if (!fs.is_open()) {
+        return -1;
+    }
+    fs.clear();
+    fs.seekp((pageNum + 1) * PAGE_SIZE, std::ios::beg);
+    fs.write(static_cast<const char *>(data), PAGE_SIZE);
+    // other handles on the same file read from disk on a miss, do not leave the page in the stream buffer
+    fs.flush();
+    return fs.good() ? 0 : -1;
+}
+
+RC FileHandle::phyReadPages(PageNum pageNum, const std::vector<void *> &pages) {
+    if (ioDescriptor == -1) {
+        return -1;
+    }
+    std::vector<iovec> iov = getPageVectors(pages);
+    return transferPages(ioDescriptor, pageNum, iov, false);
+}
+
+RC FileHandle::phyWritePages(PageNum pageNum, const std::vector<const void *> &pages) {
+    if (ioDescriptor == -1) {
+        return -1;
+    }
+    std::vector<iovec> iov = getPageVectors(pages);
+    return transferPages(ioDescriptor, pageNum, iov, true);
+}
+
+BufferManager &BufferManager::instance() {
+    // never destroyed, so RelationManager's destructor can still close files at exit
+    static BufferManager *_buffer_manager = new BufferManager();
+    return *_buffer_manager;
+}
+
+BufferManager::BufferManager() : pool(nullptr), clockHand(0), readBatch(new IOBatch()) {
+    setFrameCount(DEFAULT_FRAME_COUNT);
+}
+
+BufferManager::~BufferManager() {
+    completeReads();
+    delete readBatch;
+    free(pool);
+}
+
+BufferManager::BufferManager(const BufferManager &) = default;
+
+BufferManager &BufferManager::operator=(const BufferManager &) = default;
+
+RC BufferManager::setFrameCount(unsigned frameCount) {
+    if (frameCount == 0) {
+        return -1;
+    }
+    completeReads();
+    for (auto &frame : frames) {
+        if (frame.valid && frame.pinCount > 0) {
+            return -1;
+        }
+    }
+    for (unsigned i = 0; i < frames.size(); i++) {
+        if (frames[i].valid && frames[i].dirty) {
+            writeBack(i);
+        }
+    }
+    free(pool);
+    pool = static_cast<char *>(malloc((size_t) frameCount * PAGE_SIZE));
+    frames.assign(frameCount, Frame{"", 0, nullptr, 0, false, false, false, false});
+    pageTable.clear();
+    clockHand = 0;
+    return 0;
+}
+
+unsigned BufferManager::getFrameCount() {
+    return frames.size();
+}
+
+char *BufferManager::frameData(unsigned frameId) {
+    return pool + (size_t) frameId * PAGE_SIZE;
+}
+
+RC BufferManager::pinPage(FileHandle &fileHandle, PageNum pageNum, bool isNewPage, void *&data) {
+    auto &filePages = pageTable[fileHandle.fileName];
+    auto it = filePages.find(pageNum);
+    if (it != filePages.end() && frames[it->second].reading) {
+        // a failed read drops the page, it is read again below
+        completeReads();
+        it = filePages.find(pageNum);
+    }
+    if (it != filePages.end()) {
+        Frame &frame = frames[it->second];
+        frame.pinCount++;
+        frame.referenced = true;
+        data = frameData(it->second);
+        return 0;
+    }
+
+    unsigned frameId;
+    if (findVictim(frameId) != 0 && (readingFrames.empty() || completeReads() != 0 || findVictim(frameId) != 0)) {
+        return -1;
+    }
+    Frame &frame = frames[frameId];
+    if (frame.valid) {
+        if (frame.dirty && writeBack(frameId) != 0) {
+            return -1;
+        }
+        pageTable[frame.fileName].erase(frame.pageNum);
+        frame.valid = false;
+    }
+
+    if (!isNewPage && fileHandle.phyReadPage(pageNum, frameData(frameId)) != 0) {
+        return -1;
+    }
+    frame.fileName = fileHandle.fileName;
+    frame.pageNum = pageNum;
+    frame.owner = &fileHandle;
+    frame.pinCount = 1;
+    frame.dirty = false;
+    frame.referenced = true;
+    frame.valid = true;
+    pageTable[fileHandle.fileName][pageNum] = frameId;
+    data = frameData(frameId);
+    return 0;
+}
+
+RC BufferManager::unpinPage(FileHandle &fileHandle, PageNum pageNum, bool isDirty) {
+    auto fileIt = pageTable.find(fileHandle.fileName);
+    if (fileIt == pageTable.end()) {
+        return -1;
+    }
+    auto it = fileIt->second.find(pageNum);
+    if (it == fileIt->second.end() || frames[it->second].pinCount == 0 || frames[it->second].reading) {
+        return -1;
+    }
+    Frame &frame = frames[it->second];
+    frame.pinCount--;
+    if (isDirty) {
+        frame.dirty = true;
+        frame.owner = &fileHandle;
+    }
+    return 0;
+}
+
+RC BufferManager::prefetchPages(FileHandle &fileHandle, const std::vector<PageNum> &pageNums, bool wait) {
+    // at most half of the pool, the pages the caller works on stay resident
+    size_t limit = frames.size() / 2;
+    auto &filePages = pageTable[fileHandle.fileName];
+    // missing pages that follow each other are read by one request
+    PageNum runPageNum = 0;
+    std::vector<unsigned> runFrames;
+    RC rc = 0;
+    for (PageNum pageNum : pageNums) {
+        if (readingFrames.size() + runFrames.size() >= limit) {
+            break;
+        }
+        if (pageNum + 1 > fileHandle.getNumberOfPages()) {
+            continue;
+        }
+        auto it = filePages.find(pageNum);
+        if (it != filePages.end()) {
+            frames[it->second].referenced = true;
+            continue;
+        }
+        if (!runFrames.empty() && (pageNum != runPageNum + runFrames.size() || runFrames.size() == IO_RUN_PAGES) &&
+            readRun(fileHandle, runPageNum, runFrames) != 0) {
+            rc = -1;
+            break;
+        }
+
+        unsigned frameId;
+        if (findVictim(frameId) != 0) {
+            break;
+        }
+        Frame &frame = frames[frameId];
+        if (frame.valid) {
+            if (frame.dirty && writeBack(frameId) != 0) {
+                break;
+            }
+            pageTable[frame.fileName].erase(frame.pageNum);
+            frame.valid = false;
+        }
+        // pinned while the read is in flight, so it is not picked as a victim again
+        frame = Frame{fileHandle.fileName, pageNum, &fileHandle, 1, false, true, true, true};
+        filePages[pageNum] = frameId;
+        if (runFrames.empty()) {
+            runPageNum = pageNum;
+        }
+        runFrames.push_back(frameId);
+    }
+    if (!runFrames.empty() && readRun(fileHandle, runPageNum, runFrames) != 0) {
+        rc = -1;
+    }
+    if (wait && completeReads() != 0) {
+        rc = -1;
+    }
+    return rc;
+}
+
+RC BufferManager::readRun(FileHandle &fileHandle, PageNum pageNum, std::vector<unsigned> &runFrames) {
+    std::vector<void *> pages;
+    for (unsigned frameId : runFrames) {
+        pages.push_back(frameData(frameId));
+    }
+    RC rc = readBatch->readPages(fileHandle, pageNum, pages);
+    for (unsigned frameId : runFrames) {
+        Frame &frame = frames[frameId];
+        if (rc == 0) {
+            readingFrames.push_back(frameId);
+            continue;
+        }
+        pageTable[frame.fileName].erase(frame.pageNum);
+        frame = Frame{"", 0, nullptr, 0, false, false, false, false};
+    }
+    runFrames.clear();
+    return rc;
+}
+
+RC BufferManager::completeReads() {
+    if (readingFrames.empty()) {
+        return 0;
+    }
+    RC rc = readBatch->wait();
+    for (unsigned frameId : readingFrames) {
+        Frame &frame = frames[frameId];
+        frame.pinCount--;
+        frame.reading = false;
+        if (rc != 0) {
+            pageTable[frame.fileName].erase(frame.pageNum);
+            frame.valid = false;
+        }
+    }
+    readingFrames.clear();
+    return rc;
+}
+
+RC BufferManager::flushFile(FileHandle &fileHandle) {
+    return flushFiles({&fileHandle});
+}
+
+RC BufferManager::flushFiles(const std::vector<FileHandle *> &fileHandles) {
+    // the file may be closed next, nothing may still read from it
+    completeReads();
+    // every dirty frame is written at once, the frames do not change until the batch is done
+    std::vector<unsigned> writing;
+    IOBatch batch;
+    RC rc = 0;
+    for (FileHandle *fileHandle : fileHandles) {
+        auto fileIt = pageTable.find(fileHandle->fileName);
+        if (fileIt == pageTable.end()) {
+            continue;
+        }
+        std::vector<std::pair<PageNum, unsigned>> dirtyPages;
+        for (auto &entry : fileIt->second) {
+            Frame &frame = frames[entry.second];
+            if (frame.dirty) {
+                dirtyPages.emplace_back(frame.pageNum, entry.second);
+            }
+            frame.owner = fileHandle;
+        }
+        // dirty pages that follow each other in the file go out in one pwritev
+        std::sort(dirtyPages.begin(), dirtyPages.end());
+        for (size_t i = 0; i < dirtyPages.size() && rc == 0;) {
+            std::vector<const void *> pages;
+            PageNum pageNum = dirtyPages[i].first;
+            while (i < dirtyPages.size() && dirtyPages[i].first == pageNum + pages.size() &&
+                   pages.size() < IO_RUN_PAGES) {
+                pages.push_back(frameData(dirtyPages[i].second));
+                writing.push_back(dirtyPages[i].second);
+                i++;
+            }
+            rc = batch.writePages(*fileHandle, pageNum, pages);
+        }
+    }
+    if (batch.wait() != 0 || rc != 0) {
+        return -1;
+    }
+    for (unsigned frameId : writing) {
+        frames[frameId].dirty = false;
+    }
+    for (FileHandle *fileHandle : fileHandles) {
+        fileHandle->fs << std::flush;
+    }
+    return 0;
+}
+
+const char *BufferManager::findPage(FileHandle &fileHandle, PageNum pageNum) {
+    auto fileIt = pageTable.find(fileHandle.fileName);
+    if (fileIt == pageTable.end()) {
+        return nullptr;
+    }
+    auto it = fileIt->second.find(pageNum);
+    if (it != fileIt->second.end() && frames[it->second].reading) {
+        completeReads();
+        it = fileIt->second.find(pageNum);
+    }
+    if (it == fileIt->second.end()) {
+        return nullptr;
+    }
+    frames[it->second].referenced = true;
+    return frameData(it->second);
+}
+
+void BufferManager::updatePages(FileHandle &fileHandle, PageNum pageNum, unsigned count, const void *data) {
+    auto fileIt = pageTable.find(fileHandle.fileName);
+    if (fileIt == pageTable.end()) {
+        return;
+    }
+    for (unsigned i = 0; i < count; i++) {
+        auto it = fileIt->second.find(pageNum + i);
+        if (it == fileIt->second.end()) {
+            continue;
+        }
+        // a read in flight would overwrite the page
+        if (frames[it->second].reading) {
+            completeReads();
+            it = fileIt->second.find(pageNum + i);
+            if (it == fileIt->second.end()) {
+                continue;
+            }
+        }
+        memcpy(frameData(it->second), static_cast<const char *>(data) + (size_t) i * PAGE_SIZE, PAGE_SIZE);
+        frames[it->second].dirty = false;
+    }
+}
+
+void BufferManager::discardFile(const std::string &fileName) {
+    completeReads();
+    auto fileIt = pageTable.find(fileName);
+    if (fileIt == pageTable.end()) {
+        return;
+    }
+    for (auto &entry : fileIt->second) {
+        frames[entry.second].valid = false;
+        frames[entry.second].dirty = false;
+        frames[entry.second].pinCount = 0;
+    }
+    pageTable.erase(fileIt);
+}
+
+RC BufferManager::findVictim(unsigned &frameId) {
+    // two sweeps: the first may only clear reference bits
+    for (unsigned i = 0; i < 2 * frames.size(); i++) {
+        Frame &frame = frames[clockHand];
+        unsigned current = clockHand;
+        clockHand = (clockHand + 1) % frames.size();
+        if (!frame.valid) {
+            frameId = current;
+            return 0;
+        }
+        if (frame.pinCount > 0) {
+            continue;
+        }
+        if (frame.referenced) {
+            frame.referenced = false;
+            continue;
+        }
+        frameId = current;
+        return 0;
+    }
+    return -1;
+}
+
+RC BufferManager::writeBack(unsigned frameId) {
+    Frame &frame = frames[frameId];
+    if (frame.owner == nullptr || frame.owner->phyWritePage(frame.pageNum, frameData(frameId)) != 0) {
+        return -1;
+    }
+    frame.dirty = false;
+    return 0;
+}
+
+AsyncIOManager &AsyncIOManager::instance() {
+    // never destroyed, files are still flushed through it while other statics are destroyed at exit
+    static AsyncIOManager *_async_io_manager = new AsyncIOManager();
+    return *_async_io_manager;
+}
+
+AsyncIOManager::AsyncIOManager() : threadCount(DEFAULT_IO_THREAD_COUNT), stopping(false) {
+}
+
+AsyncIOManager::~AsyncIOManager() {
+    stopThreads();
+}
+
+RC AsyncIOManager::setThreadCount(unsigned threadCount) {
+    if (threadCount == 0) {
+        return -1;
+    }
+    // the threads finish the queue before they stop, the new count takes effect with the next request
+    stopThreads();
+    this->threadCount = threadCount;
+    return 0;
+}
+
+unsigned AsyncIOManager::getThreadCount() {
+    return threadCount;
+}
+
+void AsyncIOManager::submit(std::function<void()> request) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (threads.empty()) {
+        for (unsigned i = 0; i < threadCount; i++) {
+            threads.emplace_back(&AsyncIOManager::work, this);
+        }
+    }
+    requests.push_back(std::move(request));
+    queued.notify_one();
+}
+
+void AsyncIOManager::work() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        queued.wait(lock, [this] { return stopping || !requests.empty(); });
+        if (requests.empty()) {
+            return;
+        }
+        std::function<void()> request = std::move(requests.front());
+        requests.pop_front();
+        lock.unlock();
+        request();
+        lock.lock();
+    }
+}
+
+void AsyncIOManager::stopThreads() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        queued.notify_all();
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    threads.clear();
+    stopping = false;
+}
+
+IOBatch::IOBatch() : pendingCount(0), failed(false) {
+}
+
+IOBatch::~IOBatch() {
+    wait();
+}
+
+RC IOBatch::readPages(FileHandle &fileHandle, PageNum pageNum, const std::vector<void *> &pages,
+                      const Callback &callback) {
+    if (fileHandle.ioDescriptor == -1 || pages.empty()) {
+        return -1;
+    }
+    int fd = fileHandle.ioDescriptor;
+    std::vector<iovec> iov = getPageVectors(pages);
+    submit([fd, pageNum, iov]() mutable {
+        return transferPages(fd, pageNum, iov, false);
+    }, callback);
+    return 0;
+}
+
+RC IOBatch::writePages(FileHandle &fileHandle, PageNum pageNum, const std::vector<const void *> &pages,
+                       const Callback &callback) {
+    if (fileHandle.ioDescriptor == -1 || pages.empty()) {
+        return -1;
+    }
+    int fd = fileHandle.ioDescriptor;
+    std::vector<iovec> iov = getPageVectors(pages);
+    submit([fd, pageNum, iov]() mutable {
+        return transferPages(fd, pageNum, iov, true);
+    }, callback);
+    return 0;
+}
+
+RC IOBatch::read(FileHandle &fileHandle, PageNum pageNum, void *data, const Callback &callback) {
+    return readPages(fileHandle, pageNum, {data}, callback);
+}
+
+RC IOBatch::write(FileHandle &fileHandle, PageNum pageNum, const void *data, const Callback &callback) {
+    return writePages(fileHandle, pageNum, {data}, callback);
+}
+
+void IOBatch::submit(std::function<RC()> request, const Callback &callback) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pendingCount++;
+    }
+    AsyncIOManager::instance().submit([this, request, callback]() {
+        RC rc = request();
+        if (callback) {
+            callback(rc);
+        }
+        // notified under the lock, the batch may be destroyed as soon as wait() sees the count drop
+        std::lock_guard<std::mutex> lock(mutex);
+        pendingCount--;
+        failed = failed || rc != 0;
+        completed.notify_all();
+    });
+}
+
+RC IOBatch::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    completed.wait(lock, [this] { return pendingCount == 0; });
+    RC rc = failed ? -1 : 0;
+    failed = false;
+    return rc;
+}
+
+unsigned IOBatch::getPendingCount() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return pendingCount;
+}
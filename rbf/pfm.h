@@ -5,13 +5,147 @@ typedef unsigned PageNum;
 typedef int RC;
 
 #define PAGE_SIZE 4096
+#define DEFAULT_FRAME_COUNT 256
+#define DEFAULT_IO_THREAD_COUNT 8
+#define IO_QUEUE_DEPTH 32
+#define READAHEAD_MIN_PAGES 4
+#define READAHEAD_MAX_PAGES 64
+#define IO_RUN_PAGES 16             // at most this many consecutive pages per preadv / pwritev of a batch
+#define DEFAULT_EXTENT_PAGES 64     // files grow on disk by this many pages at a time
+#define TEMP_FILE_ATTEMPTS 1024     // names tried by createTempFile before it gives up
 
+#include <atomic>
 #include <string>
 #include <fstream>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
 #include <string.h>
 #include <limits.h>
 
 class FileHandle;
+class IOBatch;
+
+// Process-wide page cache shared by every FileHandle.
+// Frames are keyed by (fileName, pageNum), so two handles opened on the same file see the same frame.
+// Replacement uses the clock algorithm; pinned frames are never evicted and dirty frames are
+// written back through the owning FileHandle on eviction and when the file is closed.
+// Pages prefetched without waiting hold their frames pinned until the reads are completed, which
+// happens when one of them is pinned, when the pool runs out of victims and before a file is flushed.
+class BufferManager {
+public:
+    static BufferManager &instance();                                   // Access to the _buffer_manager instance
+
+    RC setFrameCount(unsigned frameCount);                              // Resize the pool, fails while any frame is pinned
+    unsigned getFrameCount();                                           // Get the number of frames in the pool
+
+    RC pinPage(FileHandle &fileHandle, PageNum pageNum, bool isNewPage, void *&data);   // Pin a page and expose its frame
+    RC unpinPage(FileHandle &fileHandle, PageNum pageNum, bool isDirty);                // Release a pinned page
+    RC prefetchPages(FileHandle &fileHandle, const std::vector<PageNum> &pageNums,
+                     bool wait = true);                                 // Read the missing pages in one batch
+    RC flushFile(FileHandle &fileHandle);                               // Write back every dirty frame of the file
+    RC flushFiles(const std::vector<FileHandle *> &fileHandles);        // Same for several files, in one batch
+    const char *findPage(FileHandle &fileHandle, PageNum pageNum);      // Frame of a resident page, nullptr if none
+    void updatePages(FileHandle &fileHandle, PageNum pageNum, unsigned count,
+                     const void *data);                                 // Copy pages just written to the file into their frames
+    void discardFile(const std::string &fileName);                      // Drop every frame of the file without writing
+
+protected:
+    BufferManager();                                                    // Prevent construction
+    ~BufferManager();                                                   // Prevent unwanted destruction
+    BufferManager(const BufferManager &);                               // Prevent construction by copying
+    BufferManager &operator=(const BufferManager &);                    // Prevent assignment
+
+private:
+    struct Frame {
+        std::string fileName;
+        PageNum pageNum;
+        FileHandle *owner;
+        unsigned pinCount;
+        bool dirty;
+        bool referenced;
+        bool valid;
+        bool reading;
+    };
+
+    RC completeReads();                                                 // Wait for the prefetched pages
+    RC readRun(FileHandle &fileHandle, PageNum pageNum, std::vector<unsigned> &runFrames);
+    RC findVictim(unsigned &frameId);
+    RC writeBack(unsigned frameId);
+    char *frameData(unsigned frameId);
+
+    char *pool;
+    std::vector<Frame> frames;
+    unsigned clockHand;
+    std::unordered_map<std::string, std::unordered_map<PageNum, unsigned>> pageTable;
+    // reads of the prefetched pages still in flight, into these frames
+    IOBatch *readBatch;
+    std::vector<unsigned> readingFrames;
+};
+
+// Pool of I/O threads shared by every FileHandle, the threads are started on the first request.
+// Each thread blocks in one pread or pwrite at a time, so a batch of requests keeps up to
+// getThreadCount() of them in flight on the device instead of one.
+class AsyncIOManager {
+public:
+    static AsyncIOManager &instance();                                  // Access to the _async_io_manager instance
+
+    RC setThreadCount(unsigned threadCount);                            // Resize the pool once the queued requests are done
+    unsigned getThreadCount();                                          // Get the number of I/O threads
+    void submit(std::function<void()> request);                         // Queue a request for the next free thread
+
+protected:
+    AsyncIOManager();                                                   // Prevent construction
+    ~AsyncIOManager();                                                  // Stops and joins the threads
+    AsyncIOManager(const AsyncIOManager &);                             // Prevent construction by copying
+    AsyncIOManager &operator=(const AsyncIOManager &);                  // Prevent assignment
+
+private:
+    void work();
+    void stopThreads();
+
+    std::mutex mutex;
+    std::condition_variable queued;
+    std::deque<std::function<void()>> requests;
+    std::vector<std::thread> threads;
+    unsigned threadCount;
+    bool stopping;
+};
+
+// Page reads and writes submitted together to the AsyncIOManager, whose completion is waited for at once.
+// Like phyReadPage and phyWritePage they go straight to the file and bypass the buffer pool.
+// Buffers belong to the caller and must stay valid until wait() returns; the callback of a request
+// runs on an I/O thread with its result.
+class IOBatch {
+public:
+    typedef std::function<void(RC)> Callback;
+
+    IOBatch();                                                          // Default constructor
+    ~IOBatch();                                                         // Waits for the requests still in flight
+
+    RC readPages(FileHandle &fileHandle, PageNum pageNum, const std::vector<void *> &pages,
+                 const Callback &callback = nullptr);                   // Queue one preadv of consecutive pages
+    RC writePages(FileHandle &fileHandle, PageNum pageNum, const std::vector<const void *> &pages,
+                  const Callback &callback = nullptr);                  // Queue one pwritev of consecutive pages
+    RC read(FileHandle &fileHandle, PageNum pageNum, void *data,
+            const Callback &callback = nullptr);                        // Queue a read of a page
+    RC write(FileHandle &fileHandle, PageNum pageNum, const void *data,
+             const Callback &callback = nullptr);                       // Queue a write of a page
+    RC wait();                                                          // Wait for every request, -1 if any failed
+    unsigned getPendingCount();                                         // Requests not completed yet
+
+private:
+    void submit(std::function<RC()> request, const Callback &callback);
+
+    std::mutex mutex;
+    std::condition_variable completed;
+    unsigned pendingCount;
+    bool failed;
+};
 
 class PagedFileManager {
 public:
@@ -19,16 +153,30 @@ public:
 
     RC createFile(const std::string &fileName);                         // Create a new file
     RC destroyFile(const std::string &fileName);                        // Destroy a file
-    RC openFile(const std::string &fileName, FileHandle &fileHandle);   // Open a file
+    RC createTempFile(const std::string &prefix, std::string &fileName);  // Create a file named prefix and a free number
+    RC openFile(const std::string &fileName, FileHandle &fileHandle,
+                bool mapped = false);                                   // Open a file, mapped read only if mapped
     RC closeFile(FileHandle &fileHandle);                               // Close a file
 
     static bool exists_test (const std::string& name);
 
+    // Appends allocate the file on disk a whole extent ahead with fallocate, so a file that grows
+    // page by page is laid out in long contiguous runs. The size of the file stays that of its pages.
+    RC setExtentPages(unsigned extentPages);                            // Pages per extent, 0 grows page by page
+    unsigned getExtentPages();                                          // Get the number of pages per extent
+
+    static RC mapFile(FileHandle &fileHandle);                          // Map an open file read only
+    static void unmapFile(FileHandle &fileHandle);                      // Drop the mapping, if any
+    static void closeDescriptor(FileHandle &fileHandle);                // Close the descriptor of the IOBatch requests
+
 protected:
     PagedFileManager();                                                 // Prevent construction
     ~PagedFileManager();                                                // Prevent unwanted destruction
     PagedFileManager(const PagedFileManager &);                         // Prevent construction by copying
     PagedFileManager &operator=(const PagedFileManager &);              // Prevent assignment
+
+private:
+    unsigned extentPages;
 };
 
 class FileHandle {
@@ -38,21 +186,61 @@ public:
     unsigned writePageCounter;
     unsigned appendPageCounter;
     unsigned totalPageCounter;
+    // stored in the header after the counters, the layer that owns the file sets it, 0 for a plain paged file
+    unsigned formatVersion;
+    // pages the file has room for on disk, up to the end of the last extent allocated
+    unsigned allocatedPageCounter;
+
+    // reads and writes (appends included) of every FileHandle of the process, for the I/O of a query
+    static std::atomic<unsigned long long> totalReadPageCounter;
+    static std::atomic<unsigned long long> totalWritePageCounter;
 
     std::fstream fs;
     std::string fileName;
 
+    // A mapped handle reads the file through a read-only mapping made by openFile and bypasses the pool.
+    // pinPage hands out pointers into the mapping, which must not be written, and every write fails.
+    // Dirty frames of the file are written back before it is mapped, pages appended after that are not seen.
+    const char *mappedData;
+    size_t mappedLength;
+    // descriptor of the file for the pread and pwrite of an IOBatch, open as long as fs is
+    int ioDescriptor;
+
+    // sequential pins are read ahead of the consumer, the window doubles every time up to READAHEAD_MAX_PAGES.
+    // a pin off the stream is ignored, two consecutive pages off it start a new stream
+    PageNum sequentialPageNum;                                          // next page of the stream, UINT_MAX if none
+    PageNum candidatePageNum;                                           // next page after the last pin off the stream
+    PageNum readaheadPageNum;                                           // pages before it were read ahead
+    unsigned readaheadWindow;
+
     FileHandle();                                                       // Default constructor
     ~FileHandle();                                                      // Destructor
 
     RC readPage(PageNum pageNum, void *data);                           // Get a specific page
     RC writePage(PageNum pageNum, const void *data);                    // Write a specific page
     RC appendPage(const void *data);                                    // Append a specific page
+    // count pages back to back in data, each call is one preadv or pwritev for the pages not in the pool
+    RC readPages(PageNum pageNum, unsigned count, void *data);          // Get consecutive pages
+    RC writePages(PageNum pageNum, unsigned count, const void *data);   // Write consecutive pages, written through
+    RC appendPages(unsigned count, const void *data);                   // Append pages, written through
+    RC allocatePages(unsigned count);                                   // Make room on disk for count more pages
+    RC pinPage(PageNum pageNum, void *&data);                           // Pin a page in the buffer pool
+    RC unpinPage(PageNum pageNum, bool isDirty);                        // Unpin a page, isDirty if the frame was modified
     unsigned getNumberOfPages();                                        // Get the number of pages in the file
+    bool isMapped() const { return mappedData != nullptr; }             // Opened with mapped
+    RC adviseSequential(bool sequential);                               // Hint a scan of the mapping in page order
+    RC prefetchPages(PageNum pageNum, unsigned count);                  // Bring count pages from pageNum into the pool
+    RC prefetchPages(const std::vector<PageNum> &pageNums);             // Bring the pages into the pool
+    RC readahead(PageNum pageNum, unsigned count);                      // Start reading count pages, without waiting
+    void trackSequential(PageNum pageNum);                              // Read ahead of a sequential stream of pins
     RC collectCounterValues(unsigned &readPageCount, unsigned &writePageCount,
                             unsigned &appendPageCount);                 // Put current counter values into variables
     RC phyWriteCounterValues();
     RC phyReadCounterValues();
+    RC phyReadPage(PageNum pageNum, void *data);                        // Read a page from disk, bypassing the pool
+    RC phyWritePage(PageNum pageNum, const void *data);                 // Write a page to disk, bypassing the pool
+    RC phyReadPages(PageNum pageNum, const std::vector<void *> &pages); // Read consecutive pages with preadv
+    RC phyWritePages(PageNum pageNum, const std::vector<const void *> &pages);  // Write them with pwritev
 };
 
 #endif
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "rbfm.h"
 #include <iostream>
 #include <unordered_map>
+#include <algorithm>
 
 RecordBasedFileManager &RecordBasedFileManager::instance() {
     static RecordBasedFileManager _rbf_manager = RecordBasedFileManager();
@@ -18,15 +19,57 @@ RecordBasedFileManager::RecordBasedFileManager(const RecordBasedFileManager &) =
 RecordBasedFileManager &RecordBasedFileManager::operator=(const RecordBasedFileManager &) = default;
 
 RC RecordBasedFileManager::createFile(const std::string &fileName) {
-    return PagedFileManager::instance().createFile(fileName);
+    RC rc = PagedFileManager::instance().createFile(fileName);
+    if (rc == -1) {
+        return -1;
+    }
+    return initiateFile(fileName);
+}
+
+RC RecordBasedFileManager::createTempFile(const std::string &prefix, std::string &fileName) {
+    if (PagedFileManager::instance().createTempFile(prefix, fileName) == -1) {
+        return -1;
+    }
+    return initiateFile(fileName);
+}
+
+RC RecordBasedFileManager::initiateFile(const std::string &fileName) {
+    freeSpaceMaps().erase(fileName);
+
+    // the first free-space directory page
+    FileHandle fileHandle;
+    if (PagedFileManager::instance().openFile(fileName, fileHandle) == -1) {
+        return -1;
+    }
+    RC rc = initiateDirectoryPage(fileHandle);
+    fileHandle.formatVersion = RBFM_FORMAT_VERSION;
+    if (PagedFileManager::instance().closeFile(fileHandle) == -1) {
+        rc = -1;
+    }
+    return rc;
 }
 
 RC RecordBasedFileManager::destroyFile(const std::string &fileName) {
+    freeSpaceMaps().erase(fileName);
     return PagedFileManager::instance().destroyFile(fileName);
 }
 
-RC RecordBasedFileManager::openFile(const std::string &fileName, FileHandle &fileHandle) {
-    return PagedFileManager::instance().openFile(fileName, fileHandle);
+std::unordered_map<std::string, FreeSpaceMap> &RecordBasedFileManager::freeSpaceMaps() {
+    // never destroyed, RelationManager's destructor still inserts into the catalog at exit
+    static auto *_free_space_maps = new std::unordered_map<std::string, FreeSpaceMap>();
+    return *_free_space_maps;
+}
+
+RC RecordBasedFileManager::openFile(const std::string &fileName, FileHandle &fileHandle, bool mapped) {
+    if (PagedFileManager::instance().openFile(fileName, fileHandle, mapped) == -1) {
+        return -1;
+    }
+    // a file from before the free-space directory pages keeps records on page 0, it cannot be read
+    if (fileHandle.formatVersion != RBFM_FORMAT_VERSION) {
+        PagedFileManager::instance().closeFile(fileHandle);
+        return -1;
+    }
+    return 0;
 }
 
 RC RecordBasedFileManager::closeFile(FileHandle &fileHandle) {
@@ -36,7 +79,6 @@ RC RecordBasedFileManager::closeFile(FileHandle &fileHandle) {
 RC RecordBasedFileManager::insertRecord(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
                                         const void *data, RID &rid) {
     unsigned pageNum = fileHandle.getNumberOfPages();
-    unsigned curPage = pageNum - 1;
     // reformat record data
     void *recordData = malloc(PAGE_SIZE);
     unsigned short recordSize;
@@ -44,26 +86,18 @@ RC RecordBasedFileManager::insertRecord(FileHandle &fileHandle, const std::vecto
     unsigned short spaceNeed = recordSize + DICT_SIZE;
     unsigned targetPage;
 
-    // find target page to insert
-    if (pageNum == 0) {
-        initiateNewPage(fileHandle);
-        targetPage = 0;
+    // find target page to insert, the last page first, then any page the free-space map knows of
+    FreeSpaceMap &freeSpaceMap = getFreeSpaceMap(fileHandle);
+    if (pageNum > 0 && freeSpaceMap.getFreeSpace(pageNum - 1) >= spaceNeed) {
+        targetPage = pageNum - 1;
     } else {
-        if (getFreeSpaceByPageNum(fileHandle, curPage) >= spaceNeed) {
-            // current page have enough space
-            targetPage = curPage;
+        int scannedPage = scanFreeSpace(fileHandle, pageNum, spaceNeed);
+        if (scannedPage == -1) {
+            // not enough space
+            targetPage = initiateNewPage(fileHandle);
         } else {
-            // scan
-            int scannedPage = scanFreeSpace(fileHandle, curPage, spaceNeed);
-            if (scannedPage == -1) {
-                // not enough space
-                initiateNewPage(fileHandle);
-                curPage++;
-                targetPage = curPage;
-            } else {
-                // find target page
-                targetPage = scannedPage;
-            }
+            // find target page
+            targetPage = scannedPage;
         }
     }
 
@@ -75,6 +109,103 @@ RC RecordBasedFileManager::insertRecord(FileHandle &fileHandle, const std::vecto
     return 0;
 }
 
+RC RecordBasedFileManager::insertRecords(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
+                                         const std::vector<const void *> &data, std::vector<RID> &rids) {
+    rids.resize(data.size());
+    void *recordData = malloc(PAGE_SIZE);
+    unsigned short recordSize;
+    unsigned i = 0;
+
+    // top up the last page first, holes in older pages are left to insertRecord
+    unsigned pageNum = fileHandle.getNumberOfPages();
+    if (pageNum > 0 && !isDirectoryPage(pageNum - 1)) {
+        void *pageData;
+        if (fileHandle.pinPage(pageNum - 1, pageData) == -1) {
+            free(recordData);
+            return -1;
+        }
+        for (; i < data.size(); i++) {
+            convertDataToRecord(data[i], recordData, recordSize, recordDescriptor);
+            if (!packRecordIntoPage(pageData, recordData, recordSize, rids[i].slotNum)) {
+                break;
+            }
+            rids[i].pageNum = pageNum - 1;
+        }
+        updateFreeSpaceMap(fileHandle, pageNum - 1, pageData);
+        fileHandle.unpinPage(pageNum - 1, true);
+    }
+
+    // fill new pages in memory, a page is done when the next record does not fit.
+    // the pages done are appended IO_QUEUE_DEPTH at a time
+    void *pageData = malloc(PAGE_SIZE);
+    std::vector<char> pages;
+    unsigned firstRecord = i;
+    setSpace(pageData, INIT_FREE_SPACE);
+    setSlot(pageData, 0);
+    while (i < data.size()) {
+        convertDataToRecord(data[i], recordData, recordSize, recordDescriptor);
+        if (packRecordIntoPage(pageData, recordData, recordSize, rids[i].slotNum)) {
+            i++;
+            if (i < data.size()) {
+                continue;
+            }
+        } else if (getTotalSlot(pageData) == 0) {
+            // does not fit into an empty page either
+            appendPages(fileHandle, pages);
+            free(pageData);
+            free(recordData);
+            return -1;
+        }
+
+        pageNum = fileHandle.getNumberOfPages() + pages.size() / PAGE_SIZE;
+        if (isDirectoryPage(pageNum)) {
+            if (appendPages(fileHandle, pages) == -1) {
+                free(pageData);
+                free(recordData);
+                return -1;
+            }
+            if (initiateDirectoryPage(fileHandle) == -1) {
+                free(pageData);
+                free(recordData);
+                return -1;
+            }
+            pageNum = fileHandle.getNumberOfPages();
+        }
+        pages.insert(pages.end(), (char *) pageData, (char *) pageData + PAGE_SIZE);
+        for (; firstRecord < i; firstRecord++) {
+            rids[firstRecord].pageNum = pageNum;
+        }
+        if (pages.size() == IO_QUEUE_DEPTH * PAGE_SIZE && appendPages(fileHandle, pages) == -1) {
+            free(pageData);
+            free(recordData);
+            return -1;
+        }
+        setSpace(pageData, INIT_FREE_SPACE);
+        setSlot(pageData, 0);
+    }
+
+    free(pageData);
+    free(recordData);
+    return appendPages(fileHandle, pages);
+}
+
+bool RecordBasedFileManager::packRecordIntoPage(void *pageData, const void *record, unsigned short dataSize,
+                                                unsigned short &slotNum) {
+    unsigned short freeSpace = getFreeSpace(pageData);
+    unsigned short totalSlot = getTotalSlot(pageData);
+    if (freeSpace < dataSize + DICT_SIZE) {
+        return false;
+    }
+
+    unsigned short offset = PAGE_SIZE - freeSpace - totalSlot * DICT_SIZE - 2 * UNSIGNED_SHORT_SIZE;
+    writeRecord(pageData, record, offset, dataSize);
+    slotNum = totalSlot + 1;
+    setSlot(pageData, slotNum);
+    setSpace(pageData, freeSpace - dataSize - DICT_SIZE);
+    setOffsetAndLength(pageData, slotNum, offset, dataSize);
+    return true;
+}
+
 RC RecordBasedFileManager::readRecord(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
                                       const RID &rid, void *data) {
     unsigned short recordLength;
@@ -87,40 +218,38 @@ RC RecordBasedFileManager::readRecord(FileHandle &fileHandle, const std::vector<
     unsigned pageNum = rid.pageNum;
     unsigned short slotNum = rid.slotNum;
 
-    void *pageData = malloc(PAGE_SIZE);
-    fileHandle.readPage(pageNum, pageData);
+    void *pageData;
+    if (fileHandle.pinPage(pageNum, pageData) == -1) {
+        return -1;
+    }
 
     unsigned short offset, length;
     getOffsetAndLength(pageData, slotNum, offset, length);
 
-    void *record = malloc(length);
-    if (readRecordFromPage(pageData, record, slotNum) == -1) {
-        free(pageData);
-        free(record);
+    if (length == 0) {
+        fileHandle.unpinPage(pageNum, false);
         return -1;
     }
 
-
-    free(pageData);
+    // decode straight from the frame
+    void *record = (char *) pageData + offset;
 
     // if record is redirected, then return the forwarded data
     if (isRedirected(record)) {
         RID redirectRID;
         getRIDFromRedirectedRecord(record, redirectRID);
-        free(record);
+        fileHandle.unpinPage(pageNum, false);
         return readRecord(fileHandle, recordDescriptor, redirectRID, data, isOutputRecord, recordLength);
     } else {
         if (isOutputRecord) {
             recordLength = length;
             memcpy((char *) data, (char *) record, length);
-            free(record);
-            return 0;
         } else {
             convertRecordToData(record, data, recordDescriptor);
-            free(record);
         }
     }
 
+    fileHandle.unpinPage(pageNum, false);
     return 0;
 }
 
@@ -250,28 +379,28 @@ RC RecordBasedFileManager::deleteRecord(FileHandle &fileHandle, const std::vecto
     unsigned pageNum = rid.pageNum;
     unsigned short slotNum = rid.slotNum;
 
-    // read page data into variable data
-    void *data = malloc(PAGE_SIZE);
-    fileHandle.readPage(pageNum, data);
-
+    // pin the page, the record is deleted in place
+    void *data;
+    if (fileHandle.pinPage(pageNum, data) == -1) {
+        return -1;
+    }
 
     unsigned short offset, length;
     getOffsetAndLength(data, slotNum, offset, length);
 
     // if record is already deleted
     if (length == 0) {
+        fileHandle.unpinPage(pageNum, false);
         return -1;
     }
 
-    // record is going to forward or not
-    void *record = malloc(length);
-    memcpy(record, (char *) data + offset, length);
-
-    // if is, also delete forward record
-    if (isRedirected(record)) {
+    // record is going to forward or not, if is, also delete forward record
+    if (isRedirected((char *) data + offset)) {
         RID redirectRID;
-        getRIDFromRedirectedRecord(record, redirectRID);
+        getRIDFromRedirectedRecord((char *) data + offset, redirectRID);
         deleteRecord(fileHandle, recordDescriptor, redirectRID);
+        // forward record may live on this very frame and shift our record
+        getOffsetAndLength(data, slotNum, offset, length);
     }
 
     // left shift
@@ -284,11 +413,8 @@ RC RecordBasedFileManager::deleteRecord(FileHandle &fileHandle, const std::vecto
     // update previous slot
     setOffsetAndLength(data, slotNum, offset, 0);
 
-    //write into file
-    fileHandle.writePage(pageNum, data);
-
-    free(data);
-    free(record);
+    updateFreeSpaceMap(fileHandle, pageNum, data);
+    fileHandle.unpinPage(pageNum, true);
     return 0;
 }
 
@@ -346,9 +472,11 @@ RC RecordBasedFileManager::updateRecord(FileHandle &fileHandle, const std::vecto
     unsigned pageNum = rid.pageNum;
     unsigned short slotNum = rid.slotNum;
 
-    // read page data into variable data
-    void *pageData = malloc(PAGE_SIZE);
-    fileHandle.readPage(pageNum, pageData);
+    // pin the page, the record is updated in place
+    void *pageData;
+    if (fileHandle.pinPage(pageNum, pageData) == -1) {
+        return -1;
+    }
 
     unsigned short newLength;
     void *newRecord = malloc(PAGE_SIZE);
@@ -356,12 +484,15 @@ RC RecordBasedFileManager::updateRecord(FileHandle &fileHandle, const std::vecto
 
     void *record = malloc(PAGE_SIZE);
     readRecordFromPage(pageData, record, slotNum);
+    // a record that was moved here keeps its mark, whatever happens to it next
+    unsigned char forwardedFlag = isForwarded(record) ? FORWARDED_FLAG : 0x00;
+    *(unsigned char *) newRecord |= forwardedFlag;
 
     // if this record is forwarded, recursively update forward record.
     if (isRedirected(record)) {
         RID newRID;
         readRIDFromRecord(record, newRID);
-        free(pageData);
+        fileHandle.unpinPage(pageNum, false);
         free(newRecord);
         free(record);
         return updateRecord(fileHandle, recordDescriptor, data, newRID);
@@ -376,7 +507,6 @@ RC RecordBasedFileManager::updateRecord(FileHandle &fileHandle, const std::vecto
     // length do not change
     if (oldLength == newLength) {
         writeRecord(pageData, newRecord, offset, newLength);
-        fileHandle.writePage(pageNum, pageData);
     } else if (newLength < oldLength) {
         lengthGap = oldLength - newLength;
         // if new record is shorter
@@ -387,8 +517,6 @@ RC RecordBasedFileManager::updateRecord(FileHandle &fileHandle, const std::vecto
 
         leftShiftRecord(pageData, offset, oldLength, newLength);
         setSpace(pageData, freeSpace + lengthGap);
-
-        fileHandle.writePage(pageNum, pageData);
     } else {
         // if new record is longer
         lengthGap = newLength - oldLength;
@@ -402,8 +530,6 @@ RC RecordBasedFileManager::updateRecord(FileHandle &fileHandle, const std::vecto
             // update record
             writeRecord(pageData, newRecord, offset, newLength);
             setOffsetAndLength(pageData, slotNum, offset, newLength);
-
-            fileHandle.writePage(pageNum, pageData);
         } else {
             // if there is not enough space for new record
 
@@ -413,20 +539,29 @@ RC RecordBasedFileManager::updateRecord(FileHandle &fileHandle, const std::vecto
             setOffsetAndLength(pageData, slotNum, offset, RID_SIZE);
             setSpace(pageData, freeSpace);
 
-            // get rid from new location
+            // get rid from new location, it never lands on this page since the page is still short of room
             RID curRid;
             insertRecord(fileHandle, recordDescriptor, data, curRid);
 
+            // mark the new location so scans only reach it through this slot
+            void *targetData;
+            if (fileHandle.pinPage(curRid.pageNum, targetData) == 0) {
+                unsigned short targetOffset, targetLength;
+                getOffsetAndLength(targetData, curRid.slotNum, targetOffset, targetLength);
+                *((unsigned char *) targetData + targetOffset) |= FORWARDED_FLAG;
+                fileHandle.unpinPage(curRid.pageNum, true);
+            }
+
             // write new RID back to old page
             createRIDRecord(record, curRid);
+            *(unsigned char *) record |= forwardedFlag;
             writeRecord(pageData, record, offset, RID_SIZE);
-
-            fileHandle.writePage(pageNum, pageData);
         }
     }
+    updateFreeSpaceMap(fileHandle, pageNum, pageData);
+    fileHandle.unpinPage(pageNum, true);
     free(record);
     free(newRecord);
-    free(pageData);
     return 0;
 }
 
@@ -545,22 +680,102 @@ unsigned int RecordBasedFileManager::getNullIndicator(void *data, int i) {
 }
 
 int RecordBasedFileManager::scanFreeSpace(FileHandle &fileHandle, unsigned curPageNum, unsigned short sizeNeed) {
-    for (int i = 0; i < curPageNum; i++) {
-        if (sizeNeed <= getFreeSpaceByPageNum(fileHandle, i)) {
-            return i;
+    int pageNum = getFreeSpaceMap(fileHandle).findPage(sizeNeed);
+    if (pageNum >= (int) curPageNum) {
+        return -1;
+    }
+    return pageNum;
+}
+
+bool RecordBasedFileManager::isDirectoryPage(unsigned pageNum) {
+    return pageNum % (FSM_ENTRIES_PER_PAGE + 1) == 0;
+}
+
+FreeSpaceMap &RecordBasedFileManager::getFreeSpaceMap(FileHandle &fileHandle) {
+    FreeSpaceMap &freeSpaceMap = freeSpaceMaps()[fileHandle.fileName];
+    unsigned totalPage = fileHandle.getNumberOfPages();
+    // first touch after the process started, read one directory page per FSM_ENTRIES_PER_PAGE pages
+    unsigned pageNum = freeSpaceMap.getNumberOfPages();
+    while (pageNum < totalPage) {
+        unsigned dirPageNum = pageNum - pageNum % (FSM_ENTRIES_PER_PAGE + 1);
+        void *dirData;
+        if (fileHandle.pinPage(dirPageNum, dirData) == -1) {
+            break;
         }
+        for (; pageNum < totalPage && pageNum <= dirPageNum + FSM_ENTRIES_PER_PAGE; pageNum++) {
+            unsigned short freeSpace = 0;
+            // directory pages themselves never take records
+            if (pageNum != dirPageNum) {
+                memcpy(&freeSpace, (char *) dirData + (pageNum - dirPageNum - 1) * UNSIGNED_SHORT_SIZE,
+                       UNSIGNED_SHORT_SIZE);
+            }
+            freeSpaceMap.setFreeSpace(pageNum, freeSpace);
+        }
+        fileHandle.unpinPage(dirPageNum, false);
     }
-    return -1;
+    return freeSpaceMap;
+}
+
+void RecordBasedFileManager::updateFreeSpaceMap(FileHandle &fileHandle, unsigned pageNum, const void *pageData) {
+    unsigned short freeSpace = getFreeSpace(pageData);
+
+    unsigned dirPageNum = pageNum - pageNum % (FSM_ENTRIES_PER_PAGE + 1);
+    void *dirData;
+    if (fileHandle.pinPage(dirPageNum, dirData) == 0) {
+        memcpy((char *) dirData + (pageNum - dirPageNum - 1) * UNSIGNED_SHORT_SIZE, &freeSpace, UNSIGNED_SHORT_SIZE);
+        fileHandle.unpinPage(dirPageNum, true);
+    }
+
+    auto it = freeSpaceMaps().find(fileHandle.fileName);
+    // not loaded yet, the directory entry is picked up when it is
+    if (it == freeSpaceMaps().end() || pageNum > it->second.getNumberOfPages()) {
+        return;
+    }
+    it->second.setFreeSpace(pageNum, freeSpace);
+}
+
+RC RecordBasedFileManager::appendPages(FileHandle &fileHandle, std::vector<char> &pages) {
+    unsigned count = pages.size() / PAGE_SIZE;
+    unsigned pageNum = fileHandle.getNumberOfPages();
+    if (fileHandle.appendPages(count, pages.data()) == -1) {
+        return -1;
+    }
+    for (unsigned i = 0; i < count; i++) {
+        updateFreeSpaceMap(fileHandle, pageNum + i, pages.data() + (size_t) i * PAGE_SIZE);
+    }
+    pages.clear();
+    return 0;
 }
 
 unsigned RecordBasedFileManager::initiateNewPage(FileHandle &fileHandle) {
+    if (isDirectoryPage(fileHandle.getNumberOfPages())) {
+        initiateDirectoryPage(fileHandle);
+    }
+
     void* data = malloc(PAGE_SIZE);
     setSpace(data, INIT_FREE_SPACE);
     setSlot(data, 0);
 
     fileHandle.appendPage(data);
+    unsigned pageNum = fileHandle.getNumberOfPages() - 1;
+    updateFreeSpaceMap(fileHandle, pageNum, data);
     free(data);
 
+    return pageNum;
+}
+
+RC RecordBasedFileManager::initiateDirectoryPage(FileHandle &fileHandle) {
+    void *data = calloc(PAGE_SIZE, 1);
+    RC rc = fileHandle.appendPage(data);
+    free(data);
+    if (rc == -1) {
+        return -1;
+    }
+
+    auto it = freeSpaceMaps().find(fileHandle.fileName);
+    if (it != freeSpaceMaps().end() && it->second.getNumberOfPages() == fileHandle.getNumberOfPages() - 1) {
+        it->second.setFreeSpace(fileHandle.getNumberOfPages() - 1, 0);
+    }
     return 0;
 }
 
@@ -581,8 +796,8 @@ bool isNullBit(unsigned char byte, int position) // position in range 0-7
 void
 RecordBasedFileManager::appendRecordIntoPage(FileHandle &fileHandle, unsigned pageIdx, unsigned short dataSize,
                                              const void *record, RID &rid) {
-    void *pageData = static_cast<char *>(malloc(PAGE_SIZE));
-    fileHandle.readPage(pageIdx, pageData);
+    void *pageData;
+    fileHandle.pinPage(pageIdx, pageData);
 
     unsigned short freeSpace = getFreeSpace(pageData);
     unsigned short slotNum = getTotalSlot(pageData);
@@ -620,12 +835,11 @@ RecordBasedFileManager::appendRecordIntoPage(FileHandle &fileHandle, unsigned pa
     setSpace(pageData, freeSpace);
     setOffsetAndLength(pageData, targetSlotNum, offset, dataSize);
 
-    fileHandle.writePage(pageIdx, pageData);
+    updateFreeSpaceMap(fileHandle, pageIdx, pageData);
+    fileHandle.unpinPage(pageIdx, true);
 
     rid.pageNum = pageIdx;
     rid.slotNum = targetSlotNum;
-
-    free(pageData);
 }
 
 void
@@ -655,10 +869,12 @@ void RecordBasedFileManager::writeRecord(void *pageData, const void *record, uns
 }
 
 unsigned short RecordBasedFileManager::getFreeSpaceByPageNum(FileHandle &fileHandle, unsigned pageNum) {
-    void *data = malloc(PAGE_SIZE);
-    fileHandle.readPage(pageNum, data);
+    void *data;
+    if (fileHandle.pinPage(pageNum, data) == -1) {
+        return 0;
+    }
     unsigned short freeSpace = getFreeSpace(data);
-    free(data);
+    fileHandle.unpinPage(pageNum, false);
     return freeSpace;
 }
 
@@ -716,7 +932,122 @@ void RecordBasedFileManager::leftShiftRecord(void *data, unsigned short startOff
 bool RecordBasedFileManager::isRedirected(void *record) {
     unsigned char redirectFlag;
     memcpy(&redirectFlag, (char *) record, REDIRECT_INDICATOR_SIZE);
-    return redirectFlag == 0x01;
+    return (redirectFlag & REDIRECT_FLAG) != 0;
+}
+
+bool RecordBasedFileManager::isForwarded(void *record) {
+    unsigned char redirectFlag;
+    memcpy(&redirectFlag, (char *) record, REDIRECT_INDICATOR_SIZE);
+    return (redirectFlag & FORWARDED_FLAG) != 0;
+}
+
+bool RecordBasedFileManager::getAttributeFromRecord(const void *record, unsigned short attrSize, unsigned attrIndex,
+                                                    unsigned short &offset, unsigned short &length) {
+    auto *nullIndicator = (const unsigned char *) record + REDIRECT_INDICATOR_SIZE + UNSIGNED_SHORT_SIZE;
+    if (isNullBit(nullIndicator[attrIndex / 8], attrIndex % 8)) {
+        return false;
+    }
+
+    // only non-NULL attributes own an entry in the offset directory
+    unsigned existBefore = 0;
+    for (unsigned i = 0; i < attrIndex; i++) {
+        if (!isNullBit(nullIndicator[i / 8], i % 8)) {
+            existBefore++;
+        }
+    }
+    unsigned short dirPos = REDIRECT_INDICATOR_SIZE + UNSIGNED_SHORT_SIZE + (attrSize + 7) / 8
+                            + existBefore * UNSIGNED_SHORT_SIZE;
+    unsigned short endPos;
+    memcpy(&offset, (const char *) record + dirPos, UNSIGNED_SHORT_SIZE);
+    memcpy(&endPos, (const char *) record + dirPos + UNSIGNED_SHORT_SIZE, UNSIGNED_SHORT_SIZE);
+    length = endPos - offset;
+    return true;
+}
+
+void RecordBasedFileManager::projectRecord(const void *record, const std::vector<Attribute> &recordDescriptor,
+                                           const std::vector<int> &projection, void *data) {
+    unsigned short nullIndicatorSize = (projection.size() + 7) / 8;
+    // set nullIndicator all to 1
+    memset(data, 0xff, nullIndicatorSize);
+    unsigned short destPos = nullIndicatorSize;
+
+    for (unsigned i = 0; i < projection.size(); i++) {
+        unsigned short offset, length;
+        if (projection[i] == -1 ||
+            !getAttributeFromRecord(record, recordDescriptor.size(), projection[i], offset, length)) {
+            continue;
+        }
+        setNullIndicator(data, i, 0);
+        if (recordDescriptor[projection[i]].type == TypeVarChar) {
+            unsigned varCharLength = length;
+            memcpy((char *) data + destPos, &varCharLength, UNSIGNED_SIZE);
+            destPos += UNSIGNED_SIZE;
+        }
+        memcpy((char *) data + destPos, (const char *) record + offset, length);
+        destPos += length;
+    }
+}
+
+bool RecordBasedFileManager::compareRawValue(const void *value, const void *data, unsigned short length,
+                                             CompOp compOp, AttrType attrType) {
+    if (compOp == NO_OP)
+        return true;
+
+    unsigned valueLength = INT_SIZE;
+    if (attrType == TypeVarChar) {
+        memcpy(&valueLength, value, UNSIGNED_SIZE);
+        value = (const char *) value + UNSIGNED_SIZE;
+    }
+    return isCompOpSatisfied(compareRawAttributes(data, length, value, valueLength, attrType), compOp);
+}
+
+int RecordBasedFileManager::compareRawAttributes(const void *lhs, unsigned short lhsLength, const void *rhs,
+                                                 unsigned short rhsLength, AttrType attrType) {
+    int cmp = 0;
+    switch (attrType) {
+        case TypeInt: {
+            int lhsInt, rhsInt;
+            memcpy(&lhsInt, lhs, INT_SIZE);
+            memcpy(&rhsInt, rhs, INT_SIZE);
+            cmp = lhsInt < rhsInt ? -1 : (lhsInt > rhsInt ? 1 : 0);
+            break;
+        }
+        case TypeReal: {
+            float lhsReal, rhsReal;
+            memcpy(&lhsReal, lhs, INT_SIZE);
+            memcpy(&rhsReal, rhs, INT_SIZE);
+            cmp = lhsReal < rhsReal ? -1 : (lhsReal > rhsReal ? 1 : 0);
+            break;
+        }
+        case TypeVarChar: {
+            cmp = memcmp(lhs, rhs, std::min(lhsLength, rhsLength));
+            if (cmp == 0) {
+                cmp = lhsLength < rhsLength ? -1 : (lhsLength > rhsLength ? 1 : 0);
+            }
+            break;
+        }
+    }
+    return cmp;
+}
+
+bool RecordBasedFileManager::isCompOpSatisfied(int cmp, CompOp compOp) {
+    switch (compOp) {
+        case EQ_OP:
+            return cmp == 0;
+        case LT_OP:
+            return cmp < 0;
+        case LE_OP:
+            return cmp <= 0;
+        case GT_OP:
+            return cmp > 0;
+        case GE_OP:
+            return cmp >= 0;
+        case NE_OP:
+            return cmp != 0;
+        case NO_OP:
+            return true;
+    }
+    return false;
 }
 
 void RecordBasedFileManager::rightShiftRecord(void *data, unsigned short startOffset, unsigned short length,
@@ -776,18 +1107,51 @@ void RecordBasedFileManager::createRIDRecord(void *record, RID &rid) {
 RC RecordBasedFileManager::scan(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
                                 const std::string &conditionAttribute, const CompOp compOp, const void *value,
                                 const std::vector<std::string> &attributeNames, RBFM_ScanIterator &rbfm_ScanIterator) {
+    return scan(fileHandle, recordDescriptor,
+                getConditionPredicate(recordDescriptor, conditionAttribute, compOp, value), attributeNames,
+                rbfm_ScanIterator);
+}
+
+RC RecordBasedFileManager::scan(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
+                                const Predicate &predicate, const std::vector<std::string> &attributeNames,
+                                RBFM_ScanIterator &rbfm_ScanIterator) {
+    rbfm_ScanIterator.unpinCurrentPage();
     rbfm_ScanIterator.fileHandle = &fileHandle;
+    // the pages of a mapped file are walked in place, in page order
+    fileHandle.adviseSequential(true);
     rbfm_ScanIterator.rid.pageNum = SCAN_INIT_PAGE_NUM;
     rbfm_ScanIterator.rid.slotNum = SCAN_INIT_SLOT_NUM;
+    rbfm_ScanIterator.readFailed = false;
     rbfm_ScanIterator.attributeNames = attributeNames;
     rbfm_ScanIterator.recordDescriptor = recordDescriptor;
-    rbfm_ScanIterator.compOp = compOp;
-    rbfm_ScanIterator.value = value;
-    rbfm_ScanIterator.conditionAttribute = conditionAttribute;
+
+    // an unknown attribute selects nothing
+    rbfm_ScanIterator.predicate.bind(predicate, recordDescriptor);
+    rbfm_ScanIterator.projection.clear();
+    for (const auto &attributeName : attributeNames) {
+        rbfm_ScanIterator.projection.push_back(getAttrIndex(recordDescriptor, attributeName));
+    }
+    rbfm_ScanIterator.isProjectionIdentity = attributeNames.size() == recordDescriptor.size();
+    for (unsigned i = 0; i < rbfm_ScanIterator.projection.size(); i++) {
+        if (rbfm_ScanIterator.projection[i] != (int) i) {
+            rbfm_ScanIterator.isProjectionIdentity = false;
+        }
+    }
 
     return 0;
 }
 
+Predicate RecordBasedFileManager::getConditionPredicate(const std::vector<Attribute> &recordDescriptor,
+                                                       const std::string &conditionAttribute, CompOp compOp,
+                                                       const void *value) {
+    if (compOp == NO_OP) {
+        return Predicate();
+    }
+    int index = getAttrIndex(recordDescriptor, conditionAttribute);
+    return Predicate::compare(conditionAttribute, compOp, index == -1 ? TypeInt : recordDescriptor[index].type,
+                              value);
+}
+
 bool RecordBasedFileManager::compareValue(const void *value, void *data, CompOp compOp, AttrType attrType) {
     if (compOp == NO_OP)
         return true;
@@ -897,52 +1261,159 @@ int RecordBasedFileManager::getAttrIndex(const std::vector<Attribute>& attrs, co
     return -1;
 }
 
+unsigned FreeSpaceMap::getNumberOfPages() {
+    return freeSpaces.size();
+}
+
+unsigned short FreeSpaceMap::getFreeSpace(unsigned pageNum) {
+    return pageNum < freeSpaces.size() ? freeSpaces[pageNum] : 0;
+}
+
+void FreeSpaceMap::setFreeSpace(unsigned pageNum, unsigned short freeSpace) {
+    if (pageNum >= freeSpaces.size()) {
+        freeSpaces.resize(pageNum + 1, 0);
+        buckets[getBucket(0)].insert(pageNum);
+    }
+    buckets[getBucket(freeSpaces[pageNum])].erase(pageNum);
+    freeSpaces[pageNum] = freeSpace;
+    buckets[getBucket(freeSpace)].insert(pageNum);
+}
+
+int FreeSpaceMap::findPage(unsigned short sizeNeed) {
+    unsigned bucket = getBucket(sizeNeed);
+    int pageNum = -1;
+    // every page in a higher bucket fits, take the lowest one
+    for (unsigned i = bucket + 1; i < FSM_BUCKET_COUNT; i++) {
+        if (!buckets[i].empty() && (pageNum == -1 || *buckets[i].begin() < (unsigned) pageNum)) {
+            pageNum = *buckets[i].begin();
+        }
+    }
+    // pages in the same bucket have to be checked one by one
+    for (unsigned page : buckets[bucket]) {
+        if (pageNum != -1 && page > (unsigned) pageNum) {
+            break;
+        }
+        if (freeSpaces[page] >= sizeNeed) {
+            return page;
+        }
+    }
+    return pageNum;
+}
+
+unsigned FreeSpaceMap::getBucket(unsigned short freeSpace) {
+    unsigned bucket = (unsigned) freeSpace * FSM_BUCKET_COUNT / PAGE_SIZE;
+    return bucket < FSM_BUCKET_COUNT ? bucket : FSM_BUCKET_COUNT - 1;
+}
+
 RBFM_ScanIterator::RBFM_ScanIterator() {
     rbfm = &RecordBasedFileManager::instance();
+    fileHandle = nullptr;
+    pageData = nullptr;
+    isPagePinned = false;
+    pinnedPageNum = 0;
+    isProjectionIdentity = false;
+    readFailed = false;
 }
 
 RC RBFM_ScanIterator::getNextRecord(RID &curRID, void *data) {
+    if (readFailed) {
+        return RBFM_EOF;
+    }
     unsigned totalPageNum = fileHandle->getNumberOfPages();
-    void *pageData = malloc(PAGE_SIZE);
 
     // move slotNum one step forward
     rid.slotNum += 1;
 
     while (rid.pageNum < totalPageNum) {
-        fileHandle->readPage(rid.pageNum, pageData);
+        // free-space directory pages hold no records
+        if (RecordBasedFileManager::isDirectoryPage(rid.pageNum)) {
+            rid.pageNum += 1;
+            rid.slotNum = 1;
+            continue;
+        }
+        if (!isPagePinned) {
+            // the pages are pinned in order, the file handle reads ahead of the scan
+            if (fileHandle->pinPage(rid.pageNum, pageData) == -1) {
+                readFailed = true;
+                return RBFM_ERROR;
+            }
+            isPagePinned = true;
+            pinnedPageNum = rid.pageNum;
+        }
         unsigned short totalSlot = rbfm->getTotalSlot(pageData);
 
         while (rid.slotNum <= totalSlot) {
-            // check current RID Valid && check whether satisfy the condition request
-            if (isCurRIDValid(pageData) && checkConditionalAttr()) {
+            unsigned short offset, length;
+            rbfm->getOffsetAndLength(pageData, rid.slotNum, offset, length);
+            void *record = (char *) pageData + offset;
+
+            // skip deleted slots and records that are reached through their original slot
+            if (length == 0 || RecordBasedFileManager::isForwarded(record)) {
+                rid.slotNum += 1;
+                continue;
+            }
+
+            // only a redirected record costs another fetch
+            if (RecordBasedFileManager::isRedirected(record)) {
+                RID redirectRID;
+                unsigned short recordLength;
+                RecordBasedFileManager::getRIDFromRedirectedRecord(record, redirectRID);
+                redirectRecord.resize(PAGE_SIZE);
+                if (rbfm->readRecord(*fileHandle, recordDescriptor, redirectRID, redirectRecord.data(), true,
+                                     recordLength) == -1) {
+                    rid.slotNum += 1;
+                    continue;
+                }
+                record = redirectRecord.data();
+            }
+
+            // check whether satisfy the condition request
+            if (checkConditionalAttr(record)) {
                 curRID.slotNum = rid.slotNum;
                 curRID.pageNum = rid.pageNum;
 
-                free(pageData);
-                // if need all attr, just read whole record
-                if (recordDescriptor.size() == attributeNames.size()) {
-                    rbfm->readRecord(*fileHandle, recordDescriptor, rid, data);
+                // if need all attr, just decode whole record
+                if (isProjectionIdentity) {
+                    RecordBasedFileManager::convertRecordToData(record, data, recordDescriptor);
                 } else {
-                    rbfm->readAttributes(*fileHandle, recordDescriptor, rid, attributeNames, data);
+                    RecordBasedFileManager::projectRecord(record, recordDescriptor, projection, data);
                 }
                 return 0;
             } else {
                 rid.slotNum += 1;
             }
         }
+        unpinCurrentPage();
         rid.pageNum += 1;
         rid.slotNum = 1;
     }
 
-    free(pageData);
     return RBFM_EOF;
 };
 
+RBFM_ScanIterator::~RBFM_ScanIterator() {
+    close();
+}
+
 RC RBFM_ScanIterator::close() {
-    rbfm->closeFile(*fileHandle);
+    if (fileHandle == nullptr) {
+        return 0;
+    }
+    unpinCurrentPage();
+    if (fileHandle->fs.is_open()) {
+        rbfm->closeFile(*fileHandle);
+    }
+    fileHandle = nullptr;
     return 0;
 }
 
+void RBFM_ScanIterator::unpinCurrentPage() {
+    if (isPagePinned) {
+        fileHandle->unpinPage(pinnedPageNum, false);
+        isPagePinned = false;
+    }
+}
+
 bool RBFM_ScanIterator::isCurRIDValid(void *data) {
     unsigned short offset, length;
     rbfm->getOffsetAndLength(data, rid.slotNum, offset, length);
@@ -950,31 +1421,220 @@ bool RBFM_ScanIterator::isCurRIDValid(void *data) {
     return length != 0;
 }
 
-bool RBFM_ScanIterator::checkConditionalAttr() {
-    if (compOp == NO_OP) {
-        return true;
+bool RBFM_ScanIterator::checkConditionalAttr(const void *record) {
+    return predicate.evaluateRecord(record);
+}
+
+Predicate Predicate::compare(const std::string &lhsAttr, CompOp op, AttrType type, const void *value) {
+    Predicate predicate;
+    predicate.type = PRED_COMPARE;
+    predicate.lhsAttr = lhsAttr;
+    predicate.op = op;
+    predicate.rhsType = type;
+    // without a condition the value is not read at all
+    if (op != NO_OP && value != nullptr) {
+        unsigned length = INT_SIZE;
+        if (type == TypeVarChar) {
+            memcpy(&length, value, UNSIGNED_SIZE);
+            length += UNSIGNED_SIZE;
+        }
+        predicate.rhsValue.assign((const char *) value, length);
     }
+    return predicate;
+}
 
-    void *data = malloc(PAGE_SIZE);
-    rbfm->readAttribute(*fileHandle, recordDescriptor, rid, conditionAttribute, data);
+Predicate Predicate::compare(const std::string &lhsAttr, CompOp op, const std::string &rhsAttr) {
+    Predicate predicate;
+    predicate.type = PRED_COMPARE;
+    predicate.lhsAttr = lhsAttr;
+    predicate.op = op;
+    predicate.bRhsIsAttr = true;
+    predicate.rhsAttr = rhsAttr;
+    return predicate;
+}
 
-    AttrType attrType;
-    for (const auto &attr : recordDescriptor) {
-        if (attr.name == conditionAttribute) {
-            attrType = attr.type;
-            break;
+Predicate Predicate::conjunction(const std::vector<Predicate> &children) {
+    Predicate predicate;
+    predicate.type = PRED_AND;
+    predicate.children = children;
+    return predicate;
+}
+
+Predicate Predicate::disjunction(const std::vector<Predicate> &children) {
+    Predicate predicate;
+    predicate.type = PRED_OR;
+    predicate.children = children;
+    return predicate;
+}
+
+Predicate Predicate::negation(const Predicate &child) {
+    Predicate predicate;
+    predicate.type = PRED_NOT;
+    predicate.children.push_back(child);
+    return predicate;
+}
+
+PredicateEvaluator::PredicateEvaluator() {
+    root = 0;
+    isBound = false;
+}
+
+RC PredicateEvaluator::bind(const Predicate &predicate, const std::vector<Attribute> &recordDescriptor) {
+    nodes.clear();
+    attrIndexes.clear();
+    attrTypes.clear();
+    for (auto const & it : recordDescriptor) {
+        attrTypes.push_back(it.type);
+    }
+    isBound = addNode(predicate, recordDescriptor, root) == 0;
+
+    // nodes hold attribute indexes so far, they become slots of the attributes read, kept in attribute order
+    std::sort(attrIndexes.begin(), attrIndexes.end());
+    attrIndexes.erase(std::unique(attrIndexes.begin(), attrIndexes.end()), attrIndexes.end());
+    for (auto & node : nodes) {
+        node.lhsSlot = node.lhsSlot == -1 ? -1 : getSlot(node.lhsSlot);
+        node.rhsSlot = node.rhsSlot == -1 ? -1 : getSlot(node.rhsSlot);
+    }
+    values.assign(attrIndexes.size(), nullptr);
+    lengths.assign(attrIndexes.size(), 0);
+    return isBound ? 0 : -1;
+}
+
+RC PredicateEvaluator::addNode(const Predicate &predicate, const std::vector<Attribute> &recordDescriptor,
+                               unsigned &node) {
+    Node it;
+    it.type = predicate.type;
+    it.op = predicate.op;
+    it.attrType = TypeInt;
+    it.lhsSlot = -1;
+    it.rhsSlot = -1;
+
+    if (predicate.type == PRED_COMPARE && predicate.op != NO_OP) {
+        int lhsIndex = RecordBasedFileManager::getAttrIndex(recordDescriptor, predicate.lhsAttr);
+        if (lhsIndex == -1) {
+            return -1;
         }
+        it.attrType = recordDescriptor[lhsIndex].type;
+        it.lhsSlot = lhsIndex;
+        attrIndexes.push_back(lhsIndex);
+        if (predicate.bRhsIsAttr) {
+            int rhsIndex = RecordBasedFileManager::getAttrIndex(recordDescriptor, predicate.rhsAttr);
+            if (rhsIndex == -1 || recordDescriptor[rhsIndex].type != it.attrType) {
+                return -1;
+            }
+            it.rhsSlot = rhsIndex;
+            attrIndexes.push_back(rhsIndex);
+        } else {
+            if (predicate.rhsType != it.attrType || predicate.rhsValue.empty()) {
+                return -1;
+            }
+            unsigned prefix = it.attrType == TypeVarChar ? UNSIGNED_SIZE : 0;
+            it.value = predicate.rhsValue.substr(prefix);
+        }
+    } else if (predicate.type == PRED_NOT && predicate.children.size() != 1) {
+        return -1;
     }
 
-    unsigned char nullIndicator;
-    memcpy(&nullIndicator, data, NULL_INDICATOR_UNIT_SIZE);
+    std::vector<unsigned> children;
+    for (auto const & child : predicate.children) {
+        unsigned childNode;
+        if (addNode(child, recordDescriptor, childNode) == -1) {
+            return -1;
+        }
+        children.push_back(childNode);
+    }
+    it.children = children;
+    node = nodes.size();
+    nodes.push_back(it);
+    return 0;
+}
 
-    if ((nullIndicator & 0x80U) == 0x80U)
-        return false;
+int PredicateEvaluator::getSlot(unsigned attrIndex) const {
+    return std::lower_bound(attrIndexes.begin(), attrIndexes.end(), attrIndex) - attrIndexes.begin();
+}
 
-    bool res = RecordBasedFileManager::compareValue(value, (char *) data + NULL_INDICATOR_UNIT_SIZE, compOp, attrType);
-    free(data);
+bool PredicateEvaluator::evaluateRecord(const void *record) {
+    if (!isBound) {
+        return false;
+    }
+    for (unsigned i = 0; i < attrIndexes.size(); i++) {
+        unsigned short offset, length;
+        bool exists = RecordBasedFileManager::getAttributeFromRecord(record, attrTypes.size(), attrIndexes[i], offset,
+                                                                     length);
+        values[i] = exists ? (const char *) record + offset : nullptr;
+        lengths[i] = length;
+    }
+    return evaluate(root) == 1;
+}
 
-    return res;
+bool PredicateEvaluator::evaluateData(const void *data) {
+    if (!isBound) {
+        return false;
+    }
+    auto *nullIndicator = (const unsigned char *) data;
+    const char *pos = (const char *) data + (attrTypes.size() + 7) / 8;
+    unsigned slot = 0;
+    for (unsigned i = 0; slot < attrIndexes.size(); i++) {
+        bool isNull = (nullIndicator[i / 8] & (0x80u >> (i % 8))) != 0;
+        unsigned length = INT_SIZE;
+        const char *value = pos;
+        if (!isNull && attrTypes[i] == TypeVarChar) {
+            memcpy(&length, pos, UNSIGNED_SIZE);
+            value += UNSIGNED_SIZE;
+            pos += UNSIGNED_SIZE;
+        }
+        if (i == attrIndexes[slot]) {
+            values[slot] = isNull ? nullptr : value;
+            lengths[slot] = length;
+            slot++;
+        }
+        if (!isNull) {
+            pos += length;
+        }
+    }
+    return evaluate(root) == 1;
 }
 
+int PredicateEvaluator::evaluate(unsigned node) const {
+    const Node &it = nodes[node];
+    int result;
+    switch (it.type) {
+        case PRED_COMPARE: {
+            if (it.op == NO_OP) {
+                return 1;
+            }
+            const char *rhs = it.rhsSlot == -1 ? it.value.data() : values[it.rhsSlot];
+            unsigned short rhsLength = it.rhsSlot == -1 ? it.value.size() : lengths[it.rhsSlot];
+            if (values[it.lhsSlot] == nullptr || rhs == nullptr) {
+                return -1;
+            }
+            int cmp = RecordBasedFileManager::compareRawAttributes(values[it.lhsSlot], lengths[it.lhsSlot], rhs,
+                                                                   rhsLength, it.attrType);
+            return RecordBasedFileManager::isCompOpSatisfied(cmp, it.op) ? 1 : 0;
+        }
+        case PRED_AND:
+            result = 1;
+            for (auto const & child : it.children) {
+                int value = evaluate(child);
+                if (value == 0) {
+                    return 0;
+                }
+                result = value == -1 ? -1 : result;
+            }
+            return result;
+        case PRED_OR:
+            result = 0;
+            for (auto const & child : it.children) {
+                int value = evaluate(child);
+                if (value == 1) {
+                    return 1;
+                }
+                result = value == -1 ? -1 : result;
+            }
+            return result;
+        case PRED_NOT:
+            result = evaluate(it.children[0]);
+            return result == -1 ? -1 : 1 - result;
+    }
+    return 0;
+}
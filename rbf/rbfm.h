@@ -3,6 +3,8 @@
 
 #include "pfm.h"
 #include <vector>
+#include <set>
+#include <unordered_map>
 
 #define F_POS 4094
 #define N_POS 4092
@@ -14,9 +16,14 @@
 #define UNSIGNED_SHORT_SIZE 2
 #define REDIRECT_INDICATOR_SIZE 1
 #define RID_SIZE 7
+#define REDIRECT_FLAG 0x01      // slot only holds the RID the record moved to
+#define FORWARDED_FLAG 0x02     // record moved here from another slot, scans reach it through that slot
 #define SCAN_INIT_PAGE_NUM 0
 #define SCAN_INIT_SLOT_NUM 0
 #define NULL_INDICATOR_UNIT_SIZE 1
+#define FSM_BUCKET_COUNT 16
+#define FSM_ENTRIES_PER_PAGE 2048
+#define RBFM_FORMAT_VERSION 1   // in the PFM header, files laid out with free-space directory pages
 
 // Record ID
 typedef struct {
@@ -59,46 +66,158 @@ typedef enum {
 ********************************************************************/
 
 # define RBFM_EOF (-1)  // end of a scan operator
+# define RBFM_ERROR (-2)  // a scan could not read its next page, it ends after this
 
 //  RBFM_ScanIterator is an iterator to go through records
 //  The way to use it is like the following:
 //  RBFM_ScanIterator rbfmScanIterator;
 //  rbfm.open(..., rbfmScanIterator);
-//  while (rbfmScanIterator(rid, data) != RBFM_EOF) {
+//  while (rbfmScanIterator(rid, data) == 0) {
 //    process the data;
 //  }
 //  rbfmScanIterator.close();
 
 class RecordBasedFileManager;
 
+// Node of a predicate tree
+typedef enum {
+    PRED_COMPARE = 0,   // attribute <op> value, or attribute <op> attribute
+    PRED_AND,           // every child holds, true without children
+    PRED_OR,            // some child holds
+    PRED_NOT            // the only child does not hold
+} PredicateType;
+
+// Boolean expression over the attributes of a record. A comparison with a NULL side is unknown,
+// AND, OR and NOT follow the three-valued logic of SQL and only a true predicate selects a record.
+// A default constructed predicate selects every record.
+struct Predicate {
+    PredicateType type = PRED_AND;
+    std::string lhsAttr;
+    CompOp op = NO_OP;
+    bool bRhsIsAttr = false;
+    std::string rhsAttr;
+    AttrType rhsType = TypeInt;
+    std::string rhsValue;               // in data format, a VarChar keeps its length
+    std::vector<Predicate> children;
+
+    static Predicate compare(const std::string &lhsAttr, CompOp op, AttrType type, const void *value);
+
+    static Predicate compare(const std::string &lhsAttr, CompOp op, const std::string &rhsAttr);
+
+    static Predicate conjunction(const std::vector<Predicate> &children);
+
+    static Predicate disjunction(const std::vector<Predicate> &children);
+
+    static Predicate negation(const Predicate &child);
+};
+
+// A predicate resolved against a record descriptor. Every attribute the predicate reads is located once per
+// record, in one pass, then the tree is evaluated on those attributes.
+class PredicateEvaluator {
+public:
+    PredicateEvaluator();
+
+    // -1 if an attribute is unknown or a comparison mixes types, nothing is selected then
+    RC bind(const Predicate &predicate, const std::vector<Attribute> &recordDescriptor);
+
+    // record as stored in a page
+    bool evaluateRecord(const void *record);
+
+    // tuple in data format, [null indicator][values]
+    bool evaluateData(const void *data);
+
+private:
+    struct Node {
+        PredicateType type;
+        CompOp op;
+        AttrType attrType;
+        int lhsSlot;                    // index into attrIndexes
+        int rhsSlot;                    // -1 compares with value
+        std::string value;              // raw, a VarChar without its length
+        std::vector<unsigned> children;
+    };
+
+    RC addNode(const Predicate &predicate, const std::vector<Attribute> &recordDescriptor, unsigned &node);
+
+    int getSlot(unsigned attrIndex) const;
+
+    // 1 true, 0 false, -1 unknown
+    int evaluate(unsigned node) const;
+
+    std::vector<Node> nodes;
+    unsigned root;
+    bool isBound;
+
+    std::vector<AttrType> attrTypes;
+    // attributes read by the predicate, located by every evaluation. nullptr for NULL
+    std::vector<unsigned> attrIndexes;
+    std::vector<const char *> values;
+    std::vector<unsigned short> lengths;
+};
+
+// In-memory index over the free-space directory of a record-based file.
+// Pages are bucketed by free bytes, so finding a page with enough room never touches the file.
+class FreeSpaceMap {
+public:
+    unsigned getNumberOfPages();
+
+    unsigned short getFreeSpace(unsigned pageNum);
+
+    void setFreeSpace(unsigned pageNum, unsigned short freeSpace);
+
+    // return the lowest page with at least sizeNeed free bytes, -1 if none
+    int findPage(unsigned short sizeNeed);
+
+private:
+    static unsigned getBucket(unsigned short freeSpace);
+
+    std::vector<unsigned short> freeSpaces;
+    std::set<unsigned> buckets[FSM_BUCKET_COUNT];
+};
+
 class RBFM_ScanIterator {
 public:
     FileHandle *fileHandle;
     std::vector<std::string> attributeNames;
     std::vector<Attribute> recordDescriptor;
-    std::string conditionAttribute;
-    CompOp compOp;
-    const void* value;
     RID rid;
+    // set once a page could not be read, every later call is RBFM_EOF
+    bool readFailed;
+
+    // resolved once in RecordBasedFileManager::scan
+    PredicateEvaluator predicate;
+    std::vector<int> projection;
+    // every attribute in record order, the record is decoded whole
+    bool isProjectionIdentity;
 
     RBFM_ScanIterator();
 
-    ~RBFM_ScanIterator() = default;
+    ~RBFM_ScanIterator();
 
     // Never keep the results in the memory. When getNextRecord() is called,
     // a satisfying record needs to be fetched from the file.
     // "data" follows the same format as RecordBasedFileManager::insertRecord().
     RC getNextRecord(RID &nextRID, void *data);
 
+    // Unpin the current page and close the file, a closed scan is left alone
     RC close();
 
     bool isCurRIDValid(void *data);
 
-    bool checkConditionalAttr();
+    bool checkConditionalAttr(const void *record);
+
+    void unpinCurrentPage();
 
 private:
     RecordBasedFileManager* rbfm;
 
+    // current page stays pinned between calls
+    void *pageData;
+    bool isPagePinned;
+    unsigned pinnedPageNum;
+    // redirected records are fetched into here
+    std::vector<char> redirectRecord;
+
 };
 
 class RecordBasedFileManager {
@@ -107,9 +226,12 @@ public:
 
     RC createFile(const std::string &fileName);                         // Create a new record-based file
 
+    RC createTempFile(const std::string &prefix, std::string &fileName); // Same, named prefix and a free number
+
     RC destroyFile(const std::string &fileName);                        // Destroy a record-based file
 
-    RC openFile(const std::string &fileName, FileHandle &fileHandle);   // Open a record-based file
+    RC openFile(const std::string &fileName, FileHandle &fileHandle,
+                bool mapped = false);                                   // Open a record-based file, read only if mapped
 
     RC closeFile(FileHandle &fileHandle);                               // Close a record-based file
 
@@ -131,6 +253,11 @@ public:
     // Insert a record into a file
     RC insertRecord(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor, const void *data, RID &rid);
 
+    // Insert a batch of records, rids[i] is the RID of data[i].
+    // The last page is filled first, the rest is packed into new pages in memory and each is appended once.
+    RC insertRecords(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
+                     const std::vector<const void *> &data, std::vector<RID> &rids);
+
     // Read a record identified by the given rid.
     RC readRecord(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor, const RID &rid, void *data);
 
@@ -176,8 +303,29 @@ public:
             const std::vector<std::string> &attributeNames, // a list of projected attributes
             RBFM_ScanIterator &rbfm_ScanIterator);
 
+    // Scan with a compound predicate, evaluated on the record in the page before it is projected.
+    RC scan(FileHandle &fileHandle,
+            const std::vector<Attribute> &recordDescriptor,
+            const Predicate &predicate,
+            const std::vector<std::string> &attributeNames,
+            RBFM_ScanIterator &rbfm_ScanIterator);
+
+    // the single condition of scan as a predicate, the value takes the type of its attribute
+    static Predicate getConditionPredicate(const std::vector<Attribute> &recordDescriptor,
+                                           const std::string &conditionAttribute, CompOp compOp, const void *value);
+
     static unsigned short getFreeSpaceByPageNum(FileHandle &fileHandle, unsigned pageNum);
 
+    // Free-space directory: page 0 and every (FSM_ENTRIES_PER_PAGE + 1)th page after it hold the free bytes
+    // (unsigned short) of the FSM_ENTRIES_PER_PAGE data pages that follow them.
+    static bool isDirectoryPage(unsigned pageNum);
+
+    // free-space map of the file, loaded from the directory pages on first use
+    static FreeSpaceMap &getFreeSpaceMap(FileHandle &fileHandle);
+
+    // record the free space of a modified page in the directory and the map
+    static void updateFreeSpaceMap(FileHandle &fileHandle, unsigned pageNum, const void *pageData);
+
     static unsigned short getTotalSlot(const void *data);
 
     static unsigned short getFreeSpace(const void *data);
@@ -185,9 +333,18 @@ public:
     // return -1 for none space remain, otherwise the page can insert
     static int scanFreeSpace(FileHandle &fileHandle, unsigned curPageNum, unsigned short sizeNeed);
 
-    // write FreeSpace & SlotNum into new page
+    // write FreeSpace & SlotNum into new page, return its page number
     static unsigned initiateNewPage(FileHandle &fileHandle);
 
+    // append the filled pages back to back in pages with one write and enter them into the directory.
+    // pages is emptied
+    static RC appendPages(FileHandle &fileHandle, std::vector<char> &pages);
+
+    static RC initiateDirectoryPage(FileHandle &fileHandle);
+
+    // the first free-space directory page of a file just created
+    static RC initiateFile(const std::string &fileName);
+
     static void setSlot(void *pageData, unsigned short slotNum);
 
     static void setSpace(void *pageData, unsigned short freeSpace);
@@ -204,6 +361,10 @@ public:
     static void appendRecordIntoPage(FileHandle &fileHandle, unsigned pageIdx, unsigned short dataSize,
                               const void *record, RID &rid);
 
+    // put a record behind the last slot of an in-memory page, false if it does not fit
+    static bool packRecordIntoPage(void *pageData, const void *record, unsigned short dataSize,
+                                   unsigned short &slotNum);
+
     static void writeRecord(void *pageData, const void *record, unsigned short offset, unsigned short length);
 
     static void convertRecordToData(void *record, void *data, const std::vector<Attribute> &recordDescriptor);
@@ -216,6 +377,26 @@ public:
 
     static bool isRedirected(void *record);
 
+    static bool isForwarded(void *record);
+
+    // locate an attribute inside a stored record, return false if it is NULL
+    static bool getAttributeFromRecord(const void *record, unsigned short attrSize, unsigned attrIndex,
+                                       unsigned short &offset, unsigned short &length);
+
+    // write the attributes listed in projection (indexes into recordDescriptor, -1 for unknown) in data format
+    static void projectRecord(const void *record, const std::vector<Attribute> &recordDescriptor,
+                              const std::vector<int> &projection, void *data);
+
+    // same as compareValue, but data is a raw attribute of the given length as stored in a record
+    static bool compareRawValue(const void *value, const void *data, unsigned short length, CompOp compOp,
+                                AttrType attrType);
+
+    // order of two raw attributes, <0, 0 or >0
+    static int compareRawAttributes(const void *lhs, unsigned short lhsLength, const void *rhs,
+                                    unsigned short rhsLength, AttrType attrType);
+
+    static bool isCompOpSatisfied(int cmp, CompOp compOp);
+
     static void getRIDFromRedirectedRecord(void* record, RID &rid);
 
     RC readRecordFromPage(void* data, void* record, unsigned short slotNum);
@@ -231,6 +412,8 @@ public:
     static int getAttrIndex(const std::vector<Attribute>& attrs, const std::string& attrName);
 
 protected:
+    static std::unordered_map<std::string, FreeSpaceMap> &freeSpaceMaps();
+
     RecordBasedFileManager();                                                   // Prevent construction
     ~RecordBasedFileManager();                                                  // Prevent unwanted destruction
     RecordBasedFileManager(const RecordBasedFileManager &);                     // Prevent construction by copying
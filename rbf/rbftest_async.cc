@@ -0,0 +1,152 @@
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+int RBFTest_Async(PagedFileManager &pfm) {
+    // Functions tested
+    // 1. Write and read pages through an IOBatch, with callbacks
+    // 2. Resize the pool of I/O threads
+    // 3. Prefetch pages into the buffer pool, later pins do not go to disk
+    // 4. Dirty frames are written back in one batch on close
+    std::cout << std::endl << "***** In RBF Test Case Async *****" << std::endl;
+
+    RC rc;
+    std::string fileName = "test_async";
+    BufferManager &bm = BufferManager::instance();
+    AsyncIOManager &am = AsyncIOManager::instance();
+
+    rc = pfm.createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    FileHandle fileHandle;
+    rc = pfm.openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    unsigned numPages = 64;
+    std::vector<char> pages((size_t) numPages * PAGE_SIZE);
+    for (unsigned i = 0; i < numPages; i++) {
+        memset(pages.data() + (size_t) i * PAGE_SIZE, i, PAGE_SIZE);
+        rc = fileHandle.appendPage(pages.data() + (size_t) i * PAGE_SIZE);
+        assert(rc == success && "Appending a page should not fail.");
+    }
+
+    // 1. overwrite every page at once, then read them back at once
+    std::atomic<unsigned> completed(0);
+    IOBatch batch;
+    for (unsigned i = 0; i < numPages; i++) {
+        memset(pages.data() + (size_t) i * PAGE_SIZE, 'a' + i % 26, PAGE_SIZE);
+        rc = batch.write(fileHandle, i, pages.data() + (size_t) i * PAGE_SIZE, [&completed](RC result) {
+            if (result == success) {
+                completed++;
+            }
+        });
+        assert(rc == success && "Queueing a write should not fail.");
+    }
+    rc = batch.wait();
+    assert(rc == success && "Writing the pages should not fail.");
+    assert(completed == numPages && batch.getPendingCount() == 0 && "Every callback should have run.");
+
+    std::vector<char> readBack((size_t) (numPages + 1) * PAGE_SIZE, 'x');
+    for (unsigned i = 0; i <= numPages; i++) {
+        rc = batch.read(fileHandle, i, readBack.data() + (size_t) i * PAGE_SIZE);
+        assert(rc == success && "Queueing a read should not fail.");
+    }
+    rc = batch.wait();
+    assert(rc == success && "Reading the pages should not fail.");
+    bool failed = memcmp(readBack.data(), pages.data(), pages.size()) != 0;
+    // past the end of the file reads zeros
+    failed = failed || readBack[(size_t) numPages * PAGE_SIZE] != 0 || readBack.back() != 0;
+
+    FileHandle closedHandle;
+    if (batch.read(closedHandle, 0, readBack.data()) != -1) {
+        failed = true;
+    }
+
+    // 2.
+    rc = am.setThreadCount(0);
+    assert(rc != success && "An empty pool should be refused.");
+    rc = am.setThreadCount(2);
+    assert(rc == success && "Resizing an idle pool should not fail.");
+    assert(am.getThreadCount() == 2 && "The pool should have been resized.");
+    for (unsigned i = 0; i < numPages; i++) {
+        batch.read(fileHandle, i, readBack.data() + (size_t) i * PAGE_SIZE);
+    }
+    if (batch.wait() != success || memcmp(readBack.data(), pages.data(), pages.size()) != 0) {
+        failed = true;
+    }
+    rc = am.setThreadCount(DEFAULT_IO_THREAD_COUNT);
+    assert(rc == success && "Resizing an idle pool should not fail.");
+
+    // 3. an empty pool of 16 frames takes 8 prefetched pages
+    rc = bm.setFrameCount(16);
+    assert(rc == success && "Resizing an idle pool should not fail.");
+    rc = fileHandle.prefetchPages(0, numPages);
+    assert(rc == success && "Prefetching should not fail.");
+    // change the file behind the pool, the prefetched pages keep what they read
+    std::vector<char> page(PAGE_SIZE, 'z');
+    for (unsigned i = 0; i < 10; i++) {
+        batch.write(fileHandle, i, page.data());
+    }
+    rc = batch.wait();
+    assert(rc == success && "Writing the pages should not fail.");
+    for (unsigned i = 0; i < 10; i++) {
+        void *data;
+        rc = fileHandle.pinPage(i, data);
+        assert(rc == success && "Pinning a page should not fail.");
+        char expected = i < 8 ? (char) ('a' + i % 26) : 'z';
+        if (((char *) data)[0] != expected || ((char *) data)[PAGE_SIZE - 1] != expected) {
+            std::cout << "Page " << i << " holds " << ((char *) data)[0] << " instead of " << expected << std::endl;
+            failed = true;
+        }
+        fileHandle.unpinPage(i, false);
+    }
+
+    // 4. dirty frames of several pages go out together
+    for (unsigned i = 20; i < 26; i++) {
+        void *data;
+        rc = fileHandle.pinPage(i, data);
+        assert(rc == success && "Pinning a page should not fail.");
+        memset(data, 'y', PAGE_SIZE);
+        rc = fileHandle.unpinPage(i, true);
+        assert(rc == success && "Unpinning a page should not fail.");
+    }
+    rc = pfm.closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    rc = bm.setFrameCount(DEFAULT_FRAME_COUNT);
+    assert(rc == success && "Resizing an idle pool should not fail.");
+
+    rc = pfm.openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    for (unsigned i = 19; i < 27; i++) {
+        rc = fileHandle.readPage(i, page.data());
+        assert(rc == success && "Reading a page should not fail.");
+        char expected = i >= 20 && i < 26 ? 'y' : (char) ('a' + i % 26);
+        if (page[0] != expected || page[PAGE_SIZE - 1] != expected) {
+            failed = true;
+        }
+    }
+    rc = pfm.closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    rc = pfm.destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    rc = destroyFileShouldSucceed(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    if (failed) {
+        std::cout << "[FAIL] Test Case Async Failed!" << std::endl << std::endl;
+        return -1;
+    }
+
+    std::cout << "RBF Test Case Async Finished! The result will be examined." << std::endl << std::endl;
+
+    return 0;
+}
+
+int main() {
+    // To test the batched page I/O under the paged file manager
+    remove("test_async");
+
+    return RBFTest_Async(PagedFileManager::instance());
+}
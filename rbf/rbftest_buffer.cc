@@ -0,0 +1,121 @@
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+int RBFTest_Buffer(PagedFileManager &pfm) {
+    // Functions tested
+    // 1. Pin / Unpin Page
+    // 2. Eviction with a small pool
+    // 3. Two handles on the same file share frames
+    // 4. Dirty frames are written back on close
+    std::cout << std::endl << "***** In RBF Test Case Buffer *****" << std::endl;
+
+    RC rc;
+    std::string fileName = "test_buffer";
+    BufferManager &bm = BufferManager::instance();
+
+    rc = bm.setFrameCount(4);
+    assert(rc == success && "Resizing an idle pool should not fail.");
+
+    rc = pfm.createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    FileHandle fileHandle;
+    rc = pfm.openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    // append more pages than there are frames
+    void *data = malloc(PAGE_SIZE);
+    unsigned numPages = 10;
+    for (unsigned i = 0; i < numPages; i++) {
+        memset(data, i, PAGE_SIZE);
+        rc = fileHandle.appendPage(data);
+        assert(rc == success && "Appending a page should not fail.");
+    }
+    rc = pfm.closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    rc = pfm.openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    FileHandle otherHandle;
+    rc = pfm.openFile(fileName, otherHandle);
+    assert(rc == success && "Opening the file twice should not fail.");
+
+    // modify a page in place through a pinned frame
+    void *frame;
+    rc = fileHandle.pinPage(3, frame);
+    assert(rc == success && "Pinning a page should not fail.");
+    memset(frame, 'x', PAGE_SIZE);
+    rc = fileHandle.unpinPage(3, true);
+    assert(rc == success && "Unpinning a page should not fail.");
+
+    // the other handle sees the change before anything is written back
+    rc = otherHandle.readPage(3, data);
+    assert(rc == success && "Reading a page should not fail.");
+    assert(((char *) data)[PAGE_SIZE - 1] == 'x' && "Both handles should see the same frame.");
+
+    // all frames pinned, no victim left
+    void *frames[4];
+    for (unsigned i = 0; i < 4; i++) {
+        rc = fileHandle.pinPage(i, frames[i]);
+        assert(rc == success && "Pinning a page should not fail.");
+    }
+    rc = fileHandle.pinPage(5, frame);
+    assert(rc != success && "Pinning with every frame pinned should fail.");
+    rc = bm.setFrameCount(8);
+    assert(rc != success && "Resizing while pages are pinned should fail.");
+    for (unsigned i = 0; i < 4; i++) {
+        rc = fileHandle.unpinPage(i, false);
+        assert(rc == success && "Unpinning a page should not fail.");
+    }
+    rc = fileHandle.unpinPage(0, false);
+    assert(rc != success && "Unpinning a page that is not pinned should fail.");
+
+    // cycle through every page so page 3 gets evicted and read back from disk
+    for (unsigned i = 0; i < numPages; i++) {
+        rc = fileHandle.readPage(i, data);
+        assert(rc == success && "Reading a page should not fail.");
+        char expected = i == 3 ? 'x' : (char) i;
+        assert(((char *) data)[0] == expected && "Page content should survive eviction.");
+    }
+
+    rc = pfm.closeFile(otherHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    rc = pfm.closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    // the data must be on disk after close
+    bm.setFrameCount(DEFAULT_FRAME_COUNT);
+    rc = pfm.openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    assert(fileHandle.getNumberOfPages() == numPages && "Page count should be persisted.");
+    rc = fileHandle.readPage(3, data);
+    assert(rc == success && "Reading a page should not fail.");
+    if (((char *) data)[0] != 'x') {
+        std::cout << "[FAIL] Test Case Buffer Failed!" << std::endl << std::endl;
+        free(data);
+        return -1;
+    }
+    rc = pfm.closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    rc = pfm.destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    rc = destroyFileShouldSucceed(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    free(data);
+
+    std::cout << "RBF Test Case Buffer Finished! The result will be examined." << std::endl << std::endl;
+
+    return 0;
+}
+
+int main() {
+    // To test the buffer pool under the paged file manager
+    remove("test_buffer");
+
+    return RBFTest_Buffer(PagedFileManager::instance());
+}
@@ -0,0 +1,108 @@
+#include <sys/stat.h>
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+// bytes of the file and bytes allocated to it on disk
+static void getFileSizes(const std::string &fileName, off_t &size, off_t &allocated) {
+    struct stat buffer;
+    stat(fileName.c_str(), &buffer);
+    size = buffer.st_size;
+    allocated = (off_t) buffer.st_blocks * 512;
+}
+
+int RBFTest_Extent(PagedFileManager &pfm) {
+    // Functions tested
+    // 1. The first append allocates a whole extent, the size of the file follows the pages
+    // 2. Appends of many pages allocate the extents they reach
+    // 3. Pages and size are kept after reopening
+    // 4. No extent is allocated ahead with 0 pages per extent
+    std::cout << std::endl << "***** In RBF Test Case Extent *****" << std::endl;
+
+    RC rc;
+    std::string fileName = "test_extent";
+    off_t size, allocated;
+
+    rc = pfm.createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    FileHandle fileHandle;
+    rc = pfm.openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    bool failed = pfm.getExtentPages() != DEFAULT_EXTENT_PAGES;
+
+    // 1.
+    std::vector<char> pages((size_t) 100 * PAGE_SIZE);
+    for (unsigned i = 0; i < 100; i++) {
+        memset(pages.data() + (size_t) i * PAGE_SIZE, i + 1, PAGE_SIZE);
+    }
+    rc = fileHandle.appendPage(pages.data());
+    assert(rc == success && "Appending a page should not fail.");
+    getFileSizes(fileName, size, allocated);
+    if (fileHandle.allocatedPageCounter != DEFAULT_EXTENT_PAGES || size != 2 * PAGE_SIZE ||
+        allocated < (off_t) (DEFAULT_EXTENT_PAGES + 1) * PAGE_SIZE) {
+        std::cout << "One page allocated " << allocated << " bytes, the file has " << size << "." << std::endl;
+        failed = true;
+    }
+
+    // 2. pages 1 to 99 reach into the second extent
+    rc = fileHandle.appendPages(99, pages.data() + PAGE_SIZE);
+    assert(rc == success && "Appending pages should not fail.");
+    getFileSizes(fileName, size, allocated);
+    if (fileHandle.getNumberOfPages() != 100 || fileHandle.allocatedPageCounter != 2 * DEFAULT_EXTENT_PAGES ||
+        size != 101 * PAGE_SIZE) {
+        failed = true;
+    }
+
+    // 3.
+    rc = pfm.closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    rc = pfm.openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    std::vector<char> readBack(pages.size());
+    rc = fileHandle.readPages(0, 100, readBack.data());
+    assert(rc == success && "Reading pages should not fail.");
+    if (fileHandle.getNumberOfPages() != 100 || fileHandle.allocatedPageCounter != 100 || readBack != pages) {
+        failed = true;
+    }
+
+    // 4.
+    rc = pfm.setExtentPages(0);
+    assert(rc == success && "Setting the extent size should not fail.");
+    rc = fileHandle.appendPage(pages.data());
+    assert(rc == success && "Appending a page should not fail.");
+    if (fileHandle.getNumberOfPages() != 101 || fileHandle.allocatedPageCounter != 100) {
+        failed = true;
+    }
+    rc = pfm.setExtentPages(DEFAULT_EXTENT_PAGES);
+    assert(rc == success && "Setting the extent size should not fail.");
+
+    rc = pfm.closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    getFileSizes(fileName, size, allocated);
+    if (size != 102 * PAGE_SIZE) {
+        failed = true;
+    }
+
+    rc = pfm.destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    rc = destroyFileShouldSucceed(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    if (failed) {
+        std::cout << "[FAIL] Test Case Extent Failed!" << std::endl << std::endl;
+        return -1;
+    }
+
+    std::cout << "RBF Test Case Extent Finished! The result will be examined." << std::endl << std::endl;
+
+    return 0;
+}
+
+int main() {
+    // To test the allocation of files in extents under the paged file manager
+    remove("test_extent");
+
+    return RBFTest_Extent(PagedFileManager::instance());
+}
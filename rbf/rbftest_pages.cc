@@ -0,0 +1,124 @@
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+int RBFTest_Pages(PagedFileManager &pfm) {
+    // Functions tested
+    // 1. Append many pages in one call
+    // 2. Read consecutive pages, a dirty page in the buffer pool wins over the file
+    // 3. Write consecutive pages, the frames in the pool follow
+    // 4. Ranges past the end of the file fail
+    // 5. Read consecutive pages of a mapped file, writes fail
+    std::cout << std::endl << "***** In RBF Test Case Pages *****" << std::endl;
+
+    RC rc;
+    std::string fileName = "test_pages";
+
+    rc = pfm.createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    FileHandle fileHandle;
+    rc = pfm.openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    // 1.
+    unsigned numPages = 100;
+    std::vector<char> pages((size_t) numPages * PAGE_SIZE);
+    for (unsigned i = 0; i < numPages; i++) {
+        memset(pages.data() + (size_t) i * PAGE_SIZE, i, PAGE_SIZE);
+    }
+    rc = fileHandle.appendPages(numPages, pages.data());
+    assert(rc == success && "Appending pages should not fail.");
+    unsigned readPageCount, writePageCount, appendPageCount;
+    fileHandle.collectCounterValues(readPageCount, writePageCount, appendPageCount);
+    bool failed = fileHandle.getNumberOfPages() != numPages || appendPageCount != numPages;
+
+    // 2.
+    void *frame;
+    rc = fileHandle.pinPage(50, frame);
+    assert(rc == success && "Pinning a page should not fail.");
+    memset(frame, 'x', PAGE_SIZE);
+    rc = fileHandle.unpinPage(50, true);
+    assert(rc == success && "Unpinning a page should not fail.");
+    memset(pages.data() + (size_t) 50 * PAGE_SIZE, 'x', PAGE_SIZE);
+
+    std::vector<char> readBack(pages.size());
+    rc = fileHandle.readPages(0, numPages, readBack.data());
+    assert(rc == success && "Reading pages should not fail.");
+    if (readBack != pages) {
+        std::cout << "The pages read back differ." << std::endl;
+        failed = true;
+    }
+
+    // 3. page 15 stays in the pool while its page on disk changes
+    rc = fileHandle.pinPage(15, frame);
+    assert(rc == success && "Pinning a page should not fail.");
+    for (unsigned i = 10; i < 30; i++) {
+        memset(pages.data() + (size_t) i * PAGE_SIZE, 'a' + i, PAGE_SIZE);
+    }
+    rc = fileHandle.writePages(10, 20, pages.data() + (size_t) 10 * PAGE_SIZE);
+    assert(rc == success && "Writing pages should not fail.");
+    if (((char *) frame)[0] != 'a' + 15) {
+        std::cout << "The frame of a page written was not updated." << std::endl;
+        failed = true;
+    }
+    rc = fileHandle.unpinPage(15, false);
+    assert(rc == success && "Unpinning a page should not fail.");
+
+    // 4.
+    if (fileHandle.readPages(90, 20, readBack.data()) != -1 ||
+        fileHandle.writePages(95, 10, pages.data()) != -1) {
+        failed = true;
+    }
+
+    rc = pfm.closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    rc = BufferManager::instance().setFrameCount(DEFAULT_FRAME_COUNT);
+    assert(rc == success && "Resizing an idle pool should not fail.");
+
+    rc = pfm.openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    rc = fileHandle.readPages(0, numPages, readBack.data());
+    assert(rc == success && "Reading pages should not fail.");
+    if (readBack != pages) {
+        std::cout << "The pages on disk differ." << std::endl;
+        failed = true;
+    }
+    rc = pfm.closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    // 5.
+    rc = pfm.openFile(fileName, fileHandle, true);
+    assert(rc == success && "Opening the file mapped should not fail.");
+    std::fill(readBack.begin(), readBack.end(), 0);
+    if (fileHandle.readPages(0, numPages, readBack.data()) != success || readBack != pages) {
+        failed = true;
+    }
+    if (fileHandle.writePages(0, 1, pages.data()) != -1 || fileHandle.appendPages(1, pages.data()) != -1) {
+        failed = true;
+    }
+    rc = pfm.closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    rc = pfm.destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    rc = destroyFileShouldSucceed(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    if (failed) {
+        std::cout << "[FAIL] Test Case Pages Failed!" << std::endl << std::endl;
+        return -1;
+    }
+
+    std::cout << "RBF Test Case Pages Finished! The result will be examined." << std::endl << std::endl;
+
+    return 0;
+}
+
+int main() {
+    // To test the multi-page reads and writes of the paged file manager
+    remove("test_pages");
+
+    return RBFTest_Pages(PagedFileManager::instance());
+}
@@ -0,0 +1,155 @@
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+// overwrite pages on disk behind the buffer pool, a page read ahead before keeps its old content
+static RC overwritePages(FileHandle &fileHandle, PageNum first, PageNum last, char value) {
+    std::vector<char> page(PAGE_SIZE, value);
+    IOBatch batch;
+    for (PageNum i = first; i < last; i++) {
+        batch.write(fileHandle, i, page.data());
+    }
+    return batch.wait();
+}
+
+// pages from first on that were read before the disk changed
+static unsigned countOldPages(FileHandle &fileHandle, PageNum first, PageNum last) {
+    unsigned count = 0;
+    for (PageNum i = first; i < last; i++) {
+        void *data;
+        if (fileHandle.pinPage(i, data) != success) {
+            break;
+        }
+        bool old = ((char *) data)[0] == (char) i && ((char *) data)[PAGE_SIZE - 1] == (char) i;
+        fileHandle.unpinPage(i, false);
+        if (!old) {
+            break;
+        }
+        count++;
+    }
+    return count;
+}
+
+int RBFTest_Readahead(PagedFileManager &pfm) {
+    // Functions tested
+    // 1. Sequential pins read ahead, the window grows while the access stays sequential
+    // 2. Pins in no order read nothing ahead
+    // 3. One pin of the first page of a fresh handle reads nothing ahead
+    // 4. Readahead of a mapped file
+    std::cout << std::endl << "***** In RBF Test Case Readahead *****" << std::endl;
+
+    RC rc;
+    std::string fileName = "test_readahead";
+    BufferManager &bm = BufferManager::instance();
+
+    rc = pfm.createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    FileHandle fileHandle;
+    rc = pfm.openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    unsigned numPages = 200;
+    std::vector<char> page(PAGE_SIZE);
+    for (unsigned i = 0; i < numPages; i++) {
+        memset(page.data(), i, PAGE_SIZE);
+        rc = fileHandle.appendPage(page.data());
+        assert(rc == success && "Appending a page should not fail.");
+    }
+    // start from an empty pool
+    rc = bm.setFrameCount(DEFAULT_FRAME_COUNT);
+    assert(rc == success && "Resizing an idle pool should not fail.");
+
+    // 1. ten pages in order, then wait for the reads in flight
+    bool failed = countOldPages(fileHandle, 0, 10) != 10;
+    rc = bm.flushFile(fileHandle);
+    assert(rc == success && "Flushing the file should not fail.");
+    rc = overwritePages(fileHandle, 10, numPages, 'z');
+    assert(rc == success && "Writing the pages should not fail.");
+    unsigned readAhead = countOldPages(fileHandle, 10, numPages);
+    if (readAhead < READAHEAD_MAX_PAGES / 2 || readAhead + 10 >= numPages) {
+        std::cout << readAhead << " pages were read ahead of page 10." << std::endl;
+        failed = true;
+    }
+
+    // 2. jumps around the file
+    rc = overwritePages(fileHandle, 0, numPages, 0);
+    assert(rc == success && "Writing the pages should not fail.");
+    rc = bm.setFrameCount(DEFAULT_FRAME_COUNT);
+    assert(rc == success && "Resizing an idle pool should not fail.");
+    for (PageNum i : {150, 120, 90, 60}) {
+        void *data;
+        rc = fileHandle.pinPage(i, data);
+        assert(rc == success && "Pinning a page should not fail.");
+        fileHandle.unpinPage(i, false);
+    }
+    rc = bm.flushFile(fileHandle);
+    assert(rc == success && "Flushing the file should not fail.");
+    rc = overwritePages(fileHandle, 0, numPages, 'y');
+    assert(rc == success && "Writing the pages should not fail.");
+    for (PageNum i : {151, 121, 91}) {
+        rc = fileHandle.readPage(i, page.data());
+        assert(rc == success && "Reading a page should not fail.");
+        if (page[0] != 'y') {
+            std::cout << "Page " << i << " was read ahead of a random access." << std::endl;
+            failed = true;
+        }
+    }
+    rc = pfm.closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    // 3. page 0 is the directory page every insert and every lookup pins first
+    {
+        FileHandle freshHandle;
+        rc = pfm.openFile(fileName, freshHandle);
+        assert(rc == success && "Opening the file should not fail.");
+        rc = bm.setFrameCount(DEFAULT_FRAME_COUNT);
+        assert(rc == success && "Resizing an idle pool should not fail.");
+        rc = freshHandle.readPage(0, page.data());
+        assert(rc == success && "Reading a page should not fail.");
+        rc = bm.flushFile(freshHandle);
+        assert(rc == success && "Flushing the file should not fail.");
+        rc = overwritePages(freshHandle, 1, 1 + READAHEAD_MIN_PAGES, 'w');
+        assert(rc == success && "Writing the pages should not fail.");
+        std::vector<char> pages((size_t) READAHEAD_MIN_PAGES * PAGE_SIZE);
+        rc = freshHandle.readPages(1, READAHEAD_MIN_PAGES, pages.data());
+        assert(rc == success && "Reading pages should not fail.");
+        if (pages != std::vector<char>(pages.size(), 'w')) {
+            std::cout << "Pages were read ahead of a single pin of page 0." << std::endl;
+            failed = true;
+        }
+        rc = pfm.closeFile(freshHandle);
+        assert(rc == success && "Closing the file should not fail.");
+    }
+
+    // 4.
+    rc = pfm.openFile(fileName, fileHandle, true);
+    assert(rc == success && "Opening the file mapped should not fail.");
+    if (fileHandle.readahead(0, numPages) != success || fileHandle.readahead(numPages, 4) != success) {
+        failed = true;
+    }
+    rc = pfm.closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+
+    rc = pfm.destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    rc = destroyFileShouldSucceed(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    if (failed) {
+        std::cout << "[FAIL] Test Case Readahead Failed!" << std::endl << std::endl;
+        return -1;
+    }
+
+    std::cout << "RBF Test Case Readahead Finished! The result will be examined." << std::endl << std::endl;
+
+    return 0;
+}
+
+int main() {
+    // To test the readahead of sequential pins under the paged file manager
+    remove("test_readahead");
+
+    return RBFTest_Readahead(PagedFileManager::instance());
+}
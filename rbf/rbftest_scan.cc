@@ -0,0 +1,137 @@
+#include "pfm.h"
+#include "rbfm.h"
+#include "test_util.h"
+
+int RBFTest_Scan(RecordBasedFileManager &rbfm) {
+    // Functions tested
+    // 1. Insert Record
+    // 2. Update Record so that it moves to another page
+    // 3. Scan with a condition and a projection
+    // 4. A moved record is returned once, under its original RID
+    // 5. A scan dropped without close releases its page and its file
+    std::cout << std::endl << "***** In RBF Test Case Scan *****" << std::endl;
+
+    RC rc;
+    std::string fileName = "test_scan";
+
+    rc = rbfm.createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    FileHandle fileHandle;
+    rc = rbfm.openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+
+    std::vector<Attribute> recordDescriptor;
+    createRecordDescriptor(recordDescriptor);
+
+    int nullFieldsIndicatorActualSize = getActualByteForNullsIndicator(recordDescriptor.size());
+    auto *nullsIndicator = (unsigned char *) malloc(nullFieldsIndicatorActualSize);
+
+    void *record = malloc(PAGE_SIZE);
+    void *returnedData = malloc(PAGE_SIZE);
+    int recordSize = 0;
+    std::string longName(2500, 'b');
+    std::string name(1000, 'a');
+
+    // about three records per page
+    int numRecords = 12;
+    std::vector<RID> rids;
+    for (int i = 0; i < numRecords; i++) {
+        memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+        // the last record has a NULL age
+        if (i == numRecords - 1) {
+            nullsIndicator[0] = 64;
+        }
+        prepareRecord(recordDescriptor.size(), nullsIndicator, name.size(), name, i, 170.0, 1000 + i, record,
+                      &recordSize);
+        RID rid;
+        rc = rbfm.insertRecord(fileHandle, recordDescriptor, record, rid);
+        assert(rc == success && "Inserting a record should not fail.");
+        rids.push_back(rid);
+    }
+
+    // grow the first record, it no longer fits into its page
+    memset(nullsIndicator, 0, nullFieldsIndicatorActualSize);
+    prepareRecord(recordDescriptor.size(), nullsIndicator, longName.size(), longName, 0, 170.0, 1000, record,
+                  &recordSize);
+    rc = rbfm.updateRecord(fileHandle, recordDescriptor, record, rids[0]);
+    assert(rc == success && "Updating a record should not fail.");
+
+    // Age >= 0 AND project (Salary, EmpName)
+    int minAge = 0;
+    std::vector<std::string> attributeNames;
+    attributeNames.emplace_back("Salary");
+    attributeNames.emplace_back("EmpName");
+
+    RBFM_ScanIterator rbfmScanIterator;
+    rc = rbfm.scan(fileHandle, recordDescriptor, "Age", GE_OP, &minAge, attributeNames, rbfmScanIterator);
+    assert(rc == success && "Scanning a file should not fail.");
+
+    RID rid;
+    int count = 0;
+    bool failed = false;
+    while (rbfmScanIterator.getNextRecord(rid, returnedData) != RBFM_EOF) {
+        count++;
+        int salary;
+        unsigned nameLength;
+        memcpy(&salary, (char *) returnedData + 1, sizeof(int));
+        memcpy(&nameLength, (char *) returnedData + 1 + sizeof(int), sizeof(unsigned));
+        int i = salary - 1000;
+        if ((*(unsigned char *) returnedData & 0xC0) != 0 || i < 0 || i >= numRecords - 1 ||
+            rid.pageNum != rids[i].pageNum || rid.slotNum != rids[i].slotNum ||
+            nameLength != (i == 0 ? longName.size() : name.size())) {
+            failed = true;
+        }
+    }
+    // closing the iterator also closes the file
+    rbfmScanIterator.close();
+    // a second close does nothing
+    rc = rbfmScanIterator.close();
+    assert(rc == success && "Closing a closed scan should not fail.");
+
+    // 5. the first page of the scan is still pinned when the iterator goes away
+    rc = rbfm.openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    {
+        RBFM_ScanIterator droppedIterator;
+        rc = rbfm.scan(fileHandle, recordDescriptor, "Age", GE_OP, &minAge, attributeNames, droppedIterator);
+        assert(rc == success && "Scanning a file should not fail.");
+        if (droppedIterator.getNextRecord(rid, returnedData) == RBFM_EOF) {
+            failed = true;
+        }
+    }
+    if (fileHandle.fs.is_open() || BufferManager::instance().setFrameCount(DEFAULT_FRAME_COUNT) != success) {
+        std::cout << "A dropped scan kept its page pinned or its file open." << std::endl;
+        failed = true;
+    }
+
+    if (failed || count != numRecords - 1) {
+        std::cout << "[FAIL] Test Case Scan Failed! " << count << " records returned." << std::endl << std::endl;
+        rbfm.destroyFile(fileName);
+        free(record);
+        free(returnedData);
+        free(nullsIndicator);
+        return -1;
+    }
+
+    rc = rbfm.destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    rc = destroyFileShouldSucceed(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    free(record);
+    free(returnedData);
+    free(nullsIndicator);
+
+    std::cout << "RBF Test Case Scan Finished! The result will be examined." << std::endl << std::endl;
+
+    return 0;
+}
+
+int main() {
+    // To test the page-at-a-time scan of the record-based file manager
+    remove("test_scan");
+
+    return RBFTest_Scan(RecordBasedFileManager::instance());
+}
@@ -2,6 +2,9 @@
 #include <utility>
 #include <algorithm>
 #include <iostream>
+#include <limits>
+#include <random>
+#include <set>
 
 RelationManager &RelationManager::instance() {
     static RelationManager _relation_manager = RelationManager();
@@ -31,6 +34,15 @@ RelationManager::RelationManager() {
     appendAttr(indexAttr, "attr-index", TypeInt, 4);
     appendAttr(indexAttr, "file-name", TypeVarChar, 50);
 
+    appendAttr(statisticsAttr, "table-name", TypeVarChar, 50);
+    appendAttr(statisticsAttr, "column-position", TypeInt, 4);
+    appendAttr(statisticsAttr, "row-count", TypeInt, 4);
+    appendAttr(statisticsAttr, "page-count", TypeInt, 4);
+    appendAttr(statisticsAttr, "avg-length", TypeInt, 4);
+    appendAttr(statisticsAttr, "null-count", TypeInt, 4);
+    appendAttr(statisticsAttr, "distinct-count", TypeInt, 4);
+    appendAttr(statisticsAttr, "histogram", TypeVarChar, STATISTICS_HISTOGRAM_SIZE);
+
     tableNameToAttrMap[TABLES_NAME] = tableAttr;
     tableNameToAttrMap[COLUMNS_NAME] = columnAttr;
 
@@ -49,6 +61,10 @@ RelationManager::RelationManager() {
         indexAttrNames.push_back(it.name);
     }
 
+    for (const auto & it : statisticsAttr) {
+        statisticsAttrNames.push_back(it.name);
+    }
+
     if (PagedFileManager::exists_test(TABLES_FILE_NAME)) {
         // read physical file into memory hashmap
         initScanTablesOrColumns(true);
@@ -56,6 +72,11 @@ RelationManager::RelationManager() {
         
         // scan all index file
         initScanIndex();
+
+        // the statistics table only exists once a table was analyzed
+        if (tableNameToFileMap.count(STATISTICS_NAME) != 0) {
+            initScanStatistics();
+        }
     } else {
         // do nothing
     }
@@ -63,6 +84,8 @@ RelationManager::RelationManager() {
 }
 
 RelationManager::~RelationManager() {
+    closeHandles();
+
     // destroy index file, write index tuple into new file
     rbfm->destroyFile(INDEX_FILE_NAME);
     rbfm->createFile(INDEX_FILE_NAME);
@@ -118,6 +141,7 @@ RC RelationManager::createCatalog() {
 }
 
 RC RelationManager::deleteCatalog() {
+    closeHandles();
     rbfm->destroyFile(TABLES_FILE_NAME);
     rbfm->destroyFile(COLUMNS_FILE_NAME);
 
@@ -139,6 +163,8 @@ RC RelationManager::deleteCatalog() {
     tableNameToAttrMap.clear();
     tNANToIndexFile.clear();
     indexMap.clear();
+    statisticsMap.clear();
+    mappedTables.clear();
 
     return 0;
 }
@@ -197,7 +223,7 @@ RC RelationManager::deleteTable(const std::string &tableName) {
 
     RID rid;
     void *data = malloc(PAGE_SIZE);
-    while (rmsi_table.getNextTuple(rid, data) != RM_EOF) {
+    while (rmsi_table.getNextTuple(rid, data) == 0) {
         std::string tupleTableName, fileName;
         unsigned id;
         bool _;
@@ -213,7 +239,7 @@ RC RelationManager::deleteTable(const std::string &tableName) {
     // delete column tuple in COLUMNS
     RM_ScanIterator rmsi_column;
     scan(COLUMNS_NAME, NULL_STRING, NO_OP, nullptr, columnAttributeNames, rmsi_column);
-    while (rmsi_column.getNextTuple(rid, data) != RM_EOF) {
+    while (rmsi_column.getNextTuple(rid, data) == 0) {
         std::string tupleTableName, fileName;
         Attribute attr;
         unsigned tupleID, position;
@@ -228,15 +254,19 @@ RC RelationManager::deleteTable(const std::string &tableName) {
 
     std::string fileName = tableNameToFileMap[tableName];
 
+    deleteStatistics(tableName);
+
     // delete index file
     for (const auto & it : indexMap[tableName]) {
         Attribute attr = tableNameToAttrMap[tableName][it];
         std::string indexNameHash = getIndexNameHash(tableName, attr.name);
+        closeHandle(tNANToIndexFile[indexNameHash]);
         rbfm->destroyFile(tNANToIndexFile[indexNameHash]);
         tNANToIndexFile.erase(indexNameHash);
     }
     indexMap.erase(tableName);
 
+    closeHandle(fileName);
     rbfm->destroyFile(fileName);
     tableNameToFileMap.erase(tableName);
 
@@ -245,6 +275,7 @@ RC RelationManager::deleteTable(const std::string &tableName) {
 
     tableNameToIsSystemTableMap.erase(tableName);
     tableNameToAttrMap.erase(tableName);
+    mappedTables.erase(tableName);
 
     return 0;
 }
@@ -271,19 +302,17 @@ RC RelationManager::insertTuple(const std::string &tableName, const void *data,
         return -1;
     }
 
-    std::string fileName = tableNameToFileMap[tableName];
-    FileHandle fileHandle;
-    rbfm->openFile(fileName, fileHandle);
+    FileHandle *fileHandle = getFileHandle(tableNameToFileMap[tableName]);
+    if (fileHandle == nullptr) {
+        return -1;
+    }
 
     auto attrs = tableNameToAttrMap[tableName];
 
-    if (rbfm->insertRecord(fileHandle, attrs, data, rid) != 0) {
-        rbfm->closeFile(fileHandle);
+    if (rbfm->insertRecord(*fileHandle, attrs, data, rid) != 0) {
         return -1;
     }
 
-    rbfm->closeFile(fileHandle);
-
     void* key = malloc(PAGE_SIZE);
 
     // insert into index file
@@ -293,21 +322,70 @@ RC RelationManager::insertTuple(const std::string &tableName, const void *data,
 
         Attribute attr = attrs[i];
         std::string indexFileName = tNANToIndexFile[getIndexNameHash(tableName, attr.name)];
-        IXFileHandle ixFileHandle;
-        int rc = 0;
-        rc = im->openFile(indexFileName, ixFileHandle);
-        if (rc == -1) {
+        IXFileHandle *ixFileHandle = getIXFileHandle(indexFileName);
+        if (ixFileHandle == nullptr) {
             throw std::logic_error("INSERT IX FILE FAILED");
         }
-        rc = im->insertEntry(ixFileHandle, attr, key, rid);
+        int rc = im->insertEntry(*ixFileHandle, attr, key, rid);
         if (rc == -1) {
             throw std::logic_error("INSERT IX FILE FAILED");
         }
-//        std::cout << ixFileHandle.fileHandle.appendPageCounter << std::endl;
-        rc = im->closeFile(ixFileHandle);
-        if (rc == -1) {
+    }
+
+    free(key);
+    return 0;
+}
+
+RC RelationManager::insertTuples(const std::string &tableName, const std::vector<const void *> &tuples,
+                                 std::vector<RID> &rids) {
+    if (tableNameToAttrMap.count(tableName) == 0 || tableNameToIsSystemTableMap[tableName]) {
+        return -1;
+    }
+
+    FileHandle *fileHandle = getFileHandle(tableNameToFileMap[tableName]);
+    if (fileHandle == nullptr) {
+        return -1;
+    }
+
+    auto attrs = tableNameToAttrMap[tableName];
+    if (rbfm->insertRecords(*fileHandle, attrs, tuples, rids) != 0) {
+        return -1;
+    }
+
+    void* key = malloc(PAGE_SIZE);
+
+    // sort the entries of each index, an empty index is built bottom-up,
+    // otherwise consecutive inserts land on the same leaf pages
+    for (const auto & i : indexMap[tableName]) {
+        Attribute attr = attrs[i];
+        IX_BulkLoader loader(attr);
+        for (unsigned j = 0; j < tuples.size(); j++) {
+            RecordBasedFileManager::readAttributeFromRawData(tuples[j], key, attrs, "", i);
+            if (loader.addEntry(key, rids[j]) == -1) {
+                throw std::logic_error("INSERT IX FILE FAILED");
+            }
+        }
+
+        std::string indexFileName = tNANToIndexFile[getIndexNameHash(tableName, attr.name)];
+        IXFileHandle *ixFileHandle = getIXFileHandle(indexFileName);
+        if (ixFileHandle == nullptr) {
             throw std::logic_error("INSERT IX FILE FAILED");
         }
+        if (IndexManager::isEmpty(*ixFileHandle)) {
+            if (im->bulkLoad(*ixFileHandle, loader) == -1) {
+                throw std::logic_error("INSERT IX FILE FAILED");
+            }
+            continue;
+        }
+        if (loader.sortEntries() == -1) {
+            throw std::logic_error("INSERT IX FILE FAILED");
+        }
+        RID rid;
+        while (loader.getNextKey(key, rid) != IX_EOF) {
+            if (im->insertEntry(*ixFileHandle, attr, key, rid) == -1) {
+                throw std::logic_error("INSERT IX FILE FAILED");
+            }
+        }
     }
 
     free(key);
@@ -327,9 +405,10 @@ RC RelationManager::deleteTuple(const std::string &tableName, const RID &rid, bo
         return -1;
     }
 
-    std::string fileName = tableNameToFileMap[tableName];
-    FileHandle fileHandle;
-    rbfm->openFile(fileName, fileHandle);
+    FileHandle *fileHandle = getFileHandle(tableNameToFileMap[tableName]);
+    if (fileHandle == nullptr) {
+        return -1;
+    }
 
     auto attrs = tableNameToAttrMap[tableName];
 
@@ -345,15 +424,14 @@ RC RelationManager::deleteTuple(const std::string &tableName, const RID &rid, bo
 
         Attribute attr = attrs[i];
         std::string indexFileName = tNANToIndexFile[getIndexNameHash(tableName, attr.name)];
-        IXFileHandle ixFileHandle;
-        im->openFile(indexFileName, ixFileHandle);
-        im->deleteEntry(ixFileHandle, attr, key, rid);
-        im->closeFile(ixFileHandle);
+        IXFileHandle *ixFileHandle = getIXFileHandle(indexFileName);
+        if (ixFileHandle != nullptr) {
+            im->deleteEntry(*ixFileHandle, attr, key, rid);
+        }
     }
 
-    int rc = rbfm->deleteRecord(fileHandle, attrs, rid);
+    int rc = rbfm->deleteRecord(*fileHandle, attrs, rid);
 
-    rbfm->closeFile(fileHandle);
     free(data);
     free(key);
 
@@ -382,27 +460,25 @@ RC RelationManager::updateTuple(const std::string &tableName, const void *data,
 
         Attribute attr = attrs[i];
         std::string indexFileName = tNANToIndexFile[getIndexNameHash(tableName, attr.name)];
-        IXFileHandle ixFileHandle;
-        im->openFile(indexFileName, ixFileHandle);
-        im->deleteEntry(ixFileHandle, attr, key, rid);
+        IXFileHandle *ixFileHandle = getIXFileHandle(indexFileName);
+        if (ixFileHandle == nullptr) {
+            continue;
+        }
+        im->deleteEntry(*ixFileHandle, attr, key, rid);
 
         // get new key from data
         RecordBasedFileManager::readAttributeFromRawData(data, key, attrs, "", i);
-        im->insertEntry(ixFileHandle, attr, key, rid);
-        im->closeFile(ixFileHandle);
+        im->insertEntry(*ixFileHandle, attr, key, rid);
     }
 
-    std::string fileName = tableNameToFileMap[tableName];
-    FileHandle fileHandle;
-    rbfm->openFile(fileName, fileHandle);
-
-    int rc = rbfm->updateRecord(fileHandle, attrs, data, rid);
-
     free(oldData);
     free(key);
 
-    rbfm->closeFile(fileHandle);
-    return rc;
+    FileHandle *fileHandle = getFileHandle(tableNameToFileMap[tableName]);
+    if (fileHandle == nullptr) {
+        return -1;
+    }
+    return rbfm->updateRecord(*fileHandle, attrs, data, rid);
 }
 
 RC RelationManager::readTuple(const std::string &tableName, const RID &rid, void *data) {
@@ -410,20 +486,36 @@ RC RelationManager::readTuple(const std::string &tableName, const RID &rid, void
         return -1;
     }
 
-    std::string fileName = tableNameToFileMap[tableName];
-    FileHandle fileHandle;
-    rbfm->openFile(fileName, fileHandle);
+    FileHandle *fileHandle = getFileHandle(tableNameToFileMap[tableName]);
+    if (fileHandle == nullptr) {
+        return -1;
+    }
 
     auto attrs = tableNameToAttrMap[tableName];
-    if (rbfm->readRecord(fileHandle, attrs, rid, data) != 0) {
-        rbfm->closeFile(fileHandle);
+    if (rbfm->readRecord(*fileHandle, attrs, rid, data) != 0) {
         return -1;
     }
-
-    rbfm->closeFile(fileHandle);
     return 0;
 }
 
+RC RelationManager::prefetchTuples(const std::string &tableName, const std::vector<RID> &rids) {
+    if (tableNameToAttrMap.count(tableName) == 0) {
+        return -1;
+    }
+
+    FileHandle *fileHandle = getFileHandle(tableNameToFileMap[tableName]);
+    if (fileHandle == nullptr) {
+        return -1;
+    }
+
+    // a page shared by several tuples is read once, redirected records are left to readTuple
+    std::vector<PageNum> pageNums;
+    for (const RID &rid : rids) {
+        pageNums.push_back(rid.pageNum);
+    }
+    return fileHandle->prefetchPages(pageNums);
+}
+
 RC RelationManager::printTuple(const std::vector<Attribute> &attrs, const void *data) {
     return rbfm->printRecord(attrs, data);
 }
@@ -434,17 +526,15 @@ RC RelationManager::readAttribute(const std::string &tableName, const RID &rid,
         return -1;
     }
 
-    std::string fileName = tableNameToFileMap[tableName];
-    FileHandle fileHandle;
-    rbfm->openFile(fileName, fileHandle);
+    FileHandle *fileHandle = getFileHandle(tableNameToFileMap[tableName]);
+    if (fileHandle == nullptr) {
+        return -1;
+    }
 
     auto attrs = tableNameToAttrMap[tableName];
-    if (rbfm->readAttribute(fileHandle, attrs, rid, attributeName, data) != 0) {
-        rbfm->closeFile(fileHandle);
+    if (rbfm->readAttribute(*fileHandle, attrs, rid, attributeName, data) != 0) {
         return -1;
     }
-
-    rbfm->closeFile(fileHandle);
     return 0;
 }
 
@@ -568,7 +658,7 @@ void RelationManager::initScanTablesOrColumns(bool isTables) {
 
     RID rid;
     void *data = malloc(PAGE_SIZE);
-    while (rmsi.getNextTuple(rid, data) != RM_EOF) {
+    while (rmsi.getNextTuple(rid, data) == 0) {
         if (isTables) {
             std::string tableName, fileName;
             unsigned id;
@@ -635,7 +725,7 @@ void RelationManager::initScanIndex() {
 
     RID rid;
     void *data = malloc(PAGE_SIZE);
-    while (rmsi.getNextTuple(rid, data) != RBFM_EOF) {
+    while (rmsi.getNextTuple(rid, data) == 0) {
         std::string tableName, attrName, fileName;
         int index;
         parseIndexData(data, tableName, attrName, index, fileName);
@@ -740,17 +830,40 @@ RC RelationManager::scan(const std::string &tableName,
                          const void *value,
                          const std::vector<std::string> &attributeNames,
                          RM_ScanIterator &rm_ScanIterator) {
+    return scan(tableName,
+                RecordBasedFileManager::getConditionPredicate(tableNameToAttrMap[tableName], conditionAttribute,
+                                                              compOp, value),
+                attributeNames, rm_ScanIterator);
+}
+
+RC RelationManager::scan(const std::string &tableName,
+                         const Predicate &predicate,
+                         const std::vector<std::string> &attributeNames,
+                         RM_ScanIterator &rm_ScanIterator) {
     std::string fileName = tableNameToFileMap[tableName];
-    rbfm->openFile(fileName, rm_ScanIterator.fileHandle);
+    // the scan reads the page count from the header, make it current first
+    flushHandle(fileName);
+    rbfm->openFile(fileName, rm_ScanIterator.fileHandle, mappedTables.count(tableName) != 0);
 
     std::vector<Attribute> recordDescriptor = tableNameToAttrMap[tableName];
 
-    rbfm->scan(rm_ScanIterator.fileHandle, recordDescriptor, conditionAttribute, compOp, value, attributeNames,
-               rm_ScanIterator.rbfmsi);
+    rbfm->scan(rm_ScanIterator.fileHandle, recordDescriptor, predicate, attributeNames, rm_ScanIterator.rbfmsi);
 
     return 0;
 }
 
+RC RelationManager::setMappedScans(const std::string &tableName, bool mapped) {
+    if (tableNameToFileMap.count(tableName) == 0) {
+        return -1;
+    }
+    if (mapped) {
+        mappedTables.insert(tableName);
+    } else {
+        mappedTables.erase(tableName);
+    }
+    return 0;
+}
+
 RC RelationManager::addAttribute(const std::string &tableName, const Attribute &attr) {
     return -1;
 }
@@ -812,18 +925,27 @@ RC RelationManager::createIndex(const std::string &tableName, const std::string
 
     scan(tableName, attributeName, NO_OP, nullptr, attributeNames, *rmsi);
 
+    // collect every (key, RID) first and build the tree bottom-up instead of inserting one by one
     RID rid;
     void *data = malloc(PAGE_SIZE);
-    IXFileHandle ixFileHandle;
-    im->openFile(indexFileName, ixFileHandle);
+    IX_BulkLoader loader(targetAttribute);
     void *key = malloc(PAGE_SIZE);
-    while(rmsi->getNextTuple(rid, data) != RM_EOF){
+    RC scanRC;
+    while ((scanRC = rmsi->getNextTuple(rid, data)) == 0) {
         RecordBasedFileManager::readAttributeFromRawData(data, key, attrs, "", index);
-        int rc = im->insertEntry(ixFileHandle, targetAttribute, key, rid);
+        int rc = loader.addEntry(key, rid);
         if (rc == -1) {
             throw std::logic_error("INSERT INDEX ERROR");
         }
     }
+    if (scanRC == RM_ERROR) {
+        throw std::logic_error("INSERT INDEX ERROR");
+    }
+    IXFileHandle ixFileHandle;
+    im->openFile(indexFileName, ixFileHandle);
+    if (im->bulkLoad(ixFileHandle, loader) == -1) {
+        throw std::logic_error("INSERT INDEX ERROR");
+    }
     int rc = im->closeFile(ixFileHandle);
     if (rc == -1) {
         throw std::logic_error("CLOSE IX FILE FAILED");
@@ -837,8 +959,9 @@ RC RelationManager::createIndex(const std::string &tableName, const std::string
 }
 
 RC RelationManager::destroyIndex(const std::string &tableName, const std::string &attributeName) {
-    std::string filename = tNANToIndexFile[attributeName];
     std::string indexHashName = getIndexNameHash(tableName, attributeName);
+    std::string filename = tNANToIndexFile[indexHashName];
+    closeHandle(filename);
     tNANToIndexFile.erase(indexHashName);
     auto attrs = tableNameToAttrMap[tableName];
     int index = RecordBasedFileManager::getAttrIndex(attrs, attributeName);
@@ -865,7 +988,8 @@ RC RelationManager::indexScan(const std::string &tableName,
 
     std::string indexNameHash = getIndexNameHash(tableName, targetAttribute.name);
     std::string indexFileName = tNANToIndexFile[indexNameHash];
-    im->openFile(indexFileName, rm_IndexScanIterator.ixFileHandle);
+    flushHandle(indexFileName);
+    im->openFile(indexFileName, rm_IndexScanIterator.ixFileHandle, mappedTables.count(tableName) != 0);
     im->scan(rm_IndexScanIterator.ixFileHandle, targetAttribute, lowKey, highKey, lowKeyInclusive, highKeyInclusive,
              rm_IndexScanIterator.ixsi);
 
@@ -876,6 +1000,366 @@ std::string RelationManager::getIndexNameHash(const std::string& tableName, cons
     return tableName + '_' + attrName;
 }
 
+RC RelationManager::flushHandles() {
+    RC rc = 0;
+    for (const auto &fileName : handleLru) {
+        if (flushHandle(fileName) == -1) {
+            rc = -1;
+        }
+    }
+    return rc;
+}
+
+RC RelationManager::closeHandles() {
+    RC rc = 0;
+    while (!handleLru.empty()) {
+        if (closeHandle(handleLru.front()) == -1) {
+            rc = -1;
+        }
+    }
+    return rc;
+}
+
+FileHandle *RelationManager::getFileHandle(const std::string &fileName) {
+    auto it = fileHandleCache.find(fileName);
+    if (it != fileHandleCache.end()) {
+        handleLru.splice(handleLru.begin(), handleLru, it->second.second);
+        return it->second.first;
+    }
+
+    auto *fileHandle = new FileHandle();
+    if (rbfm->openFile(fileName, *fileHandle) == -1) {
+        delete fileHandle;
+        return nullptr;
+    }
+    handleLru.push_front(fileName);
+    fileHandleCache[fileName] = std::make_pair(fileHandle, handleLru.begin());
+    evictHandles();
+    return fileHandle;
+}
+
+IXFileHandle *RelationManager::getIXFileHandle(const std::string &fileName) {
+    auto it = ixFileHandleCache.find(fileName);
+    if (it != ixFileHandleCache.end()) {
+        handleLru.splice(handleLru.begin(), handleLru, it->second.second);
+        return it->second.first;
+    }
+
+    auto *ixFileHandle = new IXFileHandle();
+    if (im->openFile(fileName, *ixFileHandle) == -1) {
+        delete ixFileHandle;
+        return nullptr;
+    }
+    handleLru.push_front(fileName);
+    ixFileHandleCache[fileName] = std::make_pair(ixFileHandle, handleLru.begin());
+    evictHandles();
+    return ixFileHandle;
+}
+
+// write back the dirty pages and the header (and the root page of an index), the handle stays open
+RC RelationManager::flushHandle(const std::string &fileName) {
+    FileHandle *fileHandle;
+    auto it = fileHandleCache.find(fileName);
+    auto ixIt = ixFileHandleCache.find(fileName);
+    if (it != fileHandleCache.end()) {
+        fileHandle = it->second.first;
+    } else if (ixIt != ixFileHandleCache.end()) {
+        ixIt->second.first->_writeRootPageNum();
+        fileHandle = &ixIt->second.first->fileHandle;
+    } else {
+        return 0;
+    }
+    if (BufferManager::instance().flushFile(*fileHandle) == -1) {
+        return -1;
+    }
+    return fileHandle->phyWriteCounterValues();
+}
+
+RC RelationManager::closeHandle(const std::string &fileName) {
+    RC rc;
+    auto it = fileHandleCache.find(fileName);
+    auto ixIt = ixFileHandleCache.find(fileName);
+    if (it != fileHandleCache.end()) {
+        rc = rbfm->closeFile(*it->second.first);
+        delete it->second.first;
+        handleLru.erase(it->second.second);
+        fileHandleCache.erase(it);
+    } else if (ixIt != ixFileHandleCache.end()) {
+        rc = im->closeFile(*ixIt->second.first);
+        delete ixIt->second.first;
+        handleLru.erase(ixIt->second.second);
+        ixFileHandleCache.erase(ixIt);
+    } else {
+        return 0;
+    }
+    return rc;
+}
+
+void RelationManager::evictHandles() {
+    while (handleLru.size() > RM_HANDLE_CACHE_SIZE) {
+        closeHandle(handleLru.back());
+    }
+}
+
+/*
+ * analyze
+ * one scan over the table, per attribute:
+ *  - NULLs are counted
+ *  - a reservoir keeps a uniform sample of the values, sorted it gives the bounds of an equi-depth histogram
+ *  - the smallest hashes of the values estimate the distinct values (k minimum values)
+ * */
+RC RelationManager::analyze(const std::string &tableName) {
+    if (tableNameToAttrMap.count(tableName) == 0) {
+        return -1;
+    }
+    std::vector<Attribute> attrs = tableNameToAttrMap[tableName];
+    std::vector<std::string> attrNames;
+    for (auto const & it : attrs) {
+        attrNames.push_back(it.name);
+    }
+
+    TableStatistics statistics;
+    statistics.columns.resize(attrs.size());
+    std::vector<std::vector<std::string>> samples(attrs.size());
+    std::vector<std::set<size_t>> sketches(attrs.size());
+    std::minstd_rand random(0);
+    std::hash<std::string> hash;
+    unsigned long long totalLength = 0;
+
+    RM_ScanIterator rmsi;
+    if (scan(tableName, NULL_STRING, NO_OP, nullptr, attrNames, rmsi) == -1) {
+        return -1;
+    }
+    RID rid;
+    void *data = malloc(PAGE_SIZE);
+    RC scanRC;
+    while ((scanRC = rmsi.getNextTuple(rid, data)) == 0) {
+        unsigned pos = (attrs.size() + 7) / 8;
+        for (unsigned i = 0; i < attrs.size(); i++) {
+            ColumnStatistics &column = statistics.columns[i];
+            if (RecordBasedFileManager::getNullIndicator(data, i) == 1) {
+                column.nullCount++;
+                continue;
+            }
+            unsigned length = UNSIGNED_SIZE;
+            if (attrs[i].type == TypeVarChar) {
+                memcpy(&length, (char *) data + pos, UNSIGNED_SIZE);
+                length += UNSIGNED_SIZE;
+            }
+            std::string value((char *) data + pos, length);
+            pos += length;
+
+            // every value seen so far is in the sample with the same chance
+            unsigned seen = statistics.rowCount + 1 - column.nullCount;
+            if (samples[i].size() < STATISTICS_SAMPLE_SIZE) {
+                samples[i].push_back(value);
+            } else if (random() % seen < STATISTICS_SAMPLE_SIZE) {
+                samples[i][random() % STATISTICS_SAMPLE_SIZE] = value;
+            }
+
+            std::set<size_t> &sketch = sketches[i];
+            size_t valueHash = hash(value);
+            if (sketch.size() < STATISTICS_SKETCH_SIZE || valueHash < *sketch.rbegin()) {
+                sketch.insert(valueHash);
+                if (sketch.size() > STATISTICS_SKETCH_SIZE) {
+                    sketch.erase(std::prev(sketch.end()));
+                }
+            }
+        }
+        totalLength += pos;
+        statistics.rowCount++;
+    }
+    free(data);
+    rmsi.close();
+    if (scanRC == RM_ERROR) {
+        return -1;
+    }
+
+    statistics.pageCount = getFileHandle(tableNameToFileMap[tableName])->getNumberOfPages();
+    statistics.avgTupleLength = statistics.rowCount == 0 ? 0 : totalLength / statistics.rowCount;
+
+    for (unsigned i = 0; i < attrs.size(); i++) {
+        ColumnStatistics &column = statistics.columns[i];
+        std::set<size_t> &sketch = sketches[i];
+        if (sketch.size() < STATISTICS_SKETCH_SIZE) {
+            column.distinctCount = sketch.size();
+        } else {
+            // k hashes below the k-th smallest, spread evenly over all the hashes of the distinct values
+            double fraction = (double) *sketch.rbegin() / (double) std::numeric_limits<size_t>::max();
+            double estimate = (STATISTICS_SKETCH_SIZE - 1) / fraction;
+            column.distinctCount = (unsigned) std::min<double>(estimate, statistics.rowCount - column.nullCount);
+        }
+
+        std::vector<std::string> &sample = samples[i];
+        AttrType type = attrs[i].type;
+        unsigned prefix = type == TypeVarChar ? UNSIGNED_SIZE : 0;
+        std::sort(sample.begin(), sample.end(), [type, prefix](const std::string &lhs, const std::string &rhs) {
+            return RecordBasedFileManager::compareRawAttributes(lhs.data() + prefix, lhs.size() - prefix,
+                                                                rhs.data() + prefix, rhs.size() - prefix, type) < 0;
+        });
+        for (unsigned bucket = 0; bucket <= STATISTICS_BUCKETS && !sample.empty(); bucket++) {
+            std::string bound = sample[std::min<size_t>(sample.size() - 1, bucket * sample.size() / STATISTICS_BUCKETS)];
+            if (type == TypeVarChar && bound.size() > UNSIGNED_SIZE + STATISTICS_BOUND_PREFIX) {
+                unsigned length = STATISTICS_BOUND_PREFIX;
+                bound.resize(UNSIGNED_SIZE + STATISTICS_BOUND_PREFIX);
+                memcpy(&bound[0], &length, UNSIGNED_SIZE);
+            }
+            column.bounds.push_back(bound);
+        }
+    }
+
+    // replace the rows of the last analyze
+    if (tableNameToFileMap.count(STATISTICS_NAME) == 0) {
+        createTable(STATISTICS_NAME, statisticsAttr, true);
+    }
+    deleteStatistics(tableName);
+    RC rc = 0;
+    data = malloc(PAGE_SIZE);
+    for (unsigned position = 0; position <= attrs.size() && rc == 0; position++) {
+        generateStatisticsData(data, tableName, position, statistics);
+        rc = insertTuple(STATISTICS_NAME, data, rid, true);
+    }
+    free(data);
+    statisticsMap[tableName] = statistics;
+    return rc;
+}
+
+RC RelationManager::getStatistics(const std::string &tableName, TableStatistics &statistics) {
+    auto it = statisticsMap.find(tableName);
+    if (it == statisticsMap.end()) {
+        return -1;
+    }
+    statistics = it->second;
+    return 0;
+}
+
+RC RelationManager::deleteStatistics(const std::string &tableName) {
+    statisticsMap.erase(tableName);
+    if (tableNameToFileMap.count(STATISTICS_NAME) == 0) {
+        return 0;
+    }
+
+    std::string value(UNSIGNED_SIZE, '\0');
+    unsigned length = tableName.size();
+    memcpy(&value[0], &length, UNSIGNED_SIZE);
+    value += tableName;
+    RM_ScanIterator rmsi;
+    scan(STATISTICS_NAME, Predicate::compare("table-name", EQ_OP, TypeVarChar, value.data()),
+         std::vector<std::string>{"table-name"}, rmsi);
+    RID rid;
+    std::vector<RID> rids;
+    void *data = malloc(PAGE_SIZE);
+    RC rc = 0;
+    while ((rc = rmsi.getNextTuple(rid, data)) == 0) {
+        rids.push_back(rid);
+    }
+    free(data);
+    rmsi.close();
+
+    rc = rc == RM_ERROR ? -1 : 0;
+    for (auto const & it : rids) {
+        if (deleteTuple(STATISTICS_NAME, it, true) == -1) {
+            rc = -1;
+        }
+    }
+    return rc;
+}
+
+void RelationManager::initScanStatistics() {
+    RM_ScanIterator rmsi;
+    scan(STATISTICS_NAME, NULL_STRING, NO_OP, nullptr, statisticsAttrNames, rmsi);
+
+    RID rid;
+    void *data = malloc(PAGE_SIZE);
+    while (rmsi.getNextTuple(rid, data) == 0) {
+        parseStatisticsData(data);
+    }
+    free(data);
+    rmsi.close();
+}
+
+unsigned RelationManager::generateStatisticsData(void *data, const std::string &tableName, unsigned position,
+                                                 const TableStatistics &statistics) {
+    unsigned char nullIndicator = 0x00;
+    unsigned pos = 0;
+    memcpy(data, &nullIndicator, NULL_INDICATOR_UNIT_SIZE);
+    pos += NULL_INDICATOR_UNIT_SIZE;
+
+    unsigned length = tableName.size();
+    memcpy((char *) data + pos, &length, UNSIGNED_SIZE);
+    pos += UNSIGNED_SIZE;
+    memcpy((char *) data + pos, tableName.c_str(), length);
+    pos += length;
+
+    // the table fills the counts of the table, an attribute the ones of the attribute
+    ColumnStatistics column;
+    if (position != 0) {
+        column = statistics.columns[position - 1];
+    }
+    unsigned values[6] = {position, position == 0 ? statistics.rowCount : 0, position == 0 ? statistics.pageCount : 0,
+                          position == 0 ? statistics.avgTupleLength : 0, column.nullCount, column.distinctCount};
+    memcpy((char *) data + pos, values, sizeof(values));
+    pos += sizeof(values);
+
+    std::string histogram;
+    for (auto const & it : column.bounds) {
+        histogram += it;
+    }
+    length = histogram.size();
+    memcpy((char *) data + pos, &length, UNSIGNED_SIZE);
+    pos += UNSIGNED_SIZE;
+    memcpy((char *) data + pos, histogram.data(), length);
+    pos += length;
+    return pos;
+}
+
+void RelationManager::parseStatisticsData(const void *data) {
+    unsigned pos = NULL_INDICATOR_UNIT_SIZE;
+    unsigned length;
+    memcpy(&length, (const char *) data + pos, UNSIGNED_SIZE);
+    pos += UNSIGNED_SIZE;
+    std::string tableName((const char *) data + pos, length);
+    pos += length;
+
+    unsigned values[6];
+    memcpy(values, (const char *) data + pos, sizeof(values));
+    pos += sizeof(values);
+    memcpy(&length, (const char *) data + pos, UNSIGNED_SIZE);
+    pos += UNSIGNED_SIZE;
+    std::string histogram((const char *) data + pos, length);
+
+    if (tableNameToAttrMap.count(tableName) == 0) {
+        return;
+    }
+    std::vector<Attribute> &attrs = tableNameToAttrMap[tableName];
+    TableStatistics &statistics = statisticsMap[tableName];
+    statistics.columns.resize(attrs.size());
+    unsigned position = values[0];
+    if (position == 0) {
+        statistics.rowCount = values[1];
+        statistics.pageCount = values[2];
+        statistics.avgTupleLength = values[3];
+        return;
+    }
+    if (position > attrs.size()) {
+        return;
+    }
+
+    ColumnStatistics &column = statistics.columns[position - 1];
+    column.nullCount = values[4];
+    column.distinctCount = values[5];
+    column.bounds.clear();
+    for (unsigned offset = 0; offset < histogram.size();) {
+        unsigned boundLength = UNSIGNED_SIZE;
+        if (attrs[position - 1].type == TypeVarChar) {
+            memcpy(&boundLength, histogram.data() + offset, UNSIGNED_SIZE);
+            boundLength += UNSIGNED_SIZE;
+        }
+        column.bounds.push_back(histogram.substr(offset, boundLength));
+        offset += boundLength;
+    }
+}
+
 
 
 RC  RM_IndexScanIterator::getNextEntry(RID &rid, void *key) {
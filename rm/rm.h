@@ -3,12 +3,14 @@
 
 #include <string>
 #include <vector>
+#include <list>
 #include <unordered_map>
 #include <unordered_set>
 
 #include "../ix/ix.h"
 
 # define RM_EOF (-1)  // end of a scan operator
+# define RM_ERROR (-2)  // a scan could not read its next page, same as RBFM_ERROR
 
 # define TABLES_FILE_NAME "Tables.tbl"
 # define COLUMNS_FILE_NAME "Columns.tbl"
@@ -16,9 +18,12 @@
 # define TABLES_NAME "Tables"
 # define COLUMNS_NAME "Columns"
 # define INDEX_NAME "Index"
+# define STATISTICS_FILE_NAME "Statistics.tbl"
+# define STATISTICS_NAME "Statistics"
 # define EXT ".tbl"
 # define IDX_EXT ".idx"
 # define SM_BLOCK 500
+# define RM_HANDLE_CACHE_SIZE 32
 
 #define NULL_STRING ""
 
@@ -26,8 +31,30 @@
 #define COLUMNS_ATTRIBUTE_SIZE 5
 #define SYSTEM_INDICATOR_SIZE 4
 
+#define STATISTICS_BUCKETS 10               // buckets of an equi-depth histogram
+#define STATISTICS_SAMPLE_SIZE 10000        // values of an attribute the histogram is built from
+#define STATISTICS_SKETCH_SIZE 1024         // smallest hashes kept to estimate the distinct values
+#define STATISTICS_BOUND_PREFIX 20          // VarChar bounds keep this many characters
+#define STATISTICS_HISTOGRAM_SIZE ((STATISTICS_BUCKETS + 1) * (UNSIGNED_SIZE + STATISTICS_BOUND_PREFIX))
+
 class RelationManager;
 
+// Statistics of one attribute, gathered by RelationManager::analyze
+struct ColumnStatistics {
+    unsigned nullCount = 0;
+    unsigned distinctCount = 0;
+    // equi-depth histogram, bounds[0] is the smallest value and bounds.back() the largest.
+    // about as many values fall between every two neighbours. in data format, without a null indicator
+    std::vector<std::string> bounds;
+};
+
+struct TableStatistics {
+    unsigned rowCount = 0;
+    unsigned pageCount = 0;
+    unsigned avgTupleLength = 0;            // in data format
+    std::vector<ColumnStatistics> columns;  // in attribute order
+};
+
 // RM_ScanIterator is an iterator to go through tuples
 class RM_ScanIterator {
 public:
@@ -71,10 +98,12 @@ public:
     std::vector<Attribute> tableAttr;
     std::vector<Attribute> columnAttr;
     std::vector<Attribute> indexAttr;
+    std::vector<Attribute> statisticsAttr;
     
     std::vector<std::string> tableAttributeNames;
     std::vector<std::string> columnAttributeNames;
     std::vector<std::string> indexAttrNames;
+    std::vector<std::string> statisticsAttrNames;
 
 
     // tableName -> fileName
@@ -97,6 +126,9 @@ public:
     // tableName -> vector<Attribute Name>
     std::unordered_map<std::string, std::unordered_set<int>> indexMap;
 
+    // tableName -> statistics of its last analyze
+    std::unordered_map<std::string, TableStatistics> statisticsMap;
+
     static void appendAttr(std::vector<Attribute> &attrArr, std::string name, AttrType type, AttrLength len);
 
     RC createCatalog();
@@ -115,6 +147,10 @@ public:
 
     RC insertTuple(const std::string &tableName, const void *data, RID &rid, bool isInternalCall);
 
+    // Insert a batch of tuples, rids[i] is the RID of tuples[i].
+    // Records are packed into whole pages, then every index takes its entries in key order.
+    RC insertTuples(const std::string &tableName, const std::vector<const void *> &tuples, std::vector<RID> &rids);
+
     RC deleteTuple(const std::string &tableName, const RID &rid);
 
     RC deleteTuple(const std::string &tableName, const RID &rid, bool isInternalCall);
@@ -123,6 +159,9 @@ public:
 
     RC readTuple(const std::string &tableName, const RID &rid, void *data);
 
+    // Bring the pages of the tuples into the buffer pool in one batch of reads, ahead of readTuple.
+    RC prefetchTuples(const std::string &tableName, const std::vector<RID> &rids);
+
     // Print a tuple that is passed to this utility method.
     // The format is the same as printRecord().
     RC printTuple(const std::vector <Attribute> &attrs, const void *data);
@@ -138,6 +177,12 @@ public:
             const std::vector<std::string> &attributeNames, // a list of projected attributes
             RM_ScanIterator &rm_ScanIterator);
 
+    // Scan with a compound predicate over the attributes of the table.
+    RC scan(const std::string &tableName,
+            const Predicate &predicate,
+            const std::vector<std::string> &attributeNames,
+            RM_ScanIterator &rm_ScanIterator);
+
     static void generateTablesData(unsigned id, const std::string& tableName, std::string fileName, void *data,
                             bool isSystemTable);
 
@@ -149,6 +194,8 @@ public:
 
     void initScanIndex();
 
+    void initScanStatistics();
+
     static void parseTablesData(void *data, std::string &tableName, std::string &fileName, unsigned int &id,
                          bool &isSystemTable);
 
@@ -157,11 +204,24 @@ public:
     static void
     parseIndexData(void *data, std::string &tableName, std::string &attrName, int &index, std::string &fileName);
 
+    // position 0 is the table, position i its i-th attribute
+    static unsigned generateStatisticsData(void *data, const std::string &tableName, unsigned position,
+                                           const TableStatistics &statistics);
+
+    void parseStatisticsData(const void *data);
+
     // Extra credit work (10 points)
     RC addAttribute(const std::string &tableName, const Attribute &attr);
 
     RC dropAttribute(const std::string &tableName, const std::string &attributeName);
 
+    // Scan the table once for its rows, pages and per attribute NULLs, distinct values and histogram.
+    // The result replaces the last one in the Statistics catalog table, created on first use.
+    RC analyze(const std::string &tableName);
+
+    // -1 if the table was never analyzed
+    RC getStatistics(const std::string &tableName, TableStatistics &statistics);
+
     // QE IX related
     RC createIndex(const std::string &tableName, const std::string &attributeName);
 
@@ -178,8 +238,15 @@ public:
                  bool highKeyInclusive,
                  RM_IndexScanIterator &rm_IndexScanIterator);
 
+    // scans of a read-mostly table and of its indexes read the pages in place from a read-only mapping of the
+    // files instead of the buffer pool. a scan does not see the pages appended after it started
+    RC setMappedScans(const std::string &tableName, bool mapped);
 
+    // table and index files stay open across calls, at most RM_HANDLE_CACHE_SIZE of them
+    // flush writes the headers of the cached handles so other handles on the same files see them
+    RC flushHandles();
 
+    RC closeHandles();
 
 protected:
     RelationManager();                                                  // Prevent construction
@@ -192,6 +259,26 @@ private:
     IndexManager *im;
     PagedFileManager *pfm;
     static RelationManager *_relation_manager;
+
+    // fileName -> open handle and its position in handleLru, most recently used first
+    std::list<std::string> handleLru;
+    std::unordered_map<std::string, std::pair<FileHandle *, std::list<std::string>::iterator>> fileHandleCache;
+    std::unordered_map<std::string, std::pair<IXFileHandle *, std::list<std::string>::iterator>> ixFileHandleCache;
+
+    // tables set by setMappedScans
+    std::unordered_set<std::string> mappedTables;
+
+    FileHandle *getFileHandle(const std::string &fileName);
+
+    IXFileHandle *getIXFileHandle(const std::string &fileName);
+
+    RC flushHandle(const std::string &fileName);
+
+    RC closeHandle(const std::string &fileName);
+
+    void evictHandles();
+
+    RC deleteStatistics(const std::string &tableName);
 };
 
 #endif
\ No newline at end of file
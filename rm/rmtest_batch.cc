@@ -0,0 +1,111 @@
+#include "rm_test_util.h"
+
+RC TEST_RM_BATCH(const std::string &tableName) {
+    // Functions tested
+    // 1. Insert Tuples as a batch into an empty index **
+    // 2. Insert Tuples as a batch into a non-empty table and index **
+    // 3. Read Tuple
+    // 4. Scan / Index Scan
+    std::cout << std::endl << "***** In RM Test Case Batch *****" << std::endl;
+
+    rm.deleteTable(tableName);
+    createTable(tableName);
+    RC rc = rm.createIndex(tableName, "Age");
+    assert(rc == success && "RelationManager::createIndex() should not fail.");
+
+    std::vector<Attribute> attrs;
+    rc = rm.getAttributes(tableName, attrs);
+    assert(rc == success && "RelationManager::getAttributes() should not fail.");
+
+    unsigned nullAttributesIndicatorActualSize = getActualByteForNullsIndicator(attrs.size());
+    auto *nullsIndicator = (unsigned char *) malloc(nullAttributesIndicatorActualSize);
+    memset(nullsIndicator, 0, nullAttributesIndicatorActualSize);
+
+    // one tuple the old way so the table does not start on an empty page
+    int numTuples = 6000;
+    unsigned tupleSize = 0;
+    void *tuple = malloc(200);
+    std::string name = "Anteater";
+    RID firstRid;
+    prepareTuple(attrs.size(), nullsIndicator, name.size(), name, numTuples, 180.0, 0, tuple, &tupleSize);
+    rc = rm.insertTuple(tableName, tuple, firstRid);
+    assert(rc == success && "RelationManager::insertTuple() should not fail.");
+    free(tuple);
+
+    // two batches, ages in descending order
+    std::vector<void *> tuples;
+    std::vector<unsigned> sizes;
+    for (int i = 0; i < numTuples; i++) {
+        tuple = malloc(200);
+        prepareTuple(attrs.size(), nullsIndicator, name.size(), name, numTuples - 1 - i, 170.0 + i, i, tuple,
+                     &tupleSize);
+        tuples.push_back(tuple);
+        sizes.push_back(tupleSize);
+    }
+    std::vector<RID> rids;
+    for (int batch = 0; batch < 2; batch++) {
+        std::vector<const void *> data(tuples.begin() + batch * numTuples / 2,
+                                       tuples.begin() + (batch + 1) * numTuples / 2);
+        std::vector<RID> batchRids;
+        rc = rm.insertTuples(tableName, data, batchRids);
+        assert(rc == success && "RelationManager::insertTuples() should not fail.");
+        assert(batchRids.size() == data.size() && "Every tuple should get a RID.");
+        rids.insert(rids.end(), batchRids.begin(), batchRids.end());
+    }
+
+    bool failed = false;
+    void *returnedData = malloc(200);
+    for (int i = 0; i < numTuples; i++) {
+        rc = rm.readTuple(tableName, rids[i], returnedData);
+        if (rc != success || memcmp(returnedData, tuples[i], sizes[i]) != 0) {
+            failed = true;
+        }
+    }
+
+    RM_ScanIterator rmsi;
+    std::vector<std::string> attributes = {"Age"};
+    rc = rm.scan(tableName, "", NO_OP, NULL, attributes, rmsi);
+    assert(rc == success && "RelationManager::scan() should not fail.");
+    RID rid;
+    int count = 0;
+    while (rmsi.getNextTuple(rid, returnedData) != RM_EOF) {
+        count++;
+    }
+    rmsi.close();
+
+    // every age once, in order
+    RM_IndexScanIterator rmisi;
+    rc = rm.indexScan(tableName, "Age", NULL, NULL, true, true, rmisi);
+    assert(rc == success && "RelationManager::indexScan() should not fail.");
+    int indexCount = 0;
+    int age;
+    while (rmisi.getNextEntry(rid, &age) != RM_EOF) {
+        if (age != indexCount) {
+            failed = true;
+        }
+        indexCount++;
+    }
+    rmisi.close();
+
+    rc = rm.deleteTable(tableName);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+
+    for (auto t : tuples) {
+        free(t);
+    }
+    free(returnedData);
+    free(nullsIndicator);
+
+    if (failed || count != numTuples + 1 || indexCount != numTuples + 1) {
+        std::cout << count << " tuples, " << indexCount << " index entries" << std::endl;
+        std::cout << "***** [FAIL] RM Test Case Batch failed. *****" << std::endl << std::endl;
+        return -1;
+    }
+    std::cout << "***** RM Test Case Batch finished. The result will be examined. *****" << std::endl << std::endl;
+    return success;
+}
+
+int main() {
+    // Batched inserts with index maintenance
+    return TEST_RM_BATCH("tbl_batch");
+}
@@ -0,0 +1,118 @@
+#include "rm_test_util.h"
+
+RC TEST_RM_CACHE(const std::string &tableNamePrefix) {
+    // Functions tested
+    // 1. Insert / Read / Update / Delete Tuple on more tables than there are cached handles **
+    // 2. Scan and Index Scan see what went through the cached handles **
+    // 3. Delete Table with its handles still cached **
+    std::cout << std::endl << "***** In RM Test Case Cache *****" << std::endl;
+
+    unsigned numTables = RM_HANDLE_CACHE_SIZE / 2 + 4;
+    int numTuples = 20;
+    std::vector<std::string> tableNames;
+    for (unsigned i = 0; i < numTables; i++) {
+        std::string tableName = tableNamePrefix + std::to_string(i);
+        rm.deleteTable(tableName);
+        createTable(tableName);
+        RC rc = rm.createIndex(tableName, "Age");
+        assert(rc == success && "RelationManager::createIndex() should not fail.");
+        tableNames.push_back(tableName);
+    }
+
+    std::vector<Attribute> attrs;
+    RC rc = rm.getAttributes(tableNames[0], attrs);
+    assert(rc == success && "RelationManager::getAttributes() should not fail.");
+
+    unsigned nullAttributesIndicatorActualSize = getActualByteForNullsIndicator(attrs.size());
+    auto *nullsIndicator = (unsigned char *) malloc(nullAttributesIndicatorActualSize);
+    memset(nullsIndicator, 0, nullAttributesIndicatorActualSize);
+    void *tuple = malloc(200);
+    void *returnedData = malloc(200);
+    unsigned tupleSize = 0;
+    std::string name = "Peter";
+
+    // round robin over the tables, so every insert evicts a handle
+    std::vector<std::vector<RID>> rids(numTables);
+    for (int j = 0; j < numTuples; j++) {
+        for (unsigned i = 0; i < numTables; i++) {
+            RID rid;
+            prepareTuple(attrs.size(), nullsIndicator, name.size(), name, j, 170.0, (int) i, tuple, &tupleSize);
+            rc = rm.insertTuple(tableNames[i], tuple, rid);
+            assert(rc == success && "RelationManager::insertTuple() should not fail.");
+            rids[i].push_back(rid);
+        }
+    }
+
+    bool failed = false;
+    for (unsigned i = 0; i < numTables; i++) {
+        // age 0 -> 100, delete age 1
+        prepareTuple(attrs.size(), nullsIndicator, name.size(), name, 100, 170.0, (int) i, tuple, &tupleSize);
+        rc = rm.updateTuple(tableNames[i], tuple, rids[i][0]);
+        assert(rc == success && "RelationManager::updateTuple() should not fail.");
+        rc = rm.deleteTuple(tableNames[i], rids[i][1]);
+        assert(rc == success && "RelationManager::deleteTuple() should not fail.");
+
+        rc = rm.readTuple(tableNames[i], rids[i][numTuples - 1], returnedData);
+        assert(rc == success && "RelationManager::readTuple() should not fail.");
+        prepareTuple(attrs.size(), nullsIndicator, name.size(), name, numTuples - 1, 170.0, (int) i, tuple,
+                     &tupleSize);
+        if (memcmp(tuple, returnedData, tupleSize) != 0) {
+            failed = true;
+        }
+    }
+
+    for (unsigned i = 0; i < numTables; i++) {
+        RM_ScanIterator rmsi;
+        std::vector<std::string> attributes = {"Age"};
+        rc = rm.scan(tableNames[i], "", NO_OP, NULL, attributes, rmsi);
+        assert(rc == success && "RelationManager::scan() should not fail.");
+        RID rid;
+        int count = 0;
+        while (rmsi.getNextTuple(rid, returnedData) != RM_EOF) {
+            count++;
+        }
+        rmsi.close();
+
+        RM_IndexScanIterator rmisi;
+        int lowAge = 2;
+        rc = rm.indexScan(tableNames[i], "Age", &lowAge, NULL, true, true, rmisi);
+        assert(rc == success && "RelationManager::indexScan() should not fail.");
+        int indexCount = 0;
+        int age;
+        while (rmisi.getNextEntry(rid, &age) != RM_EOF) {
+            indexCount++;
+        }
+        rmisi.close();
+
+        // 18 untouched tuples from age 2 on, plus the updated one
+        if (count != numTuples - 1 || indexCount != numTuples - 1) {
+            std::cout << tableNames[i] << ": " << count << " tuples, " << indexCount << " index entries"
+                      << std::endl;
+            failed = true;
+        }
+    }
+
+    rc = rm.flushHandles();
+    assert(rc == success && "RelationManager::flushHandles() should not fail.");
+
+    for (const auto &tableName : tableNames) {
+        rc = rm.deleteTable(tableName);
+        assert(rc == success && "RelationManager::deleteTable() should not fail.");
+    }
+
+    free(tuple);
+    free(returnedData);
+    free(nullsIndicator);
+
+    if (failed) {
+        std::cout << "***** [FAIL] RM Test Case Cache failed. *****" << std::endl << std::endl;
+        return -1;
+    }
+    std::cout << "***** RM Test Case Cache finished. The result will be examined. *****" << std::endl << std::endl;
+    return success;
+}
+
+int main() {
+    // Point operations through the handle cache
+    return TEST_RM_CACHE("tbl_cache_");
+}
@@ -0,0 +1,193 @@
+#include "rm_test_util.h"
+
+RC TEST_RM_MMAP_FILE(const std::string &fileName) {
+    // Functions tested
+    // 1. Open a file mapped, pinPage points into the mapping and readPage copies from it **
+    // 2. Writes through a mapped handle fail, the file is left as it was **
+    std::cout << std::endl << "***** In RM Test Case Mmap File *****" << std::endl;
+
+    PagedFileManager &pfm = PagedFileManager::instance();
+    pfm.destroyFile(fileName);
+    RC rc = pfm.createFile(fileName);
+    assert(rc == success && "Creating the file should not fail.");
+
+    FileHandle fileHandle;
+    rc = pfm.openFile(fileName, fileHandle);
+    assert(rc == success && "Opening the file should not fail.");
+    unsigned numPages = 5;
+    char page[PAGE_SIZE];
+    for (unsigned i = 0; i < numPages; i++) {
+        memset(page, 'a' + i, PAGE_SIZE);
+        rc = fileHandle.appendPage(page);
+        assert(rc == success && "Appending a page should not fail.");
+    }
+    // left dirty in the pool, mapping the file writes it back first
+    memset(page, 'z', PAGE_SIZE);
+    rc = fileHandle.writePage(numPages - 1, page);
+    assert(rc == success && "Writing a page should not fail.");
+    // another handle reads the page count from the header
+    rc = fileHandle.phyWriteCounterValues();
+    assert(rc == success && "Writing the header should not fail.");
+
+    bool failed = false;
+    FileHandle mappedHandle;
+    rc = pfm.openFile(fileName, mappedHandle, true);
+    assert(rc == success && "Opening the file mapped should not fail.");
+    if (!mappedHandle.isMapped() || mappedHandle.getNumberOfPages() != numPages) {
+        failed = true;
+    }
+
+    // 1.
+    for (unsigned i = 0; i < numPages; i++) {
+        void *data;
+        char expected = i == numPages - 1 ? 'z' : (char) ('a' + i);
+        if (mappedHandle.pinPage(i, data) != success || ((char *) data)[0] != expected ||
+            ((char *) data)[PAGE_SIZE - 1] != expected || mappedHandle.unpinPage(i, false) != success) {
+            failed = true;
+        }
+        if (mappedHandle.readPage(i, page) != success || page[PAGE_SIZE / 2] != expected) {
+            failed = true;
+        }
+    }
+    void *data;
+    if (mappedHandle.pinPage(numPages, data) != -1) {
+        failed = true;
+    }
+
+    // 2.
+    memset(page, 'y', PAGE_SIZE);
+    if (mappedHandle.writePage(0, page) != -1 || mappedHandle.appendPage(page) != -1 ||
+        mappedHandle.unpinPage(0, true) != -1 || mappedHandle.getNumberOfPages() != numPages) {
+        failed = true;
+    }
+    unsigned readPageCount, writePageCount, appendPageCount;
+    mappedHandle.collectCounterValues(readPageCount, writePageCount, appendPageCount);
+    if (readPageCount < 2 * numPages || appendPageCount != numPages) {
+        failed = true;
+    }
+    rc = pfm.closeFile(mappedHandle);
+    assert(rc == success && "Closing the mapped file should not fail.");
+    if (mappedHandle.isMapped()) {
+        failed = true;
+    }
+
+    rc = pfm.closeFile(fileHandle);
+    assert(rc == success && "Closing the file should not fail.");
+    rc = pfm.destroyFile(fileName);
+    assert(rc == success && "Destroying the file should not fail.");
+
+    if (failed) {
+        std::cout << "***** [FAIL] RM Test Case Mmap File failed. *****" << std::endl << std::endl;
+        return -1;
+    }
+    std::cout << "***** RM Test Case Mmap File finished. The result will be examined. *****" << std::endl << std::endl;
+    return success;
+}
+
+RC TEST_RM_MMAP_SCAN(const std::string &tableName) {
+    // Functions tested
+    // 1. Scan and Index Scan of a table set to mapped scans, after updates still in the buffer pool **
+    // 2. The same scans with mapped scans switched off again **
+    std::cout << std::endl << "***** In RM Test Case Mmap Scan *****" << std::endl;
+
+    rm.deleteTable(tableName);
+    createTable(tableName);
+    RC rc = rm.createIndex(tableName, "Age");
+    assert(rc == success && "RelationManager::createIndex() should not fail.");
+
+    std::vector<Attribute> attrs;
+    rc = rm.getAttributes(tableName, attrs);
+    assert(rc == success && "RelationManager::getAttributes() should not fail.");
+
+    unsigned nullAttributesIndicatorActualSize = getActualByteForNullsIndicator(attrs.size());
+    auto *nullsIndicator = (unsigned char *) malloc(nullAttributesIndicatorActualSize);
+    memset(nullsIndicator, 0, nullAttributesIndicatorActualSize);
+    void *tuple = malloc(200);
+    void *returnedData = malloc(200);
+    unsigned tupleSize = 0;
+    std::string name = "Peter Anteater";
+
+    // a few dozen pages
+    int numTuples = 2000;
+    std::vector<RID> rids;
+    for (int i = 0; i < numTuples; i++) {
+        RID rid;
+        prepareTuple(attrs.size(), nullsIndicator, name.size(), name, i % 100, 170.0, i, tuple, &tupleSize);
+        rc = rm.insertTuple(tableName, tuple, rid);
+        assert(rc == success && "RelationManager::insertTuple() should not fail.");
+        rids.push_back(rid);
+    }
+    // every 10th tuple gets age 1000
+    for (int i = 0; i < numTuples; i += 10) {
+        prepareTuple(attrs.size(), nullsIndicator, name.size(), name, 1000, 170.0, i, tuple, &tupleSize);
+        rc = rm.updateTuple(tableName, tuple, rids[i]);
+        assert(rc == success && "RelationManager::updateTuple() should not fail.");
+    }
+    long long expectedSum = 0;
+    for (int i = 0; i < numTuples; i++) {
+        expectedSum += i % 10 == 0 ? 1000 : i % 100;
+    }
+
+    bool failed = rm.setMappedScans(tableName + "_missing", true) != -1;
+    for (int mapped = 1; mapped >= 0; mapped--) {
+        rc = rm.setMappedScans(tableName, mapped == 1);
+        assert(rc == success && "RelationManager::setMappedScans() should not fail.");
+
+        RM_ScanIterator rmsi;
+        rc = rm.scan(tableName, "", NO_OP, NULL, {"Age"}, rmsi);
+        assert(rc == success && "RelationManager::scan() should not fail.");
+        if (rmsi.fileHandle.isMapped() != (mapped == 1)) {
+            failed = true;
+        }
+        RID rid;
+        int count = 0;
+        long long sum = 0;
+        while (rmsi.getNextTuple(rid, returnedData) != RM_EOF) {
+            int age;
+            memcpy(&age, (char *) returnedData + 1, sizeof(int));
+            sum += age;
+            count++;
+        }
+        rmsi.close();
+
+        RM_IndexScanIterator rmisi;
+        int lowAge = 1000;
+        rc = rm.indexScan(tableName, "Age", &lowAge, NULL, true, true, rmisi);
+        assert(rc == success && "RelationManager::indexScan() should not fail.");
+        int indexCount = 0;
+        int age;
+        while (rmisi.getNextEntry(rid, &age) != RM_EOF) {
+            indexCount += age == 1000 ? 1 : 0;
+        }
+        rmisi.close();
+
+        if (count != numTuples || sum != expectedSum || indexCount != numTuples / 10) {
+            std::cout << (mapped == 1 ? "mapped: " : "unmapped: ") << count << " tuples, sum " << sum << ", "
+                      << indexCount << " index entries" << std::endl;
+            failed = true;
+        }
+    }
+
+    rc = rm.deleteTable(tableName);
+    assert(rc == success && "RelationManager::deleteTable() should not fail.");
+
+    free(tuple);
+    free(returnedData);
+    free(nullsIndicator);
+
+    if (failed) {
+        std::cout << "***** [FAIL] RM Test Case Mmap Scan failed. *****" << std::endl << std::endl;
+        return -1;
+    }
+    std::cout << "***** RM Test Case Mmap Scan finished. The result will be examined. *****" << std::endl << std::endl;
+    return success;
+}
+
+int main() {
+    // Reads through read-only mappings of the files
+    RC rc = TEST_RM_MMAP_FILE("test_mmap");
+    if (TEST_RM_MMAP_SCAN("tbl_mmap") != success) {
+        rc = -1;
+    }
+    return rc;
+}